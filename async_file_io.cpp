@@ -0,0 +1,260 @@
+#include "voipmonitor.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "async_file_io.h"
+#include "tools.h"
+
+
+#ifndef FREEBSD
+
+// linux/io_uring.h is missing in older distributions - only the needed subset of the uapi follows
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup		425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter		426
+#endif
+#define AIO_IORING_OFF_SQ_RING		0ULL
+#define AIO_IORING_OFF_CQ_RING		0x8000000ULL
+#define AIO_IORING_OFF_SQES		0x10000000ULL
+#define AIO_IORING_FEAT_RW_CUR_POS	(1U << 3)
+#define AIO_IORING_OP_READ		22
+#define AIO_IORING_OP_WRITE		23
+#define AIO_IOSQE_ASYNC			(1U << 4)
+
+struct sAioSqringOffsets {
+	u_int32_t head;
+	u_int32_t tail;
+	u_int32_t ring_mask;
+	u_int32_t ring_entries;
+	u_int32_t flags;
+	u_int32_t dropped;
+	u_int32_t array;
+	u_int32_t resv1;
+	u_int64_t resv2;
+};
+
+struct sAioCqringOffsets {
+	u_int32_t head;
+	u_int32_t tail;
+	u_int32_t ring_mask;
+	u_int32_t ring_entries;
+	u_int32_t overflow;
+	u_int32_t cqes;
+	u_int32_t flags;
+	u_int32_t resv1;
+	u_int64_t resv2;
+};
+
+struct sAioUringParams {
+	u_int32_t sq_entries;
+	u_int32_t cq_entries;
+	u_int32_t flags;
+	u_int32_t sq_thread_cpu;
+	u_int32_t sq_thread_idle;
+	u_int32_t features;
+	u_int32_t wq_fd;
+	u_int32_t resv[3];
+	sAioSqringOffsets sq_off;
+	sAioCqringOffsets cq_off;
+};
+
+struct sAioUringSqe {
+	u_int8_t opcode;
+	u_int8_t flags;
+	u_int16_t ioprio;
+	int32_t fd;
+	u_int64_t off;
+	u_int64_t addr;
+	u_int32_t len;
+	u_int32_t rw_flags;
+	u_int64_t user_data;
+	u_int16_t buf_index;
+	u_int16_t personality;
+	int32_t splice_fd_in;
+	u_int64_t pad2[2];
+};
+
+struct sAioUringCqe {
+	u_int64_t user_data;
+	int32_t res;
+	u_int32_t flags;
+};
+
+#endif //FREEBSD
+
+
+cAsyncFileIO::cAsyncFileIO() {
+	ringFd = -1;
+	entries = 0;
+	sqRing = NULL;
+	sqRingSize = 0;
+	cqRing = NULL;
+	cqRingSize = 0;
+	sqes = NULL;
+	sqesSize = 0;
+	sqTail = NULL;
+	sqMask = NULL;
+	sqArray = NULL;
+	cqHead = NULL;
+	cqTail = NULL;
+	cqMask = NULL;
+	cqes = NULL;
+}
+
+cAsyncFileIO::~cAsyncFileIO() {
+	term();
+}
+
+bool cAsyncFileIO::init(unsigned entries, std::string *error) {
+	#ifndef FREEBSD
+	sAioUringParams params;
+	memset(&params, 0, sizeof(params));
+	ringFd = syscall(__NR_io_uring_setup, entries, &params);
+	if(ringFd < 0) {
+		if(error) {
+			*error = std::string("io_uring_setup failed: ") + strerror(errno);
+		}
+		ringFd = -1;
+		return(false);
+	}
+	if(!(params.features & AIO_IORING_FEAT_RW_CUR_POS)) {
+		if(error) {
+			*error = "io_uring in this kernel is too old (required 5.6)";
+		}
+		term();
+		return(false);
+	}
+	this->entries = params.sq_entries;
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(sAioUringCqe);
+	sqesSize = params.sq_entries * sizeof(sAioUringSqe);
+	sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, AIO_IORING_OFF_SQ_RING);
+	cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, AIO_IORING_OFF_CQ_RING);
+	sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, AIO_IORING_OFF_SQES);
+	if(sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+		if(error) {
+			*error = std::string("io_uring mmap failed: ") + strerror(errno);
+		}
+		term();
+		return(false);
+	}
+	sqTail = (unsigned*)((u_char*)sqRing + params.sq_off.tail);
+	sqMask = (unsigned*)((u_char*)sqRing + params.sq_off.ring_mask);
+	sqArray = (unsigned*)((u_char*)sqRing + params.sq_off.array);
+	cqHead = (unsigned*)((u_char*)cqRing + params.cq_off.head);
+	cqTail = (unsigned*)((u_char*)cqRing + params.cq_off.tail);
+	cqMask = (unsigned*)((u_char*)cqRing + params.cq_off.ring_mask);
+	cqes = (u_char*)cqRing + params.cq_off.cqes;
+	return(true);
+	#else
+	if(error) {
+		*error = "io_uring is not supported";
+	}
+	return(false);
+	#endif //FREEBSD
+}
+
+bool cAsyncFileIO::submitWrite(int fd, const void *buffer, size_t length, u_int64_t offset, sRequest *request) {
+	#ifndef FREEBSD
+	return(submit(AIO_IORING_OP_WRITE, AIO_IOSQE_ASYNC, fd, buffer, length, offset, request));
+	#else
+	return(false);
+	#endif //FREEBSD
+}
+
+bool cAsyncFileIO::submitRead(int fd, void *buffer, size_t length, u_int64_t offset, sRequest *request) {
+	#ifndef FREEBSD
+	return(submit(AIO_IORING_OP_READ, 0, fd, buffer, length, offset, request));
+	#else
+	return(false);
+	#endif //FREEBSD
+}
+
+bool cAsyncFileIO::submit(u_int8_t opcode, u_int8_t flags, int fd, const void *buffer, size_t length, u_int64_t offset, sRequest *request) {
+	#ifndef FREEBSD
+	if(ringFd < 0) {
+		return(false);
+	}
+	unsigned tail = *sqTail;
+	unsigned index = tail & *sqMask;
+	sAioUringSqe *sqe = (sAioUringSqe*)sqes + index;
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->flags = flags;
+	sqe->fd = fd;
+	sqe->off = offset;
+	sqe->addr = (u_int64_t)(unsigned long)buffer;
+	sqe->len = length;
+	sqe->user_data = (u_int64_t)(unsigned long)request;
+	sqArray[index] = index;
+	request->done = false;
+	request->result = 0;
+	request->submitTimeUS = getTimeUS();
+	__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+	int rslt;
+	while((rslt = syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, NULL, 0)) < 0 && errno == EINTR);
+	if(rslt != 1) {
+		// the sqe was not consumed - take it back
+		__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+		return(false);
+	}
+	return(true);
+	#else
+	return(false);
+	#endif //FREEBSD
+}
+
+unsigned cAsyncFileIO::reap() {
+	#ifndef FREEBSD
+	if(ringFd < 0) {
+		return(0);
+	}
+	unsigned count = 0;
+	unsigned head = *cqHead;
+	unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+	if(head != tail) {
+		u_int64_t actTimeUS = getTimeUS();
+		while(head != tail) {
+			sAioUringCqe *cqe = (sAioUringCqe*)cqes + (head & *cqMask);
+			sRequest *request = (sRequest*)(unsigned long)cqe->user_data;
+			request->result = cqe->res;
+			request->completeTimeUS = actTimeUS;
+			__sync_synchronize();
+			request->done = true;
+			++head;
+			++count;
+		}
+		__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+	}
+	return(count);
+	#else
+	return(0);
+	#endif //FREEBSD
+}
+
+void cAsyncFileIO::term() {
+	#ifndef FREEBSD
+	if(sqes && sqes != MAP_FAILED) {
+		munmap(sqes, sqesSize);
+	}
+	if(cqRing && cqRing != MAP_FAILED) {
+		munmap(cqRing, cqRingSize);
+	}
+	if(sqRing && sqRing != MAP_FAILED) {
+		munmap(sqRing, sqRingSize);
+	}
+	if(ringFd >= 0) {
+		close(ringFd);
+	}
+	#endif //FREEBSD
+	ringFd = -1;
+	sqRing = NULL;
+	cqRing = NULL;
+	sqes = NULL;
+}
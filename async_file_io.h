@@ -0,0 +1,55 @@
+#ifndef ASYNC_FILE_IO_H
+#define ASYNC_FILE_IO_H
+
+
+#include <string>
+#include <sys/types.h>
+
+
+/* Minimal io_uring ring (raw syscalls, no liburing) for asynchronous reads and writes of packetbuffer files.
+   Writes are forced to the kernel async workers so that the submitting thread never blocks on the filesystem.
+   Submit and reap are not thread safe - the owner serializes them. Requires Linux >= 5.6. */
+class cAsyncFileIO {
+public:
+	struct sRequest {
+		sRequest() {
+			done = false;
+			result = 0;
+			submitTimeUS = 0;
+			completeTimeUS = 0;
+		}
+		volatile bool done;
+		int result;
+		u_int64_t submitTimeUS;
+		u_int64_t completeTimeUS;
+	};
+public:
+	cAsyncFileIO();
+	~cAsyncFileIO();
+	bool init(unsigned entries, std::string *error = NULL);
+	bool submitWrite(int fd, const void *buffer, size_t length, u_int64_t offset, sRequest *request);
+	bool submitRead(int fd, void *buffer, size_t length, u_int64_t offset, sRequest *request);
+	unsigned reap();
+private:
+	bool submit(u_int8_t opcode, u_int8_t flags, int fd, const void *buffer, size_t length, u_int64_t offset, sRequest *request);
+	void term();
+private:
+	int ringFd;
+	unsigned entries;
+	void *sqRing;
+	size_t sqRingSize;
+	void *cqRing;
+	size_t cqRingSize;
+	void *sqes;
+	size_t sqesSize;
+	unsigned *sqTail;
+	unsigned *sqMask;
+	unsigned *sqArray;
+	unsigned *cqHead;
+	unsigned *cqTail;
+	unsigned *cqMask;
+	void *cqes;
+};
+
+
+#endif //ASYNC_FILE_IO_H
@@ -61,6 +61,7 @@
 #include "options.h"
 #include "sniff_proc_class.h"
 #include "charts.h"
+#include "packet_socket.h"
 
 
 #define MIN(x,y) ((x) < (y) ? (x) : (y))
@@ -163,6 +164,7 @@ extern int opt_rtpfromsdp_onlysip;
 extern int opt_rtpfromsdp_onlysip_skinny;
 extern int opt_rtp_check_both_sides_by_sdp;
 extern int opt_hash_modify_queue_length_ms;
+extern bool opt_hash_rtp_rcu;
 extern int opt_mysql_enable_multiple_rows_insert;
 extern int opt_mysql_max_multiple_rows_insert;
 extern PreProcessPacket *preProcessPacketCallX[];
@@ -176,6 +178,12 @@ extern char mac[32];
 
 unsigned int last_register_clean = 0;
 
+cSlabPool Call::slab_pool("Call", sizeof(Call));
+#if !((NEW_RTP_FIND__NODES && NEW_RTP_FIND__NODES__LIST) || HASH_RTP_FIND__LIST || NEW_RTP_FIND__MAP_LIST)
+cSlabPool node_call_rtp::slab_pool("node_call_rtp", sizeof(node_call_rtp));
+#endif
+cSlabPool node_call_rtp_ip_port::slab_pool("node_call_rtp_ip_port", sizeof(node_call_rtp_ip_port));
+
 extern int opt_onewaytimeout;
 extern int opt_saveaudio_reversestereo;
 extern int opt_saveaudio_stereo;
@@ -274,8 +282,8 @@ Call_abstract::Call_abstract(int call_type, u_int64_t time_us) {
 	type_base = call_type;
 	type_next = 0;
 	first_packet_time_us = time_us;
-	fbasename[0] = 0;
-	fbasename_safe[0] = 0;
+	fbasename.setArena(&str_arena);
+	fbasename_safe.setArena(&str_arena);
 	fname_register = 0;
 	useSensorId = opt_id_sensor;
 	useDlt = global_pcap_dlink;
@@ -400,10 +408,12 @@ Call_abstract::dirnamesqlfiles() {
 	return(sdirname);
 }
 
-char *
+const char *
 Call_abstract::get_fbasename_safe() {
-	strcpy_null_term(fbasename_safe, fbasename);
-	prepare_string_to_filename(fbasename_safe);
+	char _fbasename_safe[MAX_FNAME];
+	strcpy_null_term(_fbasename_safe, fbasename);
+	prepare_string_to_filename(_fbasename_safe);
+	fbasename_safe.set(_fbasename_safe);
 	return fbasename_safe;
 }
 
@@ -481,15 +491,15 @@ Call::Call(int call_type, char *call_id, unsigned long call_id_len, vector<strin
 	seenRES2XX = false;
 	seenRES2XX_no_BYE = false;
 	seenRES18X = false;
-	caller[0] = '\0';
-	caller_domain[0] = '\0';
-	callername[0] = '\0';
-	called[0] = '\0';
-	called_domain[0] = '\0';
-	contact_num[0] = '\0';
-	contact_domain[0] = '\0';
-	digest_username[0] = '\0';
-	digest_realm[0] = '\0';
+	caller.setArena(&str_arena);
+	caller_domain.setArena(&str_arena);
+	callername.setArena(&str_arena);
+	called.setArena(&str_arena);
+	called_domain.setArena(&str_arena);
+	contact_num.setArena(&str_arena);
+	contact_domain.setArena(&str_arena);
+	digest_username.setArena(&str_arena);
+	digest_realm.setArena(&str_arena);
 	register_expires = -1;
 	for(unsigned i = 0; i < (sizeof(byecseq) / sizeof(byecseq[0])); i++) {
 		byecseq[i].null();
@@ -508,8 +518,8 @@ Call::Call(int call_type, char *call_id, unsigned long call_id_len, vector<strin
 	first_response_xxx_time_us = 0;
 	first_message_time_us = 0;
 	first_response_200_time_us = 0;
-	a_ua[0] = '\0';
-	b_ua[0] = '\0';
+	a_ua.setArena(&str_arena);
+	b_ua.setArena(&str_arena);
 	memset(rtpmap, 0, sizeof(rtpmap));
 	rtp_cur[0] = NULL;
 	rtp_cur[1] = NULL;
@@ -554,10 +564,17 @@ Call::Call(int call_type, char *call_id, unsigned long call_id_len, vector<strin
 	destroy_call_at = 0;
 	destroy_call_at_bye = 0;
 	destroy_call_at_bye_confirmed = 0;
-	custom_header1[0] = '\0';
-	match_header[0] = '\0';
+	cleanup_wheel_node.data = this;
+	custom_header1.setArena(&str_arena);
+	match_header.setArena(&str_arena);
 	thread_num = 0;
 	thread_num_rd = 0;
+	rtp_thread_migrate_to = -1;
+	rtp_thread_migrate_request_ms = 0;
+	rtp_thread_migrate_last_ms = 0;
+	rtp_thread_balance_window_ms = 0;
+	rtp_thread_balance_packets = 0;
+	rtp_thread_push_sync = 0;
 	setRtpThreadNum();
 	recordstopped = 0;
 	dtmfflag = 0;
@@ -692,11 +709,11 @@ Call::hashRemove(struct timeval *ts, bool useHashQueueCounter) {
 	}
 	
 	if(!opt_hash_modify_queue_length_ms && this->rtp_ip_port_counter) {
-		syslog(LOG_WARNING, "WARNING: rest before hash cleanup for callid: %s: %i", this->fbasename, this->rtp_ip_port_counter);
+		syslog(LOG_WARNING, "WARNING: rest before hash cleanup for callid: %s: %i", this->fbasename.c_str(), this->rtp_ip_port_counter);
 		if(this->rtp_ip_port_counter > 0) {
 			calltable->hashRemove(this, ts, useHashQueueCounter);
 			if(this->rtp_ip_port_counter) {
-				syslog(LOG_WARNING, "WARNING: rest after hash cleanup for callid: %s: %i", this->fbasename, this->rtp_ip_port_counter);
+				syslog(LOG_WARNING, "WARNING: rest after hash cleanup for callid: %s: %i", this->fbasename.c_str(), this->rtp_ip_port_counter);
 			}
 		}
 	}
@@ -732,10 +749,14 @@ Call::removeFindTables(struct timeval *ts, bool set_end_call, bool destroy) {
 		}
 		hash_add_unlock();
 	} else if(destroy) {
+		bool removeFromHash = this->rtp_ip_port_counter > 0;
 		if(opt_hash_modify_queue_length_ms && this->rtp_ip_port_counter) {
 			calltable->hashRemoveForce(this);
 		}
 		this->hashRemove(ts);
+		if(removeFromHash) {
+			calltable->calls_hash_rcu_synchronize();
+		}
 	} else {
 		this->hashRemove(ts, true);
 	}
@@ -902,6 +923,10 @@ Call::~Call(){
  
 	removeMergeCalls();
 	
+	if(cleanup_wheel_node.isLinked()) {
+		((Calltable*)calltable)->cleanup_calls_wheel_remove(this);
+	}
+	
 	if(is_ssl) {
 		glob_ssl_calls--;
 	}
@@ -953,6 +978,17 @@ Call::~Call(){
 
 void
 Call::closeRawFiles() {
+	// rest of deferred jitterbuffer logs - streams are replayed in parallel, MOS is complete before the call is saved
+	for(int i = 0; i < ssrc_n; i++) {
+		if(rtp[i]->jb_deferred > 0) {
+			rtp[i]->jitterbuffer_log_submit(false);
+		}
+	}
+	for(int i = 0; i < ssrc_n; i++) {
+		if(rtp[i]->jb_deferred > 0) {
+			rtp[i]->jitterbuffer_log_wait();
+		}
+	}
 	for(int i = 0; i < ssrc_n; i++) {
 		// close RAW files
 		if(rtp[i]->gfileRAW) {
@@ -1246,7 +1282,7 @@ Call::is_multiple_to_branch() {
 }
 
 bool 
-Call::to_is_canceled(char *to) {
+Call::to_is_canceled(const char *to) {
 	for(int i = 0; i < ipport_n; i++) {
 		if(sipcallerip[0] == this->ip_port[i].sip_src_addr &&
 		   !strcmp(this->ip_port[i].to.c_str(), to) &&
@@ -1381,6 +1417,8 @@ Call::_read_rtp(packet_s *packetS, int iscaller, bool find_by_dest, bool stream_
 
 	if(first_rtp_time_us == 0) {
 		first_rtp_time_us = getTimeUS(packetS->header_pt);
+		// rtptimeout replaces sipwithoutrtptimeout
+		((Calltable*)calltable)->cleanup_calls_wheel_update(this);
 	}
 	
 	unsigned int curSSRC;
@@ -1734,7 +1772,7 @@ read:
 		char graph_extension[100];
 		snprintf(graph_extension, sizeof(graph_extension), "%d.graph%s", ssrc_n, opt_gzipGRAPH == FileZipHandler::gzip ? ".gz" : "");
 		string graph_pathfilename = get_pathfilename(tsf_graph, graph_extension);
-		strcpy(rtp[ssrc_n]->gfilename, graph_pathfilename.c_str());
+		rtp[ssrc_n]->gfilename = graph_pathfilename;
 		if((flags & FLAG_SAVEGRAPH) && !sverb.disable_save_graph) {
 			rtp[ssrc_n]->graph.auto_open(tsf_graph, graph_pathfilename.c_str());
 		}
@@ -1746,8 +1784,7 @@ read:
 		char ird_extension[100];
 		snprintf(ird_extension, sizeof(ird_extension), "i%d", !iscaller);
 		string ird_pathfilename = get_pathfilename(tsf_audio, ird_extension);
-		strncpy(rtp[ssrc_n]->basefilename, ird_pathfilename.c_str(), 1023);
-		rtp[ssrc_n]->basefilename[1023] = 0;
+		rtp[ssrc_n]->basefilename = ird_pathfilename;
 
 		rtp[ssrc_n]->index_call_ip_port = index_call_ip_port_find_side;
 		if(rtp[ssrc_n]->index_call_ip_port >= 0) {
@@ -2622,8 +2659,7 @@ Call::convertRawToWav() {
 					   strstr(de->d_name, ".i1.rawInfo")) {
 						this->call_id = de->d_name;
 						this->call_id.resize(this->call_id.length() - 11);
-						strcpy_null_term(this->fbasename, this->call_id.c_str());
-						this->fbasename[sizeof(this->fbasename) - 1] = 0;
+						this->fbasename.set(this->call_id.c_str());
 						break;
 					}
 				}
@@ -2853,7 +2889,7 @@ Call::convertRawToWav() {
 			    last_ssrc_index >= (unsigned)ssrc_n)) {
 				syslog(LOG_NOTICE, "ignoring rtp stream - bad ssrc_index[%i] or last_ssrc_index[%i] ssrc_n[%i]; call [%s] stream[%s] ssrc[%x] ssrc/last[%x]", 
 				       ssrc_index, last_ssrc_index, 
-				       ssrc_n, fbasename, raw_pathfilename.c_str(), 
+				       ssrc_n, fbasename.c_str(), raw_pathfilename.c_str(), 
 				       ssrc_index >= ssrc_n ? 0 : rtp[ssrc_index]->ssrc,
 				       last_ssrc_index >= (unsigned)ssrc_n ? 0 : rtp[last_ssrc_index]->ssrc);
 				if(!sverb.noaudiounlink) unlink(raw_pathfilename.c_str());
@@ -3548,28 +3584,85 @@ bool Call::existsBothDirectionsInSelectedRtpStream() {
 
 void Call::removeCallIdMap() {
 	if(opt_call_id_alternative[0]) {
-		map<string, Call*>::iterator callMAPIT;
-		callMAPIT = ((Calltable*)calltable)->calls_listMAP.find(call_id);
-		if(callMAPIT != ((Calltable*)calltable)->calls_listMAP.end()) {
-			((Calltable*)calltable)->calls_listMAP.erase(callMAPIT);
-		}
+		((Calltable*)calltable)->calls_listMAP.eraseWithLock(call_id);
 		if(call_id_alternative) {
 			for(map<string, bool>::iterator iter = call_id_alternative->begin(); iter != call_id_alternative->end(); iter++) {
-				callMAPIT = ((Calltable*)calltable)->calls_listMAP.find(iter->first);
-				if(callMAPIT != ((Calltable*)calltable)->calls_listMAP.end()) {
-					((Calltable*)calltable)->calls_listMAP.erase(callMAPIT);
-				}
+				((Calltable*)calltable)->calls_listMAP.eraseWithLock(iter->first);
 			}
 		}
 	}
 }
 
+time_t Call::get_cleanup_check_time() {
+	// the nearest time when one of the timeouts in Calltable::cleanup_calls can be exceeded
+	if(force_close) {
+		return(0);
+	}
+	time_t first_packet_time = get_first_packet_time_s();
+	time_t last_packet_time = get_last_packet_time_s();
+	time_t checkTime = first_packet_time + absolute_timeout + 1;
+	time_t destroyTimes[] = { destroy_call_at, destroy_call_at_bye, destroy_call_at_bye_confirmed };
+	for(unsigned i = 0; i < sizeof(destroyTimes) / sizeof(destroyTimes[0]); i++) {
+		if(destroyTimes[i] && destroyTimes[i] < checkTime) {
+			checkTime = destroyTimes[i];
+		}
+	}
+	time_t timeoutTime = first_rtp_time_us ?
+			      last_packet_time + rtptimeout + 1 :
+			      first_packet_time + sipwithoutrtptimeout + 1;
+	if(timeoutTime < checkTime) {
+		checkTime = timeoutTime;
+	}
+	if(!seenRES18X && !seenRES2XX && !first_rtp_time_us &&
+	   first_packet_time + 300 + 1 < checkTime) {
+		checkTime = first_packet_time + 300 + 1;
+	}
+	if(oneway == 1 &&
+	   last_packet_time + opt_onewaytimeout + 1 < checkTime) {
+		checkTime = last_packet_time + opt_onewaytimeout + 1;
+	}
+	return(checkTime);
+}
+
+size_t Call::get_str_fixed_size() {
+	// size of the strings in the arena as char arrays (before they were moved to str_arena)
+	return(fbasename.maxSize() + fbasename_safe.maxSize() +
+	       callername.maxSize() + caller.maxSize() + caller_domain.maxSize() +
+	       called.maxSize() + called_domain.maxSize() +
+	       contact_num.maxSize() + contact_domain.maxSize() +
+	       digest_username.maxSize() + digest_realm.maxSize() +
+	       custom_header1.maxSize() + match_header.maxSize() +
+	       a_ua.maxSize() + b_ua.maxSize());
+}
+
+size_t Call::get_rtp_size() {
+	size_t size = 0;
+	for(int i = 0; i < ssrc_n; i++) {
+		if(rtp[i]) {
+			size += sizeof(RTP) + rtp[i]->getJitterbufferChannelsSize();
+		}
+	}
+	return(size);
+}
+
 void Call::removeMergeCalls() {
 	if(isSetCallidMergeHeader()) {
 		((Calltable*)calltable)->lock_calls_mergeMAP();
 		mergecalls_lock();
 		for(map<string, sMergeLegInfo>::iterator it = mergecalls.begin(); it != mergecalls.end(); ++it) {
-			((Calltable*)calltable)->calls_mergeMAP.erase(it->first);
+			((Calltable*)calltable)->calls_mergeMAP.eraseWithLock(it->first);
+		}
+		mergecalls_unlock();
+		((Calltable*)calltable)->unlock_calls_mergeMAP();
+	}
+}
+
+void Call::restoreMergeCalls() {
+	if(isSetCallidMergeHeader()) {
+		((Calltable*)calltable)->lock_calls_mergeMAP();
+		mergecalls_lock();
+		for(map<string, sMergeLegInfo>::iterator it = mergecalls.begin(); it != mergecalls.end(); ++it) {
+			((Calltable*)calltable)->calls_mergeMAP.setWithLock(it->first, this);
 		}
 		mergecalls_unlock();
 		((Calltable*)calltable)->unlock_calls_mergeMAP();
@@ -4617,7 +4710,7 @@ bool Call::sqlFormulaOperandReplace(cEvalFormula::sValue *value, string *table,
 		}
 		return(true);
 	} else if(*column == "ua") {
-		*value = cEvalFormula::sValue(table->find("a_ua") != string::npos ? a_ua : b_ua);
+		*value = cEvalFormula::sValue(table->find("a_ua") != string::npos ? a_ua.c_str() : b_ua.c_str());
 		if(ord) {
 			ord->u.s.column = table->find("a_ua") != string::npos ? 5 : 6;
 		}
@@ -5330,7 +5423,7 @@ Call::saveToDb(bool enableBatchIfPossible) {
 	if(is_multiple_to_branch() && to_is_canceled(called)) {
 		string called_not_canceled = get_to_not_canceled();
 		if(called_not_canceled.length()) {
-			strcpy_null_term(called, called_not_canceled.c_str());
+			called.set(called_not_canceled);
 		}
 	}
 	cdr.add(sqlEscapeString(called), "called");
@@ -5933,7 +6026,7 @@ Call::saveToDb(bool enableBatchIfPossible) {
 		if(opt_cdr_ua_enable) {
 			if(a_ua[0]) {
 				if(useSetId()) {
-					cdr.add_cb_string(a_ua, "a_ua_id", cSqlDbCodebook::_cb_ua);
+					cdr.add_cb_string(a_ua.c_str(), "a_ua_id", cSqlDbCodebook::_cb_ua);
 				} else {
 					unsigned _cb_id = dbData->getCbId(cSqlDbCodebook::_cb_ua, a_ua, false, true);
 					if(_cb_id) {
@@ -5948,7 +6041,7 @@ Call::saveToDb(bool enableBatchIfPossible) {
 			}
 			if(b_ua[0]) {
 				if(useSetId()) {
-					cdr.add_cb_string(b_ua, "b_ua_id", cSqlDbCodebook::_cb_ua);
+					cdr.add_cb_string(b_ua.c_str(), "b_ua_id", cSqlDbCodebook::_cb_ua);
 				} else {
 					unsigned _cb_id = dbData->getCbId(cSqlDbCodebook::_cb_ua, b_ua, false, true);
 					if(_cb_id) {
@@ -5978,9 +6071,9 @@ Call::saveToDb(bool enableBatchIfPossible) {
 				if(opt_cdr_check_exists_callid == 2) {
 					cdr_callid_lock_name = "vm_cdr_callid_";
 					if(opt_cdr_check_unique_callid_in_sensors_list.size()) {
-						cdr_callid_lock_name += GetStringMD5(fbasename + opt_cdr_check_unique_callid_in_sensors);
+						cdr_callid_lock_name += GetStringMD5(fbasename.c_str() + opt_cdr_check_unique_callid_in_sensors);
 					} else {
-						cdr_callid_lock_name += GetStringMD5(fbasename);
+						cdr_callid_lock_name += GetStringMD5(fbasename.c_str());
 					}
 					query_str +=
 						"do get_lock('" + cdr_callid_lock_name + "', 60);\n";
@@ -6808,7 +6901,7 @@ Call::saveAloneByeToDb(bool enableBatchIfPossible) {
 			select max(cdr_id) \
 			from cdr_next \
 			where calldate > '" + sqlDateTimeString(calltime_s() - 60 * 60) + "' and \
-			      fbasename = '" + fbasename + "' \
+			      fbasename = '" + fbasename.c_str() + "' \
 			limit 1)";
 	if(enableBatchIfPossible) {
 		static unsigned int counterSqlStore = 0;
@@ -7361,7 +7454,7 @@ Call::saveMessageToDb(bool enableBatchIfPossible) {
 		if(opt_cdr_ua_enable) {
 			if(a_ua[0]) {
 				if(useSetId()) {
-					msg.add(MYSQL_CODEBOOK_ID(cSqlDbCodebook::_cb_ua, a_ua), "a_ua_id");
+					msg.add(MYSQL_CODEBOOK_ID(cSqlDbCodebook::_cb_ua, a_ua.c_str()), "a_ua_id");
 				} else {
 					unsigned _cb_id = dbData->getCbId(cSqlDbCodebook::_cb_ua, a_ua, false, true);
 					if(_cb_id) {
@@ -7376,7 +7469,7 @@ Call::saveMessageToDb(bool enableBatchIfPossible) {
 			}
 			if(b_ua[0]) {
 				if(useSetId()) {
-					msg.add(MYSQL_CODEBOOK_ID(cSqlDbCodebook::_cb_ua, b_ua), "b_ua_id");
+					msg.add(MYSQL_CODEBOOK_ID(cSqlDbCodebook::_cb_ua, b_ua.c_str()), "b_ua_id");
 				} else {
 					unsigned _cb_id = dbData->getCbId(cSqlDbCodebook::_cb_ua, b_ua, false, true);
 					if(_cb_id) {
@@ -7573,8 +7666,8 @@ Call::dump(){
 		printf("no IP:port assigned\n");
 	}
 	if(seeninvite || seenmessage) {
-		printf("From:%s\n", caller);
-		printf("To:%s\n", called);
+		printf("From:%s\n", caller.c_str());
+		printf("To:%s\n", called.c_str());
 	}
 	printf("First packet: %d, Last packet: %d\n", (int)get_first_packet_time_s(), (int)get_last_packet_time_s());
 	printf("ssrc_n:%d\n", ssrc_n);
@@ -7598,7 +7691,7 @@ void Call::atFinish() {
 		string find2 = "%basename%";
 		string find3 = "%dirname%";
 		find_and_replace(source, find1, escapeShellArgument(this->get_pathfilename(tsf_sip)));
-		find_and_replace(source, find2, escapeShellArgument(this->fbasename));
+		find_and_replace(source, find2, escapeShellArgument(this->fbasename.c_str()));
 		find_and_replace(source, find3, escapeShellArgument(this->get_pathname(tsf_sip)));
 		if(verbosity >= 2) printf("command: [%s]\n", source.c_str());
 		calltable->addSystemCommand(source.c_str());
@@ -7606,11 +7699,11 @@ void Call::atFinish() {
 	extern char filtercommand[4092];
 	if(filtercommand[0] && this->flags & FLAG_RUNSCRIPT) {
 		string source(filtercommand);
-		find_and_replace(source, string("%callid%"), escapeShellArgument(this->fbasename));
+		find_and_replace(source, string("%callid%"), escapeShellArgument(this->fbasename.c_str()));
 		find_and_replace(source, string("%dirname%"), escapeShellArgument(this->get_pathname(tsf_sip)));
 		find_and_replace(source, string("%calldate%"), escapeShellArgument(sqlDateTimeString(this->calltime_s())));
-		find_and_replace(source, string("%caller%"), escapeShellArgument(this->caller));
-		find_and_replace(source, string("%called%"), escapeShellArgument(this->called));
+		find_and_replace(source, string("%caller%"), escapeShellArgument(this->caller.c_str()));
+		find_and_replace(source, string("%called%"), escapeShellArgument(this->called.c_str()));
 		if(verbosity >= 2) printf("command: [%s]\n", source.c_str());
 		calltable->addSystemCommand(source.c_str());
 	}
@@ -7658,11 +7751,16 @@ Call::applyRtcpXrDataToRtp() {
 
 void Call::adjustUA() {
 	if(opt_cdr_ua_reg_remove.size() || opt_cdr_ua_reg_whitelist.size()) {
+		char ua[1024];
 		if(a_ua[0]) {
-			::adjustUA(a_ua, sizeof(a_ua));
+			strcpy_null_term(ua, a_ua);
+			::adjustUA(ua, sizeof(ua));
+			a_ua.set(ua);
 		}
 		if(b_ua[0]) {
-			::adjustUA(b_ua, sizeof(b_ua));
+			strcpy_null_term(ua, b_ua);
+			::adjustUA(ua, sizeof(ua));
+			b_ua.set(ua);
 		}
 	}
 }
@@ -8048,7 +8146,7 @@ void Ss7::processData(packet_s_stack *packetS, sParseData *data) {
 		iam_src_ip = packetS->saddr_();
 		iam_dst_ip = packetS->daddr_();
 		iam_time_us = getTimeUS(packetS->header_pt);
-		strcpy_null_term(fbasename, filename().c_str());
+		fbasename.set(filename());
 		break;
 	case SS7_ACM:
 		last_message_type = acm;
@@ -8269,7 +8367,16 @@ Calltable::Calltable(SqlDb *sqlDb) {
 	#else
 	memset(calls_hash, 0x0, sizeof(calls_hash));
 	#endif
+	#if NEW_RTP_FIND__NODES || NEW_RTP_FIND__PORT_NODES || NEW_RTP_FIND__MAP_LIST || HASH_RTP_FIND__LIST
+	calls_hash_rcu = false;
+	#else
+	calls_hash_rcu = opt_hash_rtp_rcu;
+	#endif
 	_sync_lock_calls_hash = 0;
+	extern bool opt_cleanup_calls_wheel;
+	cleanup_calls_wheel = opt_cleanup_calls_wheel && !opt_call_id_alternative[0];
+	_sync_lock_calls_wheel = 0;
+	_sync_lock_calls_cleanup = 0;
 	_sync_lock_calls_listMAP = 0;
 	_sync_lock_calls_mergeMAP = 0;
 	_sync_lock_registers_listMAP = 0;
@@ -8382,6 +8489,8 @@ Calltable::hashAdd(vmIP addr, vmPort port, struct timeval *ts, Call* call, int i
 	
 	call->hash_add_unlock();
 	
+	kernel_prefilter_apply();
+	
 }
  
 void
@@ -8448,10 +8557,10 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 					if(!call_ids.empty()) {
 						call_ids += " ";
 					}
-					call_ids += string("[") + (*iter)->call->fbasename + "]";
+					call_ids += string("[") + (*iter)->call->fbasename.c_str() + "]";
 				}
 				syslog(LOG_NOTICE, "call-id[%s] SDP: %s:%u is already in calls %s. Limit is %u to not cause multiplication DDOS. You can increase it sdp_multiplication = N\n", 
-				       call->fbasename, addr.getString().c_str(), (int)port,
+				       call->fbasename.c_str(), addr.getString().c_str(), (int)port,
 				       call_ids.c_str(),
 				       opt_sdp_multiplication);
 				call->syslog_sdp_multiplication = true;
@@ -8542,11 +8651,11 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 					if(!call_ids.empty()) {
 						call_ids += " ";
 					}
-					call_ids += string("[") + n_call->call->fbasename + "]";
+					call_ids += string("[") + n_call->call->fbasename.c_str() + "]";
 					n_call = n_call->next;
 				}
 				syslog(LOG_NOTICE, "call-id[%s] SDP: %s:%u is already in calls %s. Limit is %u to not cause multiplication DDOS. You can increase it sdp_multiplication = N\n", 
-				       call->fbasename, addr.getString().c_str(), (int)port,
+				       call->fbasename.c_str(), addr.getString().c_str(), (int)port,
 				       call_ids.c_str(),
 				       opt_sdp_multiplication);
 				call->syslog_sdp_multiplication = true;
@@ -8641,11 +8750,11 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 					if(!call_ids.empty()) {
 						call_ids += " ";
 					}
-					call_ids += string("[") + n_call->call->fbasename + "]";
+					call_ids += string("[") + n_call->call->fbasename.c_str() + "]";
 					n_call = n_call->next;
 				}
 				syslog(LOG_NOTICE, "call-id[%s] SDP: %s:%u is already in calls %s. Limit is %u to not cause multiplication DDOS. You can increase it sdp_multiplication = N\n", 
-				       call->fbasename, addr.getString().c_str(), (int)port,
+				       call->fbasename.c_str(), addr.getString().c_str(), (int)port,
 				       call_ids.c_str(),
 				       opt_sdp_multiplication);
 				call->syslog_sdp_multiplication = true;
@@ -8711,10 +8820,10 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 					if(!call_ids.empty()) {
 						call_ids += " ";
 					}
-					call_ids += string("[") + (*iter)->call->fbasename + "]";
+					call_ids += string("[") + (*iter)->call->fbasename.c_str() + "]";
 				}
 				syslog(LOG_NOTICE, "call-id[%s] SDP: %s:%u is already in calls %s. Limit is %u to not cause multiplication DDOS. You can increase it sdp_multiplication = N\n", 
-				       call->fbasename, addr.getString().c_str(), (int)port,
+				       call->fbasename.c_str(), addr.getString().c_str(), (int)port,
 				       call_ids.c_str(),
 				       opt_sdp_multiplication);
 				call->syslog_sdp_multiplication = true;
@@ -8779,10 +8888,10 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 								if(!call_ids.empty()) {
 									call_ids += " ";
 								}
-								call_ids += string("[") + (*iter)->call->fbasename + "]";
+								call_ids += string("[") + (*iter)->call->fbasename.c_str() + "]";
 							}
 							syslog(LOG_NOTICE, "call-id[%s] SDP: %s:%u is already in calls %s. Limit is %u to not cause multiplication DDOS. You can increase it sdp_multiplication = N\n", 
-							       call->fbasename, addr.getString().c_str(), (int)port,
+							       call->fbasename.c_str(), addr.getString().c_str(), (int)port,
 							       call_ids.c_str(),
 							       opt_sdp_multiplication);
 							call->syslog_sdp_multiplication = true;
@@ -8816,14 +8925,14 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 						if(prev) {
 							prev->next = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashRetire(node_call);
 							node_call = prev->next;
 							continue;
 						} else {
 							//removing first node
 							node->calls = node->calls->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashRetire(node_call);
 							node_call = node->calls;
 							continue;
 						}
@@ -8839,10 +8948,23 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 				if(!found) {
 					if(opt_sdp_multiplication == 0 && count == 1 && node->calls && node->calls->call) {
 						--node->calls->call->rtp_ip_port_counter;
-						node->calls->call = call;
-						node->calls->iscaller = iscaller;
-						node->calls->is_rtcp = is_rtcp;
-						node->calls->sdp_flags = sdp_flags;
+						if(calls_hash_rcu) {
+							// lock-free readers must not see the item half rewritten - replace it
+							node_call_rtp *node_call_old = node->calls;
+							node_call_rtp *node_call_new = new FILE_LINE(0) node_call_rtp;
+							node_call_new->next = node_call_old->next;
+							node_call_new->call = call;
+							node_call_new->iscaller = iscaller;
+							node_call_new->is_rtcp = is_rtcp;
+							node_call_new->sdp_flags = sdp_flags;
+							__atomic_store_n(&node->calls, node_call_new, __ATOMIC_RELEASE);
+							hashRetire(node_call_old);
+						} else {
+							node->calls->call = call;
+							node->calls->iscaller = iscaller;
+							node->calls->is_rtcp = is_rtcp;
+							node->calls->sdp_flags = sdp_flags;
+						}
 						++call->rtp_ip_port_counter;
 					} else {
 						if(opt_sdp_multiplication > 0 && count >= opt_sdp_multiplication) {
@@ -8857,11 +8979,11 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 										if(!call_ids.empty()) {
 											call_ids += " ";
 										}
-										call_ids += string("[") + node_call->call->fbasename + "]";
+										call_ids += string("[") + node_call->call->fbasename.c_str() + "]";
 										node_call = node_call->next;
 									}
 									syslog(LOG_NOTICE, "call-id[%s] SDP: %s:%u is already in calls %s. Limit is %u to not cause multiplication DDOS. You can increase it sdp_multiplication = N\n", 
-									       call->fbasename, addr.getString().c_str(), (int)port,
+									       call->fbasename.c_str(), addr.getString().c_str(), (int)port,
 									       call_ids.c_str(),
 									       opt_sdp_multiplication);
 									call->syslog_sdp_multiplication = true;
@@ -8881,7 +9003,7 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 						node_call_new->sdp_flags = sdp_flags;
 
 						//insert at first position
-						node->calls = node_call_new;
+						__atomic_store_n(&node->calls, node_call_new, __ATOMIC_RELEASE);
 						++call->rtp_ip_port_counter;
 					}
 				}
@@ -8919,9 +9041,10 @@ Calltable::_hashAdd(vmIP addr, vmPort port, long int time_s, Call* call, int isc
 		node->port = port;
 		node->next = calls_hash[h];
 		node->calls = node_call;
-		calls_hash[h] = node;
+		__atomic_store_n(&calls_hash[h], node, __ATOMIC_RELEASE);
 	#endif
 	++call->rtp_ip_port_counter;
+	kernel_prefilter_add(addr, port);
 	if (useLock) unlock_calls_hash();
 	
 #endif
@@ -8961,6 +9084,8 @@ Calltable::hashRemove(Call *call, vmIP addr, vmPort port, struct timeval *ts, bo
 		_hashRemove(call, addr, port, rtcp);
 	}
 	
+	kernel_prefilter_apply();
+	
 }
 
 int
@@ -9150,12 +9275,12 @@ Calltable::_hashRemove(Call *call, vmIP addr, vmPort port, bool rtcp, bool use_l
 						if (prev_call == NULL) {
 							node->calls = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashRetire(node_call);
 							++removeCounter;
 						} else {
 							prev_call->next = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashRetire(node_call);
 							++removeCounter;
 						}
 						break;
@@ -9171,12 +9296,13 @@ Calltable::_hashRemove(Call *call, vmIP addr, vmPort port, bool rtcp, bool use_l
 			#endif
 			) {
 				// node now contains no calls so we can remove it 
+				kernel_prefilter_remove(addr, port);
 				if (prev == NULL) {
 					calls_hash[h] = node->next;
-					delete node;
+					hashRetire(node);
 				} else {
 					prev->next = node->next;
-					delete node;
+					hashRetire(node);
 				}
 			}
 			break;
@@ -9207,16 +9333,21 @@ Calltable::hashRemove(Call *call, struct timeval *ts, bool useHashQueueCounter)
 			_applyHashModifyQueue(ts, true);
 		}
 		unlock_hash_modify_queue();
+		kernel_prefilter_apply();
 		return(-1);
 	} else {
-		return(_hashRemove(call));
+		int removeCounter = _hashRemove(call);
+		kernel_prefilter_apply();
+		return(removeCounter);
 	}
 
 }
 
 int
 Calltable::hashRemoveForce(Call *call) {
-	return(_hashRemove(call));
+	int removeCounter = _hashRemove(call);
+	kernel_prefilter_apply();
+	return(removeCounter);
 }
   
 int
@@ -9266,12 +9397,12 @@ Calltable::_hashRemove(Call *call, bool use_lock) {
 						if(prev_node_call == NULL) {
 							node->calls = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashRetire(node_call);
 							node_call = node->calls; 
 						} else {
 							prev_node_call->next = node_call->next;
 							--node_call->call->rtp_ip_port_counter;
-							delete node_call;
+							hashRetire(node_call);
 							node_call = prev_node_call->next;
 						}
 					} else {
@@ -9287,13 +9418,14 @@ Calltable::_hashRemove(Call *call, bool use_lock) {
 			node->calls == NULL
 			#endif
 			) {
+				kernel_prefilter_remove(node->addr, node->port);
 				if(prev_node == NULL) {
 					calls_hash[h] = node->next;
-					delete node;
+					hashRetire(node);
 					node = calls_hash[h];
 				} else {
 					prev_node->next = node->next;
-					delete node;
+					hashRetire(node);
 					node = prev_node->next;
 				}
 			} else {
@@ -9331,11 +9463,15 @@ Calltable::_applyHashModifyQueue(struct timeval *ts, bool setBegin, bool use_loc
 					_hashRemove(iter->call, false);
 					break;
 				}
+			}
+			if (use_lock_calls_hash) unlock_calls_hash();
+			// cleanup_calls waits for hash_queue_counter - lock-free readers which found the removed items must be finished
+			calls_hash_rcu_synchronize();
+			for(list<sHashModifyData>::iterator iter = hash_modify_queue.begin(); iter != hash_modify_queue.end(); iter++) {
 				if(iter->use_hash_queue_counter) {
 					--iter->call->hash_queue_counter;
 				}
 			}
-			if (use_lock_calls_hash) unlock_calls_hash();
 			hash_modify_queue.clear();
 			hash_modify_queue_begin_ms = 0;
 		}
@@ -9371,7 +9507,12 @@ string Calltable::getHashStats() {
 	return("nodes: " + intToString(count_use_nodes) + "\n" +
 	       "max size: " + intToString(max_node_size) + "\n" +
 	       "sum size: " + intToString(sum_nodes_size) + "\n" + 
-	       "avg size: " + (count_use_nodes ? floatToString((double)sum_nodes_size / count_use_nodes, 1) : "-") + "\n");
+	       "avg size: " + (count_use_nodes ? floatToString((double)sum_nodes_size / count_use_nodes, 1) : "-") + "\n" +
+	       (calls_hash_rcu ?
+		 "rcu retired: " + intToString(calls_hash_rcu_epoch.getRetiredCount()) + "\n" +
+		 "rcu reclaimed: " + intToString(calls_hash_rcu_epoch.getReclaimedCount()) + "\n" +
+		 "rcu pending: " + intToString((u_int64_t)calls_hash_rcu_epoch.getRetiredSize()) + "\n" :
+		 ""));
 	#endif
 }
 
@@ -9405,7 +9546,7 @@ void *Calltable::processAudioQueueThread(void *audioQueueThread) {
 		}
 		calltable->unlock_calls_audioqueue();
 		if(call) {
-			if(verbosity > 0) printf("converting RAW file to WAV %s\n", call->fbasename);
+			if(verbosity > 0) printf("converting RAW file to WAV %s\n", call->fbasename.c_str());
 			call->convertRawToWav();
 			if(opt_charts_cache && !opt_charts_cache_store) {
 				calltable->lock_calls_charts_cache_queue();
@@ -9708,20 +9849,20 @@ void
 Calltable::mgcpCleanupTransactions(Call *call) {
 	for(list<u_int32_t>::iterator iter_transactions = call->mgcp_transactions.begin(); iter_transactions != call->mgcp_transactions.end(); iter_transactions++) {
 		sStreamId2 streamId2(call->saddr, call->sport, call->daddr, call->dport, *iter_transactions, true);
-		map<sStreamId2, Call*>::iterator iter_streamid2 = calls_by_stream_id2_listMAP.find(streamId2);
-		if(iter_streamid2 != calls_by_stream_id2_listMAP.end()) {
-			calls_by_stream_id2_listMAP.erase(iter_streamid2);
-		}
+		calls_by_stream_id2_listMAP.eraseWithLock(streamId2);
 	}
 }
 
 void 
 Calltable::mgcpCleanupStream(Call *call) {
 	sStreamId streamId(call->saddr, call->sport, call->daddr, call->dport, true);
-	map<sStreamId, Call*>::iterator iter_stream = calls_by_stream_listMAP.find(streamId);
-	if(iter_stream != calls_by_stream_listMAP.end() && iter_stream->second == call) {
-		calls_by_stream_listMAP.erase(streamId);
+	u_int64_t hash = shardedMapHash(streamId);
+	calls_by_stream_listMAP.lock(hash);
+	Call **iter_stream = calls_by_stream_listMAP.find(streamId, hash);
+	if(iter_stream && *iter_stream == call) {
+		calls_by_stream_listMAP.erase(streamId, hash);
 	}
+	calls_by_stream_listMAP.unlock(hash);
 }
 
 string 
@@ -9798,29 +9939,29 @@ Calltable::getCallTableJson(char *params, bool *zip) {
 	unsigned int now = time(NULL);
 	calltable->lock_calls_listMAP();
 	list<Call*>::iterator callIT1;
-	map<string, Call*>::iterator callMAPIT1;
-	map<sStreamIds2, Call*>::iterator callMAPIT2;
+	cCallIdMap::cIterator callMAPIT1(&calltable->calls_listMAP);
+	cCallStreamCallIdMap::cIterator callMAPIT2(&calltable->calls_by_stream_callid_listMAP);
 	for(int passTypeCall = 0; passTypeCall < 2; passTypeCall++) {
 		int typeCall = passTypeCall == 0 ? INVITE : MGCP;
 		if(typeCall == INVITE) {
 			if(opt_call_id_alternative[0]) {
 				callIT1 = calltable->calls_list.begin();
 			} else {
-				callMAPIT1 = calltable->calls_listMAP.begin();
+				callMAPIT1.begin();
 			}
 		} else {
-			callMAPIT2 = calltable->calls_by_stream_callid_listMAP.begin();
+			callMAPIT2.begin();
 		}
 		while(typeCall == INVITE ? 
 		       (opt_call_id_alternative[0] ?
 			 callIT1 != calltable->calls_list.end() :
-			 callMAPIT1 != calltable->calls_listMAP.end()) : 
-		       callMAPIT2 != calltable->calls_by_stream_callid_listMAP.end()) {
+			 !callMAPIT1.isEnd()) : 
+		       !callMAPIT2.isEnd()) {
 			Call *call;
 			if(typeCall == INVITE) {
-				call = opt_call_id_alternative[0] ? *callIT1 : callMAPIT1->second;
+				call = opt_call_id_alternative[0] ? *callIT1 : callMAPIT1.value();
 			} else {
-				call = (*callMAPIT2).second;
+				call = callMAPIT2.value();
 			}
 			extern int opt_blockcleanupcalls;
 			if(!(call->typeIs(REGISTER) or call->typeIsOnly(MESSAGE) or 
@@ -9888,10 +10029,10 @@ Calltable::getCallTableJson(char *params, bool *zip) {
 				if(opt_call_id_alternative[0]) {
 					++callIT1;
 				} else {
-					++callMAPIT1;
+					callMAPIT1.next();
 				}
 			} else {
-				++callMAPIT2;
+				callMAPIT2.next();
 			}
 		}
 	}
@@ -9992,20 +10133,23 @@ Calltable::add(int call_type, char *call_id, unsigned long call_id_len, vector<s
 	string call_idS = call_id_len ? string(call_id, call_id_len) : string(call_id);
 	if(call_type == REGISTER) {
 		lock_registers_listMAP();
-		registers_listMAP[call_idS] = newcall;
+		registers_listMAP.setWithLock(call_idS, newcall);
 		registers_counter++;
 		unlock_registers_listMAP();
 	} else {
 		lock_calls_listMAP();
-		calls_listMAP[call_idS] = newcall;
+		calls_listMAP.setWithLock(call_idS, newcall);
 		if(opt_call_id_alternative[0]) {
 			calls_list.push_back(newcall);
 			if(call_id_alternative) {
 				for(unsigned i = 0; i < call_id_alternative->size(); i++) {
-					calls_listMAP[(*call_id_alternative)[i]] = newcall;
+					calls_listMAP.setWithLock((*call_id_alternative)[i], newcall);
 				}
 			}
 		}
+		if(cleanup_calls_wheel) {
+			cleanup_calls_wheel_schedule(newcall);
+		}
 		newcall->calls_counter_inc();
 		unlock_calls_listMAP();
 	}
@@ -10051,9 +10195,9 @@ Calltable::add_mgcp(sMgcpRequest *request, time_t time, vmIP saddr, vmPort sport
 	set_global_flags(newcall->flags);
 	
 	lock_calls_listMAP();
-	calls_by_stream_callid_listMAP[sStreamIds2(saddr, sport, daddr, dport, request->parameters.call_id.c_str(), true)] = newcall;
-	calls_by_stream_id2_listMAP[sStreamId2(saddr, sport, daddr, dport, request->transaction_id, true)] = newcall;
-	calls_by_stream_listMAP[sStreamId(saddr, sport, daddr, dport, true)] = newcall;
+	calls_by_stream_callid_listMAP.setWithLock(sStreamIds2(saddr, sport, daddr, dport, request->parameters.call_id.c_str(), true), newcall);
+	calls_by_stream_id2_listMAP.setWithLock(sStreamId2(saddr, sport, daddr, dport, request->transaction_id, true), newcall);
+	calls_by_stream_listMAP.setWithLock(sStreamId(saddr, sport, daddr, dport, true), newcall);
 	newcall->calls_counter_inc();
 	newcall->mgcp_transactions.push_back(request->transaction_id);
 	unlock_calls_listMAP();
@@ -10090,125 +10234,149 @@ Calltable::cleanup_calls( struct timeval *currtime, bool forceClose, const char
 	if(verbosity && verbosityE > 1) {
 		syslog(LOG_NOTICE, "call Calltable::cleanup_calls");
 	}
+	// lock_calls_listMAP is released between the passes of the close - the runs of cleanup_calls (sniffer, manager) are serialized
+	lock_calls_cleanup();
 	Call* call;
 	lock_calls_listMAP();
-	Call **closeCalls = new FILE_LINE(1012) Call*[calls_list_count() + calls_by_stream_callid_listMAP.size()];
-	unsigned int closeCalls_count = 0;
-	int rejectedCalls_count = 0;
-	
+	// the timer wheel returns only the calls with a due timeout, MGCP calls and the close of all calls walk the tables
+	bool useWheel = cleanup_calls_wheel && currtime && !forceClose;
+	vector<void*> wheelCalls;
+	if(useWheel) {
+		lock_calls_wheel();
+		calls_wheel.advance(currtime->tv_sec, &wheelCalls);
+		unlock_calls_wheel();
+	}
+	/* the close is done in two passes - the first one selects the calls with exceeded timeout and removes their find
+	   tables (calls_hash), then one grace period of the lock-free readers of calls_hash is waited for all of them
+	   (outside lock_calls_listMAP) and the second pass checks the counters of packets again and takes the calls out
+	   of the tables */
+	vector<sCleanupCallsCandidate> candidates;
+	if(useWheel) {
+		for(unsigned i = 0; i < wheelCalls.size(); i++) {
+			call = (Call*)wheelCalls[i];
+			sCleanupCallsCandidate candidate(call, INVITE);
+			if(cleanup_calls_check(call, INVITE, currtime, &candidate.in_preprocess_queue_before_process_packet)) {
+				candidate.from_wheel = true;
+				candidates.push_back(candidate);
+			} else {
+				// the check time is taken under lock_calls_wheel - a change of the call state during the check is not lost
+				cleanup_calls_wheel_schedule(call);
+			}
+		}
+	}
 	list<Call*>::iterator callIT1;
-	map<string, Call*>::iterator callMAPIT1;
-	map<sStreamIds2, Call*>::iterator callMAPIT2;
-	for(int passTypeCall = 0; passTypeCall < 2; passTypeCall++) {
+	cCallIdMap::cIterator callMAPIT1(&calls_listMAP);
+	cCallStreamCallIdMap::cIterator callMAPIT2(&calls_by_stream_callid_listMAP);
+	for(int passTypeCall = useWheel ? 1 : 0; passTypeCall < 2; passTypeCall++) {
 		int typeCall = passTypeCall == 0 ? INVITE : MGCP;
 		if(typeCall == INVITE) {
 			if(opt_call_id_alternative[0]) {
 				callIT1 = calls_list.begin();
 			} else {
-				callMAPIT1 = calls_listMAP.begin();
+				callMAPIT1.begin();
 			}
 		} else {
-			callMAPIT2 = calls_by_stream_callid_listMAP.begin();
+			callMAPIT2.begin();
 		}
 		while(typeCall == INVITE ? 
 		       (opt_call_id_alternative[0] ?
 			 callIT1 != calltable->calls_list.end() :
-			 callMAPIT1 != calltable->calls_listMAP.end()) : 
-		       callMAPIT2 != calltable->calls_by_stream_callid_listMAP.end()) {
+			 !callMAPIT1.isEnd()) : 
+		       !callMAPIT2.isEnd()) {
 			if(typeCall == INVITE) {
-				call = opt_call_id_alternative[0] ? *callIT1 : callMAPIT1->second;
+				call = opt_call_id_alternative[0] ? *callIT1 : callMAPIT1.value();
 			} else {
-				call = (*callMAPIT2).second;
+				call = callMAPIT2.value();
 			}
-			if(verbosity > 2) {
-				call->dump();
+			sCleanupCallsCandidate candidate(call, typeCall);
+			if(cleanup_calls_check(call, typeCall, currtime, &candidate.in_preprocess_queue_before_process_packet)) {
+				if(typeCall == MGCP) {
+					candidate.stream_key = callMAPIT2.key();
+				}
+				candidates.push_back(candidate);
 			}
-			if(verbosity && verbosityE > 1) {
-				syslog(LOG_NOTICE, "Calltable::cleanup - try callid %s", call->call_id.c_str());
-			}
-			// rtptimeout seconds of inactivity will save this call and remove from call table
-			bool closeCall = false;
-			if(!currtime || call->force_close) {
-				closeCall = true;
-				if(!is_read_from_file()) {
-					call->force_terminate = true;
-				}
-			} else if(call->typeIs(SKINNY_NEW) ||
-				  call->typeIs(MGCP) ||
-				  call->in_preprocess_queue_before_process_packet <= 0 ||
-				  (!is_read_from_file() &&
-				   (call->in_preprocess_queue_before_process_packet_at[0] && call->in_preprocess_queue_before_process_packet_at[0] < currtime->tv_sec - 300 &&
-				    call->in_preprocess_queue_before_process_packet_at[1] && call->in_preprocess_queue_before_process_packet_at[1] < (getTimeMS_rdtsc() / 1000) - 300))) {
-				if(call->destroy_call_at != 0 && call->destroy_call_at <= currtime->tv_sec) {
-					closeCall = true;
-				} else if((call->destroy_call_at_bye != 0 && call->destroy_call_at_bye <= currtime->tv_sec) ||
-					  (call->destroy_call_at_bye_confirmed != 0 && call->destroy_call_at_bye_confirmed <= currtime->tv_sec)) {
-					closeCall = true;
-					call->bye_timeout_exceeded = true;
-				} else if(call->first_rtp_time_us &&
-					  currtime->tv_sec - call->get_last_packet_time_s() > rtptimeout) {
-					closeCall = true;
-					call->rtp_timeout_exceeded = true;
-				} else if(!call->first_rtp_time_us &&
-					  currtime->tv_sec - call->get_first_packet_time_s() > sipwithoutrtptimeout) {
-					closeCall = true;
-					call->sipwithoutrtp_timeout_exceeded = true;
-				} else if(currtime->tv_sec - call->get_first_packet_time_s() > absolute_timeout) {
-					closeCall = true;
-					call->absolute_timeout_exceeded = true;
-				} else if(currtime->tv_sec - call->get_first_packet_time_s() > 300 &&
-					  !call->seenRES18X && !call->seenRES2XX && !call->first_rtp_time_us) {
-					closeCall = true;
-					call->zombie_timeout_exceeded = true;
-				}
-				if(!closeCall &&
-				   (call->oneway == 1 && (currtime->tv_sec - call->get_last_packet_time_s() > opt_onewaytimeout))) {
-					closeCall = true;
-					call->oneway_timeout_exceeded = true;
+			if(typeCall == INVITE) {
+				if(opt_call_id_alternative[0]) {
+					++callIT1;
+				} else {
+					callMAPIT1.next();
 				}
+			} else {
+				callMAPIT2.next();
 			}
-			if(closeCall) {
-				++call->attemptsClose;
-				call->removeFindTables(currtime, true);
-				if((currtime || !forceClose) &&
-				   ((opt_hash_modify_queue_length_ms && call->hash_queue_counter > 0) ||
-				    call->rtppacketsinqueue != 0)) {
-					closeCall = false;
-					++rejectedCalls_count;
+		}
+	}
+	unlock_calls_listMAP();
+	if(candidates.size() && !opt_hash_modify_queue_length_ms) {
+		// rtppacketsinqueue is incremented by lock-free readers of calls_hash
+		calls_hash_rcu_synchronize();
+	}
+	Call **closeCalls = new FILE_LINE(1012) Call*[candidates.size() + 1];
+	unsigned int closeCalls_count = 0;
+	int rejectedCalls_count = 0;
+	set<Call*> closeCalls_alternative;
+	lock_calls_listMAP();
+	for(unsigned i = 0; i < candidates.size(); i++) {
+		sCleanupCallsCandidate *candidate = &candidates[i];
+		call = candidate->call;
+		bool closeCall;
+		if(candidate->typeCall == INVITE) {
+			if(opt_call_id_alternative[0]) {
+				// find_by_call_id_alternative runs under lock_calls_listMAP
+				closeCall = cleanup_calls_check_close(call, INVITE, currtime, forceClose, candidate->in_preprocess_queue_before_process_packet, &rejectedCalls_count);
+				if(closeCall) {
+					closeCalls_alternative.insert(call);
+					call->removeCallIdMap();
 				}
+			} else {
+				// the shard of the call is locked from the check to the erase - find_by_call_id takes only the lock of the shard
+				// and cannot assign a packet to the call between them
+				u_int64_t call_id_hash = hashStr64(call->call_id);
+				calls_listMAP.lock(call_id_hash);
+				Call **findCall = calls_listMAP.find(call->call_id, call_id_hash);
+				closeCall = findCall && *findCall == call &&
+					    cleanup_calls_check_close(call, INVITE, currtime, forceClose, candidate->in_preprocess_queue_before_process_packet, &rejectedCalls_count);
+				if(closeCall) {
+					calls_listMAP.erase(call->call_id, call_id_hash);
+				}
+				calls_listMAP.unlock(call_id_hash);
 			}
 			if(closeCall) {
-				if(call->listening_worker_run) {
-					*call->listening_worker_run = 0;
-				}
-				closeCalls[closeCalls_count++] = call;
-				if(typeCall == INVITE) {
-					if(opt_call_id_alternative[0]) {
-						calls_list.erase(callIT1++);
-						call->removeCallIdMap();
-					} else {
-						calls_listMAP.erase(callMAPIT1++);
-					}
-					call->removeMergeCalls();
-				} else {
-					calls_by_stream_callid_listMAP.erase(callMAPIT2++);
-					mgcpCleanupTransactions(call);
-					mgcpCleanupStream(call);
-				}
+				call->removeMergeCalls();
+			}
+		} else {
+			// the stream of the call may be moved to another key (CRCX) between the passes
+			u_int64_t stream_key_hash = shardedMapHash(candidate->stream_key);
+			calls_by_stream_callid_listMAP.lock(stream_key_hash);
+			Call **findCall = calls_by_stream_callid_listMAP.find(candidate->stream_key, stream_key_hash);
+			closeCall = findCall && *findCall == call &&
+				    cleanup_calls_check_close(call, MGCP, currtime, forceClose, candidate->in_preprocess_queue_before_process_packet, &rejectedCalls_count);
+			if(closeCall) {
+				calls_by_stream_callid_listMAP.erase(candidate->stream_key, stream_key_hash);
+			}
+			calls_by_stream_callid_listMAP.unlock(stream_key_hash);
+			if(closeCall) {
+				mgcpCleanupTransactions(call);
+				mgcpCleanupStream(call);
+			}
+		}
+		if(closeCall) {
+			closeCalls[closeCalls_count++] = call;
+		} else if(candidate->from_wheel) {
+			cleanup_calls_wheel_schedule(call);
+		}
+	}
+	if(closeCalls_alternative.size()) {
+		for(callIT1 = calls_list.begin(); callIT1 != calls_list.end(); ) {
+			if(closeCalls_alternative.find(*callIT1) != closeCalls_alternative.end()) {
+				calls_list.erase(callIT1++);
 			} else {
-				if(typeCall == INVITE) {
-					if(opt_call_id_alternative[0]) {
-						++callIT1;
-					} else {
-						++callMAPIT1;
-					}
-				} else {
-					++callMAPIT2;
-				}
+				++callIT1;
 			}
 		}
 	}
 	unlock_calls_listMAP();
+	calls_hash_rcu_reclaim();
 	for(unsigned i = 0; i < closeCalls_count; i++) {
 		call = closeCalls[i];
 		if(verbosity && verbosityE > 1) {
@@ -10264,9 +10432,157 @@ Calltable::cleanup_calls( struct timeval *currtime, bool forceClose, const char
 		     << setprecision(3) << (getTimeMS_rdtsc() - beginTimeMS) / 1000. << "s" << endl;
 	}
 	
+	unlock_calls_cleanup();
+	
 	return rejectedCalls_count;
 }
 
+bool
+Calltable::cleanup_calls_check(Call *call, int typeCall, struct timeval *currtime, int *in_preprocess_queue_before_process_packet) {
+	if(verbosity > 2) {
+		call->dump();
+	}
+	if(verbosity && verbosityE > 1) {
+		syslog(LOG_NOTICE, "Calltable::cleanup - try callid %s", call->call_id.c_str());
+	}
+	// rtptimeout seconds of inactivity will save this call and remove from call table
+	bool closeCall = false;
+	*in_preprocess_queue_before_process_packet = call->in_preprocess_queue_before_process_packet;
+	if(!currtime || call->force_close) {
+		closeCall = true;
+		if(!is_read_from_file()) {
+			call->force_terminate = true;
+		}
+	} else if(call->typeIs(SKINNY_NEW) ||
+		  call->typeIs(MGCP) ||
+		  call->in_preprocess_queue_before_process_packet <= 0 ||
+		  (!is_read_from_file() &&
+		   (call->in_preprocess_queue_before_process_packet_at[0] && call->in_preprocess_queue_before_process_packet_at[0] < currtime->tv_sec - 300 &&
+		    call->in_preprocess_queue_before_process_packet_at[1] && call->in_preprocess_queue_before_process_packet_at[1] < (getTimeMS_rdtsc() / 1000) - 300))) {
+		if(call->destroy_call_at != 0 && call->destroy_call_at <= currtime->tv_sec) {
+			closeCall = true;
+		} else if((call->destroy_call_at_bye != 0 && call->destroy_call_at_bye <= currtime->tv_sec) ||
+			  (call->destroy_call_at_bye_confirmed != 0 && call->destroy_call_at_bye_confirmed <= currtime->tv_sec)) {
+			closeCall = true;
+			call->bye_timeout_exceeded = true;
+		} else if(call->first_rtp_time_us &&
+			  currtime->tv_sec - call->get_last_packet_time_s() > rtptimeout) {
+			closeCall = true;
+			call->rtp_timeout_exceeded = true;
+		} else if(!call->first_rtp_time_us &&
+			  currtime->tv_sec - call->get_first_packet_time_s() > sipwithoutrtptimeout) {
+			closeCall = true;
+			call->sipwithoutrtp_timeout_exceeded = true;
+		} else if(currtime->tv_sec - call->get_first_packet_time_s() > absolute_timeout) {
+			closeCall = true;
+			call->absolute_timeout_exceeded = true;
+		} else if(currtime->tv_sec - call->get_first_packet_time_s() > 300 &&
+			  !call->seenRES18X && !call->seenRES2XX && !call->first_rtp_time_us) {
+			closeCall = true;
+			call->zombie_timeout_exceeded = true;
+		}
+		if(!closeCall &&
+		   (call->oneway == 1 && (currtime->tv_sec - call->get_last_packet_time_s() > opt_onewaytimeout))) {
+			closeCall = true;
+			call->oneway_timeout_exceeded = true;
+		}
+	}
+	if(closeCall) {
+		++call->attemptsClose;
+		call->removeFindTables(currtime, true);
+	}
+	return(closeCall);
+}
+
+bool
+Calltable::cleanup_calls_check_close(Call *call, int typeCall, struct timeval *currtime, bool forceClose, int in_preprocess_queue_before_process_packet, int *rejectedCalls_count) {
+	// after the grace period of calls_hash readers (cleanup_calls), under the lock of the shard of the call in calls_listMAP
+	bool closeCall = true;
+	if(currtime && !call->force_close &&
+	   call->typeIsNot(SKINNY_NEW) && call->typeIsNot(MGCP) &&
+	   in_preprocess_queue_before_process_packet <= 0 && call->in_preprocess_queue_before_process_packet > 0) {
+		// a packet was assigned to the call after the first pass
+		closeCall = false;
+		++*rejectedCalls_count;
+	}
+	if(closeCall) {
+		if((currtime || !forceClose) &&
+		   ((opt_hash_modify_queue_length_ms && call->hash_queue_counter > 0) ||
+		    call->rtppacketsinqueue != 0)) {
+			closeCall = false;
+			++*rejectedCalls_count;
+		}
+	}
+	if(closeCall && typeCall == INVITE && !opt_call_id_alternative[0] &&
+	   currtime && !call->force_close && call->isSetCallidMergeHeader()) {
+		// find_by_mergecall_id does not lock calls_listMAP - check that no packet was assigned to the call in meantime
+		call->removeMergeCalls();
+		__sync_synchronize();
+		if(in_preprocess_queue_before_process_packet <= 0 && call->in_preprocess_queue_before_process_packet > 0) {
+			call->restoreMergeCalls();
+			closeCall = false;
+			++*rejectedCalls_count;
+		}
+	}
+	if(closeCall) {
+		if(call->listening_worker_run) {
+			*call->listening_worker_run = 0;
+		}
+		cleanup_calls_wheel_remove(call);
+	}
+	return(closeCall);
+}
+
+void
+Calltable::cleanup_calls_wheel_schedule(Call *call) {
+	lock_calls_wheel();
+	calls_wheel.add(&call->cleanup_wheel_node, cleanup_calls_wheel_check_time(call));
+	unlock_calls_wheel();
+}
+
+void
+Calltable::cleanup_calls_wheel_update(Call *call) {
+	if(!cleanup_calls_wheel) {
+		return;
+	}
+	lock_calls_wheel();
+	// not linked - not scheduled yet, closed or just checked by cleanup_calls (which schedules it again under this lock
+	// with the current state)
+	if(call->cleanup_wheel_node.isLinked()) {
+		u_int64_t checkTime = cleanup_calls_wheel_check_time(call);
+		if(checkTime != call->cleanup_wheel_node.expire) {
+			calls_wheel.add(&call->cleanup_wheel_node, checkTime);
+		}
+	}
+	unlock_calls_wheel();
+}
+
+time_t
+Calltable::cleanup_calls_wheel_check_time(Call *call) {
+	time_t checkTime = call->get_cleanup_check_time();
+	time_t current = calls_wheel.getCurrent();
+	if(current) {
+		// current is the tick after the last cleanup_calls
+		if(checkTime < current) {
+			// timeout exceeded but the call is still in use (preprocess queue, rtp threads)
+			checkTime = current;
+		} else if(checkTime > current - 1 + CLEANUP_CALLS_WHEEL_MAX_DELAY) {
+			checkTime = current - 1 + CLEANUP_CALLS_WHEEL_MAX_DELAY;
+		}
+	}
+	return(checkTime);
+}
+
+void
+Calltable::cleanup_calls_wheel_remove(Call *call) {
+	if(!call->cleanup_wheel_node.isLinked()) {
+		return;
+	}
+	lock_calls_wheel();
+	calls_wheel.remove(&call->cleanup_wheel_node);
+	unlock_calls_wheel();
+}
+
 int
 Calltable::cleanup_registers(struct timeval *currtime) {
 
@@ -10275,8 +10591,9 @@ Calltable::cleanup_registers(struct timeval *currtime) {
 	}
 	Call* reg;
 	lock_registers_listMAP();
-	for (map<string, Call*>::iterator registerMAPIT = registers_listMAP.begin(); registerMAPIT != registers_listMAP.end();) {
-		reg = (*registerMAPIT).second;
+	cCallIdMap::cIterator registerMAPIT(&registers_listMAP);
+	for(registerMAPIT.begin(); !registerMAPIT.isEnd();) {
+		reg = registerMAPIT.value();
 		if(verbosity > 2) {
 			reg->dump();
 		}
@@ -10351,14 +10668,15 @@ Calltable::cleanup_registers(struct timeval *currtime) {
 					unlock_registers_queue();
 				}
 			}
-			registers_listMAP.erase(registerMAPIT++);
+			registerMAPIT.erase();
+			registerMAPIT.next();
 			if(opt_enable_fraud && currtime) {
 				fraudEndCall(reg, *currtime);
 			}
 			extern u_int64_t counter_registers_clean;
 			++counter_registers_clean;
 		} else {
-			++registerMAPIT;
+			registerMAPIT.next();
 		}
 	}
 	unlock_registers_listMAP();
@@ -10416,13 +10734,10 @@ void Calltable::addSystemCommand(const char *command) {
 
 void Call::saveregister(struct timeval *currtime) {
 	((Calltable*)calltable)->lock_registers_listMAP();
-        map<string, Call*>::iterator registerMAPIT = ((Calltable*)calltable)->registers_listMAP.find(call_id);
-	if(registerMAPIT == ((Calltable*)calltable)->registers_listMAP.end()) {
+	if(!((Calltable*)calltable)->registers_listMAP.eraseWithLock(call_id)) {
 		syslog(LOG_ERR,"Fatal error REGISTER call_id[%s] not found in registerMAPIT", call_id.c_str());
 		((Calltable*)calltable)->unlock_registers_listMAP();
 		return;
-	} else {
-		((Calltable*)calltable)->registers_listMAP.erase(registerMAPIT);
 	}
 	((Calltable*)calltable)->unlock_registers_listMAP();
 	extern u_int64_t counter_registers_clean;
@@ -10493,16 +10808,16 @@ Call::handle_dtmf(char dtmf, double dtmf_time, vmIP saddr, vmIP daddr, s_dtmf::e
 
 		if (dtmfflag2[dtmfflag2_index] == 0) {
 			if (sverb.dtmf)
-				syslog(LOG_NOTICE, "[%s] initial DTMF detected %s ", fbasename, dtmf_type_string);
+				syslog(LOG_NOTICE, "[%s] initial DTMF detected %s ", fbasename.c_str(), dtmf_type_string);
 		} else {
 			if (dtmf_time - this->lastdtmf_time > opt_pauserecordingdtmf_timeout) {	//timeout reset flag
 				dtmfflag2[dtmfflag2_index] = 0;
 				if (sverb.dtmf)
 					syslog(LOG_NOTICE, "[%s] DTMF detected %s / Diff from last DTMF: %lf s / possible timeout %i s. Too late, resetting dtmf flag",
-					    fbasename, dtmf_type_string, dtmf_time - this->lastdtmf_time, opt_pauserecordingdtmf_timeout);
+					    fbasename.c_str(), dtmf_type_string, dtmf_time - this->lastdtmf_time, opt_pauserecordingdtmf_timeout);
 			} else {
 				if (sverb.dtmf)
-					syslog(LOG_NOTICE, "[%s] DTMF detected %s / Diff from last DTMF: %lf s.", fbasename, dtmf_type_string, dtmf_time - this->lastdtmf_time);
+					syslog(LOG_NOTICE, "[%s] DTMF detected %s / Diff from last DTMF: %lf s.", fbasename.c_str(), dtmf_type_string, dtmf_time - this->lastdtmf_time);
 			}
 		}
 		this->lastdtmf_time = dtmf_time;
@@ -10518,12 +10833,12 @@ Call::handle_dtmf(char dtmf, double dtmf_time, vmIP saddr, vmIP daddr, s_dtmf::e
 				if(dtmfflag2[dtmfflag2_index] + 1 == strlen(opt_silencedtmfseq)) {
 					if(silencerecording == 0) {
 						if(sverb.dtmf)
-							syslog(LOG_NOTICE, "[%s] pause DTMF sequence detected - pausing recording - %s / %lf s", fbasename, 
+							syslog(LOG_NOTICE, "[%s] pause DTMF sequence detected - pausing recording - %s / %lf s", fbasename.c_str(), 
 							       dtmf_type_string, dtmf_time - TIME_US_TO_SF(this->first_packet_time_us));
 						silencerecording = 1;
 					} else {
 						if(sverb.dtmf)
-							syslog(LOG_NOTICE, "[%s] pause DTMF sequence detected - unpausing recording - %s / %lf s", fbasename, 
+							syslog(LOG_NOTICE, "[%s] pause DTMF sequence detected - unpausing recording - %s / %lf s", fbasename.c_str(), 
 							       dtmf_type_string, dtmf_time - TIME_US_TO_SF(this->first_packet_time_us));
 						silencerecording = 0;
 					}       
@@ -43,12 +43,18 @@
 #include "voipmonitor.h"
 #include "tools_fifo_buffer.h"
 #include "record_array.h"
+#include "sharded_map.h"
+#include "epoch_rcu.h"
+#include "timer_wheel.h"
+#include "str_arena.h"
+#include "slab_alloc.h"
 
 #define MAX_IP_PER_CALL 40	//!< total maxumum of SDP sessions for one call-id
 #define MAX_SSRC_PER_CALL 40	//!< total maxumum of SDP sessions for one call-id
 #define MAX_FNAME 256		//!< max len of stored call-id
 #define MAX_RTPMAP 40          //!< max rtpmap records
 #define MAXNODE 150000
+#define CLEANUP_CALLS_WHEEL_MAX_DELAY 300	//!< max. interval of checks of a call by the cleanup timer wheel
 #define MAX_SIPCALLERDIP 8
 #define MAXLEN_SDP_SESSID 30
 #define MAXLEN_SDP_LABEL 20
@@ -201,6 +207,8 @@ struct node_call_rtp : public list<call_rtp*> {
 #else
 struct node_call_rtp : public call_rtp {
 	node_call_rtp *next;
+	SLAB_POOL_OPERATORS(slab_pool)
+	static cSlabPool slab_pool;
 };
 #endif
 
@@ -213,6 +221,8 @@ struct node_call_rtp_ip_port {
 	#endif
 	vmIP addr;
 	vmPort port;
+	SLAB_POOL_OPERATORS(slab_pool)
+	static cSlabPool slab_pool;
 };
 
 struct node_call_rtp_ports {
@@ -434,7 +444,7 @@ public:
 	string get_filename(eTypeSpoolFile typeSpoolFile, const char *fileExtension = NULL);
 	string get_pathfilename(eTypeSpoolFile typeSpoolFile, const char *fileExtension = NULL);
 	string dirnamesqlfiles();
-	char *get_fbasename_safe();
+	const char *get_fbasename_safe();
 	const char *getSpoolDir(eTypeSpoolFile typeSpoolFile) {
 		return(::getSpoolDir(typeSpoolFile, getSpoolIndex()));
 	}
@@ -465,8 +475,9 @@ public:
 	int type_base;
 	int type_next;
 	u_int64_t first_packet_time_us;
-	char fbasename[MAX_FNAME];
-	char fbasename_safe[MAX_FNAME];
+	cStrArena str_arena;
+	cArenaStr<MAX_FNAME> fbasename;
+	cArenaStr<MAX_FNAME> fbasename_safe;
 	u_int64_t fname_register;
 	int useSensorId;
 	int useDlt;
@@ -674,16 +685,16 @@ public:
 	string call_id;	//!< call-id from SIP session
 	map<string, bool> *call_id_alternative;
 	volatile int _call_id_alternative_lock;
-	char callername[256];		//!< callerid name from SIP header
-	char caller[256];		//!< From: xxx 
-	char caller_domain[256];	//!< From: xxx 
-	char called[256];		//!< To: xxx
+	cArenaStr<256> callername;	//!< callerid name from SIP header
+	cArenaStr<256> caller;		//!< From: xxx 
+	cArenaStr<256> caller_domain;	//!< From: xxx 
+	cArenaStr<256> called;		//!< To: xxx
 	map<string, string> called_invite_branch_map;
-	char called_domain[256];	//!< To: xxx
-	char contact_num[64];		//!< 
-	char contact_domain[128];	//!< 
-	char digest_username[64];	//!< 
-	char digest_realm[64];		//!< 
+	cArenaStr<256> called_domain;	//!< To: xxx
+	cArenaStr<64> contact_num;	//!< 
+	cArenaStr<128> contact_domain;	//!< 
+	cArenaStr<64> digest_username;	//!< 
+	cArenaStr<64> digest_realm;	//!< 
 	int register_expires;	
 	sCseq byecseq[2];		
 	sCseq invitecseq;		
@@ -693,8 +704,8 @@ public:
 	sCseq registercseq;
 	sCseq cancelcseq;		
 	sCseq updatecseq;		
-	char custom_header1[256];	//!< Custom SIP header
-	char match_header[128];	//!< Custom SIP header
+	cArenaStr<256> custom_header1;	//!< Custom SIP header
+	cArenaStr<128> match_header;	//!< Custom SIP header
 	bool seeninvite;		//!< true if we see SIP INVITE within the Call
 	bool seeninviteok;			//!< true if we see SIP INVITE within the Call
 	bool seenmessage;
@@ -710,8 +721,8 @@ public:
 	bool seenRES2XX_no_BYE;
 	bool seenRES18X;
 	bool sighup;			//!< true if call is saving during sighup
-	char a_ua[1024];		//!< caller user agent 
-	char b_ua[1024];		//!< callee user agent 
+	cArenaStr<1024> a_ua;		//!< caller user agent 
+	cArenaStr<1024> b_ua;		//!< callee user agent 
 	RTPMAP rtpmap[MAX_IP_PER_CALL][MAX_RTPMAP]; //!< rtpmap for every rtp stream
 	RTP *lastcallerrtp;		//!< last RTP stream from caller
 	RTP *lastcalledrtp;		//!< last RTP stream from called
@@ -773,6 +784,7 @@ public:
 	time_t destroy_call_at;
 	time_t destroy_call_at_bye;
 	time_t destroy_call_at_bye_confirmed;
+	sTimerWheelNode cleanup_wheel_node;
 	std::queue <s_dtmf> dtmf_history;
 	
 	u_int64_t first_invite_time_us;
@@ -849,6 +861,12 @@ public:
 
 	int thread_num;
 	int thread_num_rd;
+	volatile int rtp_thread_migrate_to;
+	u_int64_t rtp_thread_migrate_request_ms;
+	u_int64_t rtp_thread_migrate_last_ms;
+	u_int64_t rtp_thread_balance_window_ms;
+	u_int32_t rtp_thread_balance_packets;
+	volatile int rtp_thread_push_sync;
 
 	char oneway;
 	char absolute_timeout_exceeded;
@@ -948,13 +966,16 @@ public:
 	 * 
 	*/
 	~Call();
+	
+	SLAB_POOL_OPERATORS(slab_pool)
+	static cSlabPool slab_pool;
 
 	int get_index_by_ip_port(vmIP addr, vmPort port, bool use_sip_src_addr = false);
 	int get_index_by_sessid_to(char *sessid, char *to, vmIP sip_src_addr, ip_port_call_info::eTypeAddr type_addr);
 	int get_index_by_iscaller(int iscaller);
 	
 	bool is_multiple_to_branch();
-	bool to_is_canceled(char *to);
+	bool to_is_canceled(const char *to);
 	string get_to_not_canceled();
 
 	/**
@@ -1308,6 +1329,11 @@ public:
 		}
 	}
 	
+	time_t get_cleanup_check_time();
+	
+	size_t get_str_fixed_size();
+	size_t get_rtp_size();
+	
 	void applyRtcpXrDataToRtp();
 	
 	void adjustUA();
@@ -1378,6 +1404,7 @@ public:
 	}
 	void removeCallIdMap();
 	void removeMergeCalls();
+	void restoreMergeCalls();
 	void mergecalls_lock() {
 		while(__sync_lock_test_and_set(&this->_mergecalls_lock, 1));
 	}
@@ -1794,6 +1821,24 @@ struct sChartsCallData {
 /**
   * This class implements operations on Call list
 */
+inline u_int64_t shardedMapHash(const sStreamId &key) {
+	return(hashMix64(((u_int64_t)key.s.ip.getHashNumber() << 32 | key.c.ip.getHashNumber()) ^
+			 ((u_int64_t)key.s.port.getPort() << 48 | (u_int64_t)key.c.port.getPort() << 16)));
+}
+
+inline u_int64_t shardedMapHash(const sStreamId2 &key) {
+	return(hashMix64(shardedMapHash(sStreamId(key.s.ip, key.s.port, key.c.ip, key.c.port)) ^ key.id));
+}
+
+inline u_int64_t shardedMapHash(const sStreamIds2 &key) {
+	return(hashMix64(shardedMapHash(sStreamId(key.s.ip, key.s.port, key.c.ip, key.c.port)) ^ hashStr64(key.ids)));
+}
+
+typedef cShardedMap<string, Call*> cCallIdMap;
+typedef cShardedMap<sStreamIds2, Call*> cCallStreamCallIdMap;
+typedef cShardedMap<sStreamId2, Call*> cCallStreamId2Map;
+typedef cShardedMap<sStreamId, Call*> cCallStreamMap;
+
 class Calltable {
 private:
 	struct sAudioQueueThread {
@@ -1820,6 +1865,19 @@ private:
 		s_sdp_flags sdp_flags;
 		bool use_hash_queue_counter;
 	};
+	struct sCleanupCallsCandidate {
+		sCleanupCallsCandidate(Call *call, int typeCall) {
+			this->call = call;
+			this->typeCall = typeCall;
+			in_preprocess_queue_before_process_packet = 0;
+			from_wheel = false;
+		}
+		Call *call;
+		int typeCall;
+		int in_preprocess_queue_before_process_packet;
+		bool from_wheel;
+		sStreamIds2 stream_key;
+	};
 public:
 	deque<Call*> calls_queue; //!< this queue is used for asynchronous storing CDR by the worker thread
 	deque<Call*> audio_queue; //!< this queue is used for asynchronous audio convert by the worker thread
@@ -1831,12 +1889,12 @@ public:
 	queue<string> files_queue; //!< this queue is used for asynchronous storing CDR by the worker thread
 	queue<string> files_sqlqueue; //!< this queue is used for asynchronous storing CDR by the worker thread
 	list<Call*> calls_list;
-	map<string, Call*> calls_listMAP;
-	map<sStreamIds2, Call*> calls_by_stream_callid_listMAP;
-	map<sStreamId2, Call*> calls_by_stream_id2_listMAP;
-	map<sStreamId, Call*> calls_by_stream_listMAP;
-	map<string, Call*> calls_mergeMAP;
-	map<string, Call*> registers_listMAP;
+	cCallIdMap calls_listMAP;
+	cCallStreamCallIdMap calls_by_stream_callid_listMAP;
+	cCallStreamId2Map calls_by_stream_id2_listMAP;
+	cCallStreamMap calls_by_stream_listMAP;
+	cCallIdMap calls_mergeMAP;
+	cCallIdMap registers_listMAP;
 	map<d_item<vmIP>, Call*> skinny_ipTuples;
 	map<unsigned int, Call*> skinny_partyID;
 	map<string, Ss7*> ss7_listMAP;
@@ -1880,6 +1938,8 @@ public:
 	void lock_process_ss7_listmap() { while(__sync_lock_test_and_set(&this->_sync_lock_process_ss7_listmap, 1)) USLEEP(10); }
 	void lock_process_ss7_queue() { while(__sync_lock_test_and_set(&this->_sync_lock_process_ss7_queue, 1)) USLEEP(10); }
 	void lock_hash_modify_queue() { while(__sync_lock_test_and_set(&this->_sync_lock_hash_modify_queue, 1)) USLEEP(10); }
+	void lock_calls_wheel() { while(__sync_lock_test_and_set(&this->_sync_lock_calls_wheel, 1)) USLEEP(10); }
+	void lock_calls_cleanup() { while(__sync_lock_test_and_set(&this->_sync_lock_calls_cleanup, 1)) USLEEP(10); }
 
 	/**
 	 * @brief unlock calls_queue structure 
@@ -1900,6 +1960,8 @@ public:
 	void unlock_process_ss7_listmap() { __sync_lock_release(&this->_sync_lock_process_ss7_listmap); };
 	void unlock_process_ss7_queue() { __sync_lock_release(&this->_sync_lock_process_ss7_queue); };
 	void unlock_hash_modify_queue() { __sync_lock_release(&this->_sync_lock_hash_modify_queue); };
+	void unlock_calls_wheel() { __sync_lock_release(&this->_sync_lock_calls_wheel); };
+	void unlock_calls_cleanup() { __sync_lock_release(&this->_sync_lock_calls_cleanup); };
 
 	/**
 	 * @brief add Call to Calltable
@@ -1930,40 +1992,56 @@ public:
 	 *
 	 * @return reference of the Call if found, otherwise return NULL
 	*/
-	Call *find_by_call_id(char *call_id, unsigned long call_id_len, vector<string> *call_id_alternative, time_t time) {
+	Call *find_by_call_id(char *call_id, unsigned long call_id_len, vector<string> *call_id_alternative, time_t time, u_int64_t call_id_hash = 0) {
 		extern char opt_call_id_alternative[256];
+		if(!call_id_len) {
+			call_id_len = strlen(call_id);
+		}
+		if(opt_call_id_alternative[0]) {
+			return(find_by_call_id_alternative(string(call_id, call_id_len), call_id_alternative, time));
+		}
+		if(!call_id_hash) {
+			call_id_hash = hashStr64(call_id, call_id_len);
+		}
+		Call *rslt_call = NULL;
+		calls_listMAP.lock(call_id_hash);
+		Call **callMAPIT = calls_listMAP.find(sStrRef(call_id, call_id_len), call_id_hash);
+		if(callMAPIT) {
+			rslt_call = *callMAPIT;
+			if(time) {
+				__sync_add_and_fetch(&rslt_call->in_preprocess_queue_before_process_packet, 1);
+				rslt_call->in_preprocess_queue_before_process_packet_at[0] = time;
+				rslt_call->in_preprocess_queue_before_process_packet_at[1] = getTimeMS_rdtsc() / 1000;
+			}
+		}
+		calls_listMAP.unlock(call_id_hash);
+		return(rslt_call);
+	}
+	Call *find_by_call_id_alternative(string call_idS, vector<string> *call_id_alternative, time_t time) {
 		Call *rslt_call = NULL;
-		string call_idS = call_id_len ? string(call_id, call_id_len) : string(call_id);
 		lock_calls_listMAP();
-		map<string, Call*>::iterator callMAPIT = calls_listMAP.find(call_idS);
-		if(opt_call_id_alternative[0]) {
-			if(callMAPIT == calls_listMAP.end() && call_id_alternative) {
-				for(unsigned i = 0; i < call_id_alternative->size(); i++) {
-					callMAPIT = calls_listMAP.find((*call_id_alternative)[i]);
-					if(callMAPIT != calls_listMAP.end()) {
-						break;
-					}
+		if(!calls_listMAP.findWithLock(call_idS, &rslt_call) && call_id_alternative) {
+			for(unsigned i = 0; i < call_id_alternative->size(); i++) {
+				if(calls_listMAP.findWithLock((*call_id_alternative)[i], &rslt_call)) {
+					break;
 				}
 			}
 		}
-		if(callMAPIT != calls_listMAP.end()) {
-			rslt_call = callMAPIT->second;
-			if(opt_call_id_alternative[0]) {
-				rslt_call->call_id_alternative_lock();
-				if(call_idS != rslt_call->call_id) {
-					calls_listMAP[call_idS] = rslt_call;
-					(*rslt_call->call_id_alternative)[call_idS] = true;
-				}
-				if(call_id_alternative) {
-					for(unsigned i = 0; i < call_id_alternative->size(); i++) {
-						if((*call_id_alternative)[i] != rslt_call->call_id) {
-							calls_listMAP[(*call_id_alternative)[i]] = rslt_call;
-							(*rslt_call->call_id_alternative)[(*call_id_alternative)[i]] = true;
-						}
+		if(rslt_call) {
+			rslt_call->call_id_alternative_lock();
+			if(call_idS != rslt_call->call_id) {
+				calls_listMAP.setWithLock(call_idS, rslt_call);
+				(*rslt_call->call_id_alternative)[call_idS] = true;
+			}
+			if(call_id_alternative) {
+				for(unsigned i = 0; i < call_id_alternative->size(); i++) {
+					if((*call_id_alternative)[i] != rslt_call->call_id) {
+						calls_listMAP.setWithLock((*call_id_alternative)[i], rslt_call);
+						(*rslt_call->call_id_alternative)[(*call_id_alternative)[i]] = true;
 					}
 				}
-				rslt_call->call_id_alternative_unlock();
 			}
+			rslt_call->call_id_alternative_unlock();
 			if(time) {
 				__sync_add_and_fetch(&rslt_call->in_preprocess_queue_before_process_packet, 1);
 				rslt_call->in_preprocess_queue_before_process_packet_at[0] = time;
@@ -1975,61 +2053,56 @@ public:
 	}
 	Call *find_by_stream_callid(vmIP sip, vmPort sport, vmIP dip, vmPort dport, const char *callid) {
 		Call *rslt_call = NULL;
-		lock_calls_listMAP();
-		map<sStreamIds2, Call*>::iterator callMAPIT = calls_by_stream_callid_listMAP.find(sStreamIds2(sip, sport, dip, dport, callid, true));
-		if(callMAPIT != calls_by_stream_callid_listMAP.end()) {
-			rslt_call = callMAPIT->second;
-		}
-		unlock_calls_listMAP();
+		calls_by_stream_callid_listMAP.findWithLock(sStreamIds2(sip, sport, dip, dport, callid, true), &rslt_call);
 		return(rslt_call);
 	}
 	Call *find_by_stream_id2(vmIP sip, vmPort sport, vmIP dip, vmPort dport, u_int64_t id) {
 		Call *rslt_call = NULL;
-		lock_calls_listMAP();
-		map<sStreamId2, Call*>::iterator callMAPIT = calls_by_stream_id2_listMAP.find(sStreamId2(sip, sport, dip, dport, id, true));
-		if(callMAPIT != calls_by_stream_id2_listMAP.end()) {
-			rslt_call = callMAPIT->second;
-		}
-		unlock_calls_listMAP();
+		calls_by_stream_id2_listMAP.findWithLock(sStreamId2(sip, sport, dip, dport, id, true), &rslt_call);
 		return(rslt_call);
 	}
 	Call *find_by_stream(vmIP sip, vmPort sport, vmIP dip, vmPort dport) {
 		Call *rslt_call = NULL;
-		lock_calls_listMAP();
-		map<sStreamId, Call*>::iterator callMAPIT = calls_by_stream_listMAP.find(sStreamId(sip, sport, dip, dport, true));
-		if(callMAPIT != calls_by_stream_listMAP.end()) {
-			rslt_call = callMAPIT->second;
-		}
-		unlock_calls_listMAP();
+		calls_by_stream_listMAP.findWithLock(sStreamId(sip, sport, dip, dport, true), &rslt_call);
 		return(rslt_call);
 	}
-	Call *find_by_mergecall_id(char *call_id, unsigned long call_id_len, time_t time) {
+	/* only the shard of calls_mergeMAP is locked - cleanup_calls removes the merge ids before the final check of
+	   in_preprocess_queue_before_process_packet and restores them if a lookup came in meantime */
+	Call *find_by_mergecall_id(char *call_id, unsigned long call_id_len, time_t time, u_int64_t call_id_hash = 0) {
+		if(!call_id_len) {
+			call_id_len = strlen(call_id);
+		}
+		if(!call_id_hash) {
+			call_id_hash = hashStr64(call_id, call_id_len);
+		}
 		Call *rslt_call = NULL;
-		string call_idS = call_id_len ? string(call_id, call_id_len) : string(call_id);
-		lock_calls_listMAP();
-		lock_calls_mergeMAP();
-		map<string, Call*>::iterator mergeMAPIT = calls_mergeMAP.find(call_idS);
-		if(mergeMAPIT != calls_mergeMAP.end()) {
-			rslt_call = mergeMAPIT->second;
+		calls_mergeMAP.lock(call_id_hash);
+		Call **mergeMAPIT = calls_mergeMAP.find(sStrRef(call_id, call_id_len), call_id_hash);
+		if(mergeMAPIT) {
+			rslt_call = *mergeMAPIT;
 			if(time) {
 				__sync_add_and_fetch(&rslt_call->in_preprocess_queue_before_process_packet, 1);
 				rslt_call->in_preprocess_queue_before_process_packet_at[0] = time;
 				rslt_call->in_preprocess_queue_before_process_packet_at[1] = getTimeMS_rdtsc() / 1000;
 			}
 		}
-		unlock_calls_mergeMAP();
-		unlock_calls_listMAP();
+		calls_mergeMAP.unlock(call_id_hash);
 		return(rslt_call);
 	}
-	Call *find_by_register_id(char *register_id, unsigned long register_id_len) {
+	Call *find_by_register_id(char *register_id, unsigned long register_id_len, u_int64_t register_id_hash = 0) {
+		if(!register_id_len) {
+			register_id_len = strlen(register_id);
+		}
+		if(!register_id_hash) {
+			register_id_hash = hashStr64(register_id, register_id_len);
+		}
 		Call *rslt_register = NULL;
-		string register_idS = register_id_len ? string(register_id, register_id_len) : string(register_id);
-		lock_registers_listMAP();
-		map<string, Call*>::iterator registerMAPIT = registers_listMAP.find(register_idS);
-		if(registerMAPIT != registers_listMAP.end()) {
-			rslt_register = registerMAPIT->second;
+		registers_listMAP.lock(register_id_hash);
+		Call **registerMAPIT = registers_listMAP.find(sStrRef(register_id, register_id_len), register_id_hash);
+		if(registerMAPIT) {
+			rslt_register = *registerMAPIT;
 		}
-		unlock_registers_listMAP();
+		registers_listMAP.unlock(register_id_hash);
 		return(rslt_register);
 	}
 	Call *find_by_reference(long long callreference, bool lock) {
@@ -2044,9 +2117,10 @@ public:
 				}
 			}
 		} else {
-			for(map<string, Call*>::iterator iter = calls_listMAP.begin(); iter != calls_listMAP.end(); iter++) {
-				if((long long)(iter->second) == callreference) {
-					rslt_call = iter->second;
+			cCallIdMap::cIterator iter(&calls_listMAP);
+			for(iter.begin(); !iter.isEnd(); iter.next()) {
+				if((long long)(iter.value()) == callreference) {
+					rslt_call = iter.value();
 					break;
 				}
 			}
@@ -2105,6 +2179,15 @@ public:
 	*/
 	int cleanup_calls( struct timeval *currtime, bool forceClose = false, const char *file = NULL, int line = 0);
 	int cleanup_registers( struct timeval *currtime);
+	/* with cleanup_calls_wheel calls in calls_listMAP are scheduled to the time of their nearest timeout (Call::get_cleanup_check_time)
+	   and cleanup_calls checks only the due calls; a change of a timeout must be followed by cleanup_calls_wheel_update
+	   (activity which only moves the timeouts later is found by the check and the call is scheduled again) */
+	bool is_cleanup_calls_wheel() {
+		return(cleanup_calls_wheel);
+	}
+	void cleanup_calls_wheel_schedule(Call *call);
+	void cleanup_calls_wheel_update(Call *call);
+	void cleanup_calls_wheel_remove(Call *call);
 	int cleanup_ss7( struct timeval *currtime );
 
 	/**
@@ -2307,10 +2390,51 @@ public:
 	void unlock_calls_hash() {
 		__sync_lock_release(&this->_sync_lock_calls_hash);
 	}
+	/* readers of calls_hash - with hash_rtp_rcu only the epoch of the thread is announced, writers keep lock_calls_hash
+	   and release the unlinked nodes by hashRetire */
+	bool is_calls_hash_rcu() {
+		return(calls_hash_rcu);
+	}
+	void lock_calls_hash_read() {
+		if(calls_hash_rcu) {
+			calls_hash_rcu_epoch.readLock();
+		} else {
+			lock_calls_hash();
+		}
+	}
+	void unlock_calls_hash_read() {
+		if(calls_hash_rcu) {
+			calls_hash_rcu_epoch.readUnlock();
+		} else {
+			unlock_calls_hash();
+		}
+	}
+	void calls_hash_rcu_synchronize() {
+		if(calls_hash_rcu) {
+			calls_hash_rcu_epoch.synchronize();
+		}
+	}
+	void calls_hash_rcu_reclaim() {
+		if(calls_hash_rcu) {
+			calls_hash_rcu_epoch.reclaim();
+		}
+	}
+	template <class type_node>
+	void hashRetire(type_node *node) {
+		if(calls_hash_rcu) {
+			calls_hash_rcu_epoch.retire(node, cEpochRcu::destroyItem<type_node>);
+		} else {
+			delete node;
+		}
+	}
 	
 	void addSystemCommand(const char *command);
 	
 private:
+	bool cleanup_calls_check(Call *call, int typeCall, struct timeval *currtime, int *in_preprocess_queue_before_process_packet);
+	bool cleanup_calls_check_close(Call *call, int typeCall, struct timeval *currtime, bool forceClose, int in_preprocess_queue_before_process_packet, int *rejectedCalls_count);
+	time_t cleanup_calls_wheel_check_time(Call *call);
+	
 	/*
 	pthread_mutex_t qlock;		//!< mutex locking calls_queue
 	pthread_mutex_t qaudiolock;	//!< mutex locking calls_audioqueue
@@ -2333,7 +2457,13 @@ private:
 	#else
 	node_call_rtp_ip_port *calls_hash[MAXNODE];
 	#endif
+	bool calls_hash_rcu;
+	cEpochRcu calls_hash_rcu_epoch;
 	volatile int _sync_lock_calls_hash;
+	bool cleanup_calls_wheel;
+	cTimerWheel calls_wheel;
+	volatile int _sync_lock_calls_wheel;
+	volatile int _sync_lock_calls_cleanup;
 	volatile int _sync_lock_calls_listMAP;
 	volatile int _sync_lock_calls_mergeMAP;
 	volatile int _sync_lock_registers_listMAP;
@@ -53,6 +53,7 @@ struct sVerbose {
 	int memory_stat_ignore_limit;
 	int qring_stat;
 	int qring_full;
+	int qring_wait;
 	int alloc_stat;
 	int qfiles;
 	int query_error;
@@ -111,6 +112,7 @@ struct sVerbose {
 	int screen_popup;
 	int screen_popup_syslog;
 	int cleanup_calls;
+	int jitterbuffer_deferred_check;
 	int usleep_stats;
 	int charts_cache_only;
 	int charts_cache_filters_eval;
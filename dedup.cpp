@@ -0,0 +1,115 @@
+#include <sstream>
+
+#include "dedup.h"
+#include "heap_safe.h"
+#include "sync.h"
+
+
+extern int opt_dup_check_window_ms;
+
+
+static inline u_int64_t rotl64(u_int64_t x, int8_t r) {
+	return((x << r) | (x >> (64 - r)));
+}
+
+static inline u_int64_t fmix64(u_int64_t k) {
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdull;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ull;
+	k ^= k >> 33;
+	return(k);
+}
+
+void dedup_hash(u_int16_t *hash, const void *data, size_t length) {
+	const u_char *p = (const u_char*)data;
+	const size_t nblocks = length / 16;
+	u_int64_t h1 = 0;
+	u_int64_t h2 = 0;
+	const u_int64_t c1 = 0x87c37b91114253d5ull;
+	const u_int64_t c2 = 0x4cf5ad432745937full;
+	for(size_t i = 0; i < nblocks; i++) {
+		u_int64_t k1, k2;
+		memcpy(&k1, p + i * 16, 8);
+		memcpy(&k2, p + i * 16 + 8, 8);
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+	size_t tailLength = length & 15;
+	if(tailLength) {
+		u_char tail[16];
+		memset(tail, 0, sizeof(tail));
+		memcpy(tail, p + nblocks * 16, tailLength);
+		u_int64_t k1, k2;
+		memcpy(&k1, tail, 8);
+		memcpy(&k2, tail + 8, 8);
+		if(tailLength > 8) {
+			k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		}
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+	}
+	h1 ^= length;
+	h2 ^= length;
+	h1 += h2;
+	h2 += h1;
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+	h1 += h2;
+	h2 += h1;
+	memcpy(hash, &h1, 8);
+	memcpy(hash + 4, &h2, 8);
+	if(!hash[0]) {
+		hash[0] = 1;
+	}
+}
+
+
+std::list<cDedupTable*> cDedupTable::tables;
+cDedupTable::sStat cDedupTable::stat_removed;
+cDedupTable::sStat cDedupTable::stat_last;
+volatile int cDedupTable::tables_sync = 0;
+
+cDedupTable::cDedupTable(unsigned sets) {
+	unsigned _sets = 1;
+	while(_sets < sets) {
+		_sets <<= 1;
+	}
+	table = new FILE_LINE(0) sEntry[_sets * DEDUP_TABLE_WAYS];
+	memset(table, 0, _sets * DEDUP_TABLE_WAYS * sizeof(sEntry));
+	setsMask = _sets - 1;
+	window_us = opt_dup_check_window_ms > 0 ? opt_dup_check_window_ms * 1000ull : 0;
+	__SYNC_LOCK(tables_sync);
+	tables.push_back(this);
+	__SYNC_UNLOCK(tables_sync);
+}
+
+cDedupTable::~cDedupTable() {
+	__SYNC_LOCK(tables_sync);
+	tables.remove(this);
+	stat_removed.hits += stat.hits;
+	stat_removed.misses += stat.misses;
+	stat_removed.evictions += stat.evictions;
+	__SYNC_UNLOCK(tables_sync);
+	delete [] table;
+}
+
+std::string cDedupTable::getStatString() {
+	__SYNC_LOCK(tables_sync);
+	sStat sum = stat_removed;
+	for(std::list<cDedupTable*>::iterator iter = tables.begin(); iter != tables.end(); iter++) {
+		sum.hits += (*iter)->stat.hits;
+		sum.misses += (*iter)->stat.misses;
+		sum.evictions += (*iter)->stat.evictions;
+	}
+	__SYNC_UNLOCK(tables_sync);
+	std::ostringstream outStr;
+	outStr << "dedup["
+	       << "h" << (sum.hits - stat_last.hits)
+	       << " m" << (sum.misses - stat_last.misses)
+	       << " e" << (sum.evictions - stat_last.evictions)
+	       << "]";
+	stat_last = sum;
+	return(outStr.str());
+}
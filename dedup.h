@@ -0,0 +1,91 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+
+#include <string>
+#include <list>
+#include <string.h>
+#include <sys/types.h>
+
+
+#define DEDUP_HASH_LENGTH 16
+#define DEDUP_TABLE_WAYS 8
+#define DEDUP_TABLE_SETS (1 << 15)
+
+
+// 128-bit non-cryptographic hash (MurmurHash3 x64_128) of packet content, word hash[0] is never 0
+void dedup_hash(u_int16_t *hash, const void *data, size_t length);
+
+
+/* Set-associative table of hashes of recently seen packets. An entry is valid for opt_dup_check_window_ms
+   by packet time (0 - until replaced). New hash replaces empty or expired way of the set, if there is none
+   the oldest way is replaced (eviction). One table is used only by one thread. */
+class cDedupTable {
+public:
+	struct sStat {
+		sStat() {
+			hits = 0;
+			misses = 0;
+			evictions = 0;
+		}
+		u_int64_t hits;
+		u_int64_t misses;
+		u_int64_t evictions;
+	};
+private:
+	struct sEntry {
+		u_int64_t hash[2];
+		u_int64_t time_us;
+	};
+public:
+	cDedupTable(unsigned sets = DEDUP_TABLE_SETS);
+	~cDedupTable();
+	// returns true if hash was seen in window (duplicate), otherwise stores it
+	inline bool check(const u_int16_t *hash, u_int64_t time_us);
+	static std::string getStatString();
+private:
+	sEntry *table;
+	unsigned setsMask;
+	u_int64_t window_us;
+	sStat stat;
+	static std::list<cDedupTable*> tables;
+	static sStat stat_removed;
+	static sStat stat_last;
+	static volatile int tables_sync;
+};
+
+inline bool cDedupTable::check(const u_int16_t *hash, u_int64_t time_us) {
+	u_int64_t h[2];
+	memcpy(h, hash, DEDUP_HASH_LENGTH);
+	sEntry *set = table + ((h[1] ^ (h[1] >> 32)) & setsMask) * DEDUP_TABLE_WAYS;
+	sEntry *victim = NULL;
+	sEntry *oldest = set;
+	for(unsigned i = 0; i < DEDUP_TABLE_WAYS; i++) {
+		sEntry *entry = set + i;
+		bool valid = entry->time_us &&
+			     (!window_us || time_us < entry->time_us + window_us);
+		if(valid) {
+			if(entry->hash[0] == h[0] && entry->hash[1] == h[1]) {
+				++stat.hits;
+				return(true);
+			}
+			if(entry->time_us < oldest->time_us) {
+				oldest = entry;
+			}
+		} else if(!victim) {
+			victim = entry;
+		}
+	}
+	if(!victim) {
+		victim = oldest;
+		++stat.evictions;
+	}
+	victim->hash[0] = h[0];
+	victim->hash[1] = h[1];
+	victim->time_us = time_us ? time_us : 1;
+	++stat.misses;
+	return(false);
+}
+
+
+#endif //DEDUP_H
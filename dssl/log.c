@@ -27,7 +27,7 @@
 #endif
 #include "errors.h"
 
-int NmDebugCatchError_disabled_log = 0;
+__thread int NmDebugCatchError_disabled_log = 0;
 #ifdef _DEBUG
 int NmDebugCatchError( int rc, int line, const char* file  )
 {
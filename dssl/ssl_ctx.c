@@ -114,7 +114,9 @@ void DSSL_EnvOnSessionClosing( DSSL_Env* env, DSSL_Session* s )
 
 	if( env->session_cache )
 	{
+		dssl_SessionKT_Lock( env->session_cache );
 		dssl_SessionKT_Release( env->session_cache, s->session_id );
+		dssl_SessionKT_Unlock( env->session_cache );
 	}
 }
 
@@ -133,6 +135,28 @@ DSSL_Env* DSSL_EnvCreate( int session_cache_size, uint32_t cache_timeout_interva
 }
 
 
+/* replaces the session and ticket caches of the environment by the caches shared by more environments
+(sessions of more connections) - the shared caches are not destroyed with the environment */
+void DSSL_EnvSetSharedCache( DSSL_Env* env, dssl_SessionKeyTable* session_cache, DSSL_SessionTicketTable* ticket_cache )
+{
+	_ASSERT( env );
+
+	if( env->session_cache && !env->shared_cache )
+	{
+		dssl_SessionKT_Destroy( env->session_cache );
+	}
+
+	if( env->ticket_cache && !env->shared_cache )
+	{
+		dssl_SessionTicketTable_Destroy( env->ticket_cache );
+	}
+
+	env->session_cache = session_cache;
+	env->ticket_cache = ticket_cache;
+	env->shared_cache = 1;
+}
+
+
 void DSSL_EnvDestroy( DSSL_Env* env )
 {
 	if( env->servers ) 
@@ -151,12 +175,12 @@ void DSSL_EnvDestroy( DSSL_Env* env )
 		env->missing_key_servers = NULL;
 	}
 
-	if( env->session_cache )
+	if( env->session_cache && !env->shared_cache )
 	{
 		dssl_SessionKT_Destroy( env->session_cache );
 	}
 
-	if( env->ticket_cache )
+	if( env->ticket_cache && !env->shared_cache )
 	{
 		dssl_SessionTicketTable_Destroy( env->ticket_cache );
 	}
@@ -49,6 +49,7 @@ typedef struct _DSSL_Env
 
 	dssl_SessionKeyTable*		session_cache;
 	DSSL_SessionTicketTable*	ticket_cache;
+	int							shared_cache; /* session_cache and ticket_cache are owned by the caller */
 
 	EVP_PKEY**				keys;
 	int						key_count;
@@ -66,6 +67,7 @@ typedef struct _DSSL_Env
 
 DSSL_Env* DSSL_EnvCreate( int session_cache_size, uint32_t cache_timeout_interval );
 void DSSL_EnvDestroy( DSSL_Env* env );
+void DSSL_EnvSetSharedCache( DSSL_Env* env, dssl_SessionKeyTable* session_cache, DSSL_SessionTicketTable* ticket_cache );
 
 
 /* SSL Server info */
@@ -704,13 +704,18 @@ int ssls_lookup_session( DSSL_Session* sess )
 	_ASSERT( sess );
 	_ASSERT( sess->env );
 	
-	if( sess->env->session_cache )
+	if( !sess->env->session_cache ) return NM_ERROR( DSSL_E_SSL_SESSION_NOT_IN_CACHE );
+
+	dssl_SessionKT_Lock( sess->env->session_cache );
+
+	sess_data = dssl_SessionKT_Find( sess->env->session_cache, sess->session_id );
+
+	if( !sess_data )
 	{
-		sess_data = dssl_SessionKT_Find( sess->env->session_cache, sess->session_id );
+		dssl_SessionKT_Unlock( sess->env->session_cache );
+		return NM_ERROR( DSSL_E_SSL_SESSION_NOT_IN_CACHE );
 	}
 
-	if( !sess_data ) return NM_ERROR( DSSL_E_SSL_SESSION_NOT_IN_CACHE );
-
 	dssl_SessionKT_AddRef( sess_data );
 	memcpy( sess->master_secret, sess_data->master_secret, SSL3_MASTER_SECRET_SIZE );
 	sess->master_key_len = sess_data->master_secret_len;
@@ -724,6 +729,8 @@ int ssls_lookup_session( DSSL_Session* sess )
 	}
 	#endif //(OPENSSL_VERSION_NUMBER < 0x10100000L)
 
+	dssl_SessionKT_Unlock( sess->env->session_cache );
+
 	return DSSL_RC_OK;
 }
 
@@ -735,6 +742,8 @@ void ssls_store_session( DSSL_Session* sess )
 	_ASSERT( sess->env );
 	if( !sess->env->session_cache ) return;
 
+	dssl_SessionKT_Lock( sess->env->session_cache );
+
 	sess_data = dssl_SessionKT_Find( sess->env->session_cache, sess->session_id );
 
 	if( sess_data )
@@ -746,6 +755,8 @@ void ssls_store_session( DSSL_Session* sess )
 	{
 		dssl_SessionKT_Add( sess->env->session_cache, sess );
 	}
+
+	dssl_SessionKT_Unlock( sess->env->session_cache );
 }
 
 
@@ -910,14 +921,19 @@ int ssls_init_from_tls_ticket( DSSL_Session* sess )
 	_ASSERT( sess );
 	_ASSERT( sess->env );
 	
-	if( sess->env->ticket_cache )
+	if( !sess->env->ticket_cache ) return NM_ERROR( DSSL_E_SSL_SESSION_TICKET_NOT_CACHED );
+
+	dssl_SessionTicketTable_Lock( sess->env->ticket_cache );
+
+	ticket_data = dssl_SessionTicketTable_Find( sess->env->ticket_cache, 
+		sess->session_ticket, sess->session_ticket_len );
+
+	if( !ticket_data )
 	{
-		ticket_data = dssl_SessionTicketTable_Find( sess->env->ticket_cache, 
-			sess->session_ticket, sess->session_ticket_len );
+		dssl_SessionTicketTable_Unlock( sess->env->ticket_cache );
+		return NM_ERROR( DSSL_E_SSL_SESSION_TICKET_NOT_CACHED );
 	}
 
-	if( !ticket_data ) return NM_ERROR( DSSL_E_SSL_SESSION_TICKET_NOT_CACHED );
-
 	memcpy( sess->master_secret, ticket_data->master_secret, SSL3_MASTER_SECRET_SIZE );
 	sess->master_key_len = SSL3_MASTER_SECRET_SIZE;
 
@@ -925,6 +941,8 @@ int ssls_init_from_tls_ticket( DSSL_Session* sess )
 	sess->version = ticket_data->protocol_version;
 	sess->compression_method = ticket_data->compression_method;
 
+	dssl_SessionTicketTable_Unlock( sess->env->ticket_cache );
+
 	return DSSL_RC_OK;
 }
 
@@ -934,7 +952,11 @@ int ssls_store_new_ticket(DSSL_Session* sess, u_char* ticket, uint32_t len)
 
 	if( sess->env->ticket_cache )
 	{
-		return dssl_SessionTicketTable_Add( sess->env->ticket_cache, sess, ticket, len );
+		int rc;
+		dssl_SessionTicketTable_Lock( sess->env->ticket_cache );
+		rc = dssl_SessionTicketTable_Add( sess->env->ticket_cache, sess, ticket, len );
+		dssl_SessionTicketTable_Unlock( sess->env->ticket_cache );
+		return rc;
 	}
 	else
 	{
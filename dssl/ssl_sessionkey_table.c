@@ -219,6 +219,16 @@ void dssl_SessionKT_RemoveAll( dssl_SessionKeyTable* tbl )
 	tbl->count = 0;
 }
 
+void dssl_SessionKT_Lock( dssl_SessionKeyTable* tbl )
+{
+	while( __sync_lock_test_and_set( &tbl->_sync, 1 ) );
+}
+
+void dssl_SessionKT_Unlock( dssl_SessionKeyTable* tbl )
+{
+	__sync_lock_release( &tbl->_sync );
+}
+
 #ifdef NM_MULTI_THREADED_SSL
 	#error "Multithreading is not implemented for SSL session cache!"
 #else
@@ -231,7 +241,7 @@ void dssl_SessionKT_Release( dssl_SessionKeyTable* tbl, u_char* session_id )
 {
 	DSSL_SessionKeyData* sess_data = dssl_SessionKT_Find( tbl, session_id );
 
-	if( sess_data )
+	if( sess_data && sess_data->refcount > 0 )
 	{
 		sess_data->refcount--;
 		if(sess_data->refcount == 0 )
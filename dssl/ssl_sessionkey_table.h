@@ -49,6 +49,7 @@ struct dssl_SessionKeyTable_
 	int						table_size;
 	time_t					timeout_interval;	/* in seconds */
 	time_t					last_cleanup_time;
+	volatile int			_sync;	/* the table can be shared by sessions of more threads */
 };
 
 dssl_SessionKeyTable* dssl_SessionKT_Create( int table_size, uint32_t timeout_int );
@@ -63,6 +64,9 @@ void dssl_SessionKT_Add( dssl_SessionKeyTable* tbl, DSSL_Session* sess );
 void dssl_SessionKT_Remove( dssl_SessionKeyTable* tbl, u_char* session_id );
 void dssl_SessionKT_RemoveAll( dssl_SessionKeyTable* tbl );
 
+void dssl_SessionKT_Lock( dssl_SessionKeyTable* tbl );
+void dssl_SessionKT_Unlock( dssl_SessionKeyTable* tbl );
+
 #ifdef  __cplusplus
 }
 #endif
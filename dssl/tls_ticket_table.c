@@ -226,3 +226,13 @@ void dssl_SessionTicketTable_CleanSessionCache( DSSL_SessionTicketTable* tbl )
 		}
 	}
 }
+
+void dssl_SessionTicketTable_Lock( DSSL_SessionTicketTable* tbl )
+{
+	while( __sync_lock_test_and_set( &tbl->_sync, 1 ) );
+}
+
+void dssl_SessionTicketTable_Unlock( DSSL_SessionTicketTable* tbl )
+{
+	__sync_lock_release( &tbl->_sync );
+}
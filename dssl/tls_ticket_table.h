@@ -46,6 +46,7 @@ struct _DSSL_SessionTicketTable
 	int							table_size;
 	time_t						timeout_interval;	/* in seconds */
 	time_t						last_cleanup_time;
+	volatile int				_sync;	/* the table can be shared by sessions of more threads */
 };
 
 DSSL_SessionTicketTable* dssl_SessionTicketTable_Create( int table_size, uint32_t timeout_int );
@@ -57,6 +58,9 @@ int dssl_SessionTicketTable_Add( DSSL_SessionTicketTable* tbl, DSSL_Session* ses
 void dssl_SessionTicketTable_Remove( DSSL_SessionTicketTable* tbl, const u_char* ticket, uint32_t len );
 void dssl_SessionTicketTable_CleanSessionCache( DSSL_SessionTicketTable* tbl );
 
+void dssl_SessionTicketTable_Lock( DSSL_SessionTicketTable* tbl );
+void dssl_SessionTicketTable_Unlock( DSSL_SessionTicketTable* tbl );
+
 
 #ifdef  __cplusplus
 }
@@ -0,0 +1,172 @@
+#ifndef EPOCH_RCU_H
+#define EPOCH_RCU_H
+
+
+#include <deque>
+#include <sched.h>
+#include <sys/types.h>
+
+
+#define EPOCH_RCU_MAX_READERS 1024
+#define EPOCH_RCU_RECLAIM_THRESHOLD 1024
+
+
+/* Epoch based protection of lock-free readers (RCU style). A reader announces the global epoch in its own slot for the
+   time of the read section, writers (serialized by own lock) unlink items and pass them to retire instead of delete.
+   Retired items are freed when every active reader has announced a newer epoch than the epoch of the retire.
+   synchronize waits until readers active in the moment of the call leave their read sections.
+   Read sections are not nestable. Slots are assigned to threads at first use (the same index in all instances);
+   threads over EPOCH_RCU_MAX_READERS share a counter which blocks the reclamation while any of them is in a read section. */
+class cEpochRcu {
+public:
+	struct sReaderSlot {
+		volatile u_int64_t epoch;
+		char _pad[64 - sizeof(u_int64_t)];
+	};
+	struct sRetired {
+		void *item;
+		void (*destroy)(void *item);
+		u_int64_t epoch;
+	};
+public:
+	cEpochRcu() {
+		epoch = 1;
+		overflowReaders = 0;
+		for(unsigned i = 0; i < EPOCH_RCU_MAX_READERS; i++) {
+			readers[i].epoch = 0;
+		}
+		retiredCount = 0;
+		reclaimedCount = 0;
+		_sync_retired = 0;
+	}
+	~cEpochRcu() {
+		for(std::deque<sRetired>::iterator iter = retired.begin(); iter != retired.end(); iter++) {
+			iter->destroy(iter->item);
+		}
+	}
+	inline void readLock() {
+		int slot = getReaderSlot();
+		if(slot >= 0) {
+			readers[slot].epoch = epoch;
+			__sync_synchronize();
+		} else {
+			__sync_add_and_fetch(&overflowReaders, 1);
+		}
+	}
+	inline void readUnlock() {
+		int slot = getReaderSlot();
+		if(slot >= 0) {
+			__atomic_store_n(&readers[slot].epoch, 0, __ATOMIC_RELEASE);
+		} else {
+			__sync_sub_and_fetch(&overflowReaders, 1);
+		}
+	}
+	void retire(void *item, void (*destroy)(void *item)) {
+		sRetired retiredItem;
+		retiredItem.item = item;
+		retiredItem.destroy = destroy;
+		lockRetired();
+		retiredItem.epoch = epoch;
+		retired.push_back(retiredItem);
+		++retiredCount;
+		bool doReclaim = retired.size() >= EPOCH_RCU_RECLAIM_THRESHOLD;
+		unlockRetired();
+		if(doReclaim) {
+			reclaim();
+		}
+	}
+	template <class type_item>
+	static void destroyItem(void *item) {
+		delete (type_item*)item;
+	}
+	void reclaim() {
+		u_int64_t minEpoch = __sync_add_and_fetch(&epoch, 1);
+		if(overflowReaders) {
+			return;
+		}
+		unsigned count = getReadersCount();
+		for(unsigned i = 0; i < count; i++) {
+			u_int64_t readerEpoch = readers[i].epoch;
+			if(readerEpoch && readerEpoch < minEpoch) {
+				minEpoch = readerEpoch;
+			}
+		}
+		std::deque<sRetired> reclaimItems;
+		lockRetired();
+		while(retired.size() && retired.front().epoch < minEpoch) {
+			reclaimItems.push_back(retired.front());
+			retired.pop_front();
+		}
+		reclaimedCount += reclaimItems.size();
+		unlockRetired();
+		for(std::deque<sRetired>::iterator iter = reclaimItems.begin(); iter != reclaimItems.end(); iter++) {
+			iter->destroy(iter->item);
+		}
+	}
+	void synchronize() {
+		u_int64_t syncEpoch = __sync_add_and_fetch(&epoch, 1);
+		unsigned count = getReadersCount();
+		for(unsigned i = 0; i < count; i++) {
+			for(unsigned pass = 0; ; pass++) {
+				u_int64_t readerEpoch = readers[i].epoch;
+				if(!readerEpoch || readerEpoch >= syncEpoch) {
+					break;
+				}
+				if(pass > 100) {
+					sched_yield();
+				}
+			}
+		}
+		for(unsigned pass = 0; overflowReaders; pass++) {
+			if(pass > 100) {
+				sched_yield();
+			}
+		}
+	}
+	size_t getRetiredSize() {
+		return(retired.size());
+	}
+	u_int64_t getRetiredCount() {
+		return(retiredCount);
+	}
+	u_int64_t getReclaimedCount() {
+		return(reclaimedCount);
+	}
+private:
+	static inline int getReaderSlot() {
+		static __thread int threadSlot = -1;
+		if(threadSlot < 0) {
+			unsigned slot = __sync_fetch_and_add(threadsCounter(), 1);
+			threadSlot = slot < EPOCH_RCU_MAX_READERS ? slot : EPOCH_RCU_MAX_READERS;
+		}
+		return(threadSlot < EPOCH_RCU_MAX_READERS ? threadSlot : -1);
+	}
+	static inline unsigned getReadersCount() {
+		unsigned count = *threadsCounter();
+		return(count < EPOCH_RCU_MAX_READERS ? count : EPOCH_RCU_MAX_READERS);
+	}
+	static volatile unsigned *threadsCounter() {
+		static volatile unsigned counter = 0;
+		return(&counter);
+	}
+	void lockRetired() {
+		while(__sync_lock_test_and_set(&_sync_retired, 1)) {
+			sched_yield();
+		}
+	}
+	void unlockRetired() {
+		__sync_lock_release(&_sync_retired);
+	}
+private:
+	volatile u_int64_t epoch;
+	char _pad_epoch[64 - sizeof(u_int64_t)];
+	sReaderSlot readers[EPOCH_RCU_MAX_READERS];
+	volatile int overflowReaders;
+	std::deque<sRetired> retired;
+	u_int64_t retiredCount;
+	u_int64_t reclaimedCount;
+	volatile int _sync_retired;
+};
+
+
+#endif //EPOCH_RCU_H
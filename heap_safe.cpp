@@ -4,6 +4,7 @@
 #include <execinfo.h>
 
 #include "heap_safe.h"
+#include "slab_alloc.h"
 #include "tools.h"
 #include "common.h"
 
@@ -672,6 +673,7 @@ std::string getMemoryStat(bool all) {
 	if(MemoryStatQuick) {
 		return(getMemoryStatQuick(all));
 	}
+	std::string slabPoolsStat = cSlabPool::getStat();
 	std::ostringstream outStr;
 	if(HeapSafeCheck & _HeapSafeErrorBeginEnd && sverb.memory_stat) {
 		u_int64_t sum = 0;
@@ -723,9 +725,9 @@ std::string getMemoryStat(bool all) {
 		       << std::left << std::setw(35) << "sum" << " : " 
 		       << std::right << std::setw(16) << addThousandSeparators(sum)
 		       << std::endl;
-		return(outStr.str());
+		return(outStr.str() + slabPoolsStat);
 	} else {
-		return("memory stat is not activated\n");
+		return("memory stat is not activated\n" + slabPoolsStat);
 	}
 }
 
@@ -300,7 +300,7 @@ struct vmIP {
 	inline vmIP broadcast(unsigned mask) {
 		return(this->_or(this->wildcard_mask(mask)));
 	}
-	inline u_int32_t getHashNumber() {
+	inline u_int32_t getHashNumber() const {
 		#if VM_IPV6
 		if(!v6) {
 		#endif
@@ -0,0 +1,525 @@
+#include "voipmonitor.h"
+
+#include <syslog.h>
+
+#include "ip_frag.h"
+#include "pcap_queue.h"
+
+
+extern sVerbose sverb;
+
+
+ipfrag_data_s::ipfrag_data_s() {
+	table_size = IPFRAG_HASH_SIZE_MIN;
+	table = new FILE_LINE(26016) ip_frag_queue*[table_size];
+	memset(table, 0, table_size * sizeof(ip_frag_queue*));
+	table_count = 0;
+	memset(wheel, 0, sizeof(wheel));
+	wheel_pos = 0;
+	node_free_list = NULL;
+	queue_free_list = NULL;
+}
+
+ipfrag_data_s::~ipfrag_data_s() {
+	if(table_count) {
+		ipfrag_prune(0, true, this, -1, 0);
+	}
+	delete [] table;
+	for(std::list<ip_frag_s*>::iterator iter = node_chunks.begin(); iter != node_chunks.end(); iter++) {
+		delete [] *iter;
+	}
+	for(std::list<ip_frag_queue*>::iterator iter = queue_chunks.begin(); iter != queue_chunks.end(); iter++) {
+		delete [] *iter;
+	}
+}
+
+ip_frag_queue *ipfrag_data_s::find_or_add(vmIP saddr, vmIP daddr, u_int32_t id, u_int8_t protocol, u_int32_t ts) {
+	u_int32_t hash = get_hash(saddr, daddr, id, protocol);
+	u_int32_t mask = table_size - 1;
+	for(u_int32_t i = hash & mask; table[i]; i = (i + 1) & mask) {
+		ip_frag_queue *queue = table[i];
+		if(queue->hash == hash && queue->id == id && queue->protocol == protocol &&
+		   queue->saddr == saddr && queue->daddr == daddr) {
+			return(queue);
+		}
+	}
+	if((table_count + 1) * 2 > table_size) {
+		rehash(table_size * 2);
+		mask = table_size - 1;
+	}
+	if(!queue_free_list) {
+		ip_frag_queue *chunk = new FILE_LINE(26016) ip_frag_queue[IPFRAG_POOL_CHUNK / 8];
+		queue_chunks.push_back(chunk);
+		for(unsigned i = 0; i < IPFRAG_POOL_CHUNK / 8; i++) {
+			chunk[i].wheel_next = queue_free_list;
+			queue_free_list = &chunk[i];
+		}
+	}
+	ip_frag_queue *queue = queue_free_list;
+	queue_free_list = queue->wheel_next;
+	queue->saddr = saddr;
+	queue->daddr = daddr;
+	queue->id = id;
+	queue->protocol = protocol;
+	queue->hash = hash;
+	queue->has_first = false;
+	queue->has_last = false;
+	queue->ts = ts;
+	queue->last_end = 0;
+	queue->covered = 0;
+	queue->next_offset = 0;
+	queue->frags = NULL;
+	queue->frags_count = 0;
+	queue->buffer = NULL;
+	queue->buffer_len = 0;
+	queue->buffer_capacity = 0;
+	queue->buffer_additional_len = 0;
+	queue->buffer_header_ip_offset = 0;
+	queue->buffer_last_header = NULL;
+	u_int32_t i = hash & mask;
+	while(table[i]) {
+		i = (i + 1) & mask;
+	}
+	table[i] = queue;
+	++table_count;
+	if(!wheel_pos || ts < wheel_pos) {
+		wheel_pos = ts;
+	}
+	ip_frag_queue **bucket = &wheel[ts % IPFRAG_WHEEL_SIZE];
+	queue->wheel_prev = NULL;
+	queue->wheel_next = *bucket;
+	if(*bucket) {
+		(*bucket)->wheel_prev = queue;
+	}
+	*bucket = queue;
+	return(queue);
+}
+
+void ipfrag_data_s::remove(ip_frag_queue *queue) {
+	u_int32_t mask = table_size - 1;
+	u_int32_t i = queue->hash & mask;
+	while(table[i] != queue) {
+		i = (i + 1) & mask;
+	}
+	table[i] = NULL;
+	// backward shift of following items of the cluster
+	for(u_int32_t j = (i + 1) & mask; table[j]; j = (j + 1) & mask) {
+		u_int32_t k = table[j]->hash & mask;
+		if(i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+			table[i] = table[j];
+			table[j] = NULL;
+			i = j;
+		}
+	}
+	--table_count;
+	if(queue->wheel_prev) {
+		queue->wheel_prev->wheel_next = queue->wheel_next;
+	} else {
+		wheel[queue->ts % IPFRAG_WHEEL_SIZE] = queue->wheel_next;
+	}
+	if(queue->wheel_next) {
+		queue->wheel_next->wheel_prev = queue->wheel_prev;
+	}
+	queue->wheel_next = queue_free_list;
+	queue_free_list = queue;
+}
+
+ip_frag_s *ipfrag_data_s::node_alloc() {
+	if(!node_free_list) {
+		ip_frag_s *chunk = new FILE_LINE(26014) ip_frag_s[IPFRAG_POOL_CHUNK];
+		node_chunks.push_back(chunk);
+		for(unsigned i = 0; i < IPFRAG_POOL_CHUNK; i++) {
+			chunk[i].next = node_free_list;
+			node_free_list = &chunk[i];
+		}
+	}
+	ip_frag_s *node = node_free_list;
+	node_free_list = node->next;
+	return(node);
+}
+
+void ipfrag_data_s::rehash(u_int32_t new_size) {
+	ip_frag_queue **old_table = table;
+	u_int32_t old_size = table_size;
+	table = new FILE_LINE(26016) ip_frag_queue*[new_size];
+	memset(table, 0, new_size * sizeof(ip_frag_queue*));
+	table_size = new_size;
+	u_int32_t mask = new_size - 1;
+	for(u_int32_t i = 0; i < old_size; i++) {
+		if(old_table[i]) {
+			u_int32_t j = old_table[i]->hash & mask;
+			while(table[j]) {
+				j = (j + 1) & mask;
+			}
+			table[j] = old_table[i];
+		}
+	}
+	delete [] old_table;
+}
+
+
+static inline void ipfrag_delete_node(ip_frag_s *node, ipfrag_data_s *ipfrag_data, int pushToStack_queue_index) {
+	if(node->header_packet) {
+		PUSH_HP(&node->header_packet, pushToStack_queue_index);
+	}
+	if(node->header_pqout) {
+		delete node->header_pqout;
+		delete [] node->packet_pqout;
+	}
+	ipfrag_data->node_free(node);
+}
+
+static void ipfrag_delete_queue(ip_frag_queue *queue, ipfrag_data_s *ipfrag_data, int pushToStack_queue_index) {
+	while(queue->frags) {
+		ip_frag_s *node = queue->frags;
+		queue->frags = node->next;
+		ipfrag_delete_node(node, ipfrag_data, pushToStack_queue_index);
+	}
+	if(queue->buffer) {
+		delete [] queue->buffer;
+		queue->buffer = NULL;
+	}
+	if(queue->buffer_last_header) {
+		delete queue->buffer_last_header;
+		queue->buffer_last_header = NULL;
+	}
+	ipfrag_data->remove(queue);
+}
+
+static inline void ipfrag_log_overflow(ip_frag_queue *queue, u_int32_t totallen) {
+	if(sverb.defrag_overflow) {
+		syslog(LOG_NOTICE, "ipfrag overflow: %i src ip: %s dst ip: %s", totallen, queue->saddr.getString().c_str(), queue->daddr.getString().c_str());
+	}
+}
+
+/*
+
+append data of fragment to contiguous part in queue->buffer (packetbuffer mode)
+first fragment (offset 0) is copied with link and ip header
+
+*/
+static void ipfrag_buffer_append(ip_frag_queue *queue, u_char *packet, unsigned int header_ip_offset,
+				 u_int32_t offset, u_int32_t len, u_int16_t iphdr_len) {
+	u_int32_t payload_len = len - iphdr_len;
+	u_char *src;
+	u_int32_t src_len;
+	if(offset == 0) {
+		queue->buffer_header_ip_offset = header_ip_offset;
+		src = packet;
+		src_len = header_ip_offset + len;
+	} else {
+		src = packet + header_ip_offset + iphdr_len;
+		src_len = payload_len;
+	}
+	u_int32_t max_len = queue->buffer_header_ip_offset + 0xFFFF;
+	if(queue->buffer_len + src_len > max_len) {
+		ipfrag_log_overflow(queue, queue->buffer_len + src_len);
+		src_len = max_len > queue->buffer_len ? max_len - queue->buffer_len : 0;
+	}
+	if(queue->buffer_len + src_len > queue->buffer_capacity) {
+		u_int32_t capacity = queue->has_last ?
+				      queue->buffer_header_ip_offset + iphdr_len + queue->last_end :
+				      max(queue->buffer_capacity * 2, queue->buffer_len + src_len * 2);
+		if(capacity < queue->buffer_len + src_len) {
+			capacity = queue->buffer_len + src_len;
+		}
+		if(capacity > max_len) {
+			capacity = max_len;
+		}
+		u_char *buffer = new FILE_LINE(26013) u_char[capacity];
+		if(queue->buffer) {
+			memcpy(buffer, queue->buffer, queue->buffer_len);
+			delete [] queue->buffer;
+		}
+		queue->buffer = buffer;
+		queue->buffer_capacity = capacity;
+	}
+	memcpy(queue->buffer + queue->buffer_len, src, src_len);
+	queue->buffer_len += src_len;
+	if(offset) {
+		queue->buffer_additional_len += src_len;
+	}
+	queue->next_offset = offset + payload_len;
+}
+
+/*
+
+defragment packets from queue and allocates memory for new header and packet which is returned
+in **header_packet or *header_packet_pqout
+
+*/
+static void ipfrag_dequeue(ip_frag_queue *queue, ipfrag_data_s *ipfrag_data,
+			   sHeaderPacket **header_packet, sHeaderPacketPQout *header_packet_pqout,
+			   int pushToStack_queue_index) {
+	iphdr2 *iphdr = NULL;
+	unsigned int additionallen = 0;
+	if(header_packet) {
+		ip_frag_s *first = queue->frags;
+		u_int32_t totallen = first->header_ip_offset;
+		for(ip_frag_s *node = first; node; node = node->next) {
+			totallen += node->len;
+			if(node != first) {
+				totallen -= node->iphdr_len;
+			}
+		}
+		if(totallen > 0xFFFF + first->header_ip_offset) {
+			ipfrag_log_overflow(queue, totallen);
+			totallen = 0xFFFF + first->header_ip_offset;
+		}
+		unsigned int len = 0;
+		*header_packet = CREATE_HP(totallen);
+		while(queue->frags) {
+			ip_frag_s *node = queue->frags;
+			queue->frags = node->next;
+			if(node == first) {
+				// for first packet copy ethernet header and ip header
+				if(node->header_ip_offset) {
+					memcpy_heapsafe(HPP(*header_packet), *header_packet,
+							HPP(node->header_packet), node->header_packet,
+							node->header_ip_offset);
+					len += node->header_ip_offset;
+					iphdr = (iphdr2*)(HPP(*header_packet) + len);
+				}
+				memcpy_heapsafe(HPP(*header_packet) + len, *header_packet,
+						HPP(node->header_packet) + node->header_ip_offset, node->header_packet,
+						node->len);
+				len += node->len;
+			} else if(len < totallen) {
+				// for rest of a packets append only data
+				unsigned cpy_len = min((unsigned)(node->len - node->iphdr_len), totallen - len);
+				memcpy_heapsafe(HPP(*header_packet) + len, *header_packet,
+						HPP(node->header_packet) + node->header_ip_offset + node->iphdr_len, node->header_packet,
+						cpy_len);
+				len += cpy_len;
+				additionallen += cpy_len;
+			}
+			if(!queue->frags) {
+				memcpy_heapsafe(HPH(*header_packet), *header_packet,
+						HPH(node->header_packet), node->header_packet,
+						sizeof(struct pcap_pkthdr));
+				HPH(*header_packet)->len = totallen;
+				HPH(*header_packet)->caplen = totallen;
+			}
+			ipfrag_delete_node(node, ipfrag_data, pushToStack_queue_index);
+		}
+	} else {
+		// contiguous buffer is the reassembled packet - no copy
+		header_packet_pqout->header = queue->buffer_last_header;
+		header_packet_pqout->packet = queue->buffer;
+		header_packet_pqout->block_store = NULL;
+		header_packet_pqout->block_store_index = 0;
+		header_packet_pqout->block_store_locked = false;
+		header_packet_pqout->header->set_len(queue->buffer_len);
+		header_packet_pqout->header->set_caplen(queue->buffer_len);
+		if(queue->buffer_header_ip_offset) {
+			iphdr = (iphdr2*)(queue->buffer + queue->buffer_header_ip_offset);
+		}
+		additionallen = queue->buffer_additional_len;
+		queue->buffer = NULL;
+		queue->buffer_last_header = NULL;
+	}
+	if(iphdr) {
+		//increase IP header length
+		iphdr->set_tot_len(iphdr->get_tot_len() + additionallen);
+		// reset checksum
+		iphdr->set_check(0);
+		// reset fragment flag to 0
+		iphdr->clear_frag_data();
+	}
+	ipfrag_data->remove(queue);
+}
+
+/*
+
+function inserts packet into fragmentation queue and if all packets within fragmented IP are
+complete it will dequeue and construct large packet from all fragmented packets.
+
+return: if packet is defragmented from all pieces function returns 1 and set header and packet
+pinters to new allocated data which has to be freed later. If packet is only queued function
+returns 0 (packet is owned by queue), -1 if the fragment is duplicate (packet remains to caller)
+
+*/
+static int _handle_defrag(iphdr2 *header_ip,
+			  sHeaderPacket **header_packet, sHeaderPacketPQout *header_packet_pqout,
+			  ipfrag_data_s *ipfrag_data,
+			  int pushToStack_queue_index) {
+
+	// read all from header_ip at once - it can happen that the header_ip is overwriten in kernel ringbuffer
+	// if the ringbuffer is small
+	vmIP saddr = header_ip->get_saddr();
+	vmIP daddr = header_ip->get_daddr();
+	u_int32_t id = header_ip->get_frag_id();
+	u_int8_t protocol = header_ip->get_protocol();
+	u_int16_t frag_data = header_ip->get_frag_data();
+	u_int32_t offset = header_ip->get_frag_offset(frag_data);
+	bool more_frag = header_ip->is_more_frag(frag_data);
+	u_int32_t len = header_ip->get_tot_len();
+	u_int16_t iphdr_len = header_ip->get_hdr_size();
+	if(len < iphdr_len) {
+		return(-1);
+	}
+	u_int32_t payload_len = len - iphdr_len;
+	u_char *packet = header_packet ? HPP(*header_packet) : header_packet_pqout->packet;
+	unsigned int header_ip_offset = (u_char*)header_ip - packet;
+	u_int32_t ts = header_packet ? HPH(*header_packet)->ts.tv_sec : header_packet_pqout->header->get_tv_sec();
+
+	ip_frag_queue *queue = ipfrag_data->find_or_add(saddr, daddr, id, protocol, ts);
+
+	if(offset < queue->next_offset) {
+		// already in contiguous part - discard
+		return(-1);
+	}
+	ip_frag_s **insert = &queue->frags;
+	while(*insert && (*insert)->offset < offset) {
+		insert = &(*insert)->next;
+	}
+	if(*insert && (*insert)->offset == offset) {
+		// node with that offset already exists - discard
+		return(-1);
+	}
+
+	if(!more_frag) {
+		// this packet do not set more fragment indicator but contains offset which means that it is the last packet
+		queue->has_last = true;
+		queue->last_end = offset + payload_len;
+	}
+	if(offset == 0) {
+		queue->has_first = true;
+	}
+	queue->covered += payload_len;
+
+	if(header_packet_pqout && offset == queue->next_offset && (offset == 0 || queue->buffer)) {
+		// in order - copy to buffer and release packet
+		ipfrag_buffer_append(queue, packet, header_ip_offset, offset, len, iphdr_len);
+		if(!more_frag) {
+			queue->buffer_last_header = new FILE_LINE(26012) pcap_pkthdr_plus;
+			memcpy(queue->buffer_last_header, header_packet_pqout->header, sizeof(pcap_pkthdr_plus));
+		}
+		header_packet_pqout->destroy_or_unlock_blockstore();
+		// append following fragments which were waiting
+		while(queue->frags && queue->frags->offset <= queue->next_offset) {
+			ip_frag_s *node = queue->frags;
+			queue->frags = node->next;
+			--queue->frags_count;
+			if(node->offset == queue->next_offset) {
+				ipfrag_buffer_append(queue, node->packet_pqout, node->header_ip_offset, node->offset, node->len, node->iphdr_len);
+				if(queue->has_last && node->offset + node->len - node->iphdr_len == queue->last_end && !queue->buffer_last_header) {
+					queue->buffer_last_header = node->header_pqout;
+					node->header_pqout = NULL;
+				}
+			} else {
+				// overlapping
+				queue->covered -= node->len - node->iphdr_len;
+			}
+			if(node->header_pqout) {
+				delete node->header_pqout;
+			}
+			delete [] node->packet_pqout;
+			ipfrag_data->node_free(node);
+		}
+	} else {
+		// create node
+		ip_frag_s *node = ipfrag_data->node_alloc();
+		if(header_packet) {
+			node->header_packet = *header_packet;
+			node->header_pqout = NULL;
+			node->packet_pqout = NULL;
+			*header_packet = NULL;
+		} else {
+			sHeaderPacketPQout hp_copy = *header_packet_pqout;
+			hp_copy.alloc_and_copy_blockstore();
+			node->header_packet = NULL;
+			node->header_pqout = hp_copy.header;
+			node->packet_pqout = hp_copy.packet;
+		}
+		node->header_ip_offset = header_ip_offset;
+		node->len = len;
+		node->offset = offset;
+		node->iphdr_len = iphdr_len;
+		// add to queue sorted by offset
+		node->next = *insert;
+		*insert = node;
+		++queue->frags_count;
+	}
+
+	// now check if packets in queue are complete - if yes - defragment - if not, do nithing
+	if(!queue->has_first || !queue->has_last || queue->covered < queue->last_end) {
+		return(0);
+	}
+	if(queue->buffer) {
+		if(queue->frags || queue->next_offset < queue->last_end) {
+			return(0);
+		}
+	} else {
+		// check if there are all middle fragments
+		u_int32_t lastoffset = 0;
+		for(ip_frag_s *node = queue->frags; node; node = node->next) {
+			if(node->offset != lastoffset) {
+				return(0);
+			}
+			lastoffset += node->len - node->iphdr_len;
+		}
+	}
+	ipfrag_dequeue(queue, ipfrag_data, header_packet, header_packet_pqout, pushToStack_queue_index);
+	return(1);
+}
+
+int handle_defrag(iphdr2 *header_ip, sHeaderPacket **header_packet, ipfrag_data_s *ipfrag_data,
+		  int pushToStack_queue_index) {
+	return(_handle_defrag(header_ip, header_packet, NULL, ipfrag_data,
+			      pushToStack_queue_index));
+}
+
+int handle_defrag(iphdr2 *header_ip, void *header_packet_pqout, ipfrag_data_s *ipfrag_data) {
+	return(_handle_defrag(header_ip, NULL, (sHeaderPacketPQout*)header_packet_pqout, ipfrag_data,
+			      -1));
+}
+
+static void ipfrag_prune_bucket(ipfrag_data_s *ipfrag_data, unsigned bucket, u_int32_t until, bool all,
+				int pushToStack_queue_index) {
+	ip_frag_queue *queue = ipfrag_data->wheel[bucket];
+	while(queue) {
+		ip_frag_queue *next = queue->wheel_next;
+		if(all || queue->ts <= until) {
+			ipfrag_delete_queue(queue, ipfrag_data, pushToStack_queue_index);
+		}
+		queue = next;
+	}
+}
+
+void ipfrag_prune(unsigned int tv_sec, bool all, ipfrag_data_s *ipfrag_data,
+		  int pushToStack_queue_index, int prune_limit) {
+
+	if(prune_limit < 0) {
+		prune_limit = 30;
+	}
+	if(all) {
+		for(unsigned i = 0; i < IPFRAG_WHEEL_SIZE; i++) {
+			ipfrag_prune_bucket(ipfrag_data, i, 0, true, pushToStack_queue_index);
+		}
+		ipfrag_data->wheel_pos = 0;
+		return;
+	}
+	if(!ipfrag_data->table_count) {
+		ipfrag_data->wheel_pos = 0;
+		return;
+	}
+	if(tv_sec <= (unsigned)prune_limit) {
+		return;
+	}
+	// expire queues where tv_sec - ts > prune_limit
+	u_int32_t until = tv_sec - prune_limit - 1;
+	if(until < ipfrag_data->wheel_pos) {
+		return;
+	}
+	if(until - ipfrag_data->wheel_pos >= IPFRAG_WHEEL_SIZE) {
+		for(unsigned i = 0; i < IPFRAG_WHEEL_SIZE; i++) {
+			ipfrag_prune_bucket(ipfrag_data, i, until, false, pushToStack_queue_index);
+		}
+	} else {
+		for(u_int32_t s = ipfrag_data->wheel_pos; s <= until; s++) {
+			ipfrag_prune_bucket(ipfrag_data, s % IPFRAG_WHEEL_SIZE, until, false, pushToStack_queue_index);
+		}
+	}
+	ipfrag_data->wheel_pos = until + 1;
+}
@@ -2,33 +2,88 @@
 #define IP_FRAG_H
 
 #include <net/ethernet.h>
+#include <list>
 
 #include "header_packet.h"
+#include "ip.h"
+
+
+#define IPFRAG_HASH_SIZE_MIN 1024
+#define IPFRAG_WHEEL_SIZE 64
+#define IPFRAG_POOL_CHUNK 1024
+
+
+struct pcap_pkthdr_plus;
 
 struct ip_frag_s {
 	sHeaderPacket *header_packet;
-	void *header_packet_pqout;
+	pcap_pkthdr_plus *header_pqout;
+	u_char *packet_pqout;
 	unsigned int header_ip_offset;
-	time_t ts;
 	u_int32_t offset;
 	u_int32_t len;
 	u_int16_t iphdr_len;
+	ip_frag_s *next;
 };
 
-typedef map<unsigned int, ip_frag_s*> ip_frag_queue_t;
-typedef map<unsigned int, ip_frag_s*>::iterator ip_frag_queue_it_t;
-
-struct ip_frag_queue : ip_frag_queue_t {
-	ip_frag_queue() {
-		has_last = false;
-	}
+/* Fragments of one datagram. In packetbuffer (pqout) mode fragments continuing the contiguous part from offset 0
+   are copied directly to buffer, which becomes the reassembled packet, and released at once. Other fragments
+   (and all fragments in sHeaderPacket mode) are kept as nodes sorted by offset until the datagram is complete. */
+struct ip_frag_queue {
+	vmIP saddr;
+	vmIP daddr;
+	u_int32_t id;
+	u_int8_t protocol;
+	u_int32_t hash;
+	bool has_first;
 	bool has_last;
+	u_int32_t ts;
+	u_int32_t last_end;
+	u_int32_t covered;
+	u_int32_t next_offset;
+	ip_frag_s *frags;
+	u_int32_t frags_count;
+	u_char *buffer;
+	u_int32_t buffer_len;
+	u_int32_t buffer_capacity;
+	u_int32_t buffer_additional_len;
+	unsigned int buffer_header_ip_offset;
+	pcap_pkthdr_plus *buffer_last_header;
+	ip_frag_queue *wheel_prev;
+	ip_frag_queue *wheel_next;
 };
 
+/* Open addressing table (linear probing, backward shift deletion) of datagrams in reassembly keyed by
+   src, dst, id and protocol. Nodes and queues come from pools which grow by chunks and are returned
+   only in destructor. Queues are linked into a wheel by second of the first fragment, prune visits only
+   seconds which expired since the previous prune. */
 struct ipfrag_data_s {
-	map<vmIP, map<unsigned int, ip_frag_queue*> > ip_frag_stream;
-	map<vmIP, map<unsigned int, ip_frag_queue*> >::iterator ip_frag_streamIT;
-	map<unsigned int, ip_frag_queue*>::iterator ip_frag_streamITinner;
+	ipfrag_data_s();
+	~ipfrag_data_s();
+	ip_frag_queue *find_or_add(vmIP saddr, vmIP daddr, u_int32_t id, u_int8_t protocol, u_int32_t ts);
+	void remove(ip_frag_queue *queue);
+	ip_frag_s *node_alloc();
+	void node_free(ip_frag_s *node) {
+		node->next = node_free_list;
+		node_free_list = node;
+	}
+	inline u_int32_t get_hash(vmIP saddr, vmIP daddr, u_int32_t id, u_int8_t protocol) {
+		u_int64_t h = ((u_int64_t)saddr.getHashNumber() << 32 | daddr.getHashNumber()) ^ ((u_int64_t)id << 8 | protocol);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h >> 33;
+		return(h);
+	}
+	void rehash(u_int32_t new_size);
+	ip_frag_queue **table;
+	u_int32_t table_size;
+	u_int32_t table_count;
+	ip_frag_queue *wheel[IPFRAG_WHEEL_SIZE];
+	u_int32_t wheel_pos;
+	ip_frag_s *node_free_list;
+	ip_frag_queue *queue_free_list;
+	std::list<ip_frag_s*> node_chunks;
+	std::list<ip_frag_queue*> queue_chunks;
 };
 
 void ipfrag_prune(unsigned int tv_sec, bool all, ipfrag_data_s *ipfrag_data,
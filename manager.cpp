@@ -47,6 +47,7 @@
 #include "options.h"
 #include "server.h"
 #include "filter_mysql.h"
+#include "zstd_dict.h"
 
 #ifndef FREEBSD
 #include <malloc.h>
@@ -61,6 +62,7 @@
 #define BUFSIZE 4096		//block size?
 
 extern Calltable *calltable;
+extern int opt_pcap_queue_compress;
 extern volatile int terminating;
 extern int opt_manager_port;
 extern char opt_manager_ip[32];
@@ -336,6 +338,7 @@ int Mgmt_list_sip_msg(Mgmt_params *params);
 int Mgmt_list_history_sip_msg(Mgmt_params *params);
 int Mgmt_cleanupregisters(Mgmt_params *params);
 int Mgmt_d_close_call(Mgmt_params *params);
+int Mgmt_calls_footprint(Mgmt_params *params);
 int Mgmt_d_pointer_to_call(Mgmt_params *params);
 int Mgmt_d_lc_all(Mgmt_params *params);
 int Mgmt_d_lc_bye(Mgmt_params *params);
@@ -425,6 +428,7 @@ int Mgmt_alloc_test(Mgmt_params *params);
 int Mgmt_tcmalloc_stats(Mgmt_params *params);
 int Mgmt_hashtable_stats(Mgmt_params *params);
 int Mgmt_usleep_stats(Mgmt_params *params);
+int Mgmt_zstd_dict(Mgmt_params *params);
 
 int (* MgmtFuncArray[])(Mgmt_params *params) = {
 	Mgmt_help,
@@ -444,6 +448,7 @@ int (* MgmtFuncArray[])(Mgmt_params *params) = {
 	Mgmt_list_history_sip_msg,
 	Mgmt_cleanupregisters,
 	Mgmt_d_close_call,
+	Mgmt_calls_footprint,
 	Mgmt_d_pointer_to_call,
 	Mgmt_d_lc_all,
 	Mgmt_d_lc_bye,
@@ -533,6 +538,7 @@ int (* MgmtFuncArray[])(Mgmt_params *params) = {
 	Mgmt_tcmalloc_stats,
 	Mgmt_hashtable_stats,
 	Mgmt_usleep_stats,
+	Mgmt_zstd_dict,
 	NULL
 };
 
@@ -2528,8 +2534,9 @@ int Mgmt_d_lc_bye(Mgmt_params *params) {
 			}
 		}
 	} else {
-		for(map<string, Call*>::iterator callMAPIT = calltable->calls_listMAP.begin(); callMAPIT != calltable->calls_listMAP.end(); ++callMAPIT) {
-			call = callMAPIT->second;
+		cCallIdMap::cIterator callMAPIT(&calltable->calls_listMAP);
+		for(callMAPIT.begin(); !callMAPIT.isEnd(); callMAPIT.next()) {
+			call = callMAPIT.value();
 			if(call->typeIsNot(REGISTER) && call->seenbye) {
 				vectCall.push_back(call);
 			}
@@ -2575,8 +2582,9 @@ int Mgmt_d_lc_all(Mgmt_params *params) {
 			vectCall.push_back(*callIT);
 		}
 	} else {
-		for(map<string, Call*>::iterator callMAPIT = calltable->calls_listMAP.begin(); callMAPIT != calltable->calls_listMAP.end(); ++callMAPIT) {
-			vectCall.push_back(callMAPIT->second);
+		cCallIdMap::cIterator callMAPIT(&calltable->calls_listMAP);
+		for(callMAPIT.begin(); !callMAPIT.isEnd(); callMAPIT.next()) {
+			vectCall.push_back(callMAPIT.value());
 		}
 	}
 	if(vectCall.size()) {
@@ -2618,9 +2626,10 @@ int Mgmt_d_pointer_to_call(Mgmt_params *params) {
 			}
 		}
 	} else {
-		for(map<string, Call*>::iterator callMAPIT = calltable->calls_listMAP.begin(); callMAPIT != calltable->calls_listMAP.end(); ++callMAPIT) {
-			if(!strcmp((callMAPIT->second)->fbasename, fbasename)) {
-				outStr << "find in calltable->calls_list " << hex << (callMAPIT->second) << endl;
+		cCallIdMap::cIterator callMAPIT(&calltable->calls_listMAP);
+		for(callMAPIT.begin(); !callMAPIT.isEnd(); callMAPIT.next()) {
+			if(!strcmp((callMAPIT.value())->fbasename, fbasename)) {
+				outStr << "find in calltable->calls_list " << hex << (callMAPIT.value()) << endl;
 			}
 		}
 	}
@@ -2648,14 +2657,17 @@ int Mgmt_d_close_call(Mgmt_params *params) {
 		for(list<Call*>::iterator callIT = calltable->calls_list.begin(); callIT != calltable->calls_list.end(); ++callIT) {
 			if(!strcmp((*callIT)->fbasename, fbasename)) {
 				(*callIT)->force_close = true;
+				calltable->cleanup_calls_wheel_update(*callIT);
 				rslt = fbasename + string(" close");
 				break;
 			}
 		}
 	} else {
-		for(map<string, Call*>::iterator callMAPIT = calltable->calls_listMAP.begin(); callMAPIT != calltable->calls_listMAP.end(); ++callMAPIT) {
-			if(!strcmp((callMAPIT->second)->fbasename, fbasename)) {
-				(callMAPIT->second)->force_close = true;
+		cCallIdMap::cIterator callMAPIT(&calltable->calls_listMAP);
+		for(callMAPIT.begin(); !callMAPIT.isEnd(); callMAPIT.next()) {
+			if(!strcmp((callMAPIT.value())->fbasename, fbasename)) {
+				(callMAPIT.value())->force_close = true;
+				calltable->cleanup_calls_wheel_update(callMAPIT.value());
 				rslt = fbasename + string(" close");
 				break;
 			}
@@ -2666,6 +2678,76 @@ int Mgmt_d_close_call(Mgmt_params *params) {
 	return(params->sendString(&rslt));
 }
 
+int Mgmt_calls_footprint(Mgmt_params *params) {
+	if (params->task == params->mgmt_task_DoInit) {
+		params->registerCommand("calls_footprint", "memory footprint of active calls and registrations");
+		return(0);
+	}
+	ostringstream outStr;
+	if(!calltable) {
+		outStr << "sniffer not initialized yet" << endl;
+		return(params->sendString(&outStr));
+	}
+	size_t calls = 0;
+	size_t strArenaAlloc = 0;
+	size_t strArenaUsed = 0;
+	size_t strFixed = 0;
+	size_t rtpSize = 0;
+	calltable->lock_calls_listMAP();
+	if(opt_call_id_alternative[0]) {
+		for(list<Call*>::iterator callIT = calltable->calls_list.begin(); callIT != calltable->calls_list.end(); ++callIT) {
+			++calls;
+			strArenaAlloc += (*callIT)->str_arena.getAllocSize();
+			strArenaUsed += (*callIT)->str_arena.getUsedSize();
+			strFixed += (*callIT)->get_str_fixed_size();
+			rtpSize += (*callIT)->get_rtp_size();
+		}
+	} else {
+		cCallIdMap::cIterator callMAPIT(&calltable->calls_listMAP);
+		for(callMAPIT.begin(); !callMAPIT.isEnd(); callMAPIT.next()) {
+			++calls;
+			strArenaAlloc += callMAPIT.value()->str_arena.getAllocSize();
+			strArenaUsed += callMAPIT.value()->str_arena.getUsedSize();
+			strFixed += callMAPIT.value()->get_str_fixed_size();
+			rtpSize += callMAPIT.value()->get_rtp_size();
+		}
+	}
+	calltable->unlock_calls_listMAP();
+	// REGISTER transactions are Call objects too, the registration records are kept by Registers after them
+	size_t registerCalls = 0;
+	size_t registerCallsSize = 0;
+	calltable->lock_registers_listMAP();
+	cCallIdMap::cIterator registerMAPIT(&calltable->registers_listMAP);
+	for(registerMAPIT.begin(); !registerMAPIT.isEnd(); registerMAPIT.next()) {
+		++registerCalls;
+		registerCallsSize += sizeof(Call) + registerMAPIT.value()->str_arena.getAllocSize();
+	}
+	calltable->unlock_registers_listMAP();
+	extern Registers registers;
+	size_t registersCount = 0;
+	size_t registerStates = 0;
+	size_t registersSize = registers.getFootprint(&registersCount, &registerStates);
+	outStr << "calls: " << calls << endl
+	       << "sizeof(Call): " << sizeof(Call) << endl
+	       << "strings in arena - allocated: " << strArenaAlloc << " used: " << strArenaUsed 
+	       << " (as fixed arrays: " << strFixed << ")" << endl
+	       << "rtp streams: " << rtpSize << endl
+	       << "total: " << (calls * sizeof(Call) + strArenaAlloc + rtpSize) << endl;
+	if(calls) {
+		outStr << "per call - Call + strings: " << (sizeof(Call) + strArenaAlloc / calls)
+		       << " strings allocated: " << (strArenaAlloc / calls)
+		       << " used: " << (strArenaUsed / calls)
+		       << " rtp streams: " << (rtpSize / calls)
+		       << " total: " << (sizeof(Call) + (strArenaAlloc + rtpSize) / calls) << endl;
+	}
+	outStr << "register transactions: " << registerCalls << " size: " << registerCallsSize << endl
+	       << "registrations: " << registersCount << " states: " << registerStates << " size: " << registersSize << endl;
+	if(registersCount) {
+		outStr << "per registration: " << (registersSize / registersCount) << endl;
+	}
+	return(params->sendString(&outStr));
+}
+
 int Mgmt_getipaccount(Mgmt_params *params) {
 	if (params->task == params->mgmt_task_DoInit) {
 		params->registerCommand("getipaccount", "getipaccount");
@@ -4544,6 +4626,37 @@ int Mgmt_usleep_stats(Mgmt_params *params) {
 	return(params->sendString(usleepStats));
 }
 
+int Mgmt_zstd_dict(Mgmt_params *params) {
+	if (params->task == params->mgmt_task_DoInit) {
+		commandAndHelp ch[] = {
+			{"zstd_dict_train", "collect packets from packetbuffer blocks and train zstd dictionary: zstd_dict_train [samples MB] [dictionary KB]"},
+			{"zstd_dict_load", "load zstd dictionary for packetbuffer compression"},
+			{"zstd_dict_status", "zstd dictionary and training status"},
+			{NULL, NULL}
+		};
+		params->registerCommand(ch);
+		return(0);
+	}
+	string error;
+	if(params->command == "zstd_dict_train") {
+		unsigned samplesMB = 0;
+		unsigned dictKB = 0;
+		sscanf(params->buf, "zstd_dict_train %u %u", &samplesMB, &dictKB);
+		if(!opt_pcap_queue_compress) {
+			return(params->sendString("packetbuffer compression is disabled\n"));
+		}
+		if(!zstdDictionary.startTraining(samplesMB * 1024 * 1024, dictKB * 1024, &error)) {
+			return(params->sendString(error + "\n"));
+		}
+		return(params->sendString("collecting samples, the result will be saved to " + zstdDictionary.getFileName() + "\n"));
+	} else if(params->command == "zstd_dict_load") {
+		if(!zstdDictionary.load(&error)) {
+			return(params->sendString(error + "\n"));
+		}
+	}
+	return(params->sendString(zstdDictionary.getStatusString()));
+}
+
 int Mgmt_memcrash_test(Mgmt_params *params) {
 	if (params->task == params->mgmt_task_DoInit) {
 		commandAndHelp ch[] = {
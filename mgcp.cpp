@@ -169,13 +169,13 @@ void *handle_mgcp(packet_s_process *packetS) {
 			if(request_type == _mgcp_CRCX) {
 				if(call) {
 					calltable->lock_calls_listMAP();
-					map<sStreamIds2, Call*>::iterator callMAPIT = calltable->calls_by_stream_callid_listMAP.find(sStreamIds2(packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_(), request.parameters.call_id.c_str(), true));
-					calltable->calls_by_stream_callid_listMAP.erase(callMAPIT);
+					calltable->calls_by_stream_callid_listMAP.eraseWithLock(sStreamIds2(packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_(), request.parameters.call_id.c_str(), true));
 					for(unsigned i = 1; i < 100; i++) {
 						string call_id_undup = request.call_id() + "_" + intToString(i);
-						callMAPIT = calltable->calls_by_stream_callid_listMAP.find(sStreamIds2(packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_(), call_id_undup.c_str(), true));
-						if(callMAPIT == calltable->calls_by_stream_callid_listMAP.end()) {
-							calltable->calls_by_stream_callid_listMAP[sStreamIds2(packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_(), call_id_undup.c_str(), true)] = call;
+						sStreamIds2 streamId_undup(packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_(), call_id_undup.c_str(), true);
+						Call *call_undup;
+						if(!calltable->calls_by_stream_callid_listMAP.findWithLock(streamId_undup, &call_undup)) {
+							calltable->calls_by_stream_callid_listMAP.setWithLock(streamId_undup, call);
 							break;
 						}
 					}
@@ -183,9 +183,9 @@ void *handle_mgcp(packet_s_process *packetS) {
 					calltable->unlock_calls_listMAP();
 				} else {
 					calltable->lock_calls_listMAP();
-					map<sStreamId, Call*>::iterator callMAPIT = calltable->calls_by_stream_listMAP.find(sStreamId(packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_(), true));
-					if(callMAPIT != calltable->calls_by_stream_listMAP.end()) {
-						callMAPIT->second->removeFindTables(0, true);
+					Call *call_stream;
+					if(calltable->calls_by_stream_listMAP.findWithLock(sStreamId(packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_(), true), &call_stream)) {
+						call_stream->removeFindTables(0, true);
 					}
 					calltable->unlock_calls_listMAP();
 				}
@@ -200,11 +200,11 @@ void *handle_mgcp(packet_s_process *packetS) {
 				call = calltable->add_mgcp(&request, packetS->header_pt->ts.tv_sec, packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_(),
 							   get_pcap_handle(packetS->handle_index), packetS->dlt, packetS->sensor_id_());
 				call->set_first_packet_time_us(getTimeUS(packetS->header_pt));
-				strcpy_null_term(call->called, request.endpoint.c_str());
+				call->called.set(request.endpoint);
 				call->setSipcallerip(packetS->saddr_(), packetS->source_());
 				call->setSipcalledip(packetS->daddr_(), packetS->dest_());
 				call->flags = flags;
-				strcpy_null_term(call->fbasename, request.call_id().c_str());
+				call->fbasename.set(request.call_id());
 				if(enable_save_sip_rtp_audio(call)) {
 					if(enable_pcap_split) {
 						if(enable_save_sip(call)) {
@@ -236,7 +236,7 @@ void *handle_mgcp(packet_s_process *packetS) {
 				}
 			} else if(call) {
 				calltable->lock_calls_listMAP();
-				calltable->calls_by_stream_id2_listMAP[sStreamId2(call->saddr, call->sport, call->daddr, call->dport, request.transaction_id, true)] = call;
+				calltable->calls_by_stream_id2_listMAP.setWithLock(sStreamId2(call->saddr, call->sport, call->daddr, call->dport, request.transaction_id, true), call);
 				call->mgcp_transactions.push_back(request.transaction_id);
 				calltable->unlock_calls_listMAP();
 			}
@@ -244,7 +244,7 @@ void *handle_mgcp(packet_s_process *packetS) {
 			call = calltable->find_by_stream(packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_());
 			if(call) {
 				calltable->lock_calls_listMAP();
-				calltable->calls_by_stream_id2_listMAP[sStreamId2(call->saddr, call->sport, call->daddr, call->dport, request.transaction_id, true)] = call;
+				calltable->calls_by_stream_id2_listMAP.setWithLock(sStreamId2(call->saddr, call->sport, call->daddr, call->dport, request.transaction_id, true), call);
 				call->mgcp_transactions.push_back(request.transaction_id);
 				calltable->unlock_calls_listMAP();
 			}
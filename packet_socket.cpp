@@ -0,0 +1,1122 @@
+#include "voipmonitor.h"
+
+#ifndef FREEBSD
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <net/ethernet.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/syscall.h>
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include <sstream>
+
+#include "packet_socket.h"
+
+
+cTpacketV3::cTpacketV3() {
+	fd = -1;
+	ifindex = 0;
+	dlt = DLT_EN10MB;
+	ring = NULL;
+	ringLength = 0;
+	blockSize = 0;
+	blockCount = 0;
+	blockIndex = 0;
+}
+
+cTpacketV3::~cTpacketV3() {
+	close();
+}
+
+bool cTpacketV3::open(const char *ifname, unsigned snaplen, bool promisc,
+		      size_t ringSize, unsigned blockSize, unsigned blockTimeoutMs,
+		      std::string *error) {
+	char errorstr[1024];
+	fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+	if(fd < 0) {
+		snprintf(errorstr, sizeof(errorstr), "socket(AF_PACKET) failed: %s", strerror(errno));
+		goto failed;
+	}
+	{
+	ifreq ifr;
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+	if(ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "SIOCGIFINDEX failed: %s", strerror(errno));
+		goto failed;
+	}
+	ifindex = ifr.ifr_ifindex;
+	if(ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "SIOCGIFHWADDR failed: %s", strerror(errno));
+		goto failed;
+	}
+	switch(ifr.ifr_hwaddr.sa_family) {
+	case ARPHRD_ETHER:
+	case ARPHRD_LOOPBACK:
+		dlt = DLT_EN10MB;
+		break;
+	case ARPHRD_NONE:
+	case ARPHRD_PPP:
+	case ARPHRD_TUNNEL:
+	case ARPHRD_TUNNEL6:
+		dlt = DLT_RAW;
+		break;
+	default:
+		snprintf(errorstr, sizeof(errorstr), "unsupported link type %i", ifr.ifr_hwaddr.sa_family);
+		goto failed;
+	}
+	}
+	{
+	int version = TPACKET_V3;
+	if(setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "PACKET_VERSION TPACKET_V3 failed: %s", strerror(errno));
+		goto failed;
+	}
+	}
+	if(!setupRing(ringSize, blockSize, blockTimeoutMs, error)) {
+		close();
+		return(false);
+	}
+	{
+	// keep kernel side truncation in line with libpcap snaplen
+	sock_filter snap_insn = BPF_STMT(BPF_RET | BPF_K, snaplen);
+	sock_fprog snap_prog;
+	snap_prog.len = 1;
+	snap_prog.filter = &snap_insn;
+	setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &snap_prog, sizeof(snap_prog));
+	}
+	{
+	sockaddr_ll sll;
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(ETH_P_ALL);
+	sll.sll_ifindex = ifindex;
+	if(bind(fd, (sockaddr*)&sll, sizeof(sll)) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "bind failed: %s", strerror(errno));
+		goto failed;
+	}
+	}
+	if(promisc) {
+		packet_mreq mreq;
+		memset(&mreq, 0, sizeof(mreq));
+		mreq.mr_ifindex = ifindex;
+		mreq.mr_type = PACKET_MR_PROMISC;
+		if(setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+			snprintf(errorstr, sizeof(errorstr), "PACKET_MR_PROMISC failed: %s", strerror(errno));
+			goto failed;
+		}
+	}
+	// discard counters accumulated before bind
+	{
+	tpacket_stats_v3 kstat;
+	socklen_t len = sizeof(kstat);
+	getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &kstat, &len);
+	}
+	return(true);
+failed:
+	*error = errorstr;
+	close();
+	return(false);
+}
+
+bool cTpacketV3::setupRing(size_t ringSize, unsigned blockSize, unsigned blockTimeoutMs, std::string *error) {
+	char errorstr[1024];
+	long pageSize = sysconf(_SC_PAGESIZE);
+	if(blockSize < (unsigned)pageSize) {
+		blockSize = pageSize;
+	}
+	// block size must be a power-of-two multiple of page size
+	unsigned blockSize_pow2 = pageSize;
+	while(blockSize_pow2 < blockSize) {
+		blockSize_pow2 <<= 1;
+	}
+	blockSize = blockSize_pow2;
+	unsigned blockCount = ringSize / blockSize;
+	if(blockCount < 4) {
+		blockCount = 4;
+	}
+	tpacket_req3 req;
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = blockSize;
+	req.tp_block_nr = blockCount;
+	req.tp_frame_size = TPACKET_ALIGNMENT << 7;
+	req.tp_frame_nr = (blockSize / req.tp_frame_size) * blockCount;
+	req.tp_retire_blk_tov = blockTimeoutMs;
+	req.tp_feature_req_word = 0;
+	if(setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "PACKET_RX_RING failed: %s", strerror(errno));
+		*error = errorstr;
+		return(false);
+	}
+	ringLength = (size_t)blockSize * blockCount;
+	ring = (u_char*)mmap(NULL, ringLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+	if(ring == MAP_FAILED) {
+		ring = (u_char*)mmap(NULL, ringLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	if(ring == MAP_FAILED) {
+		ring = NULL;
+		snprintf(errorstr, sizeof(errorstr), "mmap ring failed: %s", strerror(errno));
+		*error = errorstr;
+		return(false);
+	}
+	this->blockSize = blockSize;
+	this->blockCount = blockCount;
+	this->blockIndex = 0;
+	return(true);
+}
+
+void cTpacketV3::close() {
+	if(ring) {
+		munmap(ring, ringLength);
+		ring = NULL;
+	}
+	if(fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+}
+
+bool cTpacketV3::setFilter(bpf_program *filter, std::string *error) {
+	sock_fprog prog;
+	prog.len = filter->bf_len;
+	prog.filter = (sock_filter*)filter->bf_insns;
+	if(setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+		char errorstr[1024];
+		snprintf(errorstr, sizeof(errorstr), "SO_ATTACH_FILTER failed: %s", strerror(errno));
+		*error = errorstr;
+		return(false);
+	}
+	return(true);
+}
+
+bool cTpacketV3::setFanout(u_int16_t group, std::string *error) {
+	return(packet_socket_set_fanout(fd, group, error));
+}
+
+bool cTpacketV3::getStat(sStat *stat) {
+	// kernel counters are reset on each read - keep totals here
+	tpacket_stats_v3 kstat;
+	socklen_t len = sizeof(kstat);
+	if(getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &kstat, &len) < 0) {
+		return(false);
+	}
+	this->stat.packets += kstat.tp_packets;
+	this->stat.drops += kstat.tp_drops;
+	this->stat.freeze_q_cnt += kstat.tp_freeze_q_cnt;
+	*stat = this->stat;
+	return(true);
+}
+
+bool packet_socket_set_fanout(int fd, u_int16_t group, std::string *error) {
+	// hash by flow (and reassembled ip fragments) so that both directions of a stream stay on one member
+	int fanout_arg = group | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16);
+	if(setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) < 0) {
+		char errorstr[1024];
+		snprintf(errorstr, sizeof(errorstr), "PACKET_FANOUT failed: %s", strerror(errno));
+		*error = errorstr;
+		return(false);
+	}
+	return(true);
+}
+
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+// linux/bpf.h collides with libpcap (struct bpf_insn) - only the needed subset of eBPF uapi follows
+#define XDP_BPF_MAP_CREATE		0
+#define XDP_BPF_MAP_UPDATE_ELEM		2
+#define XDP_BPF_MAP_DELETE_ELEM		3
+#define XDP_BPF_PROG_LOAD		5
+#define XDP_BPF_MAP_TYPE_HASH		1
+#define XDP_BPF_MAP_TYPE_ARRAY		2
+#define XDP_BPF_MAP_TYPE_XSKMAP		17
+#define XDP_BPF_PROG_TYPE_SOCKET_FILTER	1
+#define XDP_BPF_PROG_TYPE_XDP		6
+#define XDP_BPF_ANY			0
+#define XDP_BPF_PSEUDO_MAP_FD		1
+#define XDP_BPF_FUNC_map_lookup_elem	1
+#define XDP_BPF_FUNC_redirect_map	51
+#define XDP_BPF_ALU64			0x07
+#define XDP_BPF_DW			0x18
+#define XDP_BPF_MOV			0xb0
+#define XDP_BPF_CALL			0x80
+#define XDP_BPF_EXIT			0x90
+#define XDP_BPF_JNE			0x50
+#define XDP_MD_RX_QUEUE_INDEX_OFFSET	16
+#define XDP_ACTION_PASS			2
+#ifndef SO_ATTACH_BPF
+#define SO_ATTACH_BPF			50
+#endif
+
+struct sEbpfInsn {
+	u_int8_t code;
+	u_int8_t dst_reg:4;
+	u_int8_t src_reg:4;
+	int16_t off;
+	int32_t imm;
+};
+
+union uEbpfAttr {
+	struct {
+		u_int32_t map_type;
+		u_int32_t key_size;
+		u_int32_t value_size;
+		u_int32_t max_entries;
+		u_int32_t map_flags;
+	} map_create;
+	struct {
+		u_int32_t map_fd;
+		u_int64_t key __attribute__((aligned(8)));
+		u_int64_t value __attribute__((aligned(8)));
+		u_int64_t flags __attribute__((aligned(8)));
+	} map_elem;
+	struct {
+		u_int32_t prog_type;
+		u_int32_t insn_cnt;
+		u_int64_t insns __attribute__((aligned(8)));
+		u_int64_t license __attribute__((aligned(8)));
+		u_int32_t log_level;
+		u_int32_t log_size;
+		u_int64_t log_buf __attribute__((aligned(8)));
+	} prog_load;
+	u_char filler[128];
+};
+
+static int sys_bpf(int cmd, uEbpfAttr *attr) {
+	return(syscall(__NR_bpf, cmd, attr, sizeof(*attr)));
+}
+
+// one XDP program and XSKMAP per interface, shared by sockets of all its queues
+struct sXdpIfaceProgram {
+	sXdpIfaceProgram() {
+		map_fd = -1;
+		prog_fd = -1;
+		flags = 0;
+		refs = 0;
+	}
+	int map_fd;
+	int prog_fd;
+	u_int32_t flags;
+	int refs;
+};
+static std::map<int, sXdpIfaceProgram> xdpIfacePrograms;
+static volatile int _sync_xdpIfacePrograms = 0;
+
+static bool xdp_netlink_set_prog(int ifindex, int prog_fd, u_int32_t flags, std::string *error) {
+	int sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if(sock < 0) {
+		*error = std::string("netlink socket failed: ") + strerror(errno);
+		return(false);
+	}
+	struct {
+		nlmsghdr nh;
+		ifinfomsg ifinfo;
+		char attrbuf[64];
+	} req;
+	memset(&req, 0, sizeof(req));
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(ifinfomsg));
+	req.nh.nlmsg_type = RTM_SETLINK;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+	req.nh.nlmsg_seq = 1;
+	req.ifinfo.ifi_family = AF_UNSPEC;
+	req.ifinfo.ifi_index = ifindex;
+	rtattr *nest = (rtattr*)((char*)&req + NLMSG_ALIGN(req.nh.nlmsg_len));
+	nest->rta_type = NLA_F_NESTED | IFLA_XDP;
+	nest->rta_len = RTA_LENGTH(0);
+	rtattr *attr = (rtattr*)((char*)nest + RTA_ALIGN(nest->rta_len));
+	attr->rta_type = IFLA_XDP_FD;
+	attr->rta_len = RTA_LENGTH(sizeof(int));
+	memcpy(RTA_DATA(attr), &prog_fd, sizeof(int));
+	nest->rta_len += RTA_ALIGN(attr->rta_len);
+	if(flags) {
+		attr = (rtattr*)((char*)nest + RTA_ALIGN(nest->rta_len));
+		attr->rta_type = IFLA_XDP_FLAGS;
+		attr->rta_len = RTA_LENGTH(sizeof(u_int32_t));
+		memcpy(RTA_DATA(attr), &flags, sizeof(u_int32_t));
+		nest->rta_len += RTA_ALIGN(attr->rta_len);
+	}
+	req.nh.nlmsg_len = NLMSG_ALIGN(req.nh.nlmsg_len) + RTA_ALIGN(nest->rta_len);
+	bool ok = false;
+	if(send(sock, &req, req.nh.nlmsg_len, 0) < 0) {
+		*error = std::string("netlink send failed: ") + strerror(errno);
+	} else {
+		char buf[4096];
+		int len = recv(sock, buf, sizeof(buf), 0);
+		if(len < 0) {
+			*error = std::string("netlink recv failed: ") + strerror(errno);
+		} else {
+			for(nlmsghdr *nh = (nlmsghdr*)buf; NLMSG_OK(nh, (unsigned)len); nh = NLMSG_NEXT(nh, len)) {
+				if(nh->nlmsg_type == NLMSG_ERROR) {
+					nlmsgerr *err = (nlmsgerr*)NLMSG_DATA(nh);
+					if(err->error) {
+						*error = std::string("netlink set xdp failed: ") + strerror(-err->error);
+					} else {
+						ok = true;
+					}
+					break;
+				}
+			}
+		}
+	}
+	::close(sock);
+	return(ok);
+}
+
+static int xdp_load_redirect_program(int map_fd, std::string *error) {
+	// if(bpf_map_lookup_elem(&xsks_map, &ctx->rx_queue_index)) return(bpf_redirect_map(&xsks_map, ctx->rx_queue_index, 0)); return(XDP_PASS);
+	sEbpfInsn insns[] = {
+		{ BPF_LDX | BPF_MEM | BPF_W, 2, 1, XDP_MD_RX_QUEUE_INDEX_OFFSET, 0 },
+		{ BPF_STX | BPF_MEM | BPF_W, 10, 2, -4, 0 },
+		{ XDP_BPF_ALU64 | XDP_BPF_MOV | BPF_X, 6, 2, 0, 0 },
+		{ BPF_LD | XDP_BPF_DW | BPF_IMM, 1, XDP_BPF_PSEUDO_MAP_FD, 0, map_fd },
+		{ 0, 0, 0, 0, 0 },
+		{ XDP_BPF_ALU64 | XDP_BPF_MOV | BPF_X, 2, 10, 0, 0 },
+		{ XDP_BPF_ALU64 | BPF_ADD | BPF_K, 2, 0, 0, -4 },
+		{ BPF_JMP | XDP_BPF_CALL, 0, 0, 0, XDP_BPF_FUNC_map_lookup_elem },
+		{ BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 6, 0 },
+		{ BPF_LD | XDP_BPF_DW | BPF_IMM, 1, XDP_BPF_PSEUDO_MAP_FD, 0, map_fd },
+		{ 0, 0, 0, 0, 0 },
+		{ XDP_BPF_ALU64 | XDP_BPF_MOV | BPF_X, 2, 6, 0, 0 },
+		{ XDP_BPF_ALU64 | XDP_BPF_MOV | BPF_K, 3, 0, 0, 0 },
+		{ BPF_JMP | XDP_BPF_CALL, 0, 0, 0, XDP_BPF_FUNC_redirect_map },
+		{ BPF_JMP | XDP_BPF_EXIT, 0, 0, 0, 0 },
+		{ XDP_BPF_ALU64 | XDP_BPF_MOV | BPF_K, 0, 0, 0, XDP_ACTION_PASS },
+		{ BPF_JMP | XDP_BPF_EXIT, 0, 0, 0, 0 }
+	};
+	char license[] = "GPL";
+	char log[4096];
+	log[0] = 0;
+	uEbpfAttr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_load.prog_type = XDP_BPF_PROG_TYPE_XDP;
+	attr.prog_load.insns = (u_int64_t)insns;
+	attr.prog_load.insn_cnt = sizeof(insns) / sizeof(insns[0]);
+	attr.prog_load.license = (u_int64_t)license;
+	attr.prog_load.log_buf = (u_int64_t)log;
+	attr.prog_load.log_size = sizeof(log);
+	attr.prog_load.log_level = 1;
+	int prog_fd = sys_bpf(XDP_BPF_PROG_LOAD, &attr);
+	if(prog_fd < 0) {
+		*error = std::string("load xdp program failed: ") + strerror(errno) + (log[0] ? std::string(" - ") + log : "");
+	}
+	return(prog_fd);
+}
+
+
+cAfXdp::cAfXdp() {
+	fd = -1;
+	ifindex = 0;
+	queue = 0;
+	umem = NULL;
+	umemLength = 0;
+	frameSize = 0;
+	framesCount = 0;
+	framesInUser = 0;
+	programAttached = false;
+	refs = 1;
+	_sync_fill = 0;
+}
+
+cAfXdp::~cAfXdp() {
+	close();
+}
+
+bool cAfXdp::open(const char *ifname, unsigned queue, size_t umemSize, unsigned frameSize, unsigned headroom,
+		  bool native, std::string *error) {
+	char errorstr[1024];
+	this->queue = queue;
+	this->ifindex = if_nametoindex(ifname);
+	if(!this->ifindex) {
+		snprintf(errorstr, sizeof(errorstr), "unknown interface %s", ifname);
+		goto failed;
+	}
+	fd = socket(AF_XDP, SOCK_RAW, 0);
+	if(fd < 0) {
+		snprintf(errorstr, sizeof(errorstr), "socket(AF_XDP) failed: %s", strerror(errno));
+		goto failed;
+	}
+	{
+	unsigned frameSize_pow2 = 2048;
+	while(frameSize_pow2 < frameSize && frameSize_pow2 < 65536) {
+		frameSize_pow2 <<= 1;
+	}
+	this->frameSize = frameSize_pow2;
+	// ring sizes must be power of 2 - all frames fit into fill ring
+	framesCount = 1024;
+	while((size_t)framesCount * 2 * this->frameSize <= umemSize && framesCount < (1u << 20)) {
+		framesCount <<= 1;
+	}
+	umemLength = (size_t)framesCount * this->frameSize;
+	umem = (u_char*)mmap(NULL, umemLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if(umem == MAP_FAILED) {
+		umem = NULL;
+		snprintf(errorstr, sizeof(errorstr), "mmap umem failed: %s", strerror(errno));
+		goto failed;
+	}
+	xdp_umem_reg umemReg;
+	memset(&umemReg, 0, sizeof(umemReg));
+	umemReg.addr = (u_int64_t)umem;
+	umemReg.len = umemLength;
+	umemReg.chunk_size = this->frameSize;
+	umemReg.headroom = headroom;
+	if(setsockopt(fd, SOL_XDP, XDP_UMEM_REG, &umemReg, sizeof(umemReg)) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "XDP_UMEM_REG failed: %s", strerror(errno));
+		goto failed;
+	}
+	int ringSize = framesCount;
+	int completionRingSize = 64;
+	if(setsockopt(fd, SOL_XDP, XDP_UMEM_FILL_RING, &ringSize, sizeof(ringSize)) < 0 ||
+	   setsockopt(fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &completionRingSize, sizeof(completionRingSize)) < 0 ||
+	   setsockopt(fd, SOL_XDP, XDP_RX_RING, &ringSize, sizeof(ringSize)) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "XDP rings setup failed: %s", strerror(errno));
+		goto failed;
+	}
+	xdp_mmap_offsets offsets;
+	socklen_t offsetsLength = sizeof(offsets);
+	if(getsockopt(fd, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &offsetsLength) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "XDP_MMAP_OFFSETS failed: %s", strerror(errno));
+		goto failed;
+	}
+	std::string ringError;
+	if(!mapRing(&fill, XDP_UMEM_FILL_RING, ringSize, &offsets.fr, XDP_UMEM_PGOFF_FILL_RING, sizeof(u_int64_t), &ringError) ||
+	   !mapRing(&completion, XDP_UMEM_COMPLETION_RING, completionRingSize, &offsets.cr, XDP_UMEM_PGOFF_COMPLETION_RING, sizeof(u_int64_t), &ringError) ||
+	   !mapRing(&rx, XDP_RX_RING, ringSize, &offsets.rx, XDP_PGOFF_RX_RING, sizeof(xdp_desc), &ringError)) {
+		snprintf(errorstr, sizeof(errorstr), "%s", ringError.c_str());
+		goto failed;
+	}
+	// all frames are handed to kernel
+	for(unsigned i = 0; i < framesCount; i++) {
+		((u_int64_t*)fill.descs)[i & fill.mask] = (u_int64_t)i * this->frameSize;
+	}
+	fill.cached = framesCount;
+	__atomic_store_n(fill.producer, fill.cached, __ATOMIC_RELEASE);
+	rx.cached = __atomic_load_n(rx.consumer, __ATOMIC_ACQUIRE);
+	sockaddr_xdp sxdp;
+	memset(&sxdp, 0, sizeof(sxdp));
+	sxdp.sxdp_family = AF_XDP;
+	sxdp.sxdp_ifindex = this->ifindex;
+	sxdp.sxdp_queue_id = queue;
+	sxdp.sxdp_flags = native ? XDP_ZEROCOPY : XDP_COPY;
+	if(bind(fd, (sockaddr*)&sxdp, sizeof(sxdp)) < 0) {
+		snprintf(errorstr, sizeof(errorstr), "bind AF_XDP socket to queue %u failed: %s", queue, strerror(errno));
+		goto failed;
+	}
+	std::string programError;
+	if(!attachProgram(native, &programError)) {
+		snprintf(errorstr, sizeof(errorstr), "%s", programError.c_str());
+		goto failed;
+	}
+	}
+	return(true);
+failed:
+	*error = errorstr;
+	close();
+	return(false);
+}
+
+bool cAfXdp::mapRing(sRing *ring, int /*ringType*/, unsigned size, xdp_ring_offset *offsets, off_t pgoff, size_t descSize, std::string *error) {
+	ring->mapLength = offsets->desc + size * descSize;
+	ring->map = mmap(NULL, ring->mapLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, pgoff);
+	if(ring->map == MAP_FAILED) {
+		ring->map = NULL;
+		*error = std::string("mmap xdp ring failed: ") + strerror(errno);
+		return(false);
+	}
+	ring->producer = (u_int32_t*)((u_char*)ring->map + offsets->producer);
+	ring->consumer = (u_int32_t*)((u_char*)ring->map + offsets->consumer);
+	ring->flags = (u_int32_t*)((u_char*)ring->map + offsets->flags);
+	ring->descs = (u_char*)ring->map + offsets->desc;
+	ring->mask = size - 1;
+	ring->cached = 0;
+	return(true);
+}
+
+void cAfXdp::unmapRing(sRing *ring) {
+	if(ring->map) {
+		munmap(ring->map, ring->mapLength);
+		ring->map = NULL;
+	}
+}
+
+bool cAfXdp::attachProgram(bool native, std::string *error) {
+	while(__sync_lock_test_and_set(&_sync_xdpIfacePrograms, 1));
+	sXdpIfaceProgram *program = &xdpIfacePrograms[ifindex];
+	if(!program->refs) {
+		uEbpfAttr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.map_create.map_type = XDP_BPF_MAP_TYPE_XSKMAP;
+		attr.map_create.key_size = sizeof(int);
+		attr.map_create.value_size = sizeof(int);
+		attr.map_create.max_entries = 256;
+		program->map_fd = sys_bpf(XDP_BPF_MAP_CREATE, &attr);
+		if(program->map_fd < 0) {
+			*error = std::string("create xskmap failed: ") + strerror(errno);
+			xdpIfacePrograms.erase(ifindex);
+			__sync_lock_release(&_sync_xdpIfacePrograms);
+			return(false);
+		}
+		program->prog_fd = xdp_load_redirect_program(program->map_fd, error);
+		program->flags = native ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+		if(program->prog_fd < 0 ||
+		   !xdp_netlink_set_prog(ifindex, program->prog_fd, program->flags, error)) {
+			if(program->prog_fd >= 0) {
+				::close(program->prog_fd);
+			}
+			::close(program->map_fd);
+			xdpIfacePrograms.erase(ifindex);
+			__sync_lock_release(&_sync_xdpIfacePrograms);
+			return(false);
+		}
+	}
+	++program->refs;
+	programAttached = true;
+	uEbpfAttr attr;
+	memset(&attr, 0, sizeof(attr));
+	int key = queue;
+	attr.map_elem.map_fd = program->map_fd;
+	attr.map_elem.key = (u_int64_t)&key;
+	attr.map_elem.value = (u_int64_t)&fd;
+	bool ok = sys_bpf(XDP_BPF_MAP_UPDATE_ELEM, &attr) == 0;
+	if(!ok) {
+		*error = std::string("insert socket to xskmap failed: ") + strerror(errno);
+	}
+	__sync_lock_release(&_sync_xdpIfacePrograms);
+	return(ok);
+}
+
+void cAfXdp::detachProgram() {
+	if(!programAttached) {
+		return;
+	}
+	while(__sync_lock_test_and_set(&_sync_xdpIfacePrograms, 1));
+	std::map<int, sXdpIfaceProgram>::iterator iter = xdpIfacePrograms.find(ifindex);
+	if(iter != xdpIfacePrograms.end()) {
+		uEbpfAttr attr;
+		memset(&attr, 0, sizeof(attr));
+		int key = queue;
+		attr.map_elem.map_fd = iter->second.map_fd;
+		attr.map_elem.key = (u_int64_t)&key;
+		sys_bpf(XDP_BPF_MAP_DELETE_ELEM, &attr);
+		if(!--iter->second.refs) {
+			std::string error;
+			xdp_netlink_set_prog(ifindex, -1, iter->second.flags, &error);
+			::close(iter->second.prog_fd);
+			::close(iter->second.map_fd);
+			xdpIfacePrograms.erase(iter);
+		}
+	}
+	programAttached = false;
+	__sync_lock_release(&_sync_xdpIfacePrograms);
+}
+
+void cAfXdp::close() {
+	detachProgram();
+	if(fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+	unmapRing(&fill);
+	unmapRing(&completion);
+	unmapRing(&rx);
+	if(umem) {
+		munmap(umem, umemLength);
+		umem = NULL;
+	}
+}
+
+void cAfXdp::releaseFrame(u_int64_t addr) {
+	lock_fill();
+	((u_int64_t*)fill.descs)[fill.cached & fill.mask] = addr & ~(u_int64_t)(frameSize - 1);
+	++fill.cached;
+	__atomic_store_n(fill.producer, fill.cached, __ATOMIC_RELEASE);
+	unlock_fill();
+	__sync_sub_and_fetch(&framesInUser, 1);
+}
+
+void cAfXdp::ref() {
+	__sync_add_and_fetch(&refs, 1);
+}
+
+void cAfXdp::release(pcap_block_store *block) {
+	lock_fill();
+	for(size_t i = 0; i < block->count; i++) {
+		((u_int64_t*)fill.descs)[fill.cached & fill.mask] = block->offsets[i] & ~(u_int64_t)(frameSize - 1);
+		++fill.cached;
+	}
+	__atomic_store_n(fill.producer, fill.cached, __ATOMIC_RELEASE);
+	unlock_fill();
+	__sync_sub_and_fetch(&framesInUser, block->count);
+	unref();
+}
+
+void cAfXdp::unref() {
+	// umem lives until the last block store referencing it is destroyed
+	if(__sync_sub_and_fetch(&refs, 1) == 0) {
+		delete this;
+	}
+}
+
+bool cAfXdp::getStat(sStat *stat) {
+	xdp_statistics kstat;
+	socklen_t len = sizeof(kstat);
+	memset(&kstat, 0, sizeof(kstat));
+	if(getsockopt(fd, SOL_XDP, XDP_STATISTICS, &kstat, &len) < 0) {
+		return(false);
+	}
+	this->stat.rx_dropped = kstat.rx_dropped;
+	this->stat.rx_ring_full = kstat.rx_ring_full;
+	this->stat.fill_ring_empty = kstat.rx_fill_ring_empty_descs;
+	*stat = this->stat;
+	return(true);
+}
+
+
+// minimal eBPF assembler with forward label resolution
+class cEbpfProgramBuilder {
+public:
+	void insn(u_int8_t code, u_int8_t dst, u_int8_t src, int16_t off, int32_t imm) {
+		sEbpfInsn insn;
+		insn.code = code;
+		insn.dst_reg = dst;
+		insn.src_reg = src;
+		insn.off = off;
+		insn.imm = imm;
+		insns.push_back(insn);
+	}
+	void jmp(u_int8_t op, u_int8_t dst, int32_t imm, const char *label) {
+		jumps.push_back(std::make_pair(insns.size(), std::string(label)));
+		insn(BPF_JMP | op | BPF_K, dst, 0, 0, imm);
+	}
+	void ja(const char *label) {
+		jmp(BPF_JA, 0, 0, label);
+	}
+	void label(const char *label) {
+		labels[label] = insns.size();
+	}
+	void mov(u_int8_t dst, int32_t imm) {
+		insn(XDP_BPF_ALU64 | XDP_BPF_MOV | BPF_K, dst, 0, 0, imm);
+	}
+	void movReg(u_int8_t dst, u_int8_t src) {
+		insn(XDP_BPF_ALU64 | XDP_BPF_MOV | BPF_X, dst, src, 0, 0);
+	}
+	void alu(u_int8_t op, u_int8_t dst, int32_t imm) {
+		insn(XDP_BPF_ALU64 | op | BPF_K, dst, 0, 0, imm);
+	}
+	void aluReg(u_int8_t op, u_int8_t dst, u_int8_t src) {
+		insn(XDP_BPF_ALU64 | op | BPF_X, dst, src, 0, 0);
+	}
+	// r0 = ntoh(*(size*)(skb->data + src + offset)); r6 must hold ctx
+	void ldPacket(u_int8_t size, u_int8_t src, int32_t offset) {
+		insn(BPF_LD | (src ? BPF_IND : BPF_ABS) | size, 0, src, 0, offset);
+	}
+	void stackStore(int16_t off, u_int8_t src) {
+		insn(BPF_STX | BPF_MEM | BPF_W, 10, src, off, 0);
+	}
+	void stackStoreImm(int16_t off, int32_t imm) {
+		insn(BPF_ST | BPF_MEM | BPF_W, 10, 0, off, imm);
+	}
+	void stackLoad(u_int8_t dst, int16_t off) {
+		insn(BPF_LDX | BPF_MEM | BPF_W, dst, 10, off, 0);
+	}
+	// r0 = bpf_map_lookup_elem(map, fp + keyOff)
+	void mapLookup(int map_fd, int16_t keyOff) {
+		insn(BPF_LD | XDP_BPF_DW | BPF_IMM, 1, XDP_BPF_PSEUDO_MAP_FD, 0, map_fd);
+		insn(0, 0, 0, 0, 0);
+		movReg(2, 10);
+		alu(BPF_ADD, 2, keyOff);
+		insn(BPF_JMP | XDP_BPF_CALL, 0, 0, 0, XDP_BPF_FUNC_map_lookup_elem);
+	}
+	void exit() {
+		insn(BPF_JMP | XDP_BPF_EXIT, 0, 0, 0, 0);
+	}
+	bool link() {
+		for(unsigned i = 0; i < jumps.size(); i++) {
+			std::map<std::string, unsigned>::iterator iter = labels.find(jumps[i].second);
+			if(iter == labels.end()) {
+				return(false);
+			}
+			insns[jumps[i].first].off = iter->second - jumps[i].first - 1;
+		}
+		return(true);
+	}
+	sEbpfInsn *getInsns() {
+		return(&insns[0]);
+	}
+	unsigned getInsnsCount() {
+		return(insns.size());
+	}
+private:
+	std::vector<sEbpfInsn> insns;
+	std::map<std::string, unsigned> labels;
+	std::vector<std::pair<unsigned, std::string> > jumps;
+};
+
+#define KERNEL_PREFILTER_PASS_ALL_INDEX 65536
+
+cKernelPrefilter *kernelPrefilter = NULL;
+
+cKernelPrefilter::cKernelPrefilter() {
+	portsMapFd = -1;
+	endpointsMapFd = -1;
+	for(int i = 0; i < _lt_count; i++) {
+		progFd[i] = -1;
+	}
+	_sync_prog = 0;
+	updatesCount = 0;
+	_sync_updates = 0;
+	_sync_apply = 0;
+}
+
+cKernelPrefilter::~cKernelPrefilter() {
+	for(int i = 0; i < _lt_count; i++) {
+		if(progFd[i] >= 0) {
+			::close(progFd[i]);
+		}
+	}
+	if(endpointsMapFd >= 0) {
+		::close(endpointsMapFd);
+	}
+	if(portsMapFd >= 0) {
+		::close(portsMapFd);
+	}
+}
+
+bool cKernelPrefilter::init(unsigned maxEndpoints, std::string *error) {
+	uEbpfAttr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.map_create.map_type = XDP_BPF_MAP_TYPE_ARRAY;
+	attr.map_create.key_size = sizeof(u_int32_t);
+	attr.map_create.value_size = sizeof(u_int8_t);
+	attr.map_create.max_entries = KERNEL_PREFILTER_PASS_ALL_INDEX + 1;
+	portsMapFd = sys_bpf(XDP_BPF_MAP_CREATE, &attr);
+	if(portsMapFd < 0) {
+		*error = std::string("create ports map failed: ") + strerror(errno);
+		return(false);
+	}
+	memset(&attr, 0, sizeof(attr));
+	attr.map_create.map_type = XDP_BPF_MAP_TYPE_HASH;
+	attr.map_create.key_size = sizeof(sEndpointKey);
+	attr.map_create.value_size = sizeof(u_int8_t);
+	attr.map_create.max_entries = maxEndpoints;
+	endpointsMapFd = sys_bpf(XDP_BPF_MAP_CREATE, &attr);
+	if(endpointsMapFd < 0) {
+		*error = std::string("create endpoints map failed: ") + strerror(errno);
+		return(false);
+	}
+	return(true);
+}
+
+bool cKernelPrefilter::setPort(u_int16_t port) {
+	u_int32_t key = port;
+	u_int8_t value = 1;
+	uEbpfAttr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.map_elem.map_fd = portsMapFd;
+	attr.map_elem.key = (u_int64_t)&key;
+	attr.map_elem.value = (u_int64_t)&value;
+	attr.map_elem.flags = XDP_BPF_ANY;
+	return(sys_bpf(XDP_BPF_MAP_UPDATE_ELEM, &attr) == 0);
+}
+
+bool cKernelPrefilter::setPassAll(bool passAll) {
+	u_int32_t key = KERNEL_PREFILTER_PASS_ALL_INDEX;
+	u_int8_t value = passAll;
+	uEbpfAttr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.map_elem.map_fd = portsMapFd;
+	attr.map_elem.key = (u_int64_t)&key;
+	attr.map_elem.value = (u_int64_t)&value;
+	attr.map_elem.flags = XDP_BPF_ANY;
+	return(sys_bpf(XDP_BPF_MAP_UPDATE_ELEM, &attr) == 0);
+}
+
+bool cKernelPrefilter::attach(int fd, eLinkType linkType, std::string *error) {
+	while(__sync_lock_test_and_set(&_sync_prog, 1));
+	if(progFd[linkType] < 0) {
+		progFd[linkType] = loadProgram(linkType, error);
+	}
+	int prog_fd = progFd[linkType];
+	__sync_lock_release(&_sync_prog);
+	if(prog_fd < 0) {
+		return(false);
+	}
+	if(setsockopt(fd, SOL_SOCKET, SO_ATTACH_BPF, &prog_fd, sizeof(prog_fd)) < 0) {
+		*error = std::string("SO_ATTACH_BPF failed: ") + strerror(errno);
+		return(false);
+	}
+	return(true);
+}
+
+void cKernelPrefilter::setKey(sEndpointKey *key, vmIP ip, vmPort port) {
+	memset(key, 0, sizeof(*key));
+	// the same layout as the program builds from BPF_LD packet loads - words in host order
+	if(ip.is_v6()) {
+		in6_addr ipv6 = ip.getIPv6();
+		for(unsigned i = 0; i < 4; i++) {
+			key->addr[i] = ipv6.__in6_u.__u6_addr32[i];
+		}
+		key->family = 6;
+	} else {
+		key->addr[0] = ip.getIPv4();
+		key->family = 4;
+	}
+	key->port = port.getPort();
+}
+
+void cKernelPrefilter::add(vmIP ip, vmPort port) {
+	queueUpdate(ip, port, true);
+}
+
+void cKernelPrefilter::remove(vmIP ip, vmPort port) {
+	queueUpdate(ip, port, false);
+}
+
+void cKernelPrefilter::queueUpdate(vmIP ip, vmPort port, bool add) {
+	sEndpointUpdate update;
+	setKey(&update.key, ip, port);
+	update.add = add;
+	while(__sync_lock_test_and_set(&_sync_updates, 1)) {
+		USLEEP(10);
+	}
+	updates.push_back(update);
+	updatesCount = updates.size();
+	__sync_lock_release(&_sync_updates);
+}
+
+void cKernelPrefilter::applyUpdates() {
+	// one thread applies the updates so that add / remove of the same key stay in order,
+	// the other threads leave the updates queued by them to it - it checks the queue again after the release
+	std::vector<sEndpointUpdate> apply;
+	while(updatesCount) {
+		if(__sync_lock_test_and_set(&_sync_apply, 1)) {
+			return;
+		}
+		while(__sync_lock_test_and_set(&_sync_updates, 1)) {
+			USLEEP(10);
+		}
+		apply.swap(updates);
+		updatesCount = 0;
+		__sync_lock_release(&_sync_updates);
+		for(unsigned i = 0; i < apply.size(); i++) {
+			if(apply[i].add) {
+				mapAdd(&apply[i].key);
+			} else {
+				mapRemove(&apply[i].key);
+			}
+		}
+		apply.clear();
+		__sync_lock_release(&_sync_apply);
+		__sync_synchronize();
+	}
+}
+
+void cKernelPrefilter::mapAdd(sEndpointKey *key) {
+	u_int8_t value = 1;
+	uEbpfAttr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.map_elem.map_fd = endpointsMapFd;
+	attr.map_elem.key = (u_int64_t)key;
+	attr.map_elem.value = (u_int64_t)&value;
+	attr.map_elem.flags = XDP_BPF_ANY;
+	if(sys_bpf(XDP_BPF_MAP_UPDATE_ELEM, &attr) == 0) {
+		__sync_add_and_fetch(&stat.endpoints, 1);
+	} else {
+		// map is full - let all udp pass until the entries that did not fit are gone
+		if(__sync_fetch_and_add(&stat.missing, 1) == 0) {
+			setPassAll(true);
+			syslog(LOG_NOTICE, "kernel prefilter - endpoints map is full (%s), udp is not filtered until it drains", strerror(errno));
+		}
+		__sync_add_and_fetch(&stat.add_errors, 1);
+	}
+}
+
+void cKernelPrefilter::mapRemove(sEndpointKey *key) {
+	uEbpfAttr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.map_elem.map_fd = endpointsMapFd;
+	attr.map_elem.key = (u_int64_t)key;
+	if(sys_bpf(XDP_BPF_MAP_DELETE_ELEM, &attr) == 0) {
+		__sync_sub_and_fetch(&stat.endpoints, 1);
+	} else if(stat.missing) {
+		if(__sync_sub_and_fetch(&stat.missing, 1) == 0) {
+			setPassAll(false);
+		}
+	}
+}
+
+void cKernelPrefilter::getStat(sStat *stat) {
+	*stat = this->stat;
+}
+
+std::string cKernelPrefilter::getStatString() {
+	std::ostringstream outStr;
+	outStr << "kpf[" << stat.endpoints;
+	if(stat.missing) {
+		outStr << "/full";
+	}
+	outStr << "]";
+	return(outStr.str());
+}
+
+int cKernelPrefilter::loadProgram(eLinkType linkType, std::string *error) {
+	/* registers: r6 - ctx (required by BPF_LD packet loads), r7 - offset of ip header, r8 - offset of udp header, r9 - source port
+	   stack:     fp-4 - destination port, fp-8 - key of ports map, fp-32..fp-9 - sEndpointKey (fp-12 family, fp-16 port) */
+	cEbpfProgramBuilder prog;
+	prog.movReg(6, 1);
+	if(linkType == _lt_ethernet) {
+		// 802.1Q, 802.1ad / old QinQ outer tag with optional inner 802.1Q tag, deeper stacks pass
+		prog.mov(7, 14);
+		prog.ldPacket(BPF_H, 0, 12);
+		prog.jmp(BPF_JEQ, 0, 0x8100, "vlan");
+		prog.jmp(BPF_JEQ, 0, 0x88A8, "vlan");
+		prog.jmp(BPF_JEQ, 0, 0x9100, "vlan");
+		prog.ja("ethertype");
+		prog.label("vlan");
+		prog.mov(7, 18);
+		prog.ldPacket(BPF_H, 0, 16);
+		prog.jmp(XDP_BPF_JNE, 0, 0x8100, "ethertype");
+		prog.mov(7, 22);
+		prog.ldPacket(BPF_H, 0, 20);
+		prog.label("ethertype");
+		prog.jmp(BPF_JEQ, 0, 0x0800, "ipv4");
+		prog.jmp(BPF_JEQ, 0, 0x86DD, "ipv6");
+		prog.ja("pass");
+	} else {
+		prog.mov(7, 0);
+		prog.ldPacket(BPF_B, 0, 0);
+		prog.alu(BPF_RSH, 0, 4);
+		prog.jmp(BPF_JEQ, 0, 4, "ipv4");
+		prog.jmp(BPF_JEQ, 0, 6, "ipv6");
+		prog.ja("pass");
+	}
+	// ipv4 - only unfragmented udp is filtered, fragments go to the defragmentation in userspace
+	prog.label("ipv4");
+	prog.ldPacket(BPF_B, 7, 9);
+	prog.jmp(XDP_BPF_JNE, 0, IPPROTO_UDP, "pass");
+	prog.ldPacket(BPF_H, 7, 6);
+	prog.alu(BPF_AND, 0, 0x3FFF);
+	prog.jmp(XDP_BPF_JNE, 0, 0, "pass");
+	prog.ldPacket(BPF_B, 7, 0);
+	prog.alu(BPF_AND, 0, 0x0F);
+	prog.alu(BPF_LSH, 0, 2);
+	prog.movReg(8, 7);
+	prog.aluReg(BPF_ADD, 8, 0);
+	prog.stackStoreImm(-12, 4);
+	prog.stackStoreImm(-28, 0);
+	prog.stackStoreImm(-24, 0);
+	prog.stackStoreImm(-20, 0);
+	prog.ja("udp");
+	// ipv6 - udp must follow the fixed header, extension headers pass
+	prog.label("ipv6");
+	prog.ldPacket(BPF_B, 7, 6);
+	prog.jmp(XDP_BPF_JNE, 0, IPPROTO_UDP, "pass");
+	prog.movReg(8, 7);
+	prog.alu(BPF_ADD, 8, 40);
+	prog.stackStoreImm(-12, 6);
+	prog.label("udp");
+	prog.ldPacket(BPF_H, 8, 0);
+	prog.movReg(9, 0);
+	prog.ldPacket(BPF_H, 8, 2);
+	prog.stackStore(-4, 0);
+	// monitored ports (sip, skinny, mgcp, tunnels, ...) and pass all switch
+	prog.stackStore(-8, 0);
+	prog.mapLookup(portsMapFd, -8);
+	prog.jmp(BPF_JEQ, 0, 0, "sport");
+	prog.insn(BPF_LDX | BPF_MEM | BPF_B, 0, 0, 0, 0);
+	prog.jmp(XDP_BPF_JNE, 0, 0, "pass");
+	prog.label("sport");
+	prog.stackStore(-8, 9);
+	prog.mapLookup(portsMapFd, -8);
+	prog.jmp(BPF_JEQ, 0, 0, "pass_all");
+	prog.insn(BPF_LDX | BPF_MEM | BPF_B, 0, 0, 0, 0);
+	prog.jmp(XDP_BPF_JNE, 0, 0, "pass");
+	prog.label("pass_all");
+	prog.stackStoreImm(-8, KERNEL_PREFILTER_PASS_ALL_INDEX);
+	prog.mapLookup(portsMapFd, -8);
+	prog.jmp(BPF_JEQ, 0, 0, "dst");
+	prog.insn(BPF_LDX | BPF_MEM | BPF_B, 0, 0, 0, 0);
+	prog.jmp(XDP_BPF_JNE, 0, 0, "pass");
+	// ip:port of calls (calltable rtp hash)
+	prog.label("dst");
+	prog.stackLoad(0, -12);
+	prog.jmp(BPF_JEQ, 0, 6, "dst_ipv6");
+	prog.ldPacket(BPF_W, 7, 16);
+	prog.stackStore(-32, 0);
+	prog.ja("dst_port");
+	prog.label("dst_ipv6");
+	for(int i = 0; i < 4; i++) {
+		prog.ldPacket(BPF_W, 7, 24 + i * 4);
+		prog.stackStore(-32 + i * 4, 0);
+	}
+	prog.label("dst_port");
+	prog.stackLoad(0, -4);
+	prog.stackStore(-16, 0);
+	prog.mapLookup(endpointsMapFd, -32);
+	prog.jmp(XDP_BPF_JNE, 0, 0, "pass");
+	prog.stackLoad(0, -12);
+	prog.jmp(BPF_JEQ, 0, 6, "src_ipv6");
+	prog.ldPacket(BPF_W, 7, 12);
+	prog.stackStore(-32, 0);
+	prog.ja("src_port");
+	prog.label("src_ipv6");
+	for(int i = 0; i < 4; i++) {
+		prog.ldPacket(BPF_W, 7, 8 + i * 4);
+		prog.stackStore(-32 + i * 4, 0);
+	}
+	prog.label("src_port");
+	prog.stackStore(-16, 9);
+	prog.mapLookup(endpointsMapFd, -32);
+	prog.jmp(XDP_BPF_JNE, 0, 0, "pass");
+	prog.mov(0, 0);
+	prog.exit();
+	prog.label("pass");
+	// whole packet, truncation is up to the snaplen of capture
+	prog.mov(0, -1);
+	prog.exit();
+	if(!prog.link()) {
+		*error = "link of prefilter program failed";
+		return(-1);
+	}
+	char license[] = "GPL";
+	uEbpfAttr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_load.prog_type = XDP_BPF_PROG_TYPE_SOCKET_FILTER;
+	attr.prog_load.insns = (u_int64_t)prog.getInsns();
+	attr.prog_load.insn_cnt = prog.getInsnsCount();
+	attr.prog_load.license = (u_int64_t)license;
+	int prog_fd = sys_bpf(XDP_BPF_PROG_LOAD, &attr);
+	if(prog_fd < 0) {
+		// repeat with verifier log only for the error message
+		char *log = new FILE_LINE(0) char[65536];
+		log[0] = 0;
+		attr.prog_load.log_buf = (u_int64_t)log;
+		attr.prog_load.log_size = 65536;
+		attr.prog_load.log_level = 1;
+		prog_fd = sys_bpf(XDP_BPF_PROG_LOAD, &attr);
+		if(prog_fd < 0) {
+			*error = std::string("load prefilter program failed: ") + strerror(errno) + (log[0] ? std::string(" - ") + log : "");
+		}
+		delete [] log;
+	}
+	return(prog_fd);
+}
+
+#endif //FREEBSD
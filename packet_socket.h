@@ -0,0 +1,306 @@
+#ifndef PACKET_SOCKET_H
+#define PACKET_SOCKET_H
+
+
+#include <string>
+#include <vector>
+#include <pcap.h>
+#include <sys/types.h>
+#include <poll.h>
+
+#ifndef FREEBSD
+#include <linux/if_packet.h>
+#include <linux/if_xdp.h>
+#endif
+
+#include "pcap_queue_block.h"
+#include "ip.h"
+
+
+#ifndef FREEBSD
+
+class cTpacketV3 {
+public:
+	struct sStat {
+		sStat() {
+			packets = 0;
+			drops = 0;
+			freeze_q_cnt = 0;
+		}
+		u_int64_t packets;
+		u_int64_t drops;
+		u_int64_t freeze_q_cnt;
+	};
+public:
+	cTpacketV3();
+	~cTpacketV3();
+	bool open(const char *ifname, unsigned snaplen, bool promisc,
+		  size_t ringSize, unsigned blockSize, unsigned blockTimeoutMs,
+		  std::string *error);
+	void close();
+	bool setFilter(bpf_program *filter, std::string *error);
+	inline tpacket_block_desc *getBlock(int pollTimeoutMs);
+	inline void releaseBlock(tpacket_block_desc *block);
+	int getDlt() {
+		return(dlt);
+	}
+	int getFd() {
+		return(fd);
+	}
+	int getIfindex() {
+		return(ifindex);
+	}
+	bool getStat(sStat *stat);
+	bool setFanout(u_int16_t group, std::string *error);
+private:
+	bool setupRing(size_t ringSize, unsigned blockSize, unsigned blockTimeoutMs, std::string *error);
+private:
+	int fd;
+	int ifindex;
+	int dlt;
+	u_char *ring;
+	size_t ringLength;
+	unsigned blockSize;
+	unsigned blockCount;
+	unsigned blockIndex;
+	sStat stat;
+};
+
+inline tpacket_block_desc *cTpacketV3::getBlock(int pollTimeoutMs) {
+	tpacket_block_desc *block = (tpacket_block_desc*)(ring + (size_t)blockIndex * blockSize);
+	if(!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+		pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN | POLLERR;
+		pfd.revents = 0;
+		if(poll(&pfd, 1, pollTimeoutMs) <= 0 ||
+		   !(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+			return(NULL);
+		}
+	}
+	return(block);
+}
+
+inline void cTpacketV3::releaseBlock(tpacket_block_desc *block) {
+	__atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+	if(++blockIndex == blockCount) {
+		blockIndex = 0;
+	}
+}
+
+bool packet_socket_set_fanout(int fd, u_int16_t group, std::string *error);
+
+
+class cAfXdp : public cPcapBlockStoreExternalBuffer {
+public:
+	struct sStat {
+		sStat() {
+			packets = 0;
+			rx_dropped = 0;
+			rx_ring_full = 0;
+			fill_ring_empty = 0;
+		}
+		u_int64_t packets;
+		u_int64_t rx_dropped;
+		u_int64_t rx_ring_full;
+		u_int64_t fill_ring_empty;
+	};
+private:
+	struct sRing {
+		sRing() {
+			producer = NULL;
+			consumer = NULL;
+			flags = NULL;
+			descs = NULL;
+			mask = 0;
+			cached = 0;
+			map = NULL;
+			mapLength = 0;
+		}
+		volatile u_int32_t *producer;
+		volatile u_int32_t *consumer;
+		volatile u_int32_t *flags;
+		void *descs;
+		u_int32_t mask;
+		u_int32_t cached;
+		void *map;
+		size_t mapLength;
+	};
+public:
+	cAfXdp();
+	bool open(const char *ifname, unsigned queue, size_t umemSize, unsigned frameSize, unsigned headroom,
+		  bool native, std::string *error);
+	inline unsigned receive(unsigned max, u_int32_t *index, int pollTimeoutMs);
+	inline xdp_desc *getRxDesc(u_int32_t index) {
+		return(&((xdp_desc*)rx.descs)[index & rx.mask]);
+	}
+	inline void releaseRx() {
+		__atomic_store_n(rx.consumer, rx.cached, __ATOMIC_RELEASE);
+	}
+	void releaseFrame(u_int64_t addr);
+	u_char *getUmem() {
+		return(umem);
+	}
+	unsigned getFrameSize() {
+		return(frameSize);
+	}
+	unsigned getFreeFramesPerc() {
+		return(100 - (u_int64_t)framesInUser * 100 / framesCount);
+	}
+	bool getStat(sStat *stat);
+	void ref();
+	void release(pcap_block_store *block);
+	void unref();
+private:
+	~cAfXdp();
+	void close();
+	bool mapRing(sRing *ring, int ringType, unsigned size, xdp_ring_offset *offsets, off_t pgoff, size_t descSize, std::string *error);
+	void unmapRing(sRing *ring);
+	bool attachProgram(bool native, std::string *error);
+	void detachProgram();
+	inline void lock_fill() {
+		while(__sync_lock_test_and_set(&this->_sync_fill, 1));
+	}
+	inline void unlock_fill() {
+		__sync_lock_release(&this->_sync_fill);
+	}
+private:
+	int fd;
+	int ifindex;
+	unsigned queue;
+	u_char *umem;
+	size_t umemLength;
+	unsigned frameSize;
+	unsigned framesCount;
+	volatile int framesInUser;
+	sRing fill;
+	sRing completion;
+	sRing rx;
+	bool programAttached;
+	volatile int refs;
+	volatile int _sync_fill;
+	sStat stat;
+};
+
+inline unsigned cAfXdp::receive(unsigned max, u_int32_t *index, int pollTimeoutMs) {
+	u_int32_t entries = __atomic_load_n(rx.producer, __ATOMIC_ACQUIRE) - rx.cached;
+	if(!entries) {
+		pollfd pfd;
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if(poll(&pfd, 1, pollTimeoutMs) <= 0) {
+			return(0);
+		}
+		entries = __atomic_load_n(rx.producer, __ATOMIC_ACQUIRE) - rx.cached;
+		if(!entries) {
+			return(0);
+		}
+	}
+	if(entries > max) {
+		entries = max;
+	}
+	*index = rx.cached;
+	rx.cached += entries;
+	__sync_add_and_fetch(&framesInUser, entries);
+	stat.packets += entries;
+	return(entries);
+}
+
+
+// eBPF socket filter dropping UDP which is not to/from monitored ports nor to/from ip:port of active calls
+class cKernelPrefilter {
+public:
+	enum eLinkType {
+		_lt_ethernet,
+		_lt_raw,
+		_lt_count
+	};
+	struct sStat {
+		sStat() {
+			endpoints = 0;
+			missing = 0;
+			add_errors = 0;
+		}
+		u_int32_t endpoints;
+		u_int32_t missing;
+		u_int64_t add_errors;
+	};
+private:
+	struct sEndpointKey {
+		u_int32_t addr[4];
+		u_int32_t port;
+		u_int32_t family;
+	};
+	struct sEndpointUpdate {
+		sEndpointKey key;
+		bool add;
+	};
+public:
+	cKernelPrefilter();
+	~cKernelPrefilter();
+	bool init(unsigned maxEndpoints, std::string *error);
+	bool setPort(u_int16_t port);
+	bool attach(int fd, eLinkType linkType, std::string *error);
+	// add / remove only queue the update (called under lock_calls_hash), the map is updated by applyUpdates
+	void add(vmIP ip, vmPort port);
+	void remove(vmIP ip, vmPort port);
+	void applyUpdates();
+	bool isUpdates() {
+		return(updatesCount > 0);
+	}
+	void getStat(sStat *stat);
+	std::string getStatString();
+private:
+	void setKey(sEndpointKey *key, vmIP ip, vmPort port);
+	void queueUpdate(vmIP ip, vmPort port, bool add);
+	void mapAdd(sEndpointKey *key);
+	void mapRemove(sEndpointKey *key);
+	bool setPassAll(bool passAll);
+	int loadProgram(eLinkType linkType, std::string *error);
+private:
+	int portsMapFd;
+	int endpointsMapFd;
+	int progFd[_lt_count];
+	volatile int _sync_prog;
+	std::vector<sEndpointUpdate> updates;
+	volatile unsigned updatesCount;
+	volatile int _sync_updates;
+	volatile int _sync_apply;
+	sStat stat;
+};
+
+extern cKernelPrefilter *kernelPrefilter;
+
+inline void kernel_prefilter_add(vmIP ip, vmPort port) {
+	if(kernelPrefilter) {
+		kernelPrefilter->add(ip, port);
+	}
+}
+
+inline void kernel_prefilter_remove(vmIP ip, vmPort port) {
+	if(kernelPrefilter) {
+		kernelPrefilter->remove(ip, port);
+	}
+}
+
+// called after lock_calls_hash is released - the syscalls of map updates are not made under the lock
+inline void kernel_prefilter_apply() {
+	if(kernelPrefilter && kernelPrefilter->isUpdates()) {
+		kernelPrefilter->applyUpdates();
+	}
+}
+
+#else
+
+class cTpacketV3;
+class cAfXdp;
+
+inline void kernel_prefilter_add(vmIP /*ip*/, vmPort /*port*/) {}
+inline void kernel_prefilter_remove(vmIP /*ip*/, vmPort /*port*/) {}
+inline void kernel_prefilter_apply() {}
+
+#endif //FREEBSD
+
+
+#endif //PACKET_SOCKET_H
@@ -20,6 +20,9 @@
 #ifdef HAVE_LIBLZ4
 #include <lz4.h>
 #endif //HAVE_LIBLZ4
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif //HAVE_LIBZSTD
 
 #include "pcap_queue_block.h"
 #include "pcap_queue.h"
@@ -38,6 +41,7 @@
 #include "server.h"
 #include "ssl_dssl.h"
 #include "tcmalloc_hugetables.h"
+#include "zstd_dict.h"
 #include "heap_chunk.h"
 
 #ifndef FREEBSD
@@ -185,6 +189,12 @@ int opt_pcap_queue_compress				= -1;
 pcap_block_store::compress_method opt_pcap_queue_compress_method 
 							= pcap_block_store::snappy;
 int opt_pcap_queue_compress_ratio = 100;
+int opt_pcap_queue_compress_threads = 0;
+bool opt_pcap_queue_disk_async_io = false;
+int opt_pcap_queue_disk_async_inflight = 16;
+int opt_pcap_queue_disk_async_readahead = 4;
+int opt_pcap_queue_compress_zstd_level = 1;
+char opt_pcap_queue_compress_zstd_dict[1024];
 string opt_pcap_queue_disk_folder;
 ip_port opt_pcap_queue_send_to_ip_port;
 ip_port opt_pcap_queue_receive_from_ip_port;
@@ -202,6 +212,15 @@ int opt_pcap_queue_dequeu_method			= 2;
 int opt_pcap_queue_use_blocks				= 0;
 int opt_pcap_queue_use_blocks_auto_enable		= 0;
 int opt_pcap_queue_use_blocks_read_check		= 1;
+int opt_pcap_queue_iface_tpacket_v3			= 0;
+int opt_pcap_queue_iface_tpacket_v3_block_size		= 1024; // kB
+int opt_pcap_queue_iface_tpacket_v3_block_timeout	= 10; // ms
+int opt_pcap_queue_iface_fanout				= 0;
+int opt_pcap_queue_iface_af_xdp				= 0;
+int opt_pcap_queue_iface_af_xdp_native			= 0;
+int opt_pcap_queue_iface_af_xdp_umem_size		= 0; // MB
+int opt_pcap_queue_iface_kernel_prefilter		= 0;
+int opt_pcap_queue_iface_kernel_prefilter_max_endpoints	= 200000;
 int opt_pcap_dispatch					= 0;
 int opt_pcap_queue_suppress_t1_thread			= 0;
 int opt_pcap_queue_block_timeout			= 0;
@@ -407,6 +426,63 @@ bool pcap_block_store::get_add_hp_pointers(pcap_pkthdr_plus2 **header, u_char **
 	return(true);
 }
 
+void pcap_block_store::set_external(u_char *block, cPcapBlockStoreExternalBuffer *external) {
+	this->block = block;
+	this->external = external;
+	this->external->ref();
+}
+
+bool pcap_block_store::add_h_external(uint32_t offset, unsigned caplen) {
+	size_t headerSize = hm == plus2 ? sizeof(pcap_pkthdr_plus2) : sizeof(pcap_pkthdr_plus);
+	if(this->full ||
+	   this->size + headerSize + caplen > opt_pcap_queue_block_max_size) {
+		this->full = true;
+		return(false);
+	}
+	if(!this->offsets_size) {
+		this->offsets_size = _opt_pcap_queue_block_offset_init_size;
+		this->offsets = new FILE_LINE(0) uint32_t[this->offsets_size];
+	}
+	if(this->count == this->offsets_size) {
+		uint32_t *offsets_old = this->offsets;
+		size_t offsets_size_old = this->offsets_size;
+		this->offsets_size += _opt_pcap_queue_block_offset_inc_size;
+		this->offsets = new FILE_LINE(0) uint32_t[this->offsets_size];
+		memcpy_heapsafe(this->offsets, offsets_old, sizeof(uint32_t) * offsets_size_old,
+				__FILE__, __LINE__);
+		delete [] offsets_old;
+	}
+	this->offsets[this->count] = offset;
+	this->size += headerSize + caplen;
+	this->size_packets += caplen;
+	++this->count;
+	return(true);
+}
+
+void pcap_block_store::materialize() {
+	if(!this->external) {
+		return;
+	}
+	// copy packets from external buffer (af_xdp umem) to own block and give external buffer back
+	size_t headerSize = hm == plus2 ? sizeof(pcap_pkthdr_plus2) : sizeof(pcap_pkthdr_plus);
+	u_char *block_new = new FILE_LINE(0) u_char[max(this->size, (size_t)1)];
+	uint32_t *offsets_new = new FILE_LINE(0) uint32_t[max(this->offsets_size, (size_t)1)];
+	size_t pos = 0;
+	for(size_t i = 0; i < this->count; i++) {
+		size_t length = headerSize + ((pcap_pkthdr_plus*)(this->block + this->offsets[i]))->get_caplen();
+		memcpy(block_new + pos, this->block + this->offsets[i], length);
+		offsets_new[i] = pos;
+		pos += length;
+	}
+	this->external->release(this);
+	this->external = NULL;
+	if(this->offsets) {
+		delete [] this->offsets;
+	}
+	this->offsets = offsets_new;
+	this->block = block_new;
+}
+
 bool pcap_block_store::isFull_checkTimeout() {
 	if(this->full) {
 		return(true);
@@ -423,6 +499,11 @@ bool pcap_block_store::isTimeout() {
 }
 
 void pcap_block_store::destroy() {
+	if(this->external) {
+		this->external->release(this);
+		this->external = NULL;
+		this->block = NULL;
+	}
 	if(this->offsets) {
 		delete [] this->offsets;
 		this->offsets = NULL;
@@ -461,6 +542,11 @@ bool pcap_block_store::isEmptyRestoreBuffer() {
 }
 
 void pcap_block_store::freeBlock() {
+	if(this->external) {
+		this->external->release(this);
+		this->external = NULL;
+		this->block = NULL;
+	}
 	if(this->block) {
 		delete [] this->block;
 		this->block = NULL;
@@ -468,6 +554,7 @@ void pcap_block_store::freeBlock() {
 }
 
 u_char* pcap_block_store::getSaveBuffer(uint32_t block_counter) {
+	this->materialize();
 	size_t sizeSaveBuffer = this->getSizeSaveBuffer();
 	u_char *saveBuffer = new FILE_LINE(15010) u_char[sizeSaveBuffer];
 	pcap_block_store_header header;
@@ -643,11 +730,27 @@ bool pcap_block_store::compress() {
 		case 9: if(!((__counter++) % 6)) return(true); break;
 		}
 	}
+	this->materialize();
+	if(zstdDictionary.isCollecting() && this->count) {
+		const u_char **samples = new FILE_LINE(0) const u_char*[this->count];
+		u_int32_t *samplesLengths = new FILE_LINE(0) u_int32_t[this->count];
+		for(size_t i = 0; i < this->count; i++) {
+			samples[i] = (u_char*)this->get_packet(i);
+			samplesLengths[i] = this->get_header(i)->get_caplen();
+		}
+		zstdDictionary.addTrainingSamples(samples, samplesLengths, this->count);
+		delete [] samples;
+		delete [] samplesLengths;
+	}
 	switch(opt_pcap_queue_compress_method) {
 	case lz4:
 		#ifdef HAVE_LIBLZ4
 		return(this->compress_lz4());
 		#endif //HAVE_LIBLZ4
+	case zstd:
+		#ifdef HAVE_LIBZSTD
+		return(this->compress_zstd());
+		#endif //HAVE_LIBZSTD
 	case snappy:
 	default:
 		return(this->compress_snappy());
@@ -672,7 +775,7 @@ bool pcap_block_store::compress_snappy() {
 				this->block = (u_char*)realloc(snappyBuff, snappyBuffSize);
 			#endif
 			this->size_compress = snappyBuffSize;
-			sumPacketsSizeCompress[0] += this->size_compress;
+			__sync_fetch_and_add(&sumPacketsSizeCompress[0], this->size_compress);
 			return(true);
 		case SNAPPY_INVALID_INPUT:
 			syslog(LOG_ERR, "packetbuffer: snappy_compress: invalid input");
@@ -704,7 +807,7 @@ bool pcap_block_store::compress_lz4() {
 				__FILE__, __LINE__);
 		delete [] lz4Buff;
 		this->size_compress = lz4_size;
-		sumPacketsSizeCompress[0] += this->size_compress;
+		__sync_fetch_and_add(&sumPacketsSizeCompress[0], this->size_compress);
 		return(true);
 	} else {
 		syslog(LOG_ERR, "packetbuffer: lz4_compress: error");
@@ -714,6 +817,28 @@ bool pcap_block_store::compress_lz4() {
 	return(false);
 }
 
+bool pcap_block_store::compress_zstd() {
+	#ifdef HAVE_LIBZSTD
+	size_t zstdBuffSize = ZSTD_compressBound(this->size);
+	u_char *zstdBuff = new FILE_LINE(0) u_char[zstdBuffSize];
+	size_t zstd_size = zstdDictionary.compress(zstdBuff, zstdBuffSize, this->block, this->size);
+	if(!ZSTD_isError(zstd_size)) {
+		delete [] this->block;
+		this->block = new FILE_LINE(0) u_char[zstd_size];
+		memcpy_heapsafe(this->block, zstdBuff, zstd_size,
+				__FILE__, __LINE__);
+		delete [] zstdBuff;
+		this->size_compress = zstd_size;
+		__sync_fetch_and_add(&sumPacketsSizeCompress[0], this->size_compress);
+		return(true);
+	} else {
+		syslog(LOG_ERR, "packetbuffer: zstd_compress: %s", ZSTD_getErrorName(zstd_size));
+	}
+	delete [] zstdBuff;
+	#endif //HAVE_LIBZSTD
+	return(false);
+}
+
 bool pcap_block_store::uncompress(compress_method method) {
 	if(!this->size_compress) {
 		return(true);
@@ -723,6 +848,10 @@ bool pcap_block_store::uncompress(compress_method method) {
 		#ifdef HAVE_LIBLZ4
 		return(this->uncompress_lz4());
 		#endif //HAVE_LIBLZ4
+	case zstd:
+		#ifdef HAVE_LIBZSTD
+		return(this->uncompress_zstd());
+		#endif //HAVE_LIBZSTD
 	case snappy:
 	default:
 		return(this->uncompress_snappy());
@@ -779,6 +908,28 @@ bool pcap_block_store::uncompress_lz4() {
 	return(false);
 }
 
+bool pcap_block_store::uncompress_zstd() {
+	#ifdef HAVE_LIBZSTD
+	if(!this->size_compress) {
+		return(true);
+	}
+	size_t zstdBuffSize = this->size;
+	u_char *zstdBuff = new FILE_LINE(0) u_char[zstdBuffSize];
+	size_t zstd_size = zstdDictionary.decompress(zstdBuff, zstdBuffSize, this->block, this->size_compress);
+	if(!ZSTD_isError(zstd_size) && zstd_size == this->size) {
+		delete [] this->block;
+		this->block = zstdBuff;
+		this->size_compress = 0;
+		return(true);
+	} else {
+		syslog(LOG_ERR, "packetbuffer: zstd_uncompress: %s", 
+		       ZSTD_isError(zstd_size) ? ZSTD_getErrorName(zstd_size) : "bad size");
+	}
+	delete [] zstdBuff;
+	#endif //HAVE_LIBZSTD
+	return(false);
+}
+
 
 pcap_block_store_queue::pcap_block_store_queue() {
 	extern volatile int terminating;
@@ -799,6 +950,9 @@ pcap_block_store_queue::~pcap_block_store_queue() {
 }
 
 
+pcap_file_store::sIOStat pcap_file_store::ioStat;
+pcap_file_store::sIOStat pcap_file_store::ioStat_last;
+
 pcap_file_store::pcap_file_store(u_int id, const char *folder) {
 	this->id = id;
 	this->folder = folder;
@@ -813,16 +967,26 @@ pcap_file_store::pcap_file_store(u_int id, const char *folder) {
 	this->full = false;
 	this->timestampMS = getTimeMS_rdtsc();
 	this->_sync_flush_file = 0;
+	this->asyncIO = NULL;
+	this->fdPush = -1;
+	this->fdPop = -1;
+	this->readAheadOffset = 0;
 }
 
 pcap_file_store::~pcap_file_store() {
 	this->destroy();
+	if(this->asyncIO) {
+		delete this->asyncIO;
+	}
 }
 
 bool pcap_file_store::push(pcap_block_store *blockStore) {
-	if(!this->fileHandlePush && !this->open(typeHandlePush)) {
+	if(!this->fileHandlePush && this->fdPush < 0 && !this->open(typeHandlePush)) {
 		return(false);
 	}
+	if(this->asyncIO) {
+		return(this->pushAsync(blockStore));
+	}
 	size_t oldFileSize = this->fileSize;
 	size_t sizeSaveBuffer = blockStore->getSizeSaveBuffer();
 	u_char *saveBuffer = blockStore->getSaveBuffer();
@@ -834,10 +998,12 @@ bool pcap_file_store::push(pcap_block_store *blockStore) {
 	if(diffTimeS > 0.1) {
 		syslog(LOG_NOTICE, "packetbuffer: slow write %zdB - %.3lfs", sizeSaveBuffer, diffTimeS);
 	}
+	ioStat.write.add((timeAfterWrite - timeBeforeWrite) / 1000);
 	if(rsltWrite == sizeSaveBuffer) {
 		this->fileSize += rsltWrite;
 	} else {
 		syslog(LOG_ERR, "packetbuffer: write to %s failed", this->getFilePathName().c_str());
+		__sync_fetch_and_add(&ioStat.errors, 1);
 	}
 	this->unlock_sync_flush_file();
 	delete [] saveBuffer;
@@ -845,6 +1011,7 @@ bool pcap_file_store::push(pcap_block_store *blockStore) {
 		blockStore->freeBlock();
 		blockStore->idFileStore = this->id;
 		blockStore->filePosition = oldFileSize;
+		blockStore->fileBlockSize = sizeSaveBuffer;
 		++this->countPush;
 		return(true);
 	}
@@ -857,9 +1024,13 @@ bool pcap_file_store::pop(pcap_block_store *blockStore) {
 		syslog(LOG_ERR, "packetbuffer: invalid file store id");
 		return(false);
 	}
-	if(!this->fileHandlePop && !this->open(typeHandlePop)) {
+	if(!this->fileHandlePop && this->fdPop < 0 && !this->open(typeHandlePop)) {
 		return(false);
 	}
+	if(this->asyncIO) {
+		return(this->popAsync(blockStore));
+	}
+	u_int64_t popBeginUS = getTimeUS();
 	this->lock_sync_flush_file();
 	if(this->fileSizeFlushed <= blockStore->filePosition) {
 		this->fileSizeFlushed = this->fileSize;
@@ -874,16 +1045,21 @@ bool pcap_file_store::pop(pcap_block_store *blockStore) {
 	u_char *readBuff = new FILE_LINE(15020) u_char[readBuffSize];
 	size_t readed;
 	int rsltRestoreChunk = 0;
+	u_int64_t readBeginUS = getTimeUS();
 	while((readed = fread(readBuff, 1, readBuffSize, this->fileHandlePop)) > 0) {
 		rsltRestoreChunk = blockStore->addRestoreChunk(readBuff, readed, NULL, true);
 		if(rsltRestoreChunk != 0) {
 			break;
 		}
 	}
+	u_int64_t readEndUS = getTimeUS();
+	ioStat.read.add(readEndUS - readBeginUS);
+	ioStat.pop.add(readEndUS - popBeginUS);
 	if(rsltRestoreChunk < 0) {
 		syslog(LOG_ERR, "packetbuffer: restore block from %s failed - %s", 
 		       this->getFilePathName().c_str(),
 		       blockStore->addRestoreChunk_getErrorString(rsltRestoreChunk).c_str());
+		__sync_fetch_and_add(&ioStat.errors, 1);
 	}
 	delete [] readBuff;
 	++this->countPop;
@@ -895,13 +1071,34 @@ bool pcap_file_store::pop(pcap_block_store *blockStore) {
 }
 
 bool pcap_file_store::open(eTypeHandle typeHandle) {
-	if((!(typeHandle & typeHandlePush) || this->fileHandlePush) &&
-	   (!(typeHandle & typeHandlePop) || this->fileHandlePop)) {
+	if((!(typeHandle & typeHandlePush) || this->fileHandlePush || this->fdPush >= 0) &&
+	   (!(typeHandle & typeHandlePop) || this->fileHandlePop || this->fdPop >= 0)) {
 		return(true);
 	}
 	bool rslt = true;
 	string filePathName = this->getFilePathName();
-	if(typeHandle & typeHandlePush) {
+	if((typeHandle & typeHandlePush) && opt_pcap_queue_disk_async_io && !this->asyncIO) {
+		this->asyncIO = new FILE_LINE(0) cAsyncFileIO;
+		string error;
+		if(!this->asyncIO->init(opt_pcap_queue_disk_async_inflight + opt_pcap_queue_disk_async_readahead, &error)) {
+			static u_int64_t lastTimeLogErr = 0;
+			u_int64_t actTime = getTimeMS();
+			if(actTime - 60000 > lastTimeLogErr) {
+				syslog(LOG_ERR, "packetbuffer: %s - disk buffer uses synchronous I/O", error.c_str());
+				lastTimeLogErr = actTime;
+			}
+			delete this->asyncIO;
+			this->asyncIO = NULL;
+		}
+	}
+	if((typeHandle & typeHandlePush) && this->asyncIO) {
+		remove(filePathName.c_str());
+		this->fdPush = ::open(filePathName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if(this->fdPush < 0) {
+			syslog(LOG_ERR, "packetbuffer: open %s for write failed", filePathName.c_str());
+			rslt = false;
+		}
+	} else if(typeHandle & typeHandlePush) {
 		remove(filePathName.c_str());
 		this->fileHandlePush = fopen(filePathName.c_str(), "wb");
 		if(this->fileHandlePush) {
@@ -923,7 +1120,13 @@ bool pcap_file_store::open(eTypeHandle typeHandle) {
 			rslt = false;
 		}
 	}
-	if(typeHandle & typeHandlePop) {
+	if((typeHandle & typeHandlePop) && this->asyncIO) {
+		this->fdPop = ::open(filePathName.c_str(), O_RDONLY);
+		if(this->fdPop < 0) {
+			syslog(LOG_ERR, "packetbuffer: open %s for read failed", filePathName.c_str());
+			rslt = false;
+		}
+	} else if(typeHandle & typeHandlePop) {
 		this->fileHandlePop = fopen(filePathName.c_str(), "rb");
 		if(this->fileHandlePop) {
 			if(VERBOSE || DEBUG_VERBOSE) {
@@ -948,6 +1151,24 @@ bool pcap_file_store::open(eTypeHandle typeHandle) {
 }
 
 bool pcap_file_store::close(eTypeHandle typeHandle) {
+	if(typeHandle & typeHandlePush &&
+	   this->fdPush >= 0) {
+		this->asyncWaitWrites();
+		this->lock_sync_flush_file();
+		if(this->fdPush >= 0) {
+			::close(this->fdPush);
+			this->fdPush = -1;
+		}
+		this->unlock_sync_flush_file();
+	}
+	if(typeHandle & typeHandlePop &&
+	   this->fdPop >= 0) {
+		while(this->asyncReads.size()) {
+			this->asyncFreeRead();
+		}
+		::close(this->fdPop);
+		this->fdPop = -1;
+	}
 	if(typeHandle & typeHandlePush &&
 	   this->fileHandlePush != NULL) {
 		this->lock_sync_flush_file();
@@ -976,6 +1197,248 @@ bool pcap_file_store::destroy() {
 	return(true);
 }
 
+bool pcap_file_store::pushAsync(pcap_block_store *blockStore) {
+	size_t sizeSaveBuffer = blockStore->getSizeSaveBuffer();
+	u_char *saveBuffer = blockStore->getSaveBuffer();
+	sAsyncRequest *request = new FILE_LINE(0) sAsyncRequest;
+	request->buffer = saveBuffer;
+	request->length = sizeSaveBuffer;
+	request->written = 0;
+	unsigned int usleepCounter = 0;
+	this->lock_sync_flush_file();
+	while(this->fdPush >= 0 &&
+	      this->asyncWrites.size() >= (unsigned)opt_pcap_queue_disk_async_inflight) {
+		this->asyncReap();
+		if(this->asyncWrites.size() < (unsigned)opt_pcap_queue_disk_async_inflight) {
+			break;
+		}
+		this->unlock_sync_flush_file();
+		USLEEP_C(50, usleepCounter++);
+		this->lock_sync_flush_file();
+	}
+	request->offset = this->fileSize;
+	bool rslt = this->fdPush >= 0 &&
+		    this->asyncIO->submitWrite(this->fdPush, saveBuffer, sizeSaveBuffer, request->offset, request);
+	if(rslt) {
+		this->asyncWrites.push_back(request);
+		this->fileSize += sizeSaveBuffer;
+	}
+	this->unlock_sync_flush_file();
+	if(!rslt) {
+		syslog(LOG_ERR, "packetbuffer: submit write to %s failed", this->getFilePathName().c_str());
+		__sync_fetch_and_add(&ioStat.errors, 1);
+		delete [] saveBuffer;
+		delete request;
+		return(false);
+	}
+	blockStore->freeBlock();
+	blockStore->idFileStore = this->id;
+	blockStore->filePosition = request->offset;
+	blockStore->fileBlockSize = sizeSaveBuffer;
+	++this->countPush;
+	return(true);
+}
+
+bool pcap_file_store::popAsync(pcap_block_store *blockStore) {
+	u_int64_t popBeginUS = getTimeUS();
+	u_int64_t blockBegin = blockStore->filePosition;
+	u_int64_t blockEnd = blockBegin + blockStore->fileBlockSize;
+	u_int64_t writtenSize;
+	unsigned int usleepCounter = 0;
+	while(true) {
+		this->lock_sync_flush_file();
+		this->asyncReap();
+		writtenSize = this->asyncWrittenSize();
+		this->unlock_sync_flush_file();
+		if(writtenSize >= blockEnd || is_terminating()) {
+			break;
+		}
+		USLEEP_C(50, usleepCounter++);
+	}
+	if(writtenSize < blockEnd) {
+		return(false);
+	}
+	this->lock_sync_flush_file();
+	bool writeFailed = this->asyncWritesFailed.erase(blockBegin) > 0;
+	this->unlock_sync_flush_file();
+	if(writeFailed) {
+		syslog(LOG_ERR, "packetbuffer: skip block at %" int_64_format_prefix "lu in %s - write failed", 
+		       blockBegin, this->getFilePathName().c_str());
+		++this->countPop;
+		if(this->countPop == this->countPush && this->isFull()) {
+			this->close(typeHandlePop);
+		}
+		return(false);
+	}
+	while(this->asyncReads.size() &&
+	      (this->asyncReads.front()->offset + this->asyncReads.front()->length <= blockBegin ||
+	       this->asyncReads.front()->offset > blockBegin)) {
+		this->asyncFreeRead();
+	}
+	if(!this->asyncReads.size()) {
+		this->readAheadOffset = blockBegin;
+	}
+	blockStore->destroyRestoreBuffer();
+	int rsltRestoreChunk = 0;
+	u_int64_t position = blockBegin;
+	while(position < blockEnd) {
+		this->asyncReadAhead(writtenSize);
+		if(!this->asyncReads.size()) {
+			rsltRestoreChunk = -1;
+			break;
+		}
+		sAsyncRequest *request = this->asyncReads.front();
+		this->asyncWaitRequest(request);
+		if(request->result != (int)request->length) {
+			syslog(LOG_ERR, "packetbuffer: read from %s failed", this->getFilePathName().c_str());
+			rsltRestoreChunk = -1;
+			break;
+		}
+		u_int64_t end = min(request->offset + request->length, blockEnd);
+		rsltRestoreChunk = blockStore->addRestoreChunk(request->buffer + (position - request->offset), end - position, NULL, true);
+		position = end;
+		if(position == request->offset + request->length) {
+			this->asyncFreeRead();
+		}
+		if(rsltRestoreChunk != 0) {
+			break;
+		}
+	}
+	ioStat.pop.add(getTimeUS() - popBeginUS);
+	if(rsltRestoreChunk < 0) {
+		syslog(LOG_ERR, "packetbuffer: restore block from %s failed - %s", 
+		       this->getFilePathName().c_str(),
+		       blockStore->addRestoreChunk_getErrorString(rsltRestoreChunk).c_str());
+		__sync_fetch_and_add(&ioStat.errors, 1);
+	}
+	++this->countPop;
+	blockStore->destroyRestoreBuffer();
+	if(this->countPop == this->countPush && this->isFull()) {
+		this->close(typeHandlePop);
+	}
+	return(rsltRestoreChunk > 0);
+}
+
+void pcap_file_store::asyncReap() {
+	this->asyncIO->reap();
+	while(this->asyncWrites.size() && this->asyncWrites.front()->done) {
+		sAsyncRequest *request = this->asyncWrites.front();
+		if(request->result > 0 && request->written + request->result < request->length) {
+			// short write - the rest is submitted again, the request stays at the head so the written size does not pass it
+			request->written += request->result;
+			request->done = false;
+			request->result = 0;
+			if(this->fdPush >= 0 &&
+			   this->asyncIO->submitWrite(this->fdPush, request->buffer + request->written, request->length - request->written,
+						      request->offset + request->written, request)) {
+				break;
+			}
+			request->result = -EIO;
+		}
+		this->asyncWrites.pop_front();
+		ioStat.write.add(request->completeTimeUS - request->submitTimeUS);
+		if(request->result <= 0) {
+			syslog(LOG_ERR, "packetbuffer: write to %s failed - %s", 
+			       this->getFilePathName().c_str(),
+			       request->result < 0 ? strerror(-request->result) : "incomplete");
+			__sync_fetch_and_add(&ioStat.errors, 1);
+			// pop skips the block instead of restoring it from an incomplete range
+			this->asyncWritesFailed.insert(request->offset);
+		}
+		delete [] request->buffer;
+		delete request;
+	}
+}
+
+void pcap_file_store::asyncReadAhead(u_int64_t readLimit) {
+	while(this->asyncReads.size() < (unsigned)opt_pcap_queue_disk_async_readahead &&
+	      this->readAheadOffset < readLimit) {
+		sAsyncRequest *request = new FILE_LINE(0) sAsyncRequest;
+		request->offset = this->readAheadOffset;
+		request->length = min(readLimit - this->readAheadOffset, (u_int64_t)FILE_BUFFER_SIZE);
+		request->buffer = new FILE_LINE(0) u_char[request->length];
+		this->lock_sync_flush_file();
+		bool rslt = this->asyncIO->submitRead(this->fdPop, request->buffer, request->length, request->offset, request);
+		this->unlock_sync_flush_file();
+		if(!rslt) {
+			delete [] request->buffer;
+			delete request;
+			break;
+		}
+		this->asyncReads.push_back(request);
+		this->readAheadOffset += request->length;
+	}
+}
+
+void pcap_file_store::asyncWaitRequest(sAsyncRequest *request) {
+	unsigned int usleepCounter = 0;
+	while(!request->done) {
+		this->lock_sync_flush_file();
+		this->asyncReap();
+		this->unlock_sync_flush_file();
+		if(request->done) {
+			break;
+		}
+		USLEEP_C(20, usleepCounter++);
+	}
+	if(request->submitTimeUS && request->completeTimeUS) {
+		ioStat.read.add(request->completeTimeUS - request->submitTimeUS);
+		request->submitTimeUS = 0;
+	}
+}
+
+void pcap_file_store::asyncFreeRead() {
+	sAsyncRequest *request = this->asyncReads.front();
+	// the kernel may still write to the buffer
+	this->asyncWaitRequest(request);
+	this->asyncReads.pop_front();
+	delete [] request->buffer;
+	delete request;
+}
+
+void pcap_file_store::asyncWaitWrites() {
+	unsigned int usleepCounter = 0;
+	while(true) {
+		this->lock_sync_flush_file();
+		this->asyncReap();
+		bool empty = !this->asyncWrites.size();
+		this->unlock_sync_flush_file();
+		if(empty) {
+			break;
+		}
+		USLEEP_C(50, usleepCounter++);
+	}
+}
+
+string pcap_file_store::getIOStatString() {
+	ostringstream outStr;
+	outStr << fixed << setprecision(2);
+	sLatencyStat *stat[] = { &ioStat.write, &ioStat.read, &ioStat.pop };
+	sLatencyStat *stat_last[] = { &ioStat_last.write, &ioStat_last.read, &ioStat_last.pop };
+	const char *name[] = { "write", "read", "pop" };
+	bool empty = true;
+	for(unsigned i = 0; i < 3; i++) {
+		u_int64_t count = stat[i]->count;
+		u_int64_t sumUS = stat[i]->sumUS;
+		u_int64_t maxUS = stat[i]->maxUS;
+		stat[i]->maxUS = 0;
+		if(count > stat_last[i]->count) {
+			outStr << (empty ? "" : "  ") << name[i] << " "
+			       << (double)(sumUS - stat_last[i]->sumUS) / (count - stat_last[i]->count) / 1000 << "/"
+			       << (double)maxUS / 1000 << "ms";
+			empty = false;
+		}
+		stat_last[i]->count = count;
+		stat_last[i]->sumUS = sumUS;
+	}
+	if(ioStat.errors > ioStat_last.errors) {
+		outStr << (empty ? "" : "  ") << "errors " << (ioStat.errors - ioStat_last.errors);
+		ioStat_last.errors = ioStat.errors;
+		empty = false;
+	}
+	return(outStr.str());
+}
+
 string pcap_file_store::getFilePathName() {
 	char filePathName[this->folder.length() + 100];
 	sprintf(filePathName, TEST_DEBUG_PARAMS ? "%s/pcap_store_mx_%010u" : "%s/pcap_store_%010u", this->folder.c_str(), this->id);
@@ -1193,6 +1656,151 @@ uint64_t pcap_store_queue::getFileStoreUseSize(bool lock) {
 	return(size);
 }
 
+cPcapBlockCompressPool::cPcapBlockCompressPool(unsigned threadsCount) {
+	this->threadsCount = threadsCount;
+	this->workers = new FILE_LINE(0) sWorker[threadsCount];
+	memset(this->workers, 0, sizeof(sWorker) * threadsCount);
+	for(unsigned i = 0; i < threadsCount; i++) {
+		this->workers[i].pool = this;
+		this->workers[i].index = i;
+	}
+	this->slotsCount = threadsCount * 2;
+	this->slots = new FILE_LINE(0) sSlot[this->slotsCount];
+	memset(this->slots, 0, sizeof(sSlot) * this->slotsCount);
+	this->headIndex = 0;
+	this->addIndex = 0;
+	this->takeIndex = 0;
+	this->terminating = false;
+	this->addCounter = 0;
+	this->doneCounter = 0;
+}
+
+cPcapBlockCompressPool::~cPcapBlockCompressPool() {
+	this->terminate();
+	for(; this->headIndex < this->addIndex; this->headIndex++) {
+		delete this->slots[this->headIndex % this->slotsCount].block;
+	}
+	delete [] this->slots;
+	delete [] this->workers;
+}
+
+void cPcapBlockCompressPool::start() {
+	for(unsigned i = 0; i < this->threadsCount; i++) {
+		vm_pthread_create(("pb - compress " + intToString(i)).c_str(),
+				  &this->workers[i].thread, NULL, _workerThreadFunction, &this->workers[i], __FILE__, __LINE__);
+	}
+}
+
+void cPcapBlockCompressPool::terminate() {
+	if(this->terminating) {
+		return;
+	}
+	this->terminating = true;
+	__sync_add_and_fetch(&this->addCounter, 1);
+	this->waitAdd.notify(&this->addCounter);
+	for(unsigned i = 0; i < this->threadsCount; i++) {
+		if(this->workers[i].thread) {
+			pthread_join(this->workers[i].thread, NULL);
+			this->workers[i].thread = 0;
+		}
+	}
+}
+
+void cPcapBlockCompressPool::add(pcap_block_store *block, size_t blockSize, size_t blockSizePackets) {
+	sSlot *slot = &this->slots[this->addIndex % this->slotsCount];
+	slot->block = block;
+	slot->blockSize = blockSize;
+	slot->blockSizePackets = blockSizePackets;
+	slot->state = _slot_wait;
+	__sync_synchronize();
+	++this->addIndex;
+	__sync_add_and_fetch(&this->addCounter, 1);
+	this->waitAdd.notify(&this->addCounter);
+}
+
+void cPcapBlockCompressPool::waitHead(unsigned int *spinCounter, unsigned int timeoutUs) {
+	int doneCounter = this->doneCounter;
+	__sync_synchronize();
+	if(this->getHead()) {
+		return;
+	}
+	this->waitDone.wait(&this->doneCounter, doneCounter, spinCounter, timeoutUs);
+}
+
+string cPcapBlockCompressPool::getStatString() {
+	ostringstream outStr;
+	outStr << fixed << "tcomp[";
+	u_int64_t actTimeMS = getTimeMS_rdtsc();
+	for(unsigned i = 0; i < this->threadsCount; i++) {
+		sWorker *worker = &this->workers[i];
+		if(i) {
+			outStr << "|";
+		}
+		u_int64_t sizeIn = worker->sizeIn;
+		u_int64_t sizeOut = worker->sizeOut;
+		if(worker->statTimeMS_last && actTimeMS > worker->statTimeMS_last) {
+			double period_s = (actTimeMS - worker->statTimeMS_last) / 1000.;
+			outStr << setprecision(1) << (sizeIn - worker->sizeIn_last) / period_s / (1024 * 1024) << "MB/s";
+			if(sizeIn > worker->sizeIn_last) {
+				outStr << ":" << setprecision(0) << 100. * (sizeOut - worker->sizeOut_last) / (sizeIn - worker->sizeIn_last) << "%";
+			}
+		} else {
+			outStr << "-";
+		}
+		worker->sizeIn_last = sizeIn;
+		worker->sizeOut_last = sizeOut;
+		worker->statTimeMS_last = actTimeMS;
+		if(worker->threadId) {
+			if(worker->threadPstatData[0].cpu_total_time) {
+				worker->threadPstatData[1] = worker->threadPstatData[0];
+			}
+			pstat_get_data(worker->threadId, worker->threadPstatData);
+			if(worker->threadPstatData[0].cpu_total_time && worker->threadPstatData[1].cpu_total_time) {
+				double ucpu_usage, scpu_usage;
+				pstat_calc_cpu_usage_pct(
+					&worker->threadPstatData[0], &worker->threadPstatData[1],
+					&ucpu_usage, &scpu_usage);
+				outStr << "/" << setprecision(1) << ucpu_usage + scpu_usage << "%";
+			}
+		}
+	}
+	outStr << "]";
+	return(outStr.str());
+}
+
+void cPcapBlockCompressPool::workerThreadFunction(sWorker *worker) {
+	worker->threadId = get_unix_tid();
+	syslog(LOG_NOTICE, "start thread t1_compress/%i", worker->threadId);
+	unsigned int spinCounter = 0;
+	while(!this->terminating) {
+		// the counter is read before the index - add after this point changes it and wakes up the wait
+		int addCounter = this->addCounter;
+		__sync_synchronize();
+		u_int64_t takeIndex = this->takeIndex;
+		if(takeIndex < this->addIndex) {
+			if(__sync_bool_compare_and_swap(&this->takeIndex, takeIndex, takeIndex + 1)) {
+				sSlot *slot = &this->slots[takeIndex % this->slotsCount];
+				bool rslt = slot->block->compress();
+				worker->sizeIn += slot->blockSize;
+				worker->sizeOut += slot->block->size_compress ? slot->block->size_compress : slot->blockSize;
+				__sync_synchronize();
+				slot->state = rslt ? _slot_ok : _slot_failed;
+				__sync_add_and_fetch(&this->doneCounter, 1);
+				this->waitDone.notify(&this->doneCounter);
+			}
+			spinCounter = 0;
+		} else {
+			this->waitAdd.wait(&this->addCounter, addCounter, &spinCounter);
+		}
+	}
+}
+
+void *cPcapBlockCompressPool::_workerThreadFunction(void *arg) {
+	sWorker *worker = (sWorker*)arg;
+	worker->pool->workerThreadFunction(worker);
+	return(NULL);
+}
+
 
 PcapQueue::PcapQueue(eTypeQueue typeQueue, const char *nameQueue) {
 	this->typeQueue = typeQueue;
@@ -1905,6 +2513,14 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 				rrd_set_value(RRD_VALUE_tCPU_t0, t0cpu);
 			}
 		}
+		#ifndef FREEBSD
+		if(kernelPrefilter) {
+			outStrStat << kernelPrefilter->getStatString() << " ";
+		}
+		#endif
+		if(opt_dup_check) {
+			outStrStat << cDedupTable::getStatString() << " ";
+		}
 		static int countOccurencesForWarning = 0;
 		if((sumMaxReadThreads / countThreadsSumMaxReadThreads > opt_cpu_limit_warning_t0 || t0cpu > opt_cpu_limit_warning_t0) && 
 		   getThreadingMode() < 5 &&
@@ -1934,6 +2550,10 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 			}
 		}
 	}
+	string compressPoolStat = this->getCompressPoolStat();
+	if(compressPoolStat.length()) {
+		outStrStat << compressPoolStat << " ";
+	}
 	if(sverb.log_profiler) {
 		lapTime.push_back(getTimeMS_rdtsc());
 		lapTimeDescr.push_back("t1");
@@ -1971,12 +2591,26 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 				double defrag_cpu = pcapQueueQ_outThread_defrag->getCpuUsagePerc(true);
 				if(defrag_cpu >= 0) {
 					outStrStat << "/defrag:" << setprecision(1) << defrag_cpu;
+					if(sverb.qring_wait) {
+						u_int64_t wakeups, parked_us;
+						pcapQueueQ_outThread_defrag->getQringWaitStat(&wakeups, &parked_us);
+						if(wakeups) {
+							outStrStat << "w" << wakeups << ':' << parked_us / 1000;
+						}
+					}
 				}
 			}
 			if(pcapQueueQ_outThread_dedup) {
 				double dedup_cpu = pcapQueueQ_outThread_dedup->getCpuUsagePerc(true);
 				if(dedup_cpu >= 0) {
 					outStrStat << "/dedup:" << setprecision(1) << dedup_cpu;
+					if(sverb.qring_wait) {
+						u_int64_t wakeups, parked_us;
+						pcapQueueQ_outThread_dedup->getQringWaitStat(&wakeups, &parked_us);
+						if(wakeups) {
+							outStrStat << "w" << wakeups << ':' << parked_us / 1000;
+						}
+					}
 				}
 			}
 			if(opt_ipaccount) {
@@ -1999,6 +2633,13 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 					outStrStat << "/" 
 						   << preProcessPacket[i]->getShortcatTypeThread()
 						   << setprecision(1) << t2cpu_preprocess_packet_out_thread;
+					if(sverb.qring_wait) {
+						u_int64_t wakeups, parked_us;
+						preProcessPacket[i]->getQringWaitStat(&wakeups, &parked_us);
+						if(wakeups) {
+							outStrStat << "w" << wakeups << ':' << parked_us / 1000;
+						}
+					}
 					if(sverb.qring_stat) {
 						double qringFillingPerc = preProcessPacket[i]->getQringFillingPerc();
 						if(qringFillingPerc > 0) {
@@ -2050,6 +2691,13 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 						outStrStat << "/" 
 							   << preProcessPacketCallX[i]->getShortcatTypeThread()
 							   << setprecision(1) << t2cpu_preprocess_packet_out_thread;
+						if(sverb.qring_wait) {
+							u_int64_t wakeups, parked_us;
+							preProcessPacketCallX[i]->getQringWaitStat(&wakeups, &parked_us);
+							if(wakeups) {
+								outStrStat << "w" << wakeups << ':' << parked_us / 1000;
+							}
+						}
 						if(sverb.qring_stat) {
 							double qringFillingPerc = preProcessPacketCallX[i]->getQringFillingPerc();
 							if(qringFillingPerc > 0) {
@@ -2079,6 +2727,13 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 						if(t2cpu_process_rtp_packet_out_thread >= 0) {
 							outStrStat << "/" << (i == 0 ? "rm:" : "rh:")
 								   << setprecision(1) << t2cpu_process_rtp_packet_out_thread;
+							if(i == 0 && sverb.qring_wait) {
+								u_int64_t wakeups, parked_us;
+								processRtpPacketHash->getQringWaitStat(&wakeups, &parked_us);
+								if(wakeups) {
+									outStrStat << "w" << wakeups << ':' << parked_us / 1000;
+								}
+							}
 							if(i == 0 && sverb.qring_stat) {
 								double qringFillingPerc = processRtpPacketHash->getQringFillingPerc();
 								if(qringFillingPerc > 0) {
@@ -2105,6 +2760,13 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 						double t2cpu_process_rtp_packet_out_thread = processRtpPacketDistribute[i]->getCpuUsagePerc(true,0, &percFullQring);
 						if(t2cpu_process_rtp_packet_out_thread >= 0) {
 							outStrStat << "/" << "rd:" << setprecision(1) << t2cpu_process_rtp_packet_out_thread;
+							if(sverb.qring_wait) {
+								u_int64_t wakeups, parked_us;
+								processRtpPacketDistribute[i]->getQringWaitStat(&wakeups, &parked_us);
+								if(wakeups) {
+									outStrStat << "w" << wakeups << ':' << parked_us / 1000;
+								}
+							}
 							if(sverb.qring_stat) {
 								double qringFillingPerc = processRtpPacketDistribute[i]->getQringFillingPerc();
 								if(qringFillingPerc > 0) {
@@ -2174,6 +2836,9 @@ void PcapQueue::pcapStat(int statPeriod, bool statCalls) {
 				outStrStat << tRTPcpuMax << "m/";
 			}
 			outStrStat << num_threads_active << "t] ";
+			if(jitterbufferDeferredPool) {
+				outStrStat << jitterbufferDeferredPool->getStatString() << " ";
+			}
 			if(tRTPcpu / num_threads_active > opt_cpu_limit_new_thread ||
 			   (heapPerc > 10 && tRTPcpuMax >= 98)) {
 				for(int i = 0; i < (calls_counter > 1000 || heapPerc > 10 ? 3 : 1); i++) {
@@ -2777,6 +3442,12 @@ PcapQueue_readFromInterface_base::PcapQueue_readFromInterface_base(const char *i
 	this->interfaceMask = 0;
 	this->pcapHandle = NULL;
 	this->pcapHandleIndex = 0;
+	this->tpacket = NULL;
+	this->useTpacketV3 = false;
+	this->afxdp = NULL;
+	this->useAfXdp = false;
+	this->fanoutGroup = 0;
+	this->fanoutMember = 0;
 	this->pcapEnd = false;
 	memset(&this->filterData, 0, sizeof(this->filterData));
 	this->filterDataUse = false;
@@ -2821,6 +3492,14 @@ PcapQueue_readFromInterface_base::~PcapQueue_readFromInterface_base() {
 		pcap_close(this->pcapHandle);
 		syslog(LOG_NOTICE, "packetbuffer terminating: pcap_close pcapHandle (%s)", interfaceName.c_str());
 	}
+	#ifndef FREEBSD
+	if(this->tpacket) {
+		delete this->tpacket;
+	}
+	if(this->afxdp) {
+		this->afxdp->unref();
+	}
+	#endif
 	if(this->pcapDumpHandle) {
 		pcap_dump_close(this->pcapDumpHandle);
 		syslog(LOG_NOTICE, "packetbuffer terminating: pcap_close pcapDumpHandle (%s)", interfaceName.c_str());
@@ -2834,6 +3513,60 @@ void PcapQueue_readFromInterface_base::setInterfaceName(const char *interfaceNam
 	this->interfaceName = interfaceName;
 }
 
+void PcapQueue_readFromInterface_base::setFanout(u_int16_t fanoutGroup, int fanoutMember) {
+	this->fanoutGroup = fanoutGroup;
+	this->fanoutMember = fanoutMember;
+}
+
+void PcapQueue_readFromInterface_base::attachKernelPrefilter(int fd, int dlt) {
+#ifndef FREEBSD
+	if(!kernelPrefilter) {
+		return;
+	}
+	cKernelPrefilter::eLinkType linkType;
+	switch(dlt) {
+	case DLT_EN10MB:
+		linkType = cKernelPrefilter::_lt_ethernet;
+		break;
+	case DLT_RAW:
+	case DLT_LINUX_SLL:
+		// cooked and raw packet sockets deliver packets from network header
+		linkType = cKernelPrefilter::_lt_raw;
+		break;
+	default:
+		syslog(LOG_NOTICE, "packetbuffer - %s: kernel prefilter is not supported for dlt %i", this->getInterfaceName().c_str(), dlt);
+		return;
+	}
+	string error;
+	if(kernelPrefilter->attach(fd, linkType, &error)) {
+		if(VERBOSE) {
+			syslog(LOG_NOTICE, "packetbuffer - %s: kernel prefilter attached", this->getInterfaceName().c_str());
+		}
+	} else {
+		syslog(LOG_ERR, "packetbuffer - %s: kernel prefilter - %s", this->getInterfaceName().c_str(), error.c_str());
+	}
+#endif
+}
+
+bool PcapQueue_readFromInterface_base::joinFanout(int fd, string *error) {
+#ifndef FREEBSD
+	if(!this->fanoutGroup) {
+		return(true);
+	}
+	string fanoutError;
+	if(!packet_socket_set_fanout(fd, this->fanoutGroup, &fanoutError)) {
+		*error = "packetbuffer - " + this->getInterfaceName() + ": " + fanoutError;
+		return(false);
+	}
+	if(VERBOSE) {
+		syslog(LOG_NOTICE, "packetbuffer - %s: joined fanout group %u", this->getInterfaceName().c_str(), this->fanoutGroup);
+	}
+	return(true);
+#else
+	return(true);
+#endif
+}
+
 bool PcapQueue_readFromInterface_base::startCapture(string *error) {
 	*error = "";
 	static volatile int _sync_start_capture = 0;
@@ -2876,6 +3609,15 @@ bool PcapQueue_readFromInterface_base::startCapture(string *error) {
 		__sync_lock_release(&_sync_start_capture);
 		return(true);
 	}
+	#ifndef FREEBSD
+	if(this->useTpacketV3 || this->useAfXdp) {
+		bool rslt = this->useAfXdp ?
+			     this->startCapture_afXdp(error) :
+			     this->startCapture_tpacketV3(error);
+		__sync_lock_release(&_sync_start_capture);
+		return(rslt);
+	}
+	#endif
 	if(VERBOSE) {
 		syslog(LOG_NOTICE, "packetbuffer - %s: capturing", this->getInterfaceName().c_str());
 	}
@@ -2917,6 +3659,13 @@ bool PcapQueue_readFromInterface_base::startCapture(string *error) {
 		}
 		goto failed;
 	}
+	if(this->fanoutGroup) {
+		string fanoutError;
+		if(!this->joinFanout(pcap_fileno(this->pcapHandle), &fanoutError)) {
+			snprintf(errorstr, sizeof(errorstr), "%s", fanoutError.c_str());
+			goto failed;
+		}
+	}
 	if(rssBeforeActivate) {
 		for(int i = 0; i < 50; i++) {
 			USLEEP(100);
@@ -2981,6 +3730,7 @@ bool PcapQueue_readFromInterface_base::startCapture(string *error) {
 	}
 	global_pcap_dlink = this->pcapLinklayerHeaderType;
 //	syslog(LOG_NOTICE, "DLT - %s: %i", this->getInterfaceName().c_str(), this->pcapLinklayerHeaderType);
+	this->attachKernelPrefilter(pcap_fileno(this->pcapHandle), this->pcapLinklayerHeaderType);
 	if(opt_pcapdump) {
 		char pname[2048];
 		snprintf(pname, sizeof(pname), "%s/dump-%s-%u.pcap", 
@@ -2997,6 +3747,161 @@ failed:
 	return(false);
 }
 
+bool PcapQueue_readFromInterface_base::startCapture_tpacketV3(string *error) {
+#ifndef FREEBSD
+	char errorstr[4096];
+	string tpacketError;
+	if(VERBOSE) {
+		syslog(LOG_NOTICE, "packetbuffer - %s: capturing (TPACKET_V3)", this->getInterfaceName().c_str());
+	}
+	this->tpacket = new FILE_LINE(0) cTpacketV3;
+	if(!this->tpacket->open(this->interfaceName.c_str(), this->pcap_snaplen, this->pcap_promisc,
+				this->pcap_buffer_size, opt_pcap_queue_iface_tpacket_v3_block_size * 1024, opt_pcap_queue_iface_tpacket_v3_block_timeout,
+				&tpacketError)) {
+		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: TPACKET_V3 error: %s", this->getInterfaceName().c_str(), tpacketError.c_str());
+		cLogSensor::log(cLogSensor::error, errorstr);
+		goto failed;
+	}
+	if(this->fanoutGroup) {
+		string fanoutError;
+		if(!this->joinFanout(this->tpacket->getFd(), &fanoutError)) {
+			snprintf(errorstr, sizeof(errorstr), "%s", fanoutError.c_str());
+			goto failed;
+		}
+	}
+	all_ringbuffers_size += this->pcap_buffer_size;
+	// dead handle only carries dlt/snaplen for register_pcap_handle, bpf compile and pcap dump
+	this->pcapLinklayerHeaderType = this->tpacket->getDlt();
+	if((this->pcapHandle = pcap_open_dead(this->pcapLinklayerHeaderType, this->pcap_snaplen)) == NULL) {
+		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_open_dead failed", this->getInterfaceName().c_str()); 
+		goto failed;
+	}
+	this->pcapHandleIndex = register_pcap_handle(this->pcapHandle);
+	global_pcap_handle = this->pcapHandle;
+	global_pcap_handle_index = this->pcapHandleIndex;
+	global_pcap_dlink = this->pcapLinklayerHeaderType;
+	if(opt_mirrorip) {
+		if(opt_mirrorip_dst[0] == '\0') {
+			syslog(LOG_ERR, "packetbuffer - %s: mirroring packets was disabled because mirroripdst is not set", this->getInterfaceName().c_str());
+			opt_mirrorip = 0;
+		} else if(!mirrorip) {
+			syslog(LOG_NOTICE, "packetbuffer - %s: starting mirroring [%s]->[%s]", opt_mirrorip_src, opt_mirrorip_dst, this->getInterfaceName().c_str());
+			mirrorip = new FILE_LINE(0) MirrorIP(opt_mirrorip_src, opt_mirrorip_dst);
+		}
+	}
+	if(*user_filter != '\0') {
+		char errbuf[PCAP_ERRBUF_SIZE];
+		if(pcap_lookupnet(this->interfaceName.c_str(), &this->interfaceNet, &this->interfaceMask, errbuf) == -1) {
+			this->interfaceMask = PCAP_NETMASK_UNKNOWN;
+		}
+		struct bpf_program fp;
+		char user_filter_err[2048];
+		snprintf(user_filter_err, sizeof(user_filter_err), "%.2000s%s", user_filter, strlen(user_filter) > 2000 ? "..." : "");
+		if(pcap_compile(this->pcapHandle, &fp, user_filter, 0, this->interfaceMask) == -1) {
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: can not parse filter %s: %s", this->getInterfaceName().c_str(), user_filter_err, pcap_geterr(this->pcapHandle));
+			goto failed;
+		}
+		if(!this->tpacket->setFilter(&fp, &tpacketError)) {
+			pcap_freecode(&fp);
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: can not install filter %s: %s", this->getInterfaceName().c_str(), user_filter_err, tpacketError.c_str());
+			goto failed;
+		}
+		pcap_freecode(&fp);
+	}
+	this->attachKernelPrefilter(this->tpacket->getFd(), this->pcapLinklayerHeaderType);
+	if(opt_pcapdump) {
+		char pname[2048];
+		snprintf(pname, sizeof(pname), "%s/dump-%s-%u.pcap", 
+			 getPcapdumpDir(),
+			 this->interfaceName.c_str(), (unsigned int)time(NULL));
+		this->pcapDumpHandle = pcap_dump_open(this->pcapHandle, pname);
+	}
+	return(true);
+failed:
+	if(opt_fork) {
+		daemonizeOutput(errorstr);
+	}
+	syslog(LOG_ERR, "%s", errorstr);
+	*error = errorstr;
+	return(false);
+#else
+	*error = "TPACKET_V3 is not supported on this platform";
+	return(false);
+#endif
+}
+
+bool PcapQueue_readFromInterface_base::startCapture_afXdp(string *error) {
+#ifndef FREEBSD
+	char errorstr[4096];
+	string afxdpError;
+	// with fanout the members are bound to rx queues 0..N-1
+	unsigned queue = this->fanoutGroup ? this->fanoutMember : 0;
+	if(VERBOSE) {
+		syslog(LOG_NOTICE, "packetbuffer - %s: capturing (AF_XDP queue %u, %s mode)", this->getInterfaceName().c_str(), 
+		       queue, opt_pcap_queue_iface_af_xdp_native ? "native" : "generic");
+	}
+	size_t umemSize = opt_pcap_queue_iface_af_xdp_umem_size > 0 ?
+			   (size_t)opt_pcap_queue_iface_af_xdp_umem_size * 1024 * 1024 :
+			   (size_t)this->pcap_buffer_size;
+	this->afxdp = new FILE_LINE(0) cAfXdp;
+	if(!this->afxdp->open(this->interfaceName.c_str(), queue, umemSize, 4096, (sizeof(pcap_pkthdr_plus2) + 7) & ~7,
+			      opt_pcap_queue_iface_af_xdp_native, &afxdpError)) {
+		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: AF_XDP error: %s", this->getInterfaceName().c_str(), afxdpError.c_str());
+		cLogSensor::log(cLogSensor::error, errorstr);
+		this->afxdp->unref();
+		this->afxdp = NULL;
+		goto failed;
+	}
+	all_ringbuffers_size += umemSize;
+	this->pcapLinklayerHeaderType = DLT_EN10MB;
+	if((this->pcapHandle = pcap_open_dead(this->pcapLinklayerHeaderType, this->pcap_snaplen)) == NULL) {
+		snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: pcap_open_dead failed", this->getInterfaceName().c_str()); 
+		goto failed;
+	}
+	this->pcapHandleIndex = register_pcap_handle(this->pcapHandle);
+	global_pcap_handle = this->pcapHandle;
+	global_pcap_handle_index = this->pcapHandleIndex;
+	global_pcap_dlink = this->pcapLinklayerHeaderType;
+	if(opt_mirrorip) {
+		if(opt_mirrorip_dst[0] == '\0') {
+			syslog(LOG_ERR, "packetbuffer - %s: mirroring packets was disabled because mirroripdst is not set", this->getInterfaceName().c_str());
+			opt_mirrorip = 0;
+		} else if(!mirrorip) {
+			syslog(LOG_NOTICE, "packetbuffer - %s: starting mirroring [%s]->[%s]", opt_mirrorip_src, opt_mirrorip_dst, this->getInterfaceName().c_str());
+			mirrorip = new FILE_LINE(0) MirrorIP(opt_mirrorip_src, opt_mirrorip_dst);
+		}
+	}
+	if(*user_filter != '\0') {
+		// no socket filter on AF_XDP - filter is applied in read thread
+		if(pcap_compile(this->pcapHandle, &this->filterData, user_filter, 0, PCAP_NETMASK_UNKNOWN) == -1) {
+			char user_filter_err[2048];
+			snprintf(user_filter_err, sizeof(user_filter_err), "%.2000s%s", user_filter, strlen(user_filter) > 2000 ? "..." : "");
+			snprintf(errorstr, sizeof(errorstr), "packetbuffer - %s: can not parse filter %s: %s", this->getInterfaceName().c_str(), user_filter_err, pcap_geterr(this->pcapHandle));
+			goto failed;
+		}
+		this->filterDataUse = true;
+	}
+	if(opt_pcapdump) {
+		char pname[2048];
+		snprintf(pname, sizeof(pname), "%s/dump-%s-%u.pcap", 
+			 getPcapdumpDir(),
+			 this->interfaceName.c_str(), (unsigned int)time(NULL));
+		this->pcapDumpHandle = pcap_dump_open(this->pcapHandle, pname);
+	}
+	return(true);
+failed:
+	if(opt_fork) {
+		daemonizeOutput(errorstr);
+	}
+	syslog(LOG_ERR, "%s", errorstr);
+	*error = errorstr;
+	return(false);
+#else
+	*error = "AF_XDP is not supported on this platform";
+	return(false);
+#endif
+}
+
 inline int PcapQueue_readFromInterface_base::pcap_next_ex_iface(pcap_t *pcapHandle, pcap_pkthdr** header, u_char** packet,
 								bool checkProtocol, sCheckProtocolData *checkProtocolData) {
 	if(!pcapHandle) {
@@ -3203,29 +4108,37 @@ inline int PcapQueue_readFromInterface_base::pcap_next_ex_iface(pcap_t *pcapHand
 			syslog(LOG_NOTICE, "find oneshot libpcap buffer : %s", libpcap_buffer ? "success" : "failed");
 		}
 	}
+	if(!check_protocol(*packet, (*header)->len, checkProtocol, checkProtocolData)) {
+		return(-11);
+	}
+	return(1);
+}
+
+inline bool PcapQueue_readFromInterface_base::check_protocol(u_char *packet, u_int32_t len,
+							     bool checkProtocol, sCheckProtocolData *checkProtocolData) {
 	if(checkProtocol || filter_ip) {
 		sCheckProtocolData _checkProtocolData;
 		if(!checkProtocolData) {
 			checkProtocolData = &_checkProtocolData;
 		}
-		if(!parseEtherHeader(pcapLinklayerHeaderType, *packet,
+		if(!parseEtherHeader(pcapLinklayerHeaderType, packet,
 				     checkProtocolData->header_sll, checkProtocolData->header_eth, NULL,
 				     checkProtocolData->header_ip_offset, checkProtocolData->protocol, checkProtocolData->vlan) ||
 		   !(checkProtocolData->protocol == ETHERTYPE_IP ||
 		     (VM_IPV6_B && checkProtocolData->protocol == ETHERTYPE_IPV6)) ||
-		   !(((iphdr2*)(*packet + checkProtocolData->header_ip_offset))->version == 4 ||
-		     (VM_IPV6_B && ((iphdr2*)(*packet + checkProtocolData->header_ip_offset))->version == 6)) ||
-		   ((iphdr2*)(*packet + checkProtocolData->header_ip_offset))->get_tot_len() + checkProtocolData->header_ip_offset > (*header)->len) {
-			return(-11);
+		   !(((iphdr2*)(packet + checkProtocolData->header_ip_offset))->version == 4 ||
+		     (VM_IPV6_B && ((iphdr2*)(packet + checkProtocolData->header_ip_offset))->version == 6)) ||
+		   ((iphdr2*)(packet + checkProtocolData->header_ip_offset))->get_tot_len() + checkProtocolData->header_ip_offset > len) {
+			return(false);
 		}
 		if(filter_ip) {
-			iphdr2 *iphdr = (iphdr2*)(*packet + checkProtocolData->header_ip_offset);
+			iphdr2 *iphdr = (iphdr2*)(packet + checkProtocolData->header_ip_offset);
 			if(!filter_ip->checkIP(iphdr->get_saddr()) && !filter_ip->checkIP(iphdr->get_daddr())) {
-				return(-11);
+				return(false);
 			}
 		}
 	}
-	return(1);
+	return(true);
 }
 
 void PcapQueue_readFromInterface_base::restoreOneshotBuffer() {
@@ -3271,12 +4184,37 @@ inline int PcapQueue_readFromInterface_base::pcapProcess(sHeaderPacket **header_
 	return(0);
 }
 
+bool PcapQueue_readFromInterface_base::pcap_stats_iface(pcap_stat *ps) {
+	#ifndef FREEBSD
+	if(this->tpacket) {
+		cTpacketV3::sStat tpacketStat;
+		if(!this->tpacket->getStat(&tpacketStat)) {
+			return(false);
+		}
+		ps->ps_recv = tpacketStat.packets;
+		ps->ps_drop = tpacketStat.drops;
+		ps->ps_ifdrop = 0;
+		return(true);
+	}
+	if(this->afxdp) {
+		cAfXdp::sStat afxdpStat;
+		if(!this->afxdp->getStat(&afxdpStat)) {
+			return(false);
+		}
+		ps->ps_recv = afxdpStat.packets + afxdpStat.rx_dropped + afxdpStat.rx_ring_full + afxdpStat.fill_ring_empty;
+		ps->ps_drop = afxdpStat.rx_dropped + afxdpStat.rx_ring_full + afxdpStat.fill_ring_empty;
+		ps->ps_ifdrop = 0;
+		return(true);
+	}
+	#endif
+	return(pcap_stats(this->pcapHandle, ps) == 0);
+}
+
 string PcapQueue_readFromInterface_base::pcapStatString_interface(int /*statPeriod*/) {
 	ostringstream outStr;
 	if(this->pcapHandle) {
 		pcap_stat ps;
-		int pcapstatres = pcap_stats(this->pcapHandle, &ps);
-		if(pcapstatres == 0) {
+		if(this->pcap_stats_iface(&ps)) {
 			if(ps.ps_recv >= this->last_ps.ps_recv) {
 				extern int opt_pcap_ifdrop_limit;
 				bool pcapdrop = false;
@@ -3319,8 +4257,7 @@ string PcapQueue_readFromInterface_base::pcapDropCountStat_interface() {
 	if(this->pcapHandle) {
 		outStr << this->getInterfaceName(true) << " : " << "pdropsCount [" << this->countPacketDrop << "]";
 		pcap_stat ps;
-		int pcapstatres = pcap_stats(this->pcapHandle, &ps);
-		if(pcapstatres == 0) {
+		if(this->pcap_stats_iface(&ps)) {
 			outStr << " ringdrop [" << ps.ps_drop << "]"
 			       << " ifdrop [" << ps.ps_ifdrop << "]";
 		}
@@ -3344,8 +4281,7 @@ string PcapQueue_readFromInterface_base::getStatPacketDrop() {
 void PcapQueue_readFromInterface_base::initStat_interface() {
 	if(this->pcapHandle) {
 		pcap_stat ps;
-		int pcapstatres = pcap_stats(this->pcapHandle, &ps);
-		if(pcapstatres == 0) {
+		if(this->pcap_stats_iface(&ps)) {
 			this->last_ps = ps;
 		}
 		this->countPacketDrop = 0;
@@ -3353,6 +4289,9 @@ void PcapQueue_readFromInterface_base::initStat_interface() {
 }
 
 string PcapQueue_readFromInterface_base::getInterfaceName(bool simple) {
+	if(this->fanoutGroup) {
+		return((simple ? "" : "interface ") + this->interfaceName + "#" + intToString(this->fanoutMember));
+	}
 	return((simple ? "" : "interface ") + this->interfaceName);
 }
 
@@ -3470,6 +4409,12 @@ PcapQueue_readFromInterfaceThread::PcapQueue_readFromInterfaceThread(const char
 	this->detachBufferActiveIndex = 0;
 	this->_sync_detachBuffer[0] = 0;
 	this->_sync_detachBuffer[1] = 0;
+	#ifndef FREEBSD
+	this->useAfXdp = typeThread == read && opt_pcap_queue_use_blocks && opt_pcap_queue_iface_af_xdp &&
+			 !opt_pb_read_from_file[0];
+	this->useTpacketV3 = typeThread == read && opt_pcap_queue_use_blocks && opt_pcap_queue_iface_tpacket_v3 &&
+			     !opt_pb_read_from_file[0] && !this->useAfXdp;
+	#endif
 	if(!opt_pcap_queue_use_blocks &&
 	   opt_pcap_queue_iface_dedup_separate_threads_extend == 2 &&
 	   (typeThread == read || typeThread == detach)) {
@@ -4383,6 +5328,14 @@ void PcapQueue_readFromInterfaceThread::threadFunction_blocks() {
 	while(!(is_terminating() || this->threadDoTerminate)) {
 		switch(this->typeThread) {
 		case read: {
+			if(this->tpacket) {
+				this->readBlock_tpacketV3(&block);
+				break;
+			}
+			if(this->afxdp) {
+				this->readBlock_afXdp(&block);
+				break;
+			}
 			while(!block ||
 			      !block->get_add_hp_pointers(&pcap_header_plus2, &pcap_packet, pcap_snaplen) ||
 			      (block->count && force_push)) {
@@ -4478,6 +5431,153 @@ void PcapQueue_readFromInterfaceThread::threadFunction_blocks() {
 	this->threadTerminated = true;
 }
 
+void PcapQueue_readFromInterfaceThread::readBlock_tpacketV3(pcap_block_store **block) {
+#ifndef FREEBSD
+	tpacket_block_desc *tpacketBlock = this->tpacket->getBlock(100);
+	if(!tpacketBlock) {
+		if(*block && (*block)->count && force_push) {
+			this->push_block(*block);
+			*block = NULL;
+			force_push = false;
+		}
+		return;
+	}
+	pcap_pkthdr_plus2 *pcap_header_plus2 = NULL;
+	u_char *pcap_packet = NULL;
+	sCheckProtocolData checkProtocolData;
+	unsigned countPackets = tpacketBlock->hdr.bh1.num_pkts;
+	tpacket3_hdr *tpacketHeader = (tpacket3_hdr*)((u_char*)tpacketBlock + tpacketBlock->hdr.bh1.offset_to_first_pkt);
+	for(unsigned i = 0; i < countPackets; i++) {
+		while(!*block ||
+		      !(*block)->get_add_hp_pointers(&pcap_header_plus2, &pcap_packet, pcap_snaplen) ||
+		      ((*block)->count && force_push)) {
+			if(*block) {
+				this->push_block(*block);
+			}
+			*block = new FILE_LINE(0) pcap_block_store(pcap_block_store::plus2);
+			force_push = false;
+		}
+		u_char *packet = (u_char*)tpacketHeader + tpacketHeader->tp_mac;
+		u_int32_t caplen = tpacketHeader->tp_snaplen;
+		u_int32_t len = tpacketHeader->tp_len;
+		// kernel strips offloaded vlan tag - restore it so that the packet looks like from libpcap
+		// (not with snaplen shorter than mac addresses + tag - the lengths below would underflow)
+		if((tpacketHeader->tp_status & TP_STATUS_VLAN_VALID) &&
+		   pcapLinklayerHeaderType == DLT_EN10MB && caplen >= 2 * ETHER_ADDR_LEN &&
+		   (u_int32_t)pcap_snaplen >= 2 * ETHER_ADDR_LEN + 2 * sizeof(u_int16_t)) {
+			u_int16_t vlan_tpid = (tpacketHeader->tp_status & TP_STATUS_VLAN_TPID_VALID) && tpacketHeader->hv1.tp_vlan_tpid ?
+					       tpacketHeader->hv1.tp_vlan_tpid : ETHERTYPE_VLAN;
+			u_int16_t vlan_tag[2] = { htons(vlan_tpid), htons(tpacketHeader->hv1.tp_vlan_tci) };
+			u_int32_t caplen_vlan = min((u_int32_t)pcap_snaplen, caplen + (u_int32_t)sizeof(vlan_tag));
+			memcpy(pcap_packet, packet, 2 * ETHER_ADDR_LEN);
+			memcpy(pcap_packet + 2 * ETHER_ADDR_LEN, vlan_tag, sizeof(vlan_tag));
+			memcpy(pcap_packet + 2 * ETHER_ADDR_LEN + sizeof(vlan_tag), packet + 2 * ETHER_ADDR_LEN, caplen_vlan - 2 * ETHER_ADDR_LEN - sizeof(vlan_tag));
+			caplen = caplen_vlan;
+			len += sizeof(vlan_tag);
+		} else {
+			if(caplen > pcap_snaplen) {
+				caplen = pcap_snaplen;
+			}
+			memcpy(pcap_packet, packet, caplen);
+		}
+		if(this->check_protocol(pcap_packet, len, opt_pcap_queue_use_blocks_read_check, &checkProtocolData)) {
+			sumPacketsSize[0] += caplen;
+			pcap_header_plus2->clear();
+			if(opt_pcap_queue_use_blocks_read_check) {
+				pcap_header_plus2->detect_headers = 0x01;
+				pcap_header_plus2->header_ip_first_offset = checkProtocolData.header_ip_offset;
+				pcap_header_plus2->eth_protocol = checkProtocolData.protocol;
+				pcap_header_plus2->pid.vlan = checkProtocolData.vlan;
+				pcap_header_plus2->pid.flags = 0;
+			}
+			pcap_header_plus2->std = 0;
+			pcap_header_plus2->header_fix_size.ts_tv_sec = tpacketHeader->tp_sec;
+			pcap_header_plus2->header_fix_size.ts_tv_usec = tpacketHeader->tp_nsec / 1000;
+			pcap_header_plus2->header_fix_size.caplen = caplen;
+			pcap_header_plus2->header_fix_size.len = len;
+			pcap_header_plus2->header_ip_offset = 0;
+			pcap_header_plus2->dlink = pcapLinklayerHeaderType;
+			(*block)->inc_h(pcap_header_plus2);
+		}
+		tpacketHeader = (tpacket3_hdr*)((u_char*)tpacketHeader + tpacketHeader->tp_next_offset);
+	}
+	this->tpacket->releaseBlock(tpacketBlock);
+#endif
+}
+
+void PcapQueue_readFromInterfaceThread::readBlock_afXdp(pcap_block_store **block) {
+#ifndef FREEBSD
+	u_int32_t index;
+	unsigned countPackets = this->afxdp->receive(64, &index, 100);
+	if(!countPackets) {
+		if(*block && (*block)->count && force_push) {
+			this->pushBlock_afXdp(*block);
+			*block = NULL;
+			force_push = false;
+		}
+		return;
+	}
+	// AF_XDP does not provide packet timestamp
+	timeval ts;
+	gettimeofday(&ts, NULL);
+	u_char *umem = this->afxdp->getUmem();
+	sCheckProtocolData checkProtocolData;
+	for(unsigned i = 0; i < countPackets; i++) {
+		xdp_desc *desc = this->afxdp->getRxDesc(index + i);
+		u_char *packet = umem + desc->addr;
+		u_int32_t caplen = min((u_int32_t)pcap_snaplen, desc->len);
+		if((this->filterDataUse && !bpf_filter(this->filterData.bf_insns, packet, desc->len, caplen)) ||
+		   !this->check_protocol(packet, desc->len, opt_pcap_queue_use_blocks_read_check, &checkProtocolData)) {
+			this->afxdp->releaseFrame(desc->addr);
+			continue;
+		}
+		// header is placed into umem headroom just before packet
+		pcap_pkthdr_plus2 *pcap_header_plus2 = (pcap_pkthdr_plus2*)(packet - sizeof(pcap_pkthdr_plus2));
+		pcap_header_plus2->clear();
+		if(opt_pcap_queue_use_blocks_read_check) {
+			pcap_header_plus2->detect_headers = 0x01;
+			pcap_header_plus2->header_ip_first_offset = checkProtocolData.header_ip_offset;
+			pcap_header_plus2->eth_protocol = checkProtocolData.protocol;
+			pcap_header_plus2->pid.vlan = checkProtocolData.vlan;
+			pcap_header_plus2->pid.flags = 0;
+		}
+		pcap_header_plus2->std = 0;
+		pcap_header_plus2->header_fix_size.ts_tv_sec = ts.tv_sec;
+		pcap_header_plus2->header_fix_size.ts_tv_usec = ts.tv_usec;
+		pcap_header_plus2->header_fix_size.caplen = caplen;
+		pcap_header_plus2->header_fix_size.len = desc->len;
+		pcap_header_plus2->header_ip_offset = 0;
+		pcap_header_plus2->dlink = pcapLinklayerHeaderType;
+		uint32_t offset = desc->addr - sizeof(pcap_pkthdr_plus2);
+		if(!*block || !(*block)->add_h_external(offset, caplen)) {
+			if(*block) {
+				this->pushBlock_afXdp(*block);
+			}
+			*block = new FILE_LINE(0) pcap_block_store(pcap_block_store::plus2);
+			(*block)->set_external(umem, this->afxdp);
+			(*block)->add_h_external(offset, caplen);
+		}
+		sumPacketsSize[0] += caplen;
+	}
+	this->afxdp->releaseRx();
+	if(force_push && *block && (*block)->count) {
+		this->pushBlock_afXdp(*block);
+		*block = NULL;
+		force_push = false;
+	}
+#endif
+}
+
+inline void PcapQueue_readFromInterfaceThread::pushBlock_afXdp(pcap_block_store *block) {
+#ifndef FREEBSD
+	// blocks keep umem frames until they are destroyed - if umem runs out, switch to copy
+	if(this->afxdp->getFreeFramesPerc() < 25) {
+		block->materialize();
+	}
+#endif
+	this->push_block(block);
+}
+
 void PcapQueue_readFromInterfaceThread::processBlock(pcap_block_store *block) {
 	unsigned counter = 0;
 	int ppf = 0;
@@ -4681,10 +5781,21 @@ bool PcapQueue_readFromInterface::init() {
 		return(true);
 	}
 	vector<string> interfaces = split(this->interfaceName.c_str(), split(",|;| |\t|\r|\n", "|"), true);
+	int fanout = opt_pcap_queue_iface_fanout > 1 && !opt_pb_read_from_file[0] ? opt_pcap_queue_iface_fanout : 1;
 	for(size_t i = 0; i < interfaces.size(); i++) {
-		if(this->readThreadsCount < READ_THREADS_MAX - 1) {
-			this->readThreads[this->readThreadsCount] = new FILE_LINE(15047) PcapQueue_readFromInterfaceThread(interfaces[i].c_str());
-			++this->readThreadsCount;
+		// each fanout member gets its own read thread with complete chain of next threads
+		u_int16_t fanoutGroup = fanout > 1 ? (u_int16_t)((getpid() * READ_THREADS_MAX + i) & 0xFFFF) : 0;
+		for(int j = 0; j < fanout; j++) {
+			if(this->readThreadsCount < READ_THREADS_MAX - 1) {
+				this->readThreads[this->readThreadsCount] = new FILE_LINE(15047) PcapQueue_readFromInterfaceThread(interfaces[i].c_str());
+				if(fanoutGroup) {
+					this->readThreads[this->readThreadsCount]->setFanout(fanoutGroup, j);
+				}
+				++this->readThreadsCount;
+			} else {
+				syslog(LOG_ERR, "packetbuffer - %s: exceeded limit of read threads (%i)", interfaces[i].c_str(), READ_THREADS_MAX - 1);
+				break;
+			}
 		}
 	}
 	return(this->readThreadsCount > 0);
@@ -5312,7 +6423,7 @@ string PcapQueue_readFromInterface::pcapStatString_cpuUsageReadThreads(double *s
 		double ti_cpu = this->readThreads[i]->getCpuUsagePerc(true);
 		if(ti_cpu >= 0) {
 			sum += ti_cpu;
-			outStrStat << "t0i_" << this->readThreads[i]->interfaceName << "_CPU[";
+			outStrStat << "t0i_" << this->readThreads[i]->getInterfaceName(true) << "_CPU[";
 			outStrStat << setprecision(1) << this->readThreads[i]->getTraffic(divide) << "Mb/s";
 			outStrStat << ';' << setprecision(1) << ti_cpu;
 			if(sverb.qring_stat) {
@@ -5564,6 +6675,7 @@ PcapQueue_readFromFifo::PcapQueue_readFromFifo(const char *nameQueue, const char
 	this->_last_ts.tv_sec = 0;
 	this->_last_ts.tv_usec = 0;
 	this->block_counter = 0;
+	this->compressPool = NULL;
 	this->setEnableMainThread(opt_pcap_queue_compress || is_receiver() ||
 				  (opt_pcap_queue_disk_folder.length() && opt_pcap_queue_store_queue_max_disk_size) ||
 				  !opt_pcap_queue_suppress_t1_thread);
@@ -5599,6 +6711,9 @@ PcapQueue_readFromFifo::~PcapQueue_readFromFifo() {
 	if(this->writeThreadHandle) {
 		pthread_join(this->writeThreadHandle, NULL);
 	}
+	if(this->compressPool) {
+		delete this->compressPool;
+	}
 	if(this->clientSocket) {
 		delete this->clientSocket;
 	}
@@ -6001,7 +7116,48 @@ void *PcapQueue_readFromFifo::threadFunction(void *arg, unsigned int arg2) {
 		delete [] buffer;
 		delete blockStore;
 	} else {
-		if(opt_pcap_queue_compress || !opt_pcap_queue_suppress_t1_thread) {
+		if(opt_pcap_queue_compress && opt_pcap_queue_compress_threads > 0) {
+			this->compressPool = new FILE_LINE(0) cPcapBlockCompressPool(opt_pcap_queue_compress_threads);
+			this->compressPool->start();
+			pcap_block_store *blockStore;
+			unsigned int usleepCounter = 0;
+			unsigned int spinCounter = 0;
+			while(!TERMINATING) {
+				bool doWork = false;
+				cPcapBlockCompressPool::sSlot *slot;
+				while((slot = this->compressPool->getHead()) != NULL) {
+					if(slot->state == cPcapBlockCompressPool::_slot_ok) {
+						if(!this->pcapStoreQueue.push(slot->block, false)) {
+							break;
+						}
+						sumPacketsSize[0] += slot->blockSizePackets ? slot->blockSizePackets : slot->blockSize;
+					} else {
+						delete slot->block;
+					}
+					this->compressPool->releaseHead();
+					doWork = true;
+				}
+				while(!this->compressPool->isFull() &&
+				      (blockStore = blockStoreBypassQueue->pop(false)) != NULL) {
+					size_t blockSize = blockStore->size;
+					size_t blockSizePackets = blockStore->size_packets;
+					blockStoreBypassQueue->pop(true, blockSize);
+					this->compressPool->add(blockStore, blockSize, blockSizePackets);
+					doWork = true;
+				}
+				if(doWork) {
+					usleepCounter = 0;
+					spinCounter = 0;
+				} else if(!this->compressPool->isEmpty() && !this->compressPool->getHead()) {
+					// head block in the workers - its finish wakes up the wait, the timeout keeps
+					// polling of the input queue as before
+					this->compressPool->waitHead(&spinCounter, 100);
+				} else {
+					USLEEP_C(100, usleepCounter++);
+				}
+			}
+			this->compressPool->terminate();
+		} else if(opt_pcap_queue_compress || !opt_pcap_queue_suppress_t1_thread) {
 			pcap_block_store *blockStore;
 			unsigned int usleepCounter = 0;
 			while(!TERMINATING) {
@@ -6477,6 +7633,12 @@ string PcapQueue_readFromFifo::pcapStatString_disk_buffer(int /*statPeriod*/) {
 		       << setw(6) << (useSize / 1024 / 1024) << "MB" << setw(6) << ""
 		       << " " << setw(5) << setprecision(1) << (100. * useSize / opt_pcap_queue_store_queue_max_disk_size) << "%"
 		       << " of " << setw(6) << (opt_pcap_queue_store_queue_max_disk_size / 1024 / 1024) << "MB" << endl;
+		string ioStat = pcap_file_store::getIOStatString();
+		if(ioStat.length()) {
+			outStr << "PACKETBUFFER_FILES_IO:     "
+			       << (opt_pcap_queue_disk_async_io ? "async " : "")
+			       << ioStat << " (avg/max)" << endl;
+		}
 	}
 	return(outStr.str());
 }
@@ -6501,6 +7663,10 @@ double PcapQueue_readFromFifo::pcapStat_get_disk_buffer_mb() {
 	}
 }
 
+string PcapQueue_readFromFifo::getCompressPoolStat() {
+	return(this->compressPool ? this->compressPool->getStatString() : "");
+}
+
 string PcapQueue_readFromFifo::getCpuUsage(bool writeThread, bool preparePstatData) {
 	if(!writeThread && this->packetServerDirection == directionRead) {
 		bool empty = true;
@@ -7337,10 +8503,9 @@ PcapQueue_outputThread::PcapQueue_outputThread(eTypeOutputThread typeOutputThrea
 	this->defrag_counter = 0;
 	this->ipfrag_lastprune = 0;
 	if(typeOutputThread == dedup) {
-		this->dedup_buffer = new FILE_LINE(16003) u_char[65536 * MD5_DIGEST_LENGTH]; // 1M
-		memset(this->dedup_buffer, 0, 65536 * MD5_DIGEST_LENGTH * sizeof(u_char));
+		this->dedupTable = new FILE_LINE(16003) cDedupTable;
 	} else {
-		this->dedup_buffer = NULL;
+		this->dedupTable = NULL;
 	}
 	this->initThreadOk = false;
 	this->terminatingThread = false;
@@ -7356,7 +8521,7 @@ PcapQueue_outputThread::~PcapQueue_outputThread() {
 		ipfrag_prune(0, true, &ipfrag_data, -1, 0);
 	}
 	if(typeOutputThread == dedup) {
-		delete [] dedup_buffer;
+		delete this->dedupTable;
 	}
 }
 
@@ -7386,12 +8551,12 @@ void PcapQueue_outputThread::push(sHeaderPacketPQout *hp) {
 	*/
 	
 	if(!qring_push_index) {
-		unsigned int usleepCounter = 0;
+		unsigned int spinCounter = 0;
 		while(this->qring[this->writeit]->used != 0) {
 			if(is_terminating()) {
 				return;
 			}
-			USLEEP_C(20, usleepCounter++);
+			this->qringWaitPush.wait(&this->qring[this->writeit]->used, 1, &spinCounter);
 		}
 		qring_push_index = this->writeit + 1;
 		qring_push_index_count = 0;
@@ -7407,6 +8572,7 @@ void PcapQueue_outputThread::push(sHeaderPacketPQout *hp) {
 		} else {
 			this->writeit++;
 		}
+		this->qringWaitPop.notify(&qring_active_push_item->used);
 		qring_push_index = 0;
 		qring_push_index_count = 0;
 	}
@@ -7421,6 +8587,7 @@ void PcapQueue_outputThread::push_batch() {
 		} else {
 			this->writeit++;
 		}
+		this->qringWaitPop.notify(&qring_active_push_item->used);
 		qring_push_index = 0;
 		qring_push_index_count = 0;
 	}
@@ -7428,11 +8595,10 @@ void PcapQueue_outputThread::push_batch() {
 
 void *PcapQueue_outputThread::outThreadFunction() {
 	this->initThreadOk = true;
-	extern unsigned int opt_preprocess_packets_qring_usleep;
 	this->outThreadId = get_unix_tid();
 	syslog(LOG_NOTICE, "start thread t2_%s/%i", this->getNameOutputThread().c_str(), this->outThreadId);
 	sBatchHP *batch;
-	unsigned int usleepCounter = 0;
+	unsigned int spinCounter = 0;
 	unsigned long usleepSumTime = 0;
 	unsigned long usleepSumTime_lastPush = 0;
 	while(!is_terminating() && !this->terminatingThread) {
@@ -7455,11 +8621,12 @@ void *PcapQueue_outputThread::outThreadFunction() {
 			} else {
 				this->readit++;
 			}
-			usleepCounter = 0;
+			this->qringWaitPush.notify(&batch->used);
+			spinCounter = 0;
 			usleepSumTime = 0;
 			usleepSumTime_lastPush = 0;
 		} else {
-			usleepSumTime += USLEEP_C(opt_preprocess_packets_qring_usleep, usleepCounter++);
+			usleepSumTime += this->qringWaitPop.wait(&this->qring[this->readit]->used, 0, &spinCounter);
 			if(usleepSumTime > usleepSumTime_lastPush + 100000) {
 				switch(typeOutputThread) {
 				case defrag:
@@ -7580,10 +8747,10 @@ void PcapQueue_outputThread::processDefrag(sHeaderPacketPQout *hp) {
 }
 
 void PcapQueue_outputThread::processDedup(sHeaderPacketPQout *hp) {
-	uint16_t *_md5 = NULL;
-	uint16_t __md5[MD5_DIGEST_LENGTH / (sizeof(uint16_t) / sizeof(unsigned char))];
+	uint16_t *_hash = NULL;
+	uint16_t __hash[DEDUP_HASH_LENGTH / sizeof(uint16_t)];
 	if(hp->block_store && hp->block_store->hm == pcap_block_store::plus2 && ((pcap_pkthdr_plus2*)hp->header)->md5[0]) {
-		_md5 = ((pcap_pkthdr_plus2*)hp->header)->md5;
+		_hash = ((pcap_pkthdr_plus2*)hp->header)->md5;
 	} else {
 		if(hp->header->header_ip_offset) {
 			iphdr2 *header_ip = (iphdr2*)(hp->packet + hp->header->header_ip_offset);
@@ -7599,8 +8766,6 @@ void PcapQueue_outputThread::processDedup(sHeaderPacketPQout *hp) {
 				datalen = get_sctp_data_len(header_ip, &data, hp->packet, hp->header->get_caplen());
 			}
 			if(data && datalen) {
-				MD5_CTX md5_ctx;
-				MD5_Init(&md5_ctx);
 				if(opt_dup_check_ipheader) {
 					u_int8_t header_ip_ttl_orig = 0;
 					u_int8_t header_ip_check_orig = 0;
@@ -7610,28 +8775,26 @@ void PcapQueue_outputThread::processDedup(sHeaderPacketPQout *hp) {
 						header_ip->set_ttl(0);
 						header_ip->set_check(0);
 					}
-					MD5_Update(&md5_ctx, header_ip, MIN(datalen + (data - (char*)header_ip), header_ip->get_tot_len()));
+					dedup_hash(__hash, header_ip, MIN(datalen + (data - (char*)header_ip), header_ip->get_tot_len()));
 					if(opt_dup_check_ipheader_ignore_ttl) {
 						header_ip->set_ttl(header_ip_ttl_orig);
 						header_ip->set_check(header_ip_check_orig);
 					}
 				} else {
-					MD5_Update(&md5_ctx, data, datalen);
+					dedup_hash(__hash, data, datalen);
 				}
-				MD5_Final((unsigned char*)__md5, &md5_ctx);
-				_md5 = __md5;
+				_hash = __hash;
 			}
 		}
 	}
-	if(_md5) {
-		if(memcmp(_md5, this->dedup_buffer + (_md5[0] * MD5_DIGEST_LENGTH), MD5_DIGEST_LENGTH) == 0) {
+	if(_hash) {
+		if(this->dedupTable->check(_hash, getTimeUS(hp->header->get_tv_sec(), hp->header->get_tv_usec()))) {
 			if(sverb.dedup) {
 				cout << "*** DEDUP 2" << endl;
 			}
 			hp->destroy_or_unlock_blockstore();
 			return;
 		}
-		memcpy(this->dedup_buffer + (_md5[0] * MD5_DIGEST_LENGTH), _md5, MD5_DIGEST_LENGTH);
 	}
 	if(this->pcapQueue->processPacket(hp, _hppq_out_state_dedup) == 0) {
 		hp->destroy_or_unlock_blockstore();
@@ -7672,6 +8835,65 @@ void PcapQueue_term() {
 	delete blockStoreBypassQueue;
 }
 
+bool kernel_prefilter_init() {
+#ifndef FREEBSD
+	extern int opt_rtpnosip;
+	extern int opt_mgcp;
+	extern bool opt_audiocodes;
+	extern char *skinnyportmatrix;
+	extern char *ssl_client_random_portmatrix;
+	extern unsigned opt_udp_port_l2tp;
+	extern unsigned opt_udp_port_tzsp;
+	extern unsigned opt_udp_port_vxlan;
+	extern unsigned opt_udp_port_mgcp_gateway;
+	extern unsigned opt_udp_port_mgcp_callagent;
+	extern unsigned opt_udp_port_audiocodes;
+	const char *disableReason = 
+		opt_rtpnosip ? "rtpnosip" :
+		opt_ipaccount ? "ipaccount" :
+		*user_filter ? "filter" :
+		opt_pcap_queue_iface_af_xdp ? "af_xdp" : NULL;
+	if(disableReason) {
+		syslog(LOG_NOTICE, "kernel prefilter - disabled because set %s", disableReason);
+		return(false);
+	}
+	cKernelPrefilter *prefilter = new FILE_LINE(0) cKernelPrefilter;
+	string error;
+	if(!prefilter->init(opt_pcap_queue_iface_kernel_prefilter_max_endpoints, &error)) {
+		syslog(LOG_ERR, "kernel prefilter - %s", error.c_str());
+		delete prefilter;
+		return(false);
+	}
+	for(unsigned port = 1; port < 65536; port++) {
+		if(sipportmatrix[port] ||
+		   (opt_skinny && skinnyportmatrix[port]) ||
+		   (opt_enable_http && httpportmatrix[port]) ||
+		   (opt_enable_webrtc && webrtcportmatrix[port]) ||
+		   ssl_client_random_portmatrix[port] ||
+		   (opt_mgcp && (port == opt_udp_port_mgcp_gateway || port == opt_udp_port_mgcp_callagent)) ||
+		   (opt_audiocodes && port == opt_udp_port_audiocodes) ||
+		   port == opt_udp_port_l2tp || port == opt_udp_port_tzsp || port == opt_udp_port_vxlan) {
+			prefilter->setPort(port);
+		}
+	}
+	kernelPrefilter = prefilter;
+	syslog(LOG_NOTICE, "kernel prefilter - enabled (max endpoints %i)", opt_pcap_queue_iface_kernel_prefilter_max_endpoints);
+	return(true);
+#else
+	return(false);
+#endif
+}
+
+void kernel_prefilter_term() {
+#ifndef FREEBSD
+	if(kernelPrefilter) {
+		cKernelPrefilter *prefilter = kernelPrefilter;
+		kernelPrefilter = NULL;
+		delete prefilter;
+	}
+#endif
+}
+
 int getThreadingMode() {
 	if(opt_pcap_queue_iface_separate_threads) {
 		if(opt_pcap_queue_iface_dedup_separate_threads) {
@@ -20,6 +20,9 @@
 #include "pstat.h"
 #include "ip_frag.h"
 #include "header_packet.h"
+#include "packet_socket.h"
+#include "dedup.h"
+#include "async_file_io.h"
 
 #define READ_THREADS_MAX 20
 #define DLT_TYPES_MAX 10
@@ -73,6 +76,8 @@ private:
 	volatile int sizeOfBlocks_sync;
 };
 
+/* Disk overflow buffer file. With packetbuffer_file_async_io writes are submitted to io_uring with a bounded number
+   in flight (push does not wait for the disk) and pop reads ahead the written part of the file in chunks. */
 class pcap_file_store {
 public:
 	enum eTypeHandle {
@@ -80,6 +85,30 @@ public:
 		typeHandlePop 	= 2,
 		typeHandleAll 	= 4
 	};
+	struct sAsyncRequest : public cAsyncFileIO::sRequest {
+		u_char *buffer;
+		u_int64_t offset;
+		u_int32_t length;
+		u_int32_t written;
+	};
+	struct sLatencyStat {
+		void add(u_int64_t us) {
+			__sync_fetch_and_add(&count, 1);
+			__sync_fetch_and_add(&sumUS, us);
+			if(us > maxUS) {
+				maxUS = us;
+			}
+		}
+		volatile u_int64_t count;
+		volatile u_int64_t sumUS;
+		volatile u_int64_t maxUS;
+	};
+	struct sIOStat {
+		sLatencyStat write;
+		sLatencyStat read;
+		sLatencyStat pop;
+		volatile u_int64_t errors;
+	};
 public:
 	pcap_file_store(u_int id = 0, const char *folder = NULL);
 	~pcap_file_store();
@@ -105,10 +134,21 @@ public:
 		       this->countPush == this->countPop);
 	}
 	std::string getFilePathName();
+	static std::string getIOStatString();
 private:
 	bool open(eTypeHandle typeHandle);
 	bool close(eTypeHandle typeHandle);
 	bool destroy();
+	bool pushAsync(pcap_block_store *blockStore);
+	bool popAsync(pcap_block_store *blockStore);
+	void asyncReap();
+	void asyncReadAhead(u_int64_t readLimit);
+	void asyncWaitRequest(sAsyncRequest *request);
+	void asyncFreeRead();
+	void asyncWaitWrites();
+	u_int64_t asyncWrittenSize() {
+		return(this->asyncWrites.size() ? this->asyncWrites.front()->offset : this->fileSize);
+	}
 	void lock_sync_flush_file() {
 		while(__sync_lock_test_and_set(&this->_sync_flush_file, 1));
 	}
@@ -129,6 +169,15 @@ private:
 	bool full;
 	u_int64_t timestampMS;
 	volatile int _sync_flush_file;
+	cAsyncFileIO *asyncIO;
+	int fdPush;
+	int fdPop;
+	std::deque<sAsyncRequest*> asyncWrites;
+	std::deque<sAsyncRequest*> asyncReads;
+	std::set<u_int64_t> asyncWritesFailed;
+	u_int64_t readAheadOffset;
+	static sIOStat ioStat;
+	static sIOStat ioStat_last;
 friend class pcap_store_queue;
 };
 
@@ -230,6 +279,79 @@ struct sHeaderPacketPQout {
 	}
 };
 
+/* Compression of packetbuffer blocks in worker threads. The t1 thread adds blocks in their order into a ring of
+   slots, workers take the slots in any order and the t1 thread releases only the head slot when its block is done,
+   so pcap_store_queue and the mirror socket get the blocks in the original order. Idle workers park on the counter of
+   added blocks and the t1 thread waiting for the head slot parks on the counter of done blocks (cWaitNotify). */
+class cPcapBlockCompressPool {
+public:
+	enum eSlotState {
+		_slot_empty,
+		_slot_wait,
+		_slot_ok,
+		_slot_failed
+	};
+	struct sSlot {
+		pcap_block_store *block;
+		size_t blockSize;
+		size_t blockSizePackets;
+		volatile int state;
+	};
+	struct sWorker {
+		cPcapBlockCompressPool *pool;
+		unsigned index;
+		pthread_t thread;
+		int threadId;
+		pstat_data threadPstatData[2];
+		volatile u_int64_t sizeIn;
+		volatile u_int64_t sizeOut;
+		u_int64_t sizeIn_last;
+		u_int64_t sizeOut_last;
+		u_int64_t statTimeMS_last;
+	};
+public:
+	cPcapBlockCompressPool(unsigned threadsCount);
+	~cPcapBlockCompressPool();
+	void start();
+	void terminate();
+	bool isFull() {
+		return(this->addIndex - this->headIndex >= this->slotsCount);
+	}
+	bool isEmpty() {
+		return(this->addIndex == this->headIndex);
+	}
+	void add(pcap_block_store *block, size_t blockSize, size_t blockSizePackets);
+	void waitHead(unsigned int *spinCounter, unsigned int timeoutUs);
+	sSlot *getHead() {
+		if(this->addIndex == this->headIndex) {
+			return(NULL);
+		}
+		sSlot *slot = &this->slots[this->headIndex % this->slotsCount];
+		return(slot->state == _slot_ok || slot->state == _slot_failed ? slot : NULL);
+	}
+	void releaseHead() {
+		this->slots[this->headIndex % this->slotsCount].state = _slot_empty;
+		++this->headIndex;
+	}
+	string getStatString();
+private:
+	void workerThreadFunction(sWorker *worker);
+	static void *_workerThreadFunction(void *arg);
+private:
+	unsigned threadsCount;
+	sWorker *workers;
+	unsigned slotsCount;
+	sSlot *slots;
+	volatile u_int64_t headIndex;
+	volatile u_int64_t addIndex;
+	volatile u_int64_t takeIndex;
+	volatile bool terminating;
+	volatile int addCounter;
+	volatile int doneCounter;
+	cWaitNotify waitAdd;
+	cWaitNotify waitDone;
+};
+
 class PcapQueue {
 public:
 	enum eTypeQueue {
@@ -308,6 +430,7 @@ protected:
 	void prepareProcPstatData();
 	double getCpuUsagePerc(eTypeThread typeThread = mainThread, bool preparePstatData = false);
 	virtual string getCpuUsage(bool /*writeThread*/ = false, bool /*preparePstatData*/ = false) { return(""); }
+	virtual string getCompressPoolStat() { return(""); }
 	long unsigned int getVsizeUsage(bool preparePstatData = false);
 	long unsigned int getRssUsage(bool preparePstatData = false);
 	virtual bool isMirrorSender() {
@@ -374,13 +497,12 @@ struct pcapProcessData {
 		#endif
 		extern int opt_dup_check;
 		if(opt_dup_check) {
-			this->prevmd5s = new FILE_LINE(16003) unsigned char[65536 * MD5_DIGEST_LENGTH]; // 1M
-			memset(this->prevmd5s, 0, 65536 * MD5_DIGEST_LENGTH * sizeof(unsigned char));
+			this->dedup = new FILE_LINE(16003) cDedupTable;
 		}
 	}
 	~pcapProcessData() {
-		if(this->prevmd5s) {
-			delete [] this->prevmd5s;
+		if(this->dedup) {
+			delete this->dedup;
 		}
 		ipfrag_prune(0, true, &ipfrag_data, -1, 0);
 	}
@@ -398,8 +520,7 @@ struct pcapProcessData {
 	int istcp;
 	int isother;
 	sPacketInfoData pid;
-	unsigned char *prevmd5s;
-	MD5_CTX ctx;
+	cDedupTable *dedup;
 	u_int ipfrag_lastprune;
 	ipfrag_data_s ipfrag_data;
 };
@@ -417,10 +538,18 @@ public:
 	PcapQueue_readFromInterface_base(const char *interfaceName = NULL);
 	virtual ~PcapQueue_readFromInterface_base();
 	void setInterfaceName(const char *interfaceName);
+	void setFanout(u_int16_t fanoutGroup, int fanoutMember);
 protected:
 	virtual bool startCapture(string *error);
+	bool joinFanout(int fd, string *error);
+	void attachKernelPrefilter(int fd, int dlt);
+	bool startCapture_tpacketV3(string *error);
+	bool startCapture_afXdp(string *error);
 	inline int pcap_next_ex_iface(pcap_t *pcapHandle, pcap_pkthdr** header, u_char** packet,
 				      bool checkProtocol = false, sCheckProtocolData *checkProtocolData = NULL);
+	inline bool check_protocol(u_char *packet, u_int32_t len,
+				   bool checkProtocol, sCheckProtocolData *checkProtocolData);
+	bool pcap_stats_iface(pcap_stat *ps);
 	void restoreOneshotBuffer();
 	inline int pcap_dispatch(pcap_t *pcapHandle);
 	inline int pcapProcess(sHeaderPacket **header_packet, int pushToStack_queue_index,
@@ -446,6 +575,12 @@ protected:
 	bpf_u_int32 interfaceMask;
 	pcap_t *pcapHandle;
 	u_int16_t pcapHandleIndex;
+	cTpacketV3 *tpacket;
+	bool useTpacketV3;
+	cAfXdp *afxdp;
+	bool useAfXdp;
+	u_int16_t fanoutGroup;
+	int fanoutMember;
 	queue<pcap_t*> pcapHandlesLapsed;
 	bool pcapEnd;
 	bpf_program filterData;
@@ -673,6 +808,9 @@ protected:
 private:
 	void *threadFunction(void *arg, unsigned int arg2);
 	void threadFunction_blocks();
+	void readBlock_tpacketV3(pcap_block_store **block);
+	void readBlock_afXdp(pcap_block_store **block);
+	inline void pushBlock_afXdp(pcap_block_store *block);
 	void processBlock(pcap_block_store *block);
 	void preparePstatData();
 	double getCpuUsagePerc(bool preparePstatData = false);
@@ -909,6 +1047,7 @@ protected:
 	double pcapStat_get_disk_buffer_perc();
 	double pcapStat_get_disk_buffer_mb();
 	string getCpuUsage(bool writeThread = false, bool preparePstatData = false);
+	string getCompressPoolStat();
 	bool socketWritePcapBlock(pcap_block_store *blockStore);
 	bool socketWritePcapBlockBySnifferClient(pcap_block_store *blockStore);
 	bool socketGetHost();
@@ -962,6 +1101,7 @@ protected:
 	pthread_t socketServerThreadHandle;
 private:
 	pcap_store_queue pcapStoreQueue;
+	cPcapBlockCompressPool *compressPool;
 	deque<pcap_block_store*> blockStoreTrash;
 	u_int cleanupBlockStoreTrash_counter;
 	volatile int blockStoreTrash_sync;
@@ -1023,6 +1163,9 @@ public:
 	}
 	void preparePstatData();
 	double getCpuUsagePerc(bool preparePstatData);
+	void getQringWaitStat(u_int64_t *wakeups, u_int64_t *parked_us) {
+		qringWaitPop.getStat(wakeups, parked_us);
+	}
 private:
 	eTypeOutputThread typeOutputThread;
 	PcapQueue_readFromFifo *pcapQueue;
@@ -1040,15 +1183,19 @@ private:
 	ipfrag_data_s ipfrag_data;
 	unsigned ipfrag_lastprune;
 	unsigned defrag_counter;
-	u_char *dedup_buffer;
+	cDedupTable *dedupTable;
 	volatile bool initThreadOk;
 	volatile bool terminatingThread;
+	cWaitNotify qringWaitPush;
+	cWaitNotify qringWaitPop;
 friend inline void *_PcapQueue_outputThread_outThreadFunction(void *arg);
 };
 
 
 void PcapQueue_init();
 void PcapQueue_term();
+bool kernel_prefilter_init();
+void kernel_prefilter_term();
 int getThreadingMode();
 void setThreadingMode(int threadingMode);
 
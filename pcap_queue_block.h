@@ -136,6 +136,15 @@ struct pcap_pkthdr_plus2 : public pcap_pkthdr_plus {
 	u_int8_t ignore;
 };
 
+struct pcap_block_store;
+
+class cPcapBlockStoreExternalBuffer {
+public:
+	virtual ~cPcapBlockStoreExternalBuffer() {}
+	virtual void ref() = 0;
+	virtual void release(pcap_block_store *block) = 0;
+};
+
 struct pcap_block_store {
 	enum header_mode {
 		plus,
@@ -144,7 +153,8 @@ struct pcap_block_store {
 	enum compress_method {
 		compress_method_default,
 		snappy,
-		lz4
+		lz4,
+		zstd
 	};
 	struct pcap_pkthdr_pcap {
 		pcap_pkthdr_pcap() {
@@ -196,12 +206,14 @@ struct pcap_block_store {
 		this->hm = hm;
 		this->offsets = NULL;
 		this->block = NULL;
+		this->external = NULL;
 		this->is_voip = NULL;
 		this->destroy();
 		this->restoreBuffer = NULL;
 		this->destroyRestoreBuffer();
 		this->idFileStore = 0;
 		this->filePosition = 0;
+		this->fileBlockSize = 0;
 		this->timestampMS = getTimeMS_rdtsc();
 		this->_sync_packet_lock = 0;
 		#if DEBUG_SYNC_PCAP_BLOCK_STORE
@@ -222,6 +234,9 @@ struct pcap_block_store {
 	inline bool add_hp(pcap_pkthdr_plus *header, u_char *packet, int memcpy_packet_size = 0);
 	inline void inc_h(pcap_pkthdr_plus2 *header);
 	inline bool get_add_hp_pointers(pcap_pkthdr_plus2 **header, u_char **packet, unsigned min_size_for_packet);
+	inline void set_external(u_char *block, cPcapBlockStoreExternalBuffer *external);
+	inline bool add_h_external(uint32_t offset, unsigned caplen);
+	void materialize();
 	inline bool isFull_checkTimeout();
 	inline bool isTimeout();
 	inline pcap_pkthdr_pcap operator [] (size_t indexItem) {
@@ -266,9 +281,11 @@ struct pcap_block_store {
 	inline bool compress();
 	bool compress_snappy();
 	bool compress_lz4();
+	bool compress_zstd();
 	inline bool uncompress(compress_method method = compress_method_default);
 	bool uncompress_snappy();
 	bool uncompress_lz4();
+	bool uncompress_zstd();
 	bool check_offsets() {
 		for(size_t i = 0; i < this->offsets_size - 1; i++) {
 			if(this->offsets[i] >= this->offsets[i + 1]) {
@@ -368,6 +385,7 @@ struct pcap_block_store {
 	header_mode hm;
 	uint32_t *offsets;
 	u_char *block;
+	cPcapBlockStoreExternalBuffer *external;
 	size_t size;
 	size_t size_compress;
 	size_t size_packets;
@@ -385,6 +403,7 @@ struct pcap_block_store {
 	size_t restoreBufferAllocSize;
 	u_int idFileStore;
 	u_int64_t filePosition;
+	u_int32_t fileBlockSize;
 	u_int64_t timestampMS;
 	volatile int _sync_packet_lock;
 	#if DEBUG_SYNC_PCAP_BLOCK_STORE
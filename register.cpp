@@ -222,6 +222,17 @@ bool RegisterState::isEq(Call *call, Register *reg) {
 	       id_sensor == call->useSensorId);
 }
 
+size_t RegisterState::getFootprint() {
+	return(sizeof(RegisterState) +
+	       REG_SIZE_STR(contact_num) +
+	       REG_SIZE_STR(contact_domain) +
+	       REG_SIZE_STR(from_num) +
+	       REG_SIZE_STR(from_name) +
+	       REG_SIZE_STR(from_domain) +
+	       REG_SIZE_STR(digest_realm) +
+	       REG_SIZE_STR(ua));
+}
+
 
 Register::Register(Call *call) {
 	lock_id();
@@ -434,7 +445,7 @@ void Register::updateLastState(Call *call) {
 	}
 }
 
-void Register::updateLastStateItem(char *callItem, char *registerItem, char **stateItem) {
+void Register::updateLastStateItem(const char *callItem, char *registerItem, char **stateItem) {
 	if(callItem && callItem[0] && registerItem && registerItem[0] &&
 	   !REG_EQ_STR(*stateItem == EQ_REG ? registerItem : *stateItem, callItem)) {
 		char *tmp_str;
@@ -466,6 +477,24 @@ void Register::clean_all() {
 	unlock_states();
 }
 
+size_t Register::getFootprint() {
+	size_t size = sizeof(Register) +
+		      REG_SIZE_STR(to_num) +
+		      REG_SIZE_STR(to_domain) +
+		      REG_SIZE_STR(contact_num) +
+		      REG_SIZE_STR(contact_domain) +
+		      REG_SIZE_STR(digest_username) +
+		      REG_SIZE_STR(from_num) +
+		      REG_SIZE_STR(from_name) +
+		      REG_SIZE_STR(from_domain) +
+		      REG_SIZE_STR(digest_realm) +
+		      REG_SIZE_STR(ua);
+	for(unsigned i = 0; i < countStates; i++) {
+		size += states[i]->getFootprint();
+	}
+	return(size);
+}
+
 void Register::saveStateToDb(RegisterState *state, bool enableBatchIfPossible) {
 	if(opt_nocdr) {
 		return;
@@ -680,6 +709,23 @@ int Registers::getCount() {
 	return(registers.size());
 }
 
+/* memory of the registration records (Register with its states and strings) - without the nodes of map */
+size_t Registers::getFootprint(size_t *count, size_t *states) {
+	size_t size = 0;
+	*states = 0;
+	lock_registers();
+	*count = registers.size();
+	for(map<RegisterId, Register*>::iterator iter_reg = registers.begin(); iter_reg != registers.end(); iter_reg++) {
+		Register *reg = iter_reg->second;
+		reg->lock_states();
+		size += reg->getFootprint();
+		*states += reg->countStates;
+		reg->unlock_states();
+	}
+	unlock_registers();
+	return(size);
+}
+
 void Registers::add(Call *call) {
  
 	/*
@@ -74,6 +74,7 @@ public:
 	inline ~RegisterState();
 	inline void copyFrom(const RegisterState *src);
 	inline bool isEq(Call *call, Register *reg);
+	inline size_t getFootprint();
 public:
 	u_int64_t state_from_us;
 	u_int64_t state_to_us;
@@ -107,7 +108,7 @@ public:
 	inline void shiftStates();
 	inline void expire(bool need_lock_states = true, bool use_state_prev_last = false);
 	inline void updateLastState(Call *call);
-	inline void updateLastStateItem(char *callItem, char *registerItem, char **stateItem);
+	inline void updateLastStateItem(const char *callItem, char *registerItem, char **stateItem);
 	inline bool eqLastState(Call *call);
 	inline void clean_all();
 	inline void saveStateToDb(RegisterState *state, bool enableBatchIfPossible = true);
@@ -121,6 +122,7 @@ public:
 		return(countStates > 1 ? states[1] : NULL);
 	}
 	inline bool getDataRow(RecordArray *rec);
+	inline size_t getFootprint();
 	void lock_states() {
 		while(__sync_lock_test_and_set(&_sync_states, 1));
 	}
@@ -178,6 +180,7 @@ public:
 	inline u_int64_t getNewRegisterFailedId(int sensorId);
 	string getDataTableJson(char *params, bool *zip = NULL);
 	int getCount();
+	size_t getFootprint(size_t *count, size_t *states);
 	void cleanupByJson(char *params);
 	void lock_registers() {
 		while(__sync_lock_test_and_set(&_sync_registers, 1));
@@ -219,6 +222,7 @@ eRegisterField convRegisterFieldToFieldId(const char *field);
 #define REG_CMP_STR(str1, str2)		((!(str1) || !*(str1)) && (!(str2) || !*(str2)) ? 0 : (!(str1) || !*(str1)) ? -1 : (!(str2) || !*(str2)) ? 1 : strcasecmp(str1, str2))
 #define REG_CMP0_STR(str1, str2)	((!(str1) || !*(str1)) || (!(str2) || !*(str2)) ? 0 : strcasecmp(str1, str2))
 #define REG_CONV_STR(str)		((str) && (str) != EQ_REG ? string(str) : string())
+#define REG_SIZE_STR(str)		((str) && (str) != EQ_REG ? strlen(str) + 1 : 0)
 
 
 #endif
@@ -43,6 +43,7 @@ public:
 	}
 	bool push(typeItem *item, bool waitForFree, bool useLock = false) {
 		if(useLock) lock();
+		unsigned int spinCounter = 0;
 		while(free[writeit] != 1) {
 			if(waitForFree) {
 				if(term_rqueue && *term_rqueue) {
@@ -50,7 +51,7 @@ public:
 					return(false);
 				}
 				if(useLock) unlock();
-				USLEEP(pushUsleep);
+				waitPush.wait(&free[writeit], 0, &spinCounter);
 				if(useLock) lock();
 			} else {
 				if(useLock) unlock();
@@ -62,6 +63,7 @@ public:
 		} else {
 			buffer[writeit] = *item;
 		}
+		v_int *pushed = &free[writeit];
 		#if RQUEUE_SAFE
 			__SYNC_NULL(free[writeit]);
 			__SYNC_INCR(writeit, length);
@@ -73,18 +75,20 @@ public:
 				writeit++;
 			}
 		#endif
+		waitPop.notify(pushed);
 		if(useLock) unlock();
 		return(true);
 	}
 	bool pop(typeItem *item, bool waitForFree, bool useLock = false) {
 		if(useLock) lock();
+		unsigned int spinCounter = 0;
 		while(free[readit] != 0) {
 			if(waitForFree) {
 				if(term_rqueue && *term_rqueue) {
 					if(useLock) unlock();
 					return(false);
 				}
-				USLEEP(popUsleep);
+				waitPop.wait(&free[readit], 1, &spinCounter);
 			} else {
 				if(useLock) unlock();
 				return(false);
@@ -95,6 +99,7 @@ public:
 		} else {
 			*item = buffer[readit];
 		}
+		v_int *popped = &free[readit];
 		#if RQUEUE_SAFE
 			__SYNC_SET(free[readit]);
 			__SYNC_INCR(readit, length);
@@ -106,6 +111,7 @@ public:
 				readit++;
 			}
 		#endif
+		waitPush.notify(popped);
 		if(useLock) unlock();
 		return(true);
 	}
@@ -114,6 +120,7 @@ public:
 			return(false);
 		}
 		*item = buffer[readit];
+		v_int *popped = &free[readit];
 		#if RQUEUE_SAFE
 			__SYNC_SET(free[readit]);
 			__SYNC_INCR(readit, length);
@@ -125,6 +132,7 @@ public:
 				readit++;
 			}
 		#endif
+		waitPush.notify(popped);
 		return(true);
 	}
 	bool get(typeItem *item) {
@@ -139,6 +147,7 @@ public:
 		return(true);
 	}
 	void moveReadit() {
+		v_int *popped = &free[readit];
 		#if RQUEUE_SAFE
 			__SYNC_SET(free[readit]);
 			__SYNC_INCR(readit, length);
@@ -150,6 +159,7 @@ public:
 				readit++;
 			}
 		#endif
+		waitPush.notify(popped);
 	}
 	void lock() {
 		__SYNC_LOCK(this->_sync_lock);
@@ -173,6 +183,8 @@ private:
 	v_u_int32_t readit;
 	v_u_int32_t writeit;
 	volatile int _sync_lock;
+	cWaitNotify waitPush;
+	cWaitNotify waitPop;
 };
 
 
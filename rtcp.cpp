@@ -605,7 +605,7 @@ void parse_rtcp(char *data, int datalen, Call* call)
 
 		if(rtcp->version != 2) {
 			if(sverb.debug_rtcp) {
-				printf("[%s] Malformed RTCP packet\n", call->fbasename);
+				printf("[%s] Malformed RTCP packet\n", call->fbasename.c_str());
 			}
 			pkt += rtcp_size;
 			break;
@@ -613,7 +613,7 @@ void parse_rtcp(char *data, int datalen, Call* call)
 	
 		if((pkt + rtcp_size) > (data + datalen)){
 			if(sverb.debug_rtcp) {
-				printf("[%s] Malformed RTCP packet\n", call->fbasename);
+				printf("[%s] Malformed RTCP packet\n", call->fbasename.c_str());
 			}
 			//rtcp too big 
 			break;
@@ -40,6 +40,8 @@ Each Call class contains two RTP classes.
 
 int dtmfdebug = 0;
 
+cSlabPool RTP::slab_pool("RTP", sizeof(RTP));
+
 extern int verbosity;
 extern int opt_saveRAW;                //save RTP payload RAW data?
 extern int opt_saveWAV;                //save RTP payload RAW data?
@@ -78,6 +80,7 @@ extern int opt_jitter_forcemark_delta_threshold;
 int calculate_mos_fromdsp(RTP *rtp, struct dsp *DSP);
 
 RTPstat rtp_stat;
+cJitterbufferDeferredPool *jitterbufferDeferredPool;
 
 using namespace std;
 
@@ -237,7 +240,7 @@ RTP::RTP(int sensor_id, vmIP sensor_ip)
 	ok_other_ip_side_by_sip = false;
 	ssrc = 0;
 	ssrc2 = 0;
-	gfilename[0] = '\0';
+	gfilename.clear();
 	gfileRAW = NULL;
 	last_interval_mosf1 = 45;
 	last_interval_mosf2 = 45;
@@ -260,46 +263,18 @@ RTP::RTP(int sensor_id, vmIP sensor_ip)
 	codecchanged = false;
 	had_audio = false;
 
-	channel_fix1 = new FILE_LINE(24002) ast_channel;
-	memset(channel_fix1, 0, sizeof(ast_channel));
-	channel_fix1->jitter_impl = 0; // fixed
-	channel_fix1->jitter_max = 50; 
-	channel_fix1->jitter_resync_threshold = 100;
-	channel_fix1->last_datalen = 0;
-	channel_fix1->lastbuflen = 0;
-	channel_fix1->resync = 1;
-	channel_fix1->audiobuf = NULL;
-
-	channel_fix2  = new FILE_LINE(24003) ast_channel;
-	memset(channel_fix2, 0, sizeof(ast_channel));
-	channel_fix2->jitter_impl = 0; // fixed
-	channel_fix2->jitter_max = 200; 
-	channel_fix2->jitter_resync_threshold = 200; 
-	channel_fix2->last_datalen = 0;
-	channel_fix2->lastbuflen = 0;
-	channel_fix2->resync = 1;
-	channel_fix2->audiobuf = NULL;
-
-	channel_adapt = new FILE_LINE(24004) ast_channel;
-	memset(channel_adapt, 0, sizeof(ast_channel));
-	channel_adapt->jitter_impl = 1; // adaptive
-	channel_adapt->jitter_max = 500; 
-	channel_adapt->jitter_resync_threshold = 500; 
-	channel_adapt->last_datalen = 0;
-	channel_adapt->lastbuflen = 0;
-	channel_adapt->resync = 1;
-	channel_adapt->audiobuf = NULL;
-
-	channel_record = new FILE_LINE(24005) ast_channel;
-	memset(channel_record, 0, sizeof(ast_channel));
-	channel_record->jitter_impl = 0; // fixed
-	channel_record->jitter_max = 60; 
-	channel_record->jitter_resync_threshold = opt_saveaudio_big_jitter_resync_threshold ? 5000 : 1000; 
-	channel_record->last_datalen = 0;
-	channel_record->lastbuflen = 0;
-	channel_record->resync = 0;
-	channel_record->audiobuf = NULL;
-	channel_record->audio_decode = true;
+	channel_fix1 = NULL;
+	channel_fix2 = NULL;
+	channel_adapt = NULL;
+	channel_record = NULL;
+	memset(jb_check_channels, 0, sizeof(jb_check_channels));
+	jb_channels_packetization = 0;
+	jb_deferred = -1;
+	jb_deferred_mos_counter = 0;
+	jb_log = NULL;
+	jb_log_pending = NULL;
+	jb_log_queued = false;
+	jb_log_sync = 0;
 	last_mos_time = 0;
 	mos_processed = false;
 	save_mos_graph_wait = false;
@@ -309,9 +284,7 @@ RTP::RTP(int sensor_id, vmIP sensor_ip)
 	last_voice_frame_timestamp = 0;
 
 	//channel->name = "SIP/fixed";
-	frame = new FILE_LINE(24006) ast_frame;
-	memset(frame, 0, sizeof(ast_frame));
-	frame->frametype = AST_FRAME_VOICE;
+	frame = NULL;
 	lastframetype = AST_FRAME_VOICE;
 	//frame->src = "DUMMY";
 	last_seq = -1;
@@ -395,68 +368,9 @@ RTP::save_mos_graph(bool delimiter) {
 		this->graph.write((char*)&graph_mos, 4);
 	}
 
-	if(opt_jitterbuffer_f1 and channel_fix1) {
-		last_interval_mosf1 = calculate_mos_fromrtp(this, 1, 1);
-
-		if(owner and (owner->flags & FLAG_SAVEGRAPH) and this->graph.isOpenOrEnableAutoOpen()) {
-			this->graph.write((char*)&last_interval_mosf1, 1);
-		}
-		// reset 10 second MOS stats
-		memcpy(channel_fix1->last_interval_loss, channel_fix1->loss, sizeof(unsigned short int) * 128);
-		if(mosf1_min > last_interval_mosf1) {
-			mosf1_min = last_interval_mosf1;
-		}
-		mosf1_avg = ((mosf1_avg * mos_counter) + last_interval_mosf1) / (mos_counter + 1);
-//		if(sverb.graph) printf("rtp[%p] saddr[%s] ts[%u] ssrc[%x] mosf1_avg[%f] mosf1[%u]\n", this, saddr.getString().c_str(), header->ts.tv_sec, ssrc, mosf1_avg, last_interval_mosf1);
-	} else {
-		last_interval_mosf1 = 45;
-		mosf1_min = 45;
-		mosf1_avg = 45;
-		if(owner and (owner->flags & FLAG_SAVEGRAPH) and this->graph.isOpenOrEnableAutoOpen()) {
-			this->graph.write((char*)&last_interval_mosf1, 1);
-		}
-	}
-	if(opt_jitterbuffer_f2 and channel_fix2) {
-		last_interval_mosf2 = calculate_mos_fromrtp(this, 2, 1);
-		//if(verbosity > 1) printf("mosf2[%d]\n", last_interval_mosf2);
-		if(owner and (owner->flags & FLAG_SAVEGRAPH) and this->graph.isOpenOrEnableAutoOpen()) {
-			this->graph.write((char*)&last_interval_mosf2, 1);
-		}
-		// reset 10 second MOS stats
-		memcpy(channel_fix2->last_interval_loss, channel_fix2->loss, sizeof(unsigned short int) * 128);
-		if(mosf2_min > last_interval_mosf2) {
-			mosf2_min = last_interval_mosf2;
-		}
-		mosf2_avg = ((mosf2_avg * mos_counter) + last_interval_mosf2) / (mos_counter + 1);
-//		if(sverb.graph) printf("rtp[%p] saddr[%s] ts[%u] ssrc[%x] mosf2_avg[%f] mosf2[%u]\n", this, saddr.getString().c_str(), header->ts.tv_sec, ssrc, mosf2_avg, last_interval_mosf2);
-	} else {
-		last_interval_mosf2 = 45;
-		mosf2_min = 45;
-		mosf2_avg = 45;
-		if(owner and (owner->flags & FLAG_SAVEGRAPH) and this->graph.isOpenOrEnableAutoOpen()) {
-			this->graph.write((char*)&last_interval_mosf2, 1);
-		}
-	}
-	if(opt_jitterbuffer_adapt and channel_adapt) {
-		last_interval_mosAD = calculate_mos_fromrtp(this, 3, 1);
-		//if(verbosity > 1) printf("mosAD[%d]\n", last_interval_mosAD);
-		if(owner and (owner->flags & FLAG_SAVEGRAPH) and this->graph.isOpenOrEnableAutoOpen()) {
-			this->graph.write((char*)&last_interval_mosAD, 1);
-		}
-		// reset 10 second MOS stats
-		memcpy(channel_adapt->last_interval_loss, channel_adapt->loss, sizeof(unsigned short int) * 128);
-		if(mosAD_min > last_interval_mosAD) {
-			mosAD_min = last_interval_mosAD;
-		}
-		mosAD_avg = ((mosAD_avg * mos_counter) + last_interval_mosAD) / (mos_counter + 1);
-//		if(sverb.graph) printf("rtp[%p] saddr[%s] ts[%u] ssrc[%x] mosAD_avg[%f] mosAD[%u]\n", this, saddr.getString().c_str(), header->ts.tv_sec, ssrc, mosAD_avg, last_interval_mosAD);
-	} else {
-		last_interval_mosAD = 45;
-		mosAD_min = 45;
-		mosAD_avg = 45;
-		if(owner and (owner->flags & FLAG_SAVEGRAPH) and this->graph.isOpenOrEnableAutoOpen()) {
-			this->graph.write((char*)&last_interval_mosAD, 1);
-		}
+	if(jb_deferred <= 0) {
+		save_mos_jitterbuffer(stats.received, owner && owner->connect_time_us, mos_counter, 
+				      owner and (owner->flags & FLAG_SAVEGRAPH) and this->graph.isOpenOrEnableAutoOpen());
 	}
 
 	if(opt_silencedetect and DSP) {
@@ -513,13 +427,87 @@ RTP::save_mos_graph(bool delimiter) {
 
 	last_stat_loss_perc_mult10 = (double)lost / ((double)received + (double)lost) * 100.0;
 
-	if(!is_read_from_file_simple()) {
+	if(jb_deferred > 0) {
+		// MOS of jitterbuffers and rtp_stat are done by replay of the log
+		jitterbuffer_log_submit(true);
+	} else if(!is_read_from_file_simple()) {
 		rtp_stat.update(saddr, header_ts.tv_sec, last_interval_mosf1, last_interval_mosf2, last_interval_mosAD, jitter, last_stat_loss_perc_mult10);
 	}
 }
 
+void
+RTP::save_mos_jitterbuffer(u_int32_t received, bool connected, u_int32_t counter, bool saveGraph) {
+	if(opt_jitterbuffer_f1 and channel_fix1) {
+		last_interval_mosf1 = calculate_mos_fromrtp(this, 1, 1, received, connected);
+
+		if(saveGraph) {
+			this->graph.write((char*)&last_interval_mosf1, 1);
+		}
+		// reset 10 second MOS stats
+		memcpy(channel_fix1->last_interval_loss, channel_fix1->loss, sizeof(unsigned short int) * 128);
+		if(mosf1_min > last_interval_mosf1) {
+			mosf1_min = last_interval_mosf1;
+		}
+		mosf1_avg = ((mosf1_avg * counter) + last_interval_mosf1) / (counter + 1);
+//		if(sverb.graph) printf("rtp[%p] saddr[%s] ts[%u] ssrc[%x] mosf1_avg[%f] mosf1[%u]\n", this, saddr.getString().c_str(), header->ts.tv_sec, ssrc, mosf1_avg, last_interval_mosf1);
+	} else {
+		last_interval_mosf1 = 45;
+		mosf1_min = 45;
+		mosf1_avg = 45;
+		if(saveGraph) {
+			this->graph.write((char*)&last_interval_mosf1, 1);
+		}
+	}
+	if(opt_jitterbuffer_f2 and channel_fix2) {
+		last_interval_mosf2 = calculate_mos_fromrtp(this, 2, 1, received, connected);
+		//if(verbosity > 1) printf("mosf2[%d]\n", last_interval_mosf2);
+		if(saveGraph) {
+			this->graph.write((char*)&last_interval_mosf2, 1);
+		}
+		// reset 10 second MOS stats
+		memcpy(channel_fix2->last_interval_loss, channel_fix2->loss, sizeof(unsigned short int) * 128);
+		if(mosf2_min > last_interval_mosf2) {
+			mosf2_min = last_interval_mosf2;
+		}
+		mosf2_avg = ((mosf2_avg * counter) + last_interval_mosf2) / (counter + 1);
+//		if(sverb.graph) printf("rtp[%p] saddr[%s] ts[%u] ssrc[%x] mosf2_avg[%f] mosf2[%u]\n", this, saddr.getString().c_str(), header->ts.tv_sec, ssrc, mosf2_avg, last_interval_mosf2);
+	} else {
+		last_interval_mosf2 = 45;
+		mosf2_min = 45;
+		mosf2_avg = 45;
+		if(saveGraph) {
+			this->graph.write((char*)&last_interval_mosf2, 1);
+		}
+	}
+	if(opt_jitterbuffer_adapt and channel_adapt) {
+		last_interval_mosAD = calculate_mos_fromrtp(this, 3, 1, received, connected);
+		//if(verbosity > 1) printf("mosAD[%d]\n", last_interval_mosAD);
+		if(saveGraph) {
+			this->graph.write((char*)&last_interval_mosAD, 1);
+		}
+		// reset 10 second MOS stats
+		memcpy(channel_adapt->last_interval_loss, channel_adapt->loss, sizeof(unsigned short int) * 128);
+		if(mosAD_min > last_interval_mosAD) {
+			mosAD_min = last_interval_mosAD;
+		}
+		mosAD_avg = ((mosAD_avg * counter) + last_interval_mosAD) / (counter + 1);
+//		if(sverb.graph) printf("rtp[%p] saddr[%s] ts[%u] ssrc[%x] mosAD_avg[%f] mosAD[%u]\n", this, saddr.getString().c_str(), header->ts.tv_sec, ssrc, mosAD_avg, last_interval_mosAD);
+	} else {
+		last_interval_mosAD = 45;
+		mosAD_min = 45;
+		mosAD_avg = 45;
+		if(saveGraph) {
+			this->graph.write((char*)&last_interval_mosAD, 1);
+		}
+	}
+}
+
 /* destructor */
 RTP::~RTP() {
+	if(jb_deferred > 0) {
+		jitterbuffer_log_wait();
+	}
+
 	/*
 	if(packetization)
 		RTP::dump();
@@ -535,15 +523,25 @@ RTP::~RTP() {
 	}
 
 	delete s;
-	ast_jb_destroy(channel_fix1);
-	ast_jb_destroy(channel_fix2);
-	ast_jb_destroy(channel_adapt);
-	ast_jb_destroy(channel_record);
-	delete channel_fix1;
-	delete channel_fix2;
-	delete channel_adapt;
-	delete channel_record;
-	delete frame;
+	while(jb_log_pending) {
+		cJitterbufferLog *next = jb_log_pending->next;
+		delete jb_log_pending;
+		jb_log_pending = next;
+	}
+	if(jb_log) {
+		delete jb_log;
+	}
+	ast_channel **channels[] = { &channel_fix1, &channel_fix2, &channel_adapt, &channel_record,
+				     &jb_check_channels[0], &jb_check_channels[1], &jb_check_channels[2] };
+	for(unsigned i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+		if(*channels[i]) {
+			ast_jb_destroy(*channels[i]);
+			delete *channels[i];
+		}
+	}
+	if(frame) {
+		delete frame;
+	}
 
 	if(gfileRAW_buffer) {
 		delete [] gfileRAW_buffer;
@@ -597,14 +595,89 @@ const int RTP::get_payload_len() {
 
 /* flush jitterbuffer */
 void RTP::jitterbuffer_fixed_flush(struct ast_channel */*jchannel*/) {
-	jb_fixed_flush_deliver(channel_record);
+	if(channel_record) {
+		jb_fixed_flush_deliver(channel_record);
+	}
+}
+
+static ast_channel *create_jitterbuffer_channel(int jitter_impl, int jitter_max, int jitter_resync_threshold, int resync, int packetization) {
+	ast_channel *channel = new FILE_LINE(24002) ast_channel;
+	memset(channel, 0, sizeof(ast_channel));
+	channel->jitter_impl = jitter_impl;
+	channel->jitter_max = jitter_max;
+	channel->jitter_resync_threshold = jitter_resync_threshold;
+	channel->last_datalen = 0;
+	channel->lastbuflen = 0;
+	channel->resync = resync;
+	channel->audiobuf = NULL;
+	channel->packetization = packetization;
+	return(channel);
+}
+
+/* channels (720B each) and frame are created with the first packet which needs them - streams without enabled 
+   jitterbuffer simulation and without recorded audio (most of them on big sensors) carry only the pointers */
+void RTP::prepareJitterbufferChannels(bool record) {
+	if(!frame) {
+		frame = new FILE_LINE(24006) ast_frame;
+		memset(frame, 0, sizeof(ast_frame));
+		frame->frametype = AST_FRAME_VOICE;
+	}
+	if(!channel_fix1 && !channel_fix2 && !channel_adapt) {
+		jb_channels_packetization = packetization;
+	}
+	if(opt_jitterbuffer_f1 && !channel_fix1) {
+		channel_fix1 = create_jitterbuffer_channel(0, 50, 100, 1, packetization); // fixed
+	}
+	if(opt_jitterbuffer_f2 && !channel_fix2) {
+		channel_fix2 = create_jitterbuffer_channel(0, 200, 200, 1, packetization); // fixed
+	}
+	if(opt_jitterbuffer_adapt && !channel_adapt) {
+		channel_adapt = create_jitterbuffer_channel(1, 500, 500, 1, packetization); // adaptive
+	}
+	if(record && !channel_record) {
+		channel_record = create_jitterbuffer_channel(0, 60, opt_saveaudio_big_jitter_resync_threshold ? 5000 : 1000, 0, packetization); // fixed
+		channel_record->audio_decode = true;
+	}
+	if(jb_deferred > 0 && sverb.jitterbuffer_deferred_check) {
+		ast_channel *channels[] = { channel_fix1, channel_fix2, channel_adapt };
+		for(unsigned i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+			if(channels[i] && !jb_check_channels[i]) {
+				jb_check_channels[i] = create_jitterbuffer_channel(channels[i]->jitter_impl, channels[i]->jitter_max, channels[i]->jitter_resync_threshold, 
+										   channels[i]->resync, jb_channels_packetization);
+			}
+		}
+	}
+}
+
+void RTP::setChannelsPacketization(int packetization) {
+	jb_channels_packetization = packetization;
+	// channels fix1 / fix2 / adapt of deferred simulation are owned by the replay (it takes the packetization from the log)
+	ast_channel *channels[] = { jb_deferred > 0 ? NULL : channel_fix1, jb_deferred > 0 ? NULL : channel_fix2, jb_deferred > 0 ? NULL : channel_adapt, channel_record,
+				    jb_check_channels[0], jb_check_channels[1], jb_check_channels[2] };
+	for(unsigned i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+		if(channels[i]) {
+			channels[i]->packetization = packetization;
+		}
+	}
+}
+
+size_t RTP::getJitterbufferChannelsSize() {
+	ast_channel *channels[] = { channel_fix1, channel_fix2, channel_adapt, channel_record,
+				    jb_check_channels[0], jb_check_channels[1], jb_check_channels[2] };
+	size_t size = frame ? sizeof(ast_frame) : 0;
+	for(unsigned i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+		if(channels[i]) {
+			size += sizeof(ast_channel);
+		}
+	}
+	return(size);
 }
 
 /* add silence to RTP stream from last packet time to current time which is in header->ts */
 void
 RTP::jt_tail(struct pcap_pkthdr *header) {
 
-	if(!ast_jb_test(channel_record)) {
+	if(!channel_record || !ast_jb_test(channel_record)) {
 		// there is no ongoing recording, return
 		return;
 	}
@@ -653,16 +726,76 @@ RTP::jitterbuffer(struct ast_channel *channel, int savePayload) {
 	} else {
 		frame->skip = 0;
 	}
-	struct timeval tsdiff;
 	frame->len = packetization;
+	frame->ts = get_jitterbuffer_frame_ts();
+	frame->marker = getMarker();
+	frame->seqno = getSeqNum();
+	channel->codec = codec;
+	frame->ignore = ignore;
+	memcpy(&frame->delivery, &header_ts, sizeof(struct timeval));
+
+	/* protect for endless loops (it cannot happen in theory but to be sure */
+	if(!check_jitterbuffer_packetization()) {
+		return;
+	}
+
+	if(savePayload or (codec == PAYLOAD_G729 or codec == PAYLOAD_G723 or codec == PAYLOAD_AMR or codec == PAYLOAD_AMRWB)) {
+		jitterbuffer_payload();
+		frame->data = payload_data;
+		frame->datalen = payload_len > 0 ? payload_len : 0; /* ensure that datalen is never negative */
+
+		if(codec == PAYLOAD_G723) {
+			// voipmonitor does not handle SID packets well (silence packets) it causes out of sync
+			if((unsigned char)payload_data[0] & 2)  {
+
+				/* check if jitterbuffer is already created. If not we have to create it because 
+				   if call starts with SID packets first it will than cause out of sync calls 
+				*/
+				if(ast_test_flag(&channel->jb, (1 << 2))) {
+					// jitterbuffer is created so we can skip SID packets now
+					return;
+				}
+			}
+		}
+
+		jitterbuffer_mark_frame();
+	}
+
+	if(lastcng or lastframetype == AST_FRAME_DTMF) {
+		frame->marker = 1;
+	}
+
+	if(savePayload) {
+		channel->rawstream = gfileRAW;
+		Call *owner = (Call*)call_owner;
+		if(iscaller) {
+			owner->codec_caller = codec;
+			owner->audioBufferData[0].set(&channel->audiobuf, frame->seqno, this->ssrc, &this->header_ts);
+		} else {
+			owner->codec_called = codec;
+			owner->audioBufferData[1].set(&channel->audiobuf, frame->seqno, this->ssrc, &this->header_ts);
+		}
+		if(payload_len > 0) {
+			channel->last_datalen = frame->datalen;
+		}
+	} else {
+		frame->datalen = 0;
+		frame->data = NULL;
+		channel->rawstream = NULL;
+	}
+
+	jitterbuffer_put(channel, frame, &header_ts, packetization, lastframetype == AST_FRAME_DTMF, savePayload, false);
+}
+
+int
+RTP::get_jitterbuffer_frame_ts() {
 	switch(codec) {
 		case PAYLOAD_VXOPUS12:
 		case PAYLOAD_XOPUS12:
 		case PAYLOAD_OPUS12:
 		case PAYLOAD_G722112:
-			frame->ts = getTimestamp() / 12;
+			return(getTimestamp() / 12);
 			//frame->len = packetization * 2 / 3;
-			break;
 		case PAYLOAD_ISAC16:
 		case PAYLOAD_SILK16:
 		case PAYLOAD_VXOPUS16:
@@ -670,41 +803,35 @@ RTP::jitterbuffer(struct ast_channel *channel, int savePayload) {
 		case PAYLOAD_OPUS16:
 		case PAYLOAD_G722116:
 		case PAYLOAD_AMRWB:
-			frame->ts = getTimestamp() / 16;
+			return(getTimestamp() / 16);
 			//frame->len = packetization / 2;
-			break;
 		case PAYLOAD_SILK24:
 		case PAYLOAD_VXOPUS24:
 		case PAYLOAD_XOPUS24:
 		case PAYLOAD_OPUS24:
 		case PAYLOAD_G722124:
-			frame->ts = getTimestamp() / 24;
+			return(getTimestamp() / 24);
 			//frame->len = packetization / 3;
-			break;
 		case PAYLOAD_ISAC32:
 		case PAYLOAD_G722132:
-			frame->ts = getTimestamp() / 32;
+			return(getTimestamp() / 32);
 			//frame->len = packetization / 4;
-			break;
 		case PAYLOAD_VXOPUS48:
 		case PAYLOAD_XOPUS48:
 		case PAYLOAD_OPUS48:
-			frame->ts = getTimestamp() / 48;
+			return(getTimestamp() / 48);
 			//frame->len = packetization / 6;
-			break;
 		default: 
-			frame->ts = getTimestamp() / 8;
+			return(getTimestamp() / 8);
 			//frame->len = packetization;
 	}
-	frame->marker = getMarker();
-	frame->seqno = getSeqNum();
-	channel->codec = codec;
-	frame->ignore = ignore;
-	memcpy(&frame->delivery, &header_ts, sizeof(struct timeval));
+}
 
-	/* protect for endless loops (it cannot happen in theory but to be sure */
+bool
+RTP::check_jitterbuffer_packetization() {
 	if(packetization <= 0) {
 		if(pinformed == 0) {
+			Call *owner = (Call*)call_owner;
 			if(owner) {
 				syslog(LOG_ERR, "call-id[%s] ssrc[%x]: packetization is 0 in jitterbuffer function.", owner->get_fbasename_safe(), getSSRC());
 				
@@ -713,107 +840,80 @@ RTP::jitterbuffer(struct ast_channel *channel, int savePayload) {
 			}
 		}
 		pinformed = 1;
-		return;
+		return(false);
 	} else {
 		pinformed = 0;
 	}
+	return(true);
+}
 
+/* get RTP payload header and datalen */
+void
+RTP::jitterbuffer_payload() {
 	int mylen = MIN((unsigned int)len, header_ip->get_tot_len() - header_ip->get_hdr_size() - sizeof(udphdr2));
+	payload_data = data + sizeof(RTPFixedHeader);
+	payload_len = mylen - sizeof(RTPFixedHeader);
+	if(getPadding()) {
+		/*
+		* If set, this packet contains one or more additional padding
+		* bytes at the end which are not part of the payload. The last
+		* byte of the padding contains a count of how many padding bytes
+		* should be ignored. Padding may be needed by some encryption
+		* algorithms with fixed block sizes or for carrying several RTP
+		* packets in a lower-layer protocol data unit.
+		*/
+		payload_len -= ((u_int8_t *)data)[payload_len - 1];
+		padding_len = ((u_int8_t *)data)[payload_len - 1];
+	}
+	if(getCC() > 0) {
+		/*
+		* The number of CSRC identifiers that follow the fixed header.
+		*/
+		payload_data += 4 * getCC();
+		payload_len -= 4 * getCC();
+	}
+	if(getExtension()) {
+		/*
+		* If set, the fixed header is followed by exactly one header extension.
+		*/
+		extension_hdr_t *rtpext;
 
-	if(savePayload or (codec == PAYLOAD_G729 or codec == PAYLOAD_G723 or codec == PAYLOAD_AMR or codec == PAYLOAD_AMRWB)) {
-		/* get RTP payload header and datalen */
-		payload_data = data + sizeof(RTPFixedHeader);
-		payload_len = mylen - sizeof(RTPFixedHeader);
-		if(getPadding()) {
-			/*
-			* If set, this packet contains one or more additional padding
-			* bytes at the end which are not part of the payload. The last
-			* byte of the padding contains a count of how many padding bytes
-			* should be ignored. Padding may be needed by some encryption
-			* algorithms with fixed block sizes or for carrying several RTP
-			* packets in a lower-layer protocol data unit.
-			*/
-			payload_len -= ((u_int8_t *)data)[payload_len - 1];
-			padding_len = ((u_int8_t *)data)[payload_len - 1];
-		}
-		if(getCC() > 0) {
-			/*
-			* The number of CSRC identifiers that follow the fixed header.
-			*/
-			payload_data += 4 * getCC();
-			payload_len -= 4 * getCC();
-		}
-		if(getExtension()) {
-			/*
-			* If set, the fixed header is followed by exactly one header extension.
-			*/
-			extension_hdr_t *rtpext;
-
-			// the extension, if present, is after the CSRC list.
-			rtpext = (extension_hdr_t *)((u_int8_t *)payload_data);
-			payload_data += sizeof(extension_hdr_t) + ntohs(rtpext->length);
-			payload_len -= sizeof(extension_hdr_t) + ntohs(rtpext->length);
-			if (payload_len < 4) {
-				payload_data = data + sizeof(RTPFixedHeader);
-				payload_len = 0;
-			}
-			
-		}
-		frame->data = payload_data;
-		frame->datalen = payload_len > 0 ? payload_len : 0; /* ensure that datalen is never negative */
-
-		if(codec == PAYLOAD_G723) {
-			// voipmonitor does not handle SID packets well (silence packets) it causes out of sync
-			if((unsigned char)payload_data[0] & 2)  {
-
-				/* check if jitterbuffer is already created. If not we have to create it because 
-				   if call starts with SID packets first it will than cause out of sync calls 
-				*/
-				if(ast_test_flag(&channel->jb, (1 << 2))) {
-					// jitterbuffer is created so we can skip SID packets now
-					return;
-				}
-			}
-		}
-
-		if(codec == PAYLOAD_G729 and (payload_len <= (packetization == 10 ? 9 : 12))) {
-			frame->frametype = AST_FRAME_DTMF;
-			frame->marker = 1;
-		}
-		if((codec == PAYLOAD_AMR or codec == PAYLOAD_AMRWB) and payload_len <= 7) {
-			frame->frametype = AST_FRAME_DTMF;
-			frame->marker = 1;
+		// the extension, if present, is after the CSRC list.
+		rtpext = (extension_hdr_t *)((u_int8_t *)payload_data);
+		payload_data += sizeof(extension_hdr_t) + ntohs(rtpext->length);
+		payload_len -= sizeof(extension_hdr_t) + ntohs(rtpext->length);
+		if (payload_len < 4) {
+			payload_data = data + sizeof(RTPFixedHeader);
+			payload_len = 0;
 		}
+		
 	}
+}
 
-	if(lastcng or lastframetype == AST_FRAME_DTMF) {
+/* G729 / AMR comfort noise frames are passed to jitterbuffer as DTMF */
+void
+RTP::jitterbuffer_mark_frame() {
+	if(codec == PAYLOAD_G729 and (payload_len <= (packetization == 10 ? 9 : 12))) {
+		frame->frametype = AST_FRAME_DTMF;
 		frame->marker = 1;
 	}
-
-	if(savePayload) {
-		channel->rawstream = gfileRAW;
-		Call *owner = (Call*)call_owner;
-		if(iscaller) {
-			owner->codec_caller = codec;
-			owner->audioBufferData[0].set(&channel->audiobuf, frame->seqno, this->ssrc, &this->header_ts);
-		} else {
-			owner->codec_called = codec;
-			owner->audioBufferData[1].set(&channel->audiobuf, frame->seqno, this->ssrc, &this->header_ts);
-		}
-		if(payload_len > 0) {
-			channel->last_datalen = frame->datalen;
-		}
-	} else {
-		frame->datalen = 0;
-		frame->data = NULL;
-		channel->rawstream = NULL;
+	if((codec == PAYLOAD_AMR or codec == PAYLOAD_AMRWB) and payload_len <= 7) {
+		frame->frametype = AST_FRAME_DTMF;
+		frame->marker = 1;
 	}
+}
+
+void
+RTP::jitterbuffer_put(struct ast_channel *channel, struct ast_frame *frame, struct timeval *header_ts, int packetization, bool lastframe_dtmf, int savePayload, bool replay) {
+
+	Call *owner = (Call*)call_owner;
+	struct timeval tsdiff;
 
 	// create jitter buffer structures 
-	ast_jb_do_usecheck(channel, &header_ts);
-	if(channel->jb.timebase.tv_sec == header_ts.tv_sec &&
-	   channel->jb.timebase.tv_usec == header_ts.tv_usec) {
-		channel->last_ts = header_ts;
+	ast_jb_do_usecheck(channel, header_ts);
+	if(channel->jb.timebase.tv_sec == header_ts->tv_sec &&
+	   channel->jb.timebase.tv_usec == header_ts->tv_usec) {
+		channel->last_ts = *header_ts;
 	}
 	
 	if(!channel->jb_reseted) {
@@ -824,54 +924,60 @@ RTP::jitterbuffer(struct ast_channel *channel, int savePayload) {
 		
 		ast_jb_empty_and_reset(channel);
 		channel->jb_reseted = 1;
-		memcpy(&channel->last_ts, &header_ts, sizeof(struct timeval));
-		ast_jb_put(channel, frame, &header_ts);
-		this->clearAudioBuff(owner, channel);
+		memcpy(&channel->last_ts, header_ts, sizeof(struct timeval));
+		ast_jb_put(channel, frame, header_ts);
+		if(!replay) {
+			this->clearAudioBuff(owner, channel);
+		}
 		return;
 	}
 
 	/* calculate time difference between last packet and current packet + packetization time*/ 
-	int msdiff = ast_tvdiff_ms( header_ts, ast_tvadd(channel->last_ts, ast_samp2tv(packetization, 1000)) );
+	int msdiff = ast_tvdiff_ms( *header_ts, ast_tvadd(channel->last_ts, ast_samp2tv(packetization, 1000)) );
 	//printf("ms:%d\n", msdiff);
 	if(msdiff > packetization * 10000) {
 		// difference is too big, reseting last_ts to current packet. If we dont check this it could happen to run while cycle endlessly
-		memcpy(&channel->last_ts, &header_ts, sizeof(struct timeval));
-		ast_jb_put(channel, frame, &header_ts);
-		if(verbosity > 4) syslog(LOG_ERR, "big timestamp jump (msdiff:%d packetization: %d) in this file: %s\n", msdiff, packetization, gfilename);
-		this->clearAudioBuff(owner, channel);
+		memcpy(&channel->last_ts, header_ts, sizeof(struct timeval));
+		ast_jb_put(channel, frame, header_ts);
+		if(verbosity > 4) syslog(LOG_ERR, "big timestamp jump (msdiff:%d packetization: %d) in this file: %s\n", msdiff, packetization, gfilename.c_str());
+		if(!replay) {
+			this->clearAudioBuff(owner, channel);
+		}
 		return;
 	}
 
-	/* between last packet and current packet is big timestamp difference and it could count 
-	 * interpolated framed although it was silence so calculate real number of packets based 
-	 * on timestamps in packet header, timestamps in rtp header and sequence numbers between 
-	 * last packet and current packet
-	 */
+	if(!replay) {
+		/* between last packet and current packet is big timestamp difference and it could count 
+		 * interpolated framed although it was silence so calculate real number of packets based 
+		 * on timestamps in packet header, timestamps in rtp header and sequence numbers between 
+		 * last packet and current packet
+		 */
 
-	// relative time difference calculated from packet sequence 
-	u_int32_t sequencems = (frame->seqno - last_seq) * packetization;
+		// relative time difference calculated from packet sequence 
+		u_int32_t sequencems = (frame->seqno - last_seq) * packetization;
 
-	/* difference (in ms) between timestamps in packet header and rtp timestamps. this should 
-	 * be ideally equal to zero. Negative values mean that packet arrives earlier and positive 
-	 * values indicates that packet was late 
-	 */
-	long double transit = (timeval_subtract(&tsdiff, header_ts, s->lastTimeRecJ) ? -timeval2micro(tsdiff)/1000.0 : timeval2micro(tsdiff)/1000.0) - ((double)getTimestamp() - s->lastTimeStampJ)/(double)samplerate/1000;
-	
-	/* and now if there is bigger (lets say one second) timestamp difference (calculated from packet headers) 
-	 * between two last packets and transit time is equel or smaller than sequencems (with 200ms toleration), 
-	 * it was silence and manually mark the frame which indicates to not count interpolated frame and resynchronize jitterbuffer
-	 */
-	if( msdiff > 1000 and (transit <= (sequencems + 200)) ) {
-		// check if the last frame was CNG or the last frame was DTMF - force mark bit
-		if(lastcng or (lastframetype == AST_FRAME_DTMF)) {
-			if(verbosity > 4) printf("jitterbuffer: manually marking packet, msdiff(%d) > 1000 and transit (%Lf) <= ((sequencems(%u) + 200)\n", msdiff, transit, sequencems);
-			frame->marker = 1;
+		/* difference (in ms) between timestamps in packet header and rtp timestamps. this should 
+		 * be ideally equal to zero. Negative values mean that packet arrives earlier and positive 
+		 * values indicates that packet was late 
+		 */
+		long double transit = (timeval_subtract(&tsdiff, *header_ts, s->lastTimeRecJ) ? -timeval2micro(tsdiff)/1000.0 : timeval2micro(tsdiff)/1000.0) - ((double)getTimestamp() - s->lastTimeStampJ)/(double)samplerate/1000;
+		
+		/* and now if there is bigger (lets say one second) timestamp difference (calculated from packet headers) 
+		 * between two last packets and transit time is equel or smaller than sequencems (with 200ms toleration), 
+		 * it was silence and manually mark the frame which indicates to not count interpolated frame and resynchronize jitterbuffer
+		 */
+		if( msdiff > 1000 and (transit <= (sequencems + 200)) ) {
+			// check if the last frame was CNG or the last frame was DTMF - force mark bit
+			if(lastcng or lastframe_dtmf) {
+				if(verbosity > 4) printf("jitterbuffer: manually marking packet, msdiff(%d) > 1000 and transit (%Lf) <= ((sequencems(%u) + 200)\n", msdiff, transit, sequencems);
+				frame->marker = 1;
+			}
 		}
 	}
 	
 	// fetch packet from jitterbuffer every 20 ms regardless on packet loss or delay
 	while( msdiff >= packetization )  {
-		if(frame->marker or lastframetype == AST_FRAME_DTMF) {
+		if(frame->marker or lastframe_dtmf) {
 			/* if last frame was marked or DTMF, ignore interpolated frames */
 			channel->last_loss_burst = 0;
 		}
@@ -883,9 +989,257 @@ RTP::jitterbuffer(struct ast_channel *channel, int savePayload) {
 	}
 
 	//printf("s[%u] codec[%d]\n",getSeqNum(), codec);
-	ast_jb_put(channel, frame, &header_ts);
+	ast_jb_put(channel, frame, header_ts);
 	
-	this->clearAudioBuff(owner, channel);
+	if(!replay) {
+		this->clearAudioBuff(owner, channel);
+	}
+}
+
+/* jitterbuffer simulations fix1 / fix2 / adapt - inline or (jitterbuffer_deferred_threads) only logged for replay in cJitterbufferDeferredPool */
+void
+RTP::jitterbuffer_mos_channels() {
+	if(!(opt_jitterbuffer_f1 or opt_jitterbuffer_f2 or opt_jitterbuffer_adapt)) {
+		return;
+	}
+	if(jb_deferred <= 0) {
+		if(opt_jitterbuffer_f1)
+			jitterbuffer(channel_fix1, 0);
+		if(opt_jitterbuffer_f2)
+			jitterbuffer(channel_fix2, 0);
+		if(opt_jitterbuffer_adapt)
+			jitterbuffer(channel_adapt, 0);
+		return;
+	}
+	for(unsigned i = 0; i < sizeof(jb_check_channels) / sizeof(jb_check_channels[0]); i++) {
+		if(jb_check_channels[i]) {
+			jitterbuffer(jb_check_channels[i], 0);
+		}
+	}
+	if(codec == PAYLOAD_TELEVENT) return;
+	sJitterbufferLogItem item;
+	memset(&item, 0, sizeof(item));
+	item.time_us = getTimeUS(header_ts);
+	item.ts = get_jitterbuffer_frame_ts();
+	item.seq = getSeqNum();
+	item.codec = codec;
+	item.packetization = packetization;
+	item.channel_packetization = jb_channels_packetization;
+	if(ignore) {
+		item.flags |= JB_LOG_IGNORE;
+	}
+	// the same changes of frame as in jitterbuffer (frame->frametype is used by read as lastframetype)
+	frame->marker = getMarker();
+	if(check_jitterbuffer_packetization()) {
+		if(codec == PAYLOAD_G729 or codec == PAYLOAD_G723 or codec == PAYLOAD_AMR or codec == PAYLOAD_AMRWB) {
+			jitterbuffer_payload();
+			item.payload_len = payload_len > 0 ? payload_len : 0;
+			if(codec == PAYLOAD_G723 and (unsigned char)payload_data[0] & 2) {
+				item.flags |= JB_LOG_G723_SID;
+			}
+			jitterbuffer_mark_frame();
+		}
+		if(lastcng or lastframetype == AST_FRAME_DTMF) {
+			frame->marker = 1;
+		}
+	}
+	if(frame->marker) {
+		item.flags |= JB_LOG_MARKER;
+	}
+	if(frame->frametype == AST_FRAME_DTMF) {
+		item.flags |= JB_LOG_DTMF;
+	}
+	if(lastframetype == AST_FRAME_DTMF) {
+		item.flags |= JB_LOG_LAST_DTMF;
+	}
+	jitterbuffer_log_add(&item);
+}
+
+void
+RTP::jitterbuffer_mos_channels_reset() {
+	if(jb_deferred > 0) {
+		sJitterbufferLogItem item;
+		memset(&item, 0, sizeof(item));
+		item.flags = JB_LOG_RESET;
+		jitterbuffer_log_add(&item);
+		for(unsigned i = 0; i < sizeof(jb_check_channels) / sizeof(jb_check_channels[0]); i++) {
+			if(jb_check_channels[i]) {
+				ast_jb_empty_and_reset(jb_check_channels[i]);
+				ast_jb_destroy(jb_check_channels[i]);
+			}
+		}
+		return;
+	}
+	if(opt_jitterbuffer_adapt) {
+		ast_jb_empty_and_reset(channel_adapt);
+		ast_jb_destroy(channel_adapt);
+	}
+	if(opt_jitterbuffer_f1) {
+		ast_jb_empty_and_reset(channel_fix1);
+		ast_jb_destroy(channel_fix1);
+	}
+	if(opt_jitterbuffer_f2) {
+		ast_jb_empty_and_reset(channel_fix2);
+		ast_jb_destroy(channel_fix2);
+	}
+}
+
+void
+RTP::jitterbuffer_log_add(sJitterbufferLogItem *item) {
+	if(!jb_log) {
+		jb_log = new FILE_LINE(0) cJitterbufferLog;
+	}
+	jb_log->items.push_back(*item);
+}
+
+/* hands the log to the pool - with interval the replay closes the MOS interval as save_mos_graph does */
+void
+RTP::jitterbuffer_log_submit(bool interval) {
+	if(!jb_log) {
+		if(!interval) {
+			return;
+		}
+		jb_log = new FILE_LINE(0) cJitterbufferLog;
+	}
+	if(interval) {
+		jb_log->interval = true;
+		jb_log->received = stats.received;
+		jb_log->connected = call_owner && ((Call*)call_owner)->connect_time_us;
+		jb_log->saddr = saddr;
+		jb_log->time_s = header_ts.tv_sec;
+		jb_log->jitter = jitter;
+		jb_log->loss = last_stat_loss_perc_mult10;
+		if(sverb.jitterbuffer_deferred_check) {
+			// MOS of the inline simulations as save_mos_jitterbuffer, compared after the replay (jitterbuffer_log_check)
+			for(unsigned i = 0; i < sizeof(jb_check_channels) / sizeof(jb_check_channels[0]); i++) {
+				ast_channel *channel = jb_check_channels[i];
+				if(channel) {
+					jb_log->check_mos[i] = calculate_mos_fromchannel(this, channel, 1, jb_log->received, jb_log->connected);
+					memcpy(channel->last_interval_loss, channel->loss, sizeof(unsigned short int) * 128);
+				} else {
+					jb_log->check_mos[i] = 45;
+				}
+			}
+			jb_log->check = true;
+		}
+	}
+	cJitterbufferLog *log = jb_log;
+	jb_log = NULL;
+	jitterbuffer_log_lock();
+	cJitterbufferLog **last = &jb_log_pending;
+	while(*last) {
+		last = &(*last)->next;
+	}
+	*last = log;
+	bool queue = !jb_log_queued;
+	jb_log_queued = true;
+	jitterbuffer_log_unlock();
+	if(queue && !jitterbufferDeferredPool->add(this)) {
+		// pool is terminating
+		u_int64_t packets = 0;
+		while(jitterbuffer_log_replay_pending(&packets));
+	}
+}
+
+void
+RTP::jitterbuffer_log_wait() {
+	while(jb_log_queued) {
+		USLEEP(100);
+	}
+	__sync_synchronize();
+}
+
+/* called by worker of the pool - replays all pending logs of the stream, false if there is nothing more */
+bool
+RTP::jitterbuffer_log_replay_pending(u_int64_t *packets) {
+	jitterbuffer_log_lock();
+	cJitterbufferLog *logs = jb_log_pending;
+	jb_log_pending = NULL;
+	if(!logs) {
+		jb_log_queued = false;
+	}
+	jitterbuffer_log_unlock();
+	if(!logs) {
+		return(false);
+	}
+	while(logs) {
+		cJitterbufferLog *next = logs->next;
+		*packets += jitterbuffer_log_replay(logs);
+		delete logs;
+		logs = next;
+	}
+	return(true);
+}
+
+u_int64_t
+RTP::jitterbuffer_log_replay(cJitterbufferLog *log) {
+	ast_channel *channels[] = { 
+		opt_jitterbuffer_f1 ? channel_fix1 : NULL, 
+		opt_jitterbuffer_f2 ? channel_fix2 : NULL, 
+		opt_jitterbuffer_adapt ? channel_adapt : NULL
+	};
+	ast_frame jb_frame;
+	memset(&jb_frame, 0, sizeof(jb_frame));
+	for(vector<sJitterbufferLogItem>::iterator iter = log->items.begin(); iter != log->items.end(); iter++) {
+		sJitterbufferLogItem *item = &(*iter);
+		for(unsigned i = 0; i < sizeof(channels) / sizeof(channels[0]); i++) {
+			ast_channel *channel = channels[i];
+			if(!channel) {
+				continue;
+			}
+			if(item->flags & JB_LOG_RESET) {
+				ast_jb_empty_and_reset(channel);
+				ast_jb_destroy(channel);
+				continue;
+			}
+			channel->codec = item->codec;
+			if(item->packetization <= 0) {
+				continue;
+			}
+			if((item->flags & JB_LOG_G723_SID) && ast_test_flag(&channel->jb, (1 << 2))) {
+				continue;
+			}
+			channel->packetization = item->channel_packetization;
+			channel->rawstream = NULL;
+			jb_frame.frametype = item->flags & JB_LOG_DTMF ? AST_FRAME_DTMF : AST_FRAME_VOICE;
+			jb_frame.lastframetype = item->flags & JB_LOG_LAST_DTMF ? AST_FRAME_DTMF : AST_FRAME_VOICE;
+			jb_frame.len = item->packetization;
+			jb_frame.ts = item->ts;
+			jb_frame.marker = item->flags & JB_LOG_MARKER ? 1 : 0;
+			jb_frame.seqno = item->seq;
+			jb_frame.ignore = item->flags & JB_LOG_IGNORE ? 1 : 0;
+			jb_frame.delivery.tv_sec = item->time_us / 1000000;
+			jb_frame.delivery.tv_usec = item->time_us % 1000000;
+			jitterbuffer_put(channel, &jb_frame, &jb_frame.delivery, item->packetization, item->flags & JB_LOG_LAST_DTMF, 0, true);
+		}
+	}
+	if(log->interval) {
+		save_mos_jitterbuffer(log->received, log->connected, jb_deferred_mos_counter, false);
+		if(log->check) {
+			jitterbuffer_log_check(log);
+		}
+		++jb_deferred_mos_counter;
+		if(!is_read_from_file_simple()) {
+			rtp_stat.update(log->saddr, log->time_s, last_interval_mosf1, last_interval_mosf2, last_interval_mosAD, log->jitter, log->loss);
+		}
+	}
+	return(log->items.size());
+}
+
+void
+RTP::jitterbuffer_log_check(cJitterbufferLog *log) {
+	unsigned char mos[] = { last_interval_mosf1, last_interval_mosf2, last_interval_mosAD };
+	if(memcmp(mos, log->check_mos, sizeof(mos))) {
+		Call *owner = (Call*)call_owner;
+		syslog(LOG_WARNING, "jitterbuffer deferred check: call-id[%s] ssrc[%x] interval %u - MOS inline %u / %u / %u, replay %u / %u / %u (received %u, connected %i)",
+		       owner ? owner->get_fbasename_safe() : "N/A", getSSRC(), jb_deferred_mos_counter,
+		       log->check_mos[0], log->check_mos[1], log->check_mos[2],
+		       mos[0], mos[1], mos[2],
+		       log->received, log->connected);
+	} else if(sverb.jitter) {
+		printf("jitterbuffer deferred check: ssrc[%x] interval %u - MOS %u / %u / %u ok\n",
+		       getSSRC(), jb_deferred_mos_counter, mos[0], mos[1], mos[2]);
+	}
 }
 #endif
 
@@ -953,6 +1307,12 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 	if(this->stopReadProcessing) {
 		return(false);
 	}
+	
+	if(jb_deferred < 0) {
+		// streams with graph keep the simulations inline - graph gets MOS of interval together with the other records
+		jb_deferred = jitterbufferDeferredPool && !graph.isOpenOrEnableAutoOpen();
+	}
+	prepareJitterbufferChannels(false);
  
 	this->data = data; 
 	this->header_ip = header_ip;
@@ -1001,7 +1361,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 					syslog(LOG_NOTICE, "warning - packet from sensor (%i/%s) in RTP created for sensor (%i/%s) - call %s", 
 					       sensor_id, sensor_ip.isSet() ? sensor_ip.getString().c_str() : "-", 
 					       this->sensor_id, this->sensor_ip.isSet() ? this->sensor_ip.getString().c_str() : "-",
-					       owner->fbasename);
+					       owner->fbasename.c_str());
 					lastTimeSyslog = actTime;
 				}
 			}
@@ -1080,7 +1440,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 	if(payload_len < 0) {
 		if(owner) {
 			if(!owner->error_negative_payload_length) {
-				syslog(LOG_NOTICE, "warning - negative payload_len in call %s", owner->fbasename);
+				syslog(LOG_NOTICE, "warning - negative payload_len in call %s", owner->fbasename.c_str());
 				owner->error_negative_payload_length = true;
 			}
 		} else {
@@ -1183,18 +1543,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 
 			resetgraph = true;
 
-			if(opt_jitterbuffer_adapt) {
-				ast_jb_empty_and_reset(channel_adapt);
-				ast_jb_destroy(channel_adapt);
-			}
-			if(opt_jitterbuffer_f1) {
-				ast_jb_empty_and_reset(channel_fix1);
-				ast_jb_destroy(channel_fix1);
-			}
-			if(opt_jitterbuffer_f2) {
-				ast_jb_empty_and_reset(channel_fix2);
-				ast_jb_destroy(channel_fix2);
-			}
+			jitterbuffer_mos_channels_reset();
 
 			forcemark = _forcemark_diff_seq;
 		} else {
@@ -1254,18 +1603,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 
 		if(!(lastframetype == AST_FRAME_DTMF and codec != PAYLOAD_TELEVENT) and diffSsrcInEqAddrPort) {
 			// reset jitter if ssrc changed
-			if(opt_jitterbuffer_adapt) {
-				ast_jb_empty_and_reset(channel_adapt);
-				ast_jb_destroy(channel_adapt);
-			}
-			if(opt_jitterbuffer_f1) {
-				ast_jb_empty_and_reset(channel_fix1);
-				ast_jb_destroy(channel_fix1);
-			}
-			if(opt_jitterbuffer_f2) {
-				ast_jb_empty_and_reset(channel_fix2);
-				ast_jb_destroy(channel_fix2);
-			}
+			jitterbuffer_mos_channels_reset();
 		}
 		//reset silence DSP
 		if(DSP) {
@@ -1275,18 +1613,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 
 	if(lastframetype == AST_FRAME_DTMF and codec != PAYLOAD_TELEVENT) {
 		// last frame was DTMF and now we have voice. Reset jitterbuffers (case 338f884b17f9e5de6c830c237dcc09dd) 
-		if(opt_jitterbuffer_adapt) {
-			ast_jb_empty_and_reset(channel_adapt);
-			ast_jb_destroy(channel_adapt);
-		}
-		if(opt_jitterbuffer_f1) {
-			ast_jb_empty_and_reset(channel_fix1);
-			ast_jb_destroy(channel_fix1);
-		}
-		if(opt_jitterbuffer_f2) {
-			ast_jb_empty_and_reset(channel_fix2);
-			ast_jb_destroy(channel_fix2);
-		}
+		jitterbuffer_mos_channels_reset();
 		//reset silence DSP
 		if(DSP) {
 			memcpy(DSP->last_interval_loss_hist, DSP->loss_hist, sizeof(unsigned short int) * 32);
@@ -1356,18 +1683,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 		// on reinvite (which indicates forcemark_by_owner completely reset rtp jitterbuffer simulator and 
 		// there are cases where on reinvite rtp stream stops and there is gap in rtp sequence and timestamp but 
 		// since it was reinvite the stream just continues as expected
-		if(opt_jitterbuffer_adapt) {
-			ast_jb_empty_and_reset(channel_adapt);
-			ast_jb_destroy(channel_adapt);
-		}
-		if(opt_jitterbuffer_f1) {
-			ast_jb_empty_and_reset(channel_fix1);
-			ast_jb_destroy(channel_fix1);
-		}
-		if(opt_jitterbuffer_f2) {
-			ast_jb_empty_and_reset(channel_fix2);
-			ast_jb_destroy(channel_fix2);
-		}
+		jitterbuffer_mos_channels_reset();
 
 		forcemark_by_owner = false;
 		forcemark = _forcemark_sip_sdp;
@@ -1397,6 +1713,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 	bool recordingRequested_use_jitterbuffer_channel_record = false;
 	bool recordingRequested_enable_jitterbuffer_savepayload = false;
 	if(recordingRequested) {
+		prepareJitterbufferChannels(true);
 		// MOS LQO is calculated only if the call is connected 
 		recordingRequested_use_jitterbuffer_channel_record =
 			!owner ||
@@ -1476,7 +1793,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 				/* open file for raw codec */
 				unsigned long unique = getTimestamp();
 				char tmp[1024 + 100];
-				snprintf(tmp, sizeof(tmp), "%s.%d.%lu.%d.%ld.%ld.raw", basefilename, ssrc_index, unique, codec, header->ts.tv_sec, header->ts.tv_usec);
+				snprintf(tmp, sizeof(tmp), "%s.%d.%lu.%d.%ld.%ld.raw", basefilename.c_str(), ssrc_index, unique, codec, header->ts.tv_sec, header->ts.tv_usec);
 				if(gfileRAW)  {
 					jitterbuffer_fixed_flush(channel_record);
 					ast_jb_empty_and_reset(channel_record);
@@ -1496,6 +1813,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 						prevrtp->header_ts = header_ts;
 						prevrtp->codec = prevrtp->prev_codec;
 						if(recordingRequested_use_jitterbuffer_channel_record) {
+							prevrtp->prepareJitterbufferChannels(true);
 							prevrtp->jitterbuffer(prevrtp->channel_record, recordingRequested_enable_jitterbuffer_savepayload);
 						}
 					}
@@ -1531,7 +1849,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 				}
 
 				/* write file info to "playlist" */
-				snprintf(tmp, sizeof(tmp), "%s.rawInfo", basefilename);
+				snprintf(tmp, sizeof(tmp), "%s.rawInfo", basefilename.c_str());
 				owner->iscaller_consecutive[iscaller] = 0;
 				bool gfileRAWInfo_exists = file_exists(tmp);
 				FILE *gfileRAWInfo = fopen(tmp, "a");
@@ -1542,7 +1860,7 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 					fprintf(gfileRAWInfo, "%d:%lu:%d:%d:%ld:%ld\n", ssrc_index, unique, codec, frame_size, header->ts.tv_sec, header->ts.tv_usec);
 					fclose(gfileRAWInfo);
 				} else {
-					syslog(LOG_ERR, "Cannot open file %s.rawInfo for writing\n", basefilename);
+					syslog(LOG_ERR, "Cannot open file %s.rawInfo for writing\n", basefilename.c_str());
 				}
 			}
 		}
@@ -1661,21 +1979,15 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 				break;
 			}
 
-			channel_fix1->packetization = default_packetization = 
-				channel_fix2->packetization = channel_adapt->packetization = 
-				channel_record->packetization = packetization = apacketization;
+			default_packetization = packetization = apacketization;
+			setChannelsPacketization(packetization);
 
 			if(packetization >= 10) {
 				if(verbosity > 3) printf("packetization:[%d] ssrc[%x]\n", packetization, getSSRC());
 
 				packetization_iterator = 10; // this will cause that packetization is estimated as final
 
-				if(opt_jitterbuffer_f1)
-					jitterbuffer(channel_fix1, 0);
-				if(opt_jitterbuffer_f2)
-					jitterbuffer(channel_fix2, 0);
-				if(opt_jitterbuffer_adapt)
-					jitterbuffer(channel_adapt, 0);
+				jitterbuffer_mos_channels();
 			} 
 
 		} 
@@ -1771,15 +2083,10 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 				}
 			} else {
 				packetization_iterator++;
-				channel_fix1->packetization = channel_fix2->packetization = channel_adapt->packetization = channel_record->packetization = packetization;
+				setChannelsPacketization(packetization);
 				if(verbosity > 3) printf("[%x] packetization:[%d]\n", getSSRC(), packetization);
 
-				if(opt_jitterbuffer_f1)
-					jitterbuffer(channel_fix1, 0);
-				if(opt_jitterbuffer_f2)
-					jitterbuffer(channel_fix2, 0);
-				if(opt_jitterbuffer_adapt)
-					jitterbuffer(channel_adapt, 0);
+				jitterbuffer_mos_channels();
 				if(recordingRequested) {
 					if(recordingRequested_use_jitterbuffer_channel_record &&
 					   checkDuplChannelRecordSeq(seq)) {
@@ -1908,7 +2215,8 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 			if(change_packetization_iterator > 1) { 
 				//packetization changed for two last packets
 				if(verbosity > 3) printf("[%x] changing packetization:[%d]->[%d]\n", getSSRC(), packetization, curpacketization);
-				channel_fix1->packetization = channel_fix2->packetization = channel_adapt->packetization = channel_record->packetization = packetization = curpacketization;
+				packetization = curpacketization;
+				setChannelsPacketization(packetization);
 				last_packetization = curpacketization;
 				change_packetization_iterator = 0;
 			}
@@ -1922,15 +2230,10 @@ RTP::read(unsigned char* data, iphdr2 *header_ip, unsigned *len, struct pcap_pkt
 			} else if(payload_len == 24*3) {
 				packetization = 90;
 			}
-			channel_fix1->packetization = channel_fix2->packetization = channel_adapt->packetization = channel_record->packetization = packetization;
+			setChannelsPacketization(packetization);
 		}
 		//printf("packetization [%d]\n", packetization);
-		if(opt_jitterbuffer_f1)
-			jitterbuffer(channel_fix1, 0);
-		if(opt_jitterbuffer_f2)
-			jitterbuffer(channel_fix2, 0);
-		if(opt_jitterbuffer_adapt)
-			jitterbuffer(channel_adapt, 0);
+		jitterbuffer_mos_channels();
 		if(recordingRequested) {
 			if(recordingRequested_use_jitterbuffer_channel_record &&
 			   checkDuplChannelRecordSeq(seq)) {
@@ -2764,20 +3067,26 @@ RTP::dump() {
 
 	double burstr, lossr;
 	printf("jitter stats:\n");
-	burstr_calculate(channel_fix1, s->received, &burstr, &lossr, 1);
-	//printf("s->received: %d, loss: %d, bursts: %d\n", s->received, lost, bursts);
-	printf("fix(50/50)\tloss rate:\t%f\n", lossr);
-	printf("fix(50/50)\tburst rate:\t%f\n", burstr);
-
-	burstr_calculate(channel_fix2, s->received, &burstr, &lossr, 1);
-	//printf("s->received: %d, loss: %d, bursts: %d\n", s->received, lost, bursts);
-	printf("fix(200/200)\tloss rate:\t%f\n", lossr);
-	printf("fix(200/200)\tburst rate:\t%f\n", burstr);
-
-	burstr_calculate(channel_adapt, s->received, &burstr, &lossr, 1);
-	//printf("s->received: %d, loss: %d, bursts: %d\n", s->received, lost, bursts);
-	printf("adapt(500/500)\tloss rate:\t%f\n", lossr);
-	printf("adapt(500/500)\tburst rate:\t%f\n", burstr);
+	if(channel_fix1) {
+		burstr_calculate(channel_fix1, s->received, &burstr, &lossr, 1);
+		//printf("s->received: %d, loss: %d, bursts: %d\n", s->received, lost, bursts);
+		printf("fix(50/50)\tloss rate:\t%f\n", lossr);
+		printf("fix(50/50)\tburst rate:\t%f\n", burstr);
+	}
+
+	if(channel_fix2) {
+		burstr_calculate(channel_fix2, s->received, &burstr, &lossr, 1);
+		//printf("s->received: %d, loss: %d, bursts: %d\n", s->received, lost, bursts);
+		printf("fix(200/200)\tloss rate:\t%f\n", lossr);
+		printf("fix(200/200)\tburst rate:\t%f\n", burstr);
+	}
+
+	if(channel_adapt) {
+		burstr_calculate(channel_adapt, s->received, &burstr, &lossr, 1);
+		//printf("s->received: %d, loss: %d, bursts: %d\n", s->received, lost, bursts);
+		printf("adapt(500/500)\tloss rate:\t%f\n", lossr);
+		printf("adapt(500/500)\tburst rate:\t%f\n", burstr);
+	}
 	printf("---\n");
 }
 
@@ -2886,32 +3195,36 @@ int calculate_mos_fromdsp(RTP *rtp, struct dsp *DSP) {
 	return mos;
 }
 
-int calculate_mos_fromrtp(RTP *rtp, int jittertype, int lastinterval) {
-	double burstr, lossr;
+int calculate_mos_fromrtp(RTP *rtp, int jittertype, int lastinterval, int64_t received, int connected) {
+	ast_channel *channel = NULL;
 	switch(jittertype) {
 	case 1: 
-		if(rtp->channel_fix1) {
-			burstr_calculate(rtp->channel_fix1, rtp->stats.received, &burstr, &lossr, lastinterval);
-		} else {
-			return 45;
-		}
+		channel = rtp->channel_fix1;
 		break;  
 	case 2: 
-		if(rtp->channel_fix2) {
-			burstr_calculate(rtp->channel_fix2, rtp->stats.received, &burstr, &lossr, lastinterval);
-		} else {
-			return 45;
-		}
+		channel = rtp->channel_fix2;
 		break;  
 	case 3: 
-		if(rtp->channel_adapt) {
-			burstr_calculate(rtp->channel_adapt, rtp->stats.received, &burstr, &lossr, lastinterval);
-		} else {
-			return 45;
-		}
+		channel = rtp->channel_adapt;
 		break;  
 	}       
-	int mos = (int)round(calculate_mos(lossr, burstr, rtp->first_codec, rtp->stats.received, rtp->call_owner && ((Call*)rtp->call_owner)->connect_time_us) * 10);
+	if(!channel) {
+		return 45;
+	}
+	return(calculate_mos_fromchannel(rtp, channel, lastinterval, received, connected));
+}
+
+/* received and connected (-1 - current state of stream and call) are given by the replay of jitterbuffer log - the values at the end of MOS interval */
+int calculate_mos_fromchannel(RTP *rtp, ast_channel *channel, int lastinterval, int64_t received, int connected) {
+	double burstr, lossr;
+	if(received < 0) {
+		received = rtp->stats.received;
+	}
+	if(connected < 0) {
+		connected = rtp->call_owner && ((Call*)rtp->call_owner)->connect_time_us;
+	}
+	burstr_calculate(channel, received, &burstr, &lossr, lastinterval);
+	int mos = (int)round(calculate_mos(lossr, burstr, rtp->first_codec, received, connected) * 10);
 	return mos;
 }       
 
@@ -3080,3 +3393,125 @@ RTPstat::flush() {
 	flush_and_clean(maps[0]);
 	flush_and_clean(maps[1]);
 }
+
+
+cJitterbufferDeferredPool::cJitterbufferDeferredPool(unsigned threadsCount) {
+	this->threadsCount = threadsCount;
+	this->workers = new FILE_LINE(0) sWorker[threadsCount];
+	memset(this->workers, 0, sizeof(sWorker) * threadsCount);
+	for(unsigned i = 0; i < threadsCount; i++) {
+		this->workers[i].pool = this;
+		this->workers[i].index = i;
+	}
+	this->_sync = 0;
+	this->terminating = false;
+}
+
+cJitterbufferDeferredPool::~cJitterbufferDeferredPool() {
+	this->terminate();
+	delete [] this->workers;
+}
+
+void cJitterbufferDeferredPool::start() {
+	for(unsigned i = 0; i < this->threadsCount; i++) {
+		vm_pthread_create(("jitterbuffer " + intToString(i)).c_str(),
+				  &this->workers[i].thread, NULL, _workerThreadFunction, &this->workers[i], __FILE__, __LINE__);
+	}
+}
+
+void cJitterbufferDeferredPool::terminate() {
+	lock();
+	if(this->terminating) {
+		unlock();
+		return;
+	}
+	this->terminating = true;
+	unlock();
+	for(unsigned i = 0; i < this->threadsCount; i++) {
+		if(this->workers[i].thread) {
+			pthread_join(this->workers[i].thread, NULL);
+			this->workers[i].thread = 0;
+		}
+	}
+}
+
+bool cJitterbufferDeferredPool::add(RTP *rtp) {
+	lock();
+	if(this->terminating) {
+		unlock();
+		return(false);
+	}
+	this->queue.push_back(rtp);
+	unlock();
+	return(true);
+}
+
+string cJitterbufferDeferredPool::getStatString() {
+	ostringstream outStr;
+	outStr << fixed << "tjb[";
+	u_int64_t actTimeMS = getTimeMS_rdtsc();
+	lock();
+	size_t queueSize = this->queue.size();
+	unlock();
+	for(unsigned i = 0; i < this->threadsCount; i++) {
+		sWorker *worker = &this->workers[i];
+		if(i) {
+			outStr << "|";
+		}
+		u_int64_t packets = worker->packets;
+		if(worker->statTimeMS_last && actTimeMS > worker->statTimeMS_last) {
+			outStr << setprecision(1) << (packets - worker->packets_last) / ((actTimeMS - worker->statTimeMS_last) / 1000.) / 1000 << "kp/s";
+		} else {
+			outStr << "-";
+		}
+		worker->packets_last = packets;
+		worker->statTimeMS_last = actTimeMS;
+		if(worker->threadId) {
+			if(worker->threadPstatData[0].cpu_total_time) {
+				worker->threadPstatData[1] = worker->threadPstatData[0];
+			}
+			pstat_get_data(worker->threadId, worker->threadPstatData);
+			if(worker->threadPstatData[0].cpu_total_time && worker->threadPstatData[1].cpu_total_time) {
+				double ucpu_usage, scpu_usage;
+				pstat_calc_cpu_usage_pct(
+					&worker->threadPstatData[0], &worker->threadPstatData[1],
+					&ucpu_usage, &scpu_usage);
+				outStr << "/" << setprecision(1) << ucpu_usage + scpu_usage << "%";
+			}
+		}
+	}
+	outStr << "/q" << queueSize << "]";
+	return(outStr.str());
+}
+
+void cJitterbufferDeferredPool::workerThreadFunction(sWorker *worker) {
+	worker->threadId = get_unix_tid();
+	syslog(LOG_NOTICE, "start thread jitterbuffer/%i", worker->threadId);
+	unsigned int usleepCounter = 0;
+	while(true) {
+		lock();
+		if(!this->queue.size()) {
+			bool terminating = this->terminating;
+			unlock();
+			if(terminating) {
+				break;
+			}
+			USLEEP_C(100, usleepCounter++);
+			continue;
+		}
+		RTP *rtp = this->queue.front();
+		this->queue.pop_front();
+		unlock();
+		u_int64_t packets = 0;
+		// logs submitted during the replay are taken too - the stream leaves the queue only when it has nothing pending
+		while(rtp->jitterbuffer_log_replay_pending(&packets));
+		worker->packets += packets;
+		usleepCounter = 0;
+	}
+}
+
+void *cJitterbufferDeferredPool::_workerThreadFunction(void *arg) {
+	sWorker *worker = (sWorker*)arg;
+	worker->pool->workerThreadFunction(worker);
+	return(NULL);
+}
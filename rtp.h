@@ -10,6 +10,7 @@
 #include <iostream>
 
 #include "tools.h"
+#include "slab_alloc.h"
 #include "dsp.h"
 
 //#include "jitterbuffer/asterisk/channel.h"
@@ -23,7 +24,8 @@ using namespace std;
 int get_ticks_bycodec(int);
 
 void burstr_calculate(struct ast_channel *chan, u_int32_t received, double *burstr, double *lossr, int lastinterval);
-int calculate_mos_fromrtp(RTP *rtp, int jittertype, int lastinterval);
+int calculate_mos_fromrtp(RTP *rtp, int jittertype, int lastinterval, int64_t received = -1, int connected = -1);
+int calculate_mos_fromchannel(RTP *rtp, struct ast_channel *channel, int lastinterval, int64_t received = -1, int connected = -1);
 double calculate_mos_g711(double ppl, double burstr, int version);
 double calculate_mos(double ppl, double burstr, int codec, unsigned int received, bool call_is_connected);
 
@@ -192,6 +194,51 @@ enum eRtpMarkType {
 	_forcemark_sip_sdp = 3
 };
 
+#define JB_LOG_MARKER		0x01
+#define JB_LOG_IGNORE		0x02
+#define JB_LOG_DTMF		0x04
+#define JB_LOG_LAST_DTMF	0x08
+#define JB_LOG_G723_SID		0x10
+#define JB_LOG_RESET		0x20
+
+/* packet of deferred jitterbuffer simulation - frame fields already resolved by RTP::read */
+struct sJitterbufferLogItem {
+	u_int64_t time_us;		//!< arrival time
+	u_int32_t ts;			//!< rtp timestamp in ms (frame->ts)
+	u_int16_t seq;
+	u_int16_t payload_len;
+	u_int16_t codec;
+	int16_t packetization;
+	int16_t channel_packetization;
+	u_int8_t flags;			//!< JB_LOG_*
+};
+
+/* packets of one MOS interval (or the rest of the stream) waiting for replay */
+struct cJitterbufferLog {
+	cJitterbufferLog() {
+		interval = false;
+		received = 0;
+		connected = false;
+		time_s = 0;
+		jitter = 0;
+		loss = 0;
+		check = false;
+		memset(check_mos, 0, sizeof(check_mos));
+		next = NULL;
+	}
+	vector<sJitterbufferLogItem> items;
+	bool interval;			//!< replay closes the MOS interval (values of save_mos_graph at the end of interval follow)
+	u_int32_t received;		//!< received packets of the stream and the state of the call at the end of interval -
+	bool connected;			//!< MOS of the replay must not depend on the time of replay
+	vmIP saddr;
+	u_int32_t time_s;
+	double jitter;
+	double loss;
+	bool check;			//!< check_mos holds MOS fix1 / fix2 / adapt of the inline simulation (sverb jitterbuffer_deferred_check)
+	unsigned char check_mos[3];
+	cJitterbufferLog *next;
+};
+
 
 /**
  * This class implements operations on RTP strem
@@ -237,14 +284,22 @@ public:
 	RtpGraphSaver graph;
 	FILE *gfileRAW;	 //!< file for storing RTP payload in RAW format
 	char *gfileRAW_buffer;
-	char gfilename[1024];	//!< file name of this file 
-	char basefilename[1024];
+	string gfilename;	//!< file name of this file 
+	string basefilename;
 	int rawiterator;	//!< iterator for raw file name 
-	struct ast_channel *channel_fix1;
+	struct ast_channel *channel_fix1;	//!< jitterbuffer channels and frame are allocated on first use (prepareJitterbufferChannels)
 	struct ast_channel *channel_fix2;
 	struct ast_channel *channel_adapt;
 	struct ast_channel *channel_record;
+	struct ast_channel *jb_check_channels[3];	//!< inline simulations fix1 / fix2 / adapt of deferred stream (sverb jitterbuffer_deferred_check)
 	struct ast_frame *frame;
+	int jb_channels_packetization;	//!< packetization of channels fix1 / fix2 / adapt
+	int8_t jb_deferred;		//!< simulations fix1 / fix2 / adapt are replayed from jb_log by cJitterbufferDeferredPool (-1 - not decided)
+	u_int32_t jb_deferred_mos_counter;
+	cJitterbufferLog *jb_log;
+	cJitterbufferLog *jb_log_pending;
+	volatile bool jb_log_queued;
+	volatile int jb_log_sync;
 	int lastframetype;		//!< last packet sequence number
 	char lastcng;		//!< last packet sequence number
 	u_int16_t seq;		//!< current sequence number
@@ -410,6 +465,9 @@ public:
 	*/
 	~RTP();
 	
+	SLAB_POOL_OPERATORS(slab_pool)
+	static cSlabPool slab_pool;
+	
 	void setSRtpDecrypt(class RTPsecure *srtp_decrypt);
 
 	/**
@@ -422,6 +480,28 @@ public:
 	*/
 	void jitterbuffer(struct ast_channel *channel, int savePayload);
 
+	/**
+	 * @brief allocates jitterbuffer channels which are needed by the stream
+	 *
+	 * channels fix1 / fix2 / adapt are created only for the enabled jitterbuffer options, channel record only when recording is requested
+	 *
+	*/
+	void prepareJitterbufferChannels(bool record);
+	
+	/**
+	 * @brief jitterbuffer simulations fix1 / fix2 / adapt for current packet
+	 *
+	 * with jitterbuffer_deferred_threads only adds the packet to jb_log
+	 *
+	*/
+	void jitterbuffer_mos_channels();
+	void jitterbuffer_mos_channels_reset();
+	void jitterbuffer_log_submit(bool interval);
+	void jitterbuffer_log_wait();
+	bool jitterbuffer_log_replay_pending(u_int64_t *packets);
+	void setChannelsPacketization(int packetization);
+	size_t getJitterbufferChannelsSize();
+
 	void process_dtmf_rfc2833();
 
 	/**
@@ -585,6 +665,7 @@ public:
 	u_int32_t getLost() { return s->probation ? 0 : ((s->cycles + s->max_seq) - s->base_seq + 1) - s->received; };
 
 	void save_mos_graph(bool delimiter);
+	void save_mos_jitterbuffer(u_int32_t received, bool connected, u_int32_t counter, bool saveGraph);
 	
 	inline void clearAudioBuff(class Call *call, ast_channel *channel);
 	
@@ -666,10 +747,70 @@ private:
 	
 	sRSA rsa;
 	
+private:
+	int get_jitterbuffer_frame_ts();
+	bool check_jitterbuffer_packetization();
+	void jitterbuffer_payload();
+	void jitterbuffer_mark_frame();
+	void jitterbuffer_put(struct ast_channel *channel, struct ast_frame *frame, struct timeval *header_ts, int packetization, bool lastframe_dtmf, int savePayload, bool replay);
+	void jitterbuffer_log_add(sJitterbufferLogItem *item);
+	u_int64_t jitterbuffer_log_replay(cJitterbufferLog *log);
+	void jitterbuffer_log_check(cJitterbufferLog *log);
+	void jitterbuffer_log_lock() {
+		while(__sync_lock_test_and_set(&jb_log_sync, 1)) {
+			USLEEP(10);
+		}
+	}
+	void jitterbuffer_log_unlock() {
+		__sync_lock_release(&jb_log_sync);
+	}
+	
 friend class Call;
 };
 
 
+/* Replay of jitterbuffer logs (jitterbuffer_deferred_threads) - RTP threads only log the packets of streams and hand
+   the log over at every MOS interval and when the call is closed, workers run the fix1 / fix2 / adapt simulations over
+   the whole batch. A stream is in the queue at most once, so its logs are replayed in order by one worker at a time. */
+class cJitterbufferDeferredPool {
+public:
+	struct sWorker {
+		cJitterbufferDeferredPool *pool;
+		unsigned index;
+		pthread_t thread;
+		int threadId;
+		pstat_data threadPstatData[2];
+		volatile u_int64_t packets;
+		u_int64_t packets_last;
+		u_int64_t statTimeMS_last;
+	};
+public:
+	cJitterbufferDeferredPool(unsigned threadsCount);
+	~cJitterbufferDeferredPool();
+	void start();
+	void terminate();
+	bool add(RTP *rtp);
+	string getStatString();
+private:
+	void workerThreadFunction(sWorker *worker);
+	static void *_workerThreadFunction(void *arg);
+	void lock() {
+		while(__sync_lock_test_and_set(&_sync, 1)) {
+			USLEEP(10);
+		}
+	}
+	void unlock() {
+		__sync_lock_release(&_sync);
+	}
+private:
+	unsigned threadsCount;
+	sWorker *workers;
+	deque<RTP*> queue;
+	volatile int _sync;
+	volatile bool terminating;
+};
+
+
 class RTPstat {
 	typedef struct {
 		uint32_t 	time;		// seconds since unix epoch of the last update 
@@ -717,4 +858,7 @@ private:
 };
 
 
+extern cJitterbufferDeferredPool *jitterbufferDeferredPool;
+
+
 #endif
@@ -0,0 +1,317 @@
+#ifndef SHARDED_MAP_H
+#define SHARDED_MAP_H
+
+
+#include <string>
+#include <algorithm>
+#include <string.h>
+#include <sys/types.h>
+
+#include "tools_global.h"
+
+
+struct sStrRef {
+	sStrRef(const char *str, unsigned len) {
+		this->str = str;
+		this->len = len;
+	}
+	const char *str;
+	unsigned len;
+};
+
+inline u_int64_t hashMix64(u_int64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return(h);
+}
+
+inline u_int64_t hashStr64(const char *str, unsigned len) {
+	u_int64_t h = 0x9e3779b97f4a7c15ull ^ len;
+	u_int64_t v;
+	while(len >= 8) {
+		memcpy(&v, str, 8);
+		h = (h ^ v) * 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+		str += 8;
+		len -= 8;
+	}
+	if(len) {
+		v = 0;
+		memcpy(&v, str, len);
+		h = (h ^ v) * 0xc4ceb9fe1a85ec53ull;
+		h ^= h >> 29;
+	}
+	return(hashMix64(h));
+}
+
+inline u_int64_t hashStr64(const std::string &str) {
+	return(hashStr64(str.data(), str.length()));
+}
+
+inline u_int64_t shardedMapHash(const std::string &key) {
+	return(hashStr64(key));
+}
+
+inline bool shardedMapKeyEq(const std::string &key, const sStrRef &lookup) {
+	return(key.length() == lookup.len && !memcmp(key.data(), lookup.str, lookup.len));
+}
+
+template <class type_key>
+inline bool shardedMapKeyEq(const type_key &key, const type_key &lookup) {
+	return(key == lookup);
+}
+
+
+/* Hash map split into shards by the high bits of a hash computed by the caller (so that the hash of a Call-ID is computed
+   once per packet and the lookup does not allocate). Every shard is an open addressing table (linear probing) with own
+   spinlock - lookups lock only one shard. Deleted slots are marked and purged at rehash, so erase during iteration
+   does not move the remaining items. Callers lock the shard of the hash around find / set / erase (or use the *WithLock
+   variants which compute the hash by shardedMapHash of the key); cIterator locks the shard it is walking through. */
+template <class type_key, class type_value>
+class cShardedMap {
+public:
+	enum eSlotState {
+		_slot_empty,
+		_slot_used,
+		_slot_deleted
+	};
+	struct sSlot {
+		u_int64_t hash;
+		type_key key;
+		type_value value;
+		u_int8_t state;
+	};
+	struct sShard {
+		sSlot *slots;
+		u_int32_t size;
+		u_int32_t used;
+		u_int32_t deleted;
+		volatile int _sync;
+	};
+	class cIterator {
+	public:
+		cIterator(cShardedMap *map) {
+			this->map = map;
+			this->shard = 0;
+			this->pos = 0;
+			this->locked = false;
+		}
+		~cIterator() {
+			this->release();
+		}
+		void begin() {
+			this->release();
+			this->shard = 0;
+			this->pos = 0;
+			this->map->lockShard(0);
+			this->locked = true;
+			this->seek();
+		}
+		bool isEnd() {
+			return(this->shard >= this->map->shardsCount);
+		}
+		void next() {
+			++this->pos;
+			this->seek();
+		}
+		type_key &key() {
+			return(this->map->shards[this->shard].slots[this->pos].key);
+		}
+		type_value &value() {
+			return(this->map->shards[this->shard].slots[this->pos].value);
+		}
+		void erase() {
+			this->map->eraseSlot(&this->map->shards[this->shard], this->pos);
+		}
+	private:
+		void seek() {
+			while(this->shard < this->map->shardsCount) {
+				sShard *shard = &this->map->shards[this->shard];
+				for(; this->pos < shard->size; this->pos++) {
+					if(shard->slots[this->pos].state == _slot_used) {
+						return;
+					}
+				}
+				this->map->unlockShard(this->shard);
+				this->locked = false;
+				++this->shard;
+				this->pos = 0;
+				if(this->shard < this->map->shardsCount) {
+					this->map->lockShard(this->shard);
+					this->locked = true;
+				}
+			}
+		}
+		void release() {
+			if(this->locked) {
+				this->map->unlockShard(this->shard);
+				this->locked = false;
+			}
+		}
+	private:
+		cShardedMap *map;
+		unsigned shard;
+		u_int32_t pos;
+		bool locked;
+	};
+public:
+	cShardedMap(unsigned shardsBits = 6, unsigned shardInitSize = 256) {
+		this->shardsCount = 1 << shardsBits;
+		this->shards = new FILE_LINE(0) sShard[this->shardsCount];
+		for(unsigned i = 0; i < this->shardsCount; i++) {
+			this->shards[i].slots = new FILE_LINE(0) sSlot[shardInitSize];
+			for(unsigned j = 0; j < shardInitSize; j++) {
+				this->shards[i].slots[j].state = _slot_empty;
+			}
+			this->shards[i].size = shardInitSize;
+			this->shards[i].used = 0;
+			this->shards[i].deleted = 0;
+			this->shards[i]._sync = 0;
+		}
+		this->count = 0;
+	}
+	~cShardedMap() {
+		for(unsigned i = 0; i < this->shardsCount; i++) {
+			delete [] this->shards[i].slots;
+		}
+		delete [] this->shards;
+	}
+	void lock(u_int64_t hash) {
+		this->lockShard(this->getShardIndex(hash));
+	}
+	void unlock(u_int64_t hash) {
+		this->unlockShard(this->getShardIndex(hash));
+	}
+	template <class type_lookup>
+	type_value *find(const type_lookup &lookup, u_int64_t hash) {
+		sShard *shard = &this->shards[this->getShardIndex(hash)];
+		u_int32_t mask = shard->size - 1;
+		for(u_int32_t i = hash & mask; shard->slots[i].state != _slot_empty; i = (i + 1) & mask) {
+			sSlot *slot = &shard->slots[i];
+			if(slot->state == _slot_used && slot->hash == hash && shardedMapKeyEq(slot->key, lookup)) {
+				return(&slot->value);
+			}
+		}
+		return(NULL);
+	}
+	void set(const type_key &key, u_int64_t hash, type_value value) {
+		type_value *existsValue = this->find(key, hash);
+		if(existsValue) {
+			*existsValue = value;
+			return;
+		}
+		sShard *shard = &this->shards[this->getShardIndex(hash)];
+		if((shard->used + shard->deleted + 1) * 3 > shard->size * 2) {
+			this->rehash(shard, (shard->used + 1) * 3 > shard->size ? shard->size * 2 : shard->size);
+		}
+		u_int32_t mask = shard->size - 1;
+		u_int32_t i = hash & mask;
+		while(shard->slots[i].state == _slot_used) {
+			i = (i + 1) & mask;
+		}
+		sSlot *slot = &shard->slots[i];
+		if(slot->state == _slot_deleted) {
+			--shard->deleted;
+		}
+		slot->hash = hash;
+		slot->key = key;
+		slot->value = value;
+		slot->state = _slot_used;
+		++shard->used;
+		__sync_fetch_and_add(&this->count, 1);
+	}
+	template <class type_lookup>
+	bool erase(const type_lookup &lookup, u_int64_t hash) {
+		sShard *shard = &this->shards[this->getShardIndex(hash)];
+		u_int32_t mask = shard->size - 1;
+		for(u_int32_t i = hash & mask; shard->slots[i].state != _slot_empty; i = (i + 1) & mask) {
+			sSlot *slot = &shard->slots[i];
+			if(slot->state == _slot_used && slot->hash == hash && shardedMapKeyEq(slot->key, lookup)) {
+				this->eraseSlot(shard, i);
+				return(true);
+			}
+		}
+		return(false);
+	}
+	void setWithLock(const type_key &key, type_value value) {
+		u_int64_t hash = shardedMapHash(key);
+		this->lock(hash);
+		this->set(key, hash, value);
+		this->unlock(hash);
+	}
+	bool findWithLock(const type_key &key, type_value *value) {
+		u_int64_t hash = shardedMapHash(key);
+		this->lock(hash);
+		type_value *findValue = this->find(key, hash);
+		if(findValue) {
+			*value = *findValue;
+		}
+		this->unlock(hash);
+		return(findValue != NULL);
+	}
+	bool eraseWithLock(const type_key &key) {
+		u_int64_t hash = shardedMapHash(key);
+		this->lock(hash);
+		bool rslt = this->erase(key, hash);
+		this->unlock(hash);
+		return(rslt);
+	}
+	size_t size() {
+		return(this->count);
+	}
+private:
+	unsigned getShardIndex(u_int64_t hash) {
+		return((hash >> 40) & (this->shardsCount - 1));
+	}
+	void lockShard(unsigned index) {
+		while(__sync_lock_test_and_set(&this->shards[index]._sync, 1)) {
+			USLEEP(10);
+		}
+	}
+	void unlockShard(unsigned index) {
+		__sync_lock_release(&this->shards[index]._sync);
+	}
+	void eraseSlot(sShard *shard, u_int32_t pos) {
+		sSlot *slot = &shard->slots[pos];
+		slot->key = type_key();
+		slot->state = _slot_deleted;
+		--shard->used;
+		++shard->deleted;
+		__sync_fetch_and_sub(&this->count, 1);
+	}
+	void rehash(sShard *shard, u_int32_t newSize) {
+		sSlot *oldSlots = shard->slots;
+		u_int32_t oldSize = shard->size;
+		shard->slots = new FILE_LINE(0) sSlot[newSize];
+		for(u_int32_t i = 0; i < newSize; i++) {
+			shard->slots[i].state = _slot_empty;
+		}
+		shard->size = newSize;
+		shard->deleted = 0;
+		u_int32_t mask = newSize - 1;
+		for(u_int32_t i = 0; i < oldSize; i++) {
+			if(oldSlots[i].state == _slot_used) {
+				u_int32_t j = oldSlots[i].hash & mask;
+				while(shard->slots[j].state == _slot_used) {
+					j = (j + 1) & mask;
+				}
+				shard->slots[j].hash = oldSlots[i].hash;
+				std::swap(shard->slots[j].key, oldSlots[i].key);
+				shard->slots[j].value = oldSlots[i].value;
+				shard->slots[j].state = _slot_used;
+			}
+		}
+		delete [] oldSlots;
+	}
+private:
+	sShard *shards;
+	unsigned shardsCount;
+	volatile size_t count;
+friend class cIterator;
+};
+
+
+#endif //SHARDED_MAP_H
@@ -0,0 +1,87 @@
+#include <string.h>
+
+#include "sip_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__SSE2__)
+#define SIP_SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define SIP_SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+
+#if SIP_SCAN_SSE2
+static u_int64_t sip_scan_mask_sse2(const char *data) {
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+	u_int64_t mask = 0;
+	for(unsigned i = 0; i < SIP_SCAN_BLOCK; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+		__m128i eol = _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf));
+		mask |= (u_int64_t)(u_int16_t)_mm_movemask_epi8(eol) << i;
+	}
+	return(mask);
+}
+#endif
+
+#if SIP_SCAN_AVX2
+__attribute__((target("avx2")))
+static u_int64_t sip_scan_mask_avx2(const char *data) {
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i lf = _mm256_set1_epi8('\n');
+	__m256i v0 = _mm256_loadu_si256((const __m256i*)data);
+	__m256i v1 = _mm256_loadu_si256((const __m256i*)(data + 32));
+	__m256i eol0 = _mm256_or_si256(_mm256_cmpeq_epi8(v0, cr), _mm256_cmpeq_epi8(v0, lf));
+	__m256i eol1 = _mm256_or_si256(_mm256_cmpeq_epi8(v1, cr), _mm256_cmpeq_epi8(v1, lf));
+	return((u_int64_t)(u_int32_t)_mm256_movemask_epi8(eol0) |
+	       ((u_int64_t)(u_int32_t)_mm256_movemask_epi8(eol1) << 32));
+}
+#endif
+
+struct sSipScanImplementation {
+	u_int64_t (*mask)(const char *data);
+	const char *name;
+};
+
+static sSipScanImplementation sip_scan_select() {
+	sSipScanImplementation impl;
+	impl.mask = NULL;
+	impl.name = "scalar";
+	#if SIP_SCAN_SSE2
+	impl.mask = sip_scan_mask_sse2;
+	impl.name = "sse2";
+	#endif
+	#if SIP_SCAN_AVX2
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		impl.mask = sip_scan_mask_avx2;
+		impl.name = "avx2";
+	}
+	#endif
+	return(impl);
+}
+
+static sSipScanImplementation sipScanImplementation = sip_scan_select();
+// false (scalar walk) also in the time before the static initialization of this unit
+bool cSipScan::simd = sipScanImplementation.mask != NULL;
+
+
+void cSipScan::loadMask(u_int32_t block) {
+	maskBlock = block;
+	if(block + SIP_SCAN_BLOCK <= length) {
+		mask = sipScanImplementation.mask(data + block);
+	} else {
+		char tail[SIP_SCAN_BLOCK];
+		memset(tail, 0, sizeof(tail));
+		memcpy(tail, data + block, length - block);
+		mask = sipScanImplementation.mask(tail);
+	}
+}
+
+const char *cSipScan::getImplementation() {
+	return(sipScanImplementation.name);
+}
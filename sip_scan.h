@@ -0,0 +1,62 @@
+#ifndef SIP_SCAN_H
+#define SIP_SCAN_H
+
+
+#include <sys/types.h>
+
+
+#define SIP_SCAN_BLOCK 64
+
+
+/* Finder of line ends (CR / LF) in SIP message. Bytes are compared in blocks of SIP_SCAN_BLOCK with AVX2 (when the cpu
+   supports it, the choice is made once at runtime because the sniffer is built for the generic -march) or SSE2 and
+   the block is kept as bit mask so that the walk over the lines of one message needs one compare of each byte.
+   The tail of the message shorter than the block is copied so that the SIMD loads never read over the end of data.
+   Without SIMD (other architectures) the bytes are walked one by one. */
+class cSipScan {
+public:
+	cSipScan(const char *data, u_int32_t length) {
+		this->data = data;
+		this->length = length;
+		this->maskBlock = (u_int32_t)-1;
+		this->mask = 0;
+	}
+	// position of the first CR or LF from pos, length if there is none
+	inline u_int32_t nextEol(u_int32_t pos) {
+		if(!simd) {
+			while(pos < length && data[pos] != '\r' && data[pos] != '\n') {
+				++pos;
+			}
+			return(pos < length ? pos : length);
+		}
+		if(pos >= length) {
+			return(length);
+		}
+		u_int32_t block = pos & ~(SIP_SCAN_BLOCK - 1);
+		if(block != maskBlock) {
+			loadMask(block);
+		}
+		u_int64_t m = mask & (~0ull << (pos - block));
+		while(!m) {
+			block += SIP_SCAN_BLOCK;
+			if(block >= length) {
+				return(length);
+			}
+			loadMask(block);
+			m = mask;
+		}
+		return(block + __builtin_ctzll(m));
+	}
+	static const char *getImplementation();
+private:
+	void loadMask(u_int32_t block);
+private:
+	const char *data;
+	u_int32_t length;
+	u_int32_t maskBlock;
+	u_int64_t mask;
+	static bool simd;
+};
+
+
+#endif //SIP_SCAN_H
@@ -1356,7 +1356,7 @@ Call *new_skinny_channel(int state, char */*data*/, int /*datalen*/, struct pcap
 	call->setSipcallerip(saddr, source);
 	call->setSipcalledip(daddr, dest);
 	call->flags = flags;
-	strcpy_null_term(call->fbasename, callidstr);
+	call->fbasename.set(callidstr);
 	
 	// add saddr|daddr into map
 	d_item<vmIP> ip2;
@@ -1498,6 +1498,7 @@ void *handle_skinny2(pcap_pkthdr *header, const u_char *packet, vmIP saddr, vmPo
 		case SKINNY_ONHOOK:
 			strcpy(call->lastSIPresponse, "ON HOOK");
 			call->destroy_call_at = header->ts.tv_sec + 5;
+			calltable->cleanup_calls_wheel_update(call);
 			if(!is_read_from_file_by_pb()) {
 				call->removeFindTables(0, true);
 			}
@@ -1576,9 +1577,9 @@ void *handle_skinny2(pcap_pkthdr *header, const u_char *packet, vmIP saddr, vmPo
 		SKINNY_DEBUG(DEBUG_PACKET, 3, "Received CALL_INFO_MESSAGE ref %d\n", ref);
 		snprintf(callid, sizeof(callid), "%u", ref);
 		if ((call = calltable->find_by_call_id(callid, strlen(callid), NULL, 0))){
-			memcpy(call->callername, req.data.callinfo.callingPartyName, sizeof(req.data.callinfo.callingPartyName));
-			memcpy(call->caller, req.data.callinfo.callingParty, sizeof(req.data.callinfo.callingParty));
-			memcpy(call->called, req.data.callinfo.calledParty, sizeof(req.data.callinfo.calledParty));
+			call->callername.set(req.data.callinfo.callingPartyName, strnlen(req.data.callinfo.callingPartyName, sizeof(req.data.callinfo.callingPartyName)));
+			call->caller.set(req.data.callinfo.callingParty, strnlen(req.data.callinfo.callingParty, sizeof(req.data.callinfo.callingParty)));
+			call->called.set(req.data.callinfo.calledParty, strnlen(req.data.callinfo.calledParty, sizeof(req.data.callinfo.calledParty)));
 
 			u_int64_t _forcemark_time = getTimeUS(header);
 			call->forcemark_lock();
@@ -1682,16 +1683,13 @@ void *handle_skinny2(pcap_pkthdr *header, const u_char *packet, vmIP saddr, vmPo
 			}
 
 			if(callingParty) {
-				memcpy(call->caller, callingParty, MIN(sizeof(call->caller), strlen(callingParty) + 1));
-				call->caller[sizeof(call->caller) - 1] = 0;
+				call->caller.set(callingParty);
 			}
 			if(calledParty) {
-				memcpy(call->called, calledParty, MIN(sizeof(call->called), strlen(calledParty) + 1));
-				call->called[sizeof(call->called) - 1] = 0;
+				call->called.set(calledParty);
 			}
 			if(callingPartyName) {
-				memcpy(call->callername, callingPartyName, MIN(sizeof(call->callername), strlen(callingPartyName) + 1));
-				call->callername[sizeof(call->callername) - 1] = 0;
+				call->callername.set(callingPartyName);
 			}
 		}
 		}
@@ -1730,7 +1728,7 @@ void *handle_skinny2(pcap_pkthdr *header, const u_char *packet, vmIP saddr, vmPo
 		SKINNY_DEBUG(DEBUG_PACKET, 3, "Received DIALED_NUMBER_MESSAGE ref %d num:[%s]\n", ref, req.data.dialednumber.dialedNumber);
 		snprintf(callid, sizeof(callid), "%u", ref);
 		if((call = calltable->find_by_call_id(callid, strlen(callid), NULL, 0))){
-			strcpy_null_term(call->called, req.data.dialednumber.dialedNumber);
+			call->called.set(req.data.dialednumber.dialedNumber);
 		}
 		}
 		break;
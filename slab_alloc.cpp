@@ -0,0 +1,201 @@
+#include <sstream>
+#include <iomanip>
+#include <pthread.h>
+
+#include "slab_alloc.h"
+#include "heap_safe.h"
+
+
+cSlabPool *cSlabPool::pools[SLAB_POOL_MAX];
+volatile unsigned cSlabPool::poolsCount;
+volatile bool cSlabPool::active;
+
+static __thread cSlabPool::sThreadCache slabPoolThreadCaches[SLAB_POOL_MAX];
+static __thread bool slabPoolThreadRegistered;
+static pthread_key_t slabPoolThreadKey;
+static pthread_once_t slabPoolThreadKeyOnce = PTHREAD_ONCE_INIT;
+
+
+cSlabPool::cSlabPool(const char *name, size_t objectSize) {
+	this->name = name;
+	this->objectSize = objectSize;
+	this->itemSize = ((objectSize > sizeof(sItem) ? objectSize : sizeof(sItem)) + 15) & ~(size_t)15;
+	this->magazineSize = SLAB_POOL_MAGAZINE_BYTES / this->itemSize;
+	if(this->magazineSize < SLAB_POOL_MAGAZINE_MIN) {
+		this->magazineSize = SLAB_POOL_MAGAZINE_MIN;
+	} else if(this->magazineSize > SLAB_POOL_MAGAZINE_MAX) {
+		this->magazineSize = SLAB_POOL_MAGAZINE_MAX;
+	}
+	this->depot = NULL;
+	this->depotItems = 0;
+	this->slabs = 0;
+	this->items = 0;
+	this->_sync = 0;
+	this->index = __sync_fetch_and_add(&poolsCount, 1);
+	if(this->index < SLAB_POOL_MAX) {
+		pools[this->index] = this;
+	}
+}
+
+void *cSlabPool::alloc(size_t size) {
+	if(!active || size != objectSize || index >= SLAB_POOL_MAX) {
+		return(::operator new(size));
+	}
+	sThreadCache *cache = getThreadCache();
+	if(!cache->items) {
+		cache->items = takeBatch(&cache->count);
+	}
+	sItem *item = cache->items;
+	cache->items = item->next;
+	--cache->count;
+	return(item);
+}
+
+void cSlabPool::free(void *item, size_t size) {
+	if(!item) {
+		return;
+	}
+	if(!active || size != objectSize || index >= SLAB_POOL_MAX) {
+		::operator delete(item);
+		return;
+	}
+	sThreadCache *cache = getThreadCache();
+	((sItem*)item)->next = cache->items;
+	cache->items = (sItem*)item;
+	++cache->count;
+	if(cache->count >= magazineSize * 2) {
+		sItem *batch = cache->items;
+		sItem *last = batch;
+		for(unsigned i = 1; i < magazineSize; i++) {
+			last = last->next;
+		}
+		cache->items = last->next;
+		cache->count -= magazineSize;
+		last->next = NULL;
+		putBatch(batch, magazineSize);
+	}
+}
+
+void cSlabPool::flushThreadCache(sThreadCache *cache) {
+	while(cache->items) {
+		sItem *batch = cache->items;
+		sItem *last = batch;
+		unsigned count = 1;
+		while(last->next && count < magazineSize) {
+			last = last->next;
+			++count;
+		}
+		cache->items = last->next;
+		last->next = NULL;
+		putBatch(batch, count);
+	}
+	cache->count = 0;
+}
+
+void cSlabPool::setActive() {
+	active = true;
+}
+
+std::string cSlabPool::getStat() {
+	if(!active) {
+		return("");
+	}
+	std::ostringstream outStr;
+	unsigned count = poolsCount < SLAB_POOL_MAX ? poolsCount : SLAB_POOL_MAX;
+	for(unsigned i = 0; i < count; i++) {
+		cSlabPool *pool = pools[i];
+		pool->lock();
+		u_int64_t slabs = pool->slabs;
+		u_int64_t items = pool->items;
+		u_int64_t depotItems = pool->depotItems;
+		pool->unlock();
+		outStr << std::fixed
+		       << std::left << std::setw(35) << (std::string("slab pool ") + pool->name) << " : "
+		       << std::right << std::setw(16) << addThousandSeparators(items * pool->itemSize)
+		       << " (slabs " << slabs
+		       << ", items " << items
+		       << ", in threads " << (items - depotItems)
+		       << ", free in depot " << depotItems
+		       << ", item size " << pool->itemSize << ")"
+		       << std::endl;
+	}
+	return(outStr.str());
+}
+
+cSlabPool::sItem *cSlabPool::takeBatch(unsigned *count) {
+	lock();
+	while(!depot) {
+		unlock();
+		addSlab();
+		lock();
+	}
+	sItem *batch = depot;
+	depot = batch->next_batch;
+	*count = batch->batch_count;
+	depotItems -= batch->batch_count;
+	unlock();
+	return(batch);
+}
+
+void cSlabPool::putBatch(sItem *items, unsigned count) {
+	items->batch_count = count;
+	lock();
+	items->next_batch = depot;
+	depot = items;
+	depotItems += count;
+	unlock();
+}
+
+void cSlabPool::addSlab() {
+	unsigned slabItems = SLAB_POOL_SLAB_SIZE / itemSize;
+	if(slabItems < magazineSize) {
+		slabItems = magazineSize;
+	}
+	char *slab = new FILE_LINE(0) char[slabItems * itemSize];
+	sItem *batches = NULL;
+	for(unsigned i = 0; i < slabItems; i += magazineSize) {
+		unsigned batchCount = slabItems - i < magazineSize ? slabItems - i : magazineSize;
+		sItem *batch = (sItem*)(slab + i * itemSize);
+		for(unsigned j = 0; j < batchCount; j++) {
+			sItem *item = (sItem*)(slab + (i + j) * itemSize);
+			item->next = j < batchCount - 1 ? (sItem*)(slab + (i + j + 1) * itemSize) : NULL;
+		}
+		batch->batch_count = batchCount;
+		batch->next_batch = batches;
+		batches = batch;
+	}
+	lock();
+	while(batches) {
+		sItem *batch = batches;
+		batches = batch->next_batch;
+		batch->next_batch = depot;
+		depot = batch;
+		depotItems += batch->batch_count;
+	}
+	++slabs;
+	items += slabItems;
+	unlock();
+}
+
+cSlabPool::sThreadCache *cSlabPool::getThreadCache() {
+	if(!slabPoolThreadRegistered) {
+		// the key destructor returns the cache of an ending thread to the depots
+		pthread_once(&slabPoolThreadKeyOnce, threadKeyInit);
+		pthread_setspecific(slabPoolThreadKey, (void*)1);
+		slabPoolThreadRegistered = true;
+	}
+	return(&slabPoolThreadCaches[index]);
+}
+
+void cSlabPool::threadKeyInit() {
+	pthread_key_create(&slabPoolThreadKey, threadExit);
+}
+
+void cSlabPool::threadExit(void *) {
+	unsigned count = poolsCount < SLAB_POOL_MAX ? poolsCount : SLAB_POOL_MAX;
+	for(unsigned i = 0; i < count; i++) {
+		if(slabPoolThreadCaches[i].items) {
+			pools[i]->flushThreadCache(&slabPoolThreadCaches[i]);
+		}
+	}
+}
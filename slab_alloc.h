@@ -0,0 +1,95 @@
+#ifndef SLAB_ALLOC_H
+#define SLAB_ALLOC_H
+
+
+#include <string>
+#include <sched.h>
+#include <sys/types.h>
+
+
+#define SLAB_POOL_MAX 16
+#define SLAB_POOL_SLAB_SIZE (256 * 1024)
+#define SLAB_POOL_MAGAZINE_BYTES (64 * 1024)
+#define SLAB_POOL_MAGAZINE_MIN 4
+#define SLAB_POOL_MAGAZINE_MAX 64
+
+
+/* Pool of objects of one type (one size) carved from big slabs. Every thread has own cache (magazine) of free items
+   so that alloc / free take no lock; a thread which frees more than it allocates (calls_deletequeue) returns the items
+   to the shared depot in batches of one magazine and a thread which allocates more takes whole batches from there.
+   The memory of slabs is kept for the items of the same type (it is not returned to the heap).
+   Pools are used only after setActive (before the first object of the type is created) - otherwise alloc / free
+   pass to the global operators (so that heapsafe / memory_stat checks see every object). */
+class cSlabPool {
+public:
+	struct sItem {
+		sItem *next;
+		sItem *next_batch;
+		unsigned batch_count;
+	};
+	struct sThreadCache {
+		sItem *items;
+		unsigned count;
+	};
+public:
+	cSlabPool(const char *name, size_t objectSize);
+	void *alloc(size_t size);
+	void free(void *item, size_t size);
+	static void setActive();
+	static bool isActive() {
+		return(active);
+	}
+	static std::string getStat();
+private:
+	sItem *takeBatch(unsigned *count);
+	void putBatch(sItem *items, unsigned count);
+	void addSlab();
+	void lock() {
+		while(__sync_lock_test_and_set(&_sync, 1)) {
+			sched_yield();
+		}
+	}
+	void unlock() {
+		__sync_lock_release(&_sync);
+	}
+	void flushThreadCache(sThreadCache *cache);
+	sThreadCache *getThreadCache();
+	static void threadKeyInit();
+	static void threadExit(void *);
+private:
+	const char *name;
+	size_t objectSize;
+	size_t itemSize;
+	unsigned magazineSize;
+	unsigned index;
+	sItem *depot;
+	u_int64_t depotItems;
+	u_int64_t slabs;
+	u_int64_t items;
+	volatile int _sync;
+	static cSlabPool *pools[SLAB_POOL_MAX];
+	static volatile unsigned poolsCount;
+	static volatile bool active;
+};
+
+
+#if HEAPSAFE
+#define SLAB_POOL_OPERATOR_NEW_FILE_LINE(pool) \
+	static void *operator new(size_t size, const char *, int, int) { \
+		return(pool.alloc(size)); \
+	}
+#else
+#define SLAB_POOL_OPERATOR_NEW_FILE_LINE(pool)
+#endif
+
+#define SLAB_POOL_OPERATORS(pool) \
+	static void *operator new(size_t size) { \
+		return(pool.alloc(size)); \
+	} \
+	SLAB_POOL_OPERATOR_NEW_FILE_LINE(pool) \
+	static void operator delete(void *item, size_t size) { \
+		pool.free(item, size); \
+	}
+
+
+#endif //SLAB_ALLOC_H
@@ -247,6 +247,7 @@ extern bool _save_sip_history_all_responses;
 extern int opt_rtpfromsdp_onlysip;
 extern int opt_rtpfromsdp_onlysip_skinny;
 extern int opt_t2_boost;
+extern bool opt_rtp_threads_balance;
 unsigned int glob_ssl_calls = 0;
 extern int opt_bye_timeout;
 extern int opt_bye_confirmed_timeout;
@@ -318,6 +319,7 @@ volatile int usersniffer_sync;
 
 
 #include "sniff_inline.h"
+#include "sip_scan.h"
 
 
 unsigned long process_packet__last_cleanup_calls = 0;
@@ -889,16 +891,10 @@ int check_sip20(char *data, unsigned long len, ParsePacket::ppContentsX *parseCo
 	if(check_websocket(data, len, !isTcp)) {
 		cWebSocketHeader ws((u_char*)data, len);
 		if(len > ws.getHeaderLength()) {
-			bool allocData;
-			u_char *ws_data = ws.decodeData(&allocData, len);
-			if(!ws_data) {
-				return 0;
-			}
-			int rslt = check_sip20((char*)ws_data, ws.getDataLength(), parseContents, isTcp);
-			if(allocData) {
-				delete [] ws_data;
-			}
-			return(rslt);
+			// only the beginning of the data is checked - it is unmasked to the local buffer
+			u_char ws_data[128];
+			unsigned ws_data_length = ws.decodeDataPrefix(ws_data, sizeof(ws_data), len);
+			return(check_sip20((char*)ws_data, ws_data_length, NULL, isTcp));
 		} else {
 			return 0;
 		}
@@ -1688,163 +1684,273 @@ int mimeSubtypeToInt(char *mimeSubtype) {
 	       return 0;
 }
 
-int get_rtpmap_from_sdp(char *sdp_text, unsigned long len, RTPMAP *rtpmap, bool *existsPayloadTelevent){
-	unsigned long l = 0;
-	char *s, *z;
-	int payload;
-	int codec;
-	char mimeSubtype[255];
-	int i = 0;
-	int rate = 0;
-
-	s = sdp_text;
-	
-	do {
-		s = _gettag(s, len - (s - sdp_text), "a=rtpmap:", &l);
-		
-		char zchr;
-		if(l && 
-		   ((z = strnchr(s, '\r', len - (s - sdp_text))) ||
-		    (z = strnchr(s, '\n', len - (s - sdp_text))))) {
-			zchr = *z;
-			*z = '\0';
-		} else {
-			break;
+static int rtpmap_codec(char *mimeSubtype, int rate) {
+	int codec = mimeSubtypeToInt(mimeSubtype);
+	if(codec == PAYLOAD_G7221) {
+		switch(rate) {
+			case 8000:
+				codec = PAYLOAD_G72218;
+				break;
+			case 12000:
+				codec = PAYLOAD_G722112;
+				break;
+			case 16000:
+				codec = PAYLOAD_G722116;
+				break;
+			case 24000:
+				codec = PAYLOAD_G722124;
+				break;
+			case 32000:
+				codec = PAYLOAD_G722132;
+				break;
+			case 48000:
+				codec = PAYLOAD_G722148;
+				break;
 		}
-		payload = 0;
-		codec = 0;
-		if (sscanf(s, "%30u %254[^/]/%d", &payload, mimeSubtype, &rate) == 3) {
-			// store payload type and its codec into one integer with 1000 offset
-			codec = mimeSubtypeToInt(mimeSubtype);
-			if(codec == PAYLOAD_G7221) {
-				switch(rate) {
-					case 8000:
-						codec = PAYLOAD_G72218;
-						break;
-					case 12000:
-						codec = PAYLOAD_G722112;
-						break;
-					case 16000:
-						codec = PAYLOAD_G722116;
-						break;
-					case 24000:
-						codec = PAYLOAD_G722124;
-						break;
-					case 32000:
-						codec = PAYLOAD_G722132;
-						break;
-					case 48000:
-						codec = PAYLOAD_G722148;
-						break;
-				}
-			} else if(codec == PAYLOAD_SILK) {
-				switch(rate) {
-					case 8000:
-						codec = PAYLOAD_SILK8;
-						break;
-					case 12000:
-						codec = PAYLOAD_SILK12;
-						break;
-					case 16000:
-						codec = PAYLOAD_SILK16;
-						break;
-					case 24000:
-						codec = PAYLOAD_SILK24;
-						break;
-				}
-			} else if(codec == PAYLOAD_ISAC) {
-				switch(rate) {
-					case 16000:
-						codec = PAYLOAD_ISAC16;
-						break;
-					case 32000:
-						codec = PAYLOAD_ISAC32;
-						break;
-				}
-			} else if(codec == PAYLOAD_OPUS) {
-				switch(rate) {
-					case 8000:
-						codec = PAYLOAD_OPUS8;
-						break;
-					case 12000:
-						codec = PAYLOAD_OPUS12;
-						break;
-					case 16000:
-						codec = PAYLOAD_OPUS16;
-						break;
-					case 24000:
-						codec = PAYLOAD_OPUS24;
-						break;
-					case 48000:
-						codec = PAYLOAD_OPUS48;
-						break;
-				}
-			} else if(codec == PAYLOAD_XOPUS) {
-				switch(rate) {
-					case 8000:
-						codec = PAYLOAD_XOPUS8;
-						break;
-					case 12000:
-						codec = PAYLOAD_XOPUS12;
-						break;
-					case 16000:
-						codec = PAYLOAD_XOPUS16;
-						break;
-					case 24000:
-						codec = PAYLOAD_XOPUS24;
-						break;
-					case 48000:
-						codec = PAYLOAD_XOPUS48;
-						break;
-				}
-			} else if(codec == PAYLOAD_VXOPUS) {
-				switch(rate) {
-					case 8000:
-						codec = PAYLOAD_VXOPUS8;
-						break;
-					case 12000:
-						codec = PAYLOAD_VXOPUS12;
-						break;
-					case 16000:
-						codec = PAYLOAD_VXOPUS16;
-						break;
-					case 24000:
-						codec = PAYLOAD_VXOPUS24;
-						break;
-					case 48000:
-						codec = PAYLOAD_VXOPUS48;
-						break;
-				}
-			} else if(codec == PAYLOAD_MP4ALATM128) {
-				switch(rate) {
-					case 128000:
-						codec = PAYLOAD_MP4ALATM128;
-						break;
-					case 64000:
-						codec = PAYLOAD_MP4ALATM64;
+	} else if(codec == PAYLOAD_SILK) {
+		switch(rate) {
+			case 8000:
+				codec = PAYLOAD_SILK8;
+				break;
+			case 12000:
+				codec = PAYLOAD_SILK12;
+				break;
+			case 16000:
+				codec = PAYLOAD_SILK16;
+				break;
+			case 24000:
+				codec = PAYLOAD_SILK24;
+				break;
+		}
+	} else if(codec == PAYLOAD_ISAC) {
+		switch(rate) {
+			case 16000:
+				codec = PAYLOAD_ISAC16;
+				break;
+			case 32000:
+				codec = PAYLOAD_ISAC32;
+				break;
+		}
+	} else if(codec == PAYLOAD_OPUS) {
+		switch(rate) {
+			case 8000:
+				codec = PAYLOAD_OPUS8;
+				break;
+			case 12000:
+				codec = PAYLOAD_OPUS12;
+				break;
+			case 16000:
+				codec = PAYLOAD_OPUS16;
+				break;
+			case 24000:
+				codec = PAYLOAD_OPUS24;
+				break;
+			case 48000:
+				codec = PAYLOAD_OPUS48;
+				break;
+		}
+	} else if(codec == PAYLOAD_XOPUS) {
+		switch(rate) {
+			case 8000:
+				codec = PAYLOAD_XOPUS8;
+				break;
+			case 12000:
+				codec = PAYLOAD_XOPUS12;
+				break;
+			case 16000:
+				codec = PAYLOAD_XOPUS16;
+				break;
+			case 24000:
+				codec = PAYLOAD_XOPUS24;
+				break;
+			case 48000:
+				codec = PAYLOAD_XOPUS48;
+				break;
+		}
+	} else if(codec == PAYLOAD_VXOPUS) {
+		switch(rate) {
+			case 8000:
+				codec = PAYLOAD_VXOPUS8;
+				break;
+			case 12000:
+				codec = PAYLOAD_VXOPUS12;
+				break;
+			case 16000:
+				codec = PAYLOAD_VXOPUS16;
+				break;
+			case 24000:
+				codec = PAYLOAD_VXOPUS24;
+				break;
+			case 48000:
+				codec = PAYLOAD_VXOPUS48;
+				break;
+		}
+	} else if(codec == PAYLOAD_MP4ALATM128) {
+		switch(rate) {
+			case 128000:
+				codec = PAYLOAD_MP4ALATM128;
+				break;
+			case 64000:
+				codec = PAYLOAD_MP4ALATM64;
+				break;
+		}
+	}
+	return(codec);
+}
+
+void s_sdp_parse::parse(char *sdp, unsigned sdp_len) {
+	static struct {
+		const char *prefix;
+		unsigned length;
+		bool ignore_case;
+		e_line_type type;
+	} sdp_lines[] = {
+		{ "o=", 2, true, _sdp_origin },
+		{ "c=IN IP4 ", 9, true, _sdp_connection_ip4 },
+		{ "c=IN IP6 ", 9, true, _sdp_connection_ip6 },
+		{ "m=audio ", 8, true, _sdp_media_audio },
+		{ "m=image ", 8, true, _sdp_media_image },
+		{ "a=label:", 8, true, _sdp_label },
+		{ "a=crypto:", 9, true, _sdp_crypto },
+		{ "a=rtpmap:", 9, true, _sdp_rtpmap },
+		{ "a=fmtp:", 7, true, _sdp_fmtp },
+		{ "a=rtcp-mux", 10, false, _sdp_rtcp_mux },
+		{ "a=sendonly", 10, false, _sdp_sendonly },
+		{ "a=sendrecv", 10, false, _sdp_sendrecv },
+		{ "a=inactive", 10, false, _sdp_inactive }
+	};
+	this->sdp = sdp;
+	this->sdp_len = sdp_len;
+	lines_count = 0;
+	media_count = 0;
+	cSipScan scan(sdp, sdp_len);
+	unsigned pos = 0;
+	bool lines_limit = false;
+	while(pos < sdp_len && !lines_limit) {
+		unsigned eol = scan.nextEol(pos);
+		if(eol - pos > 1 && sdp[pos + 1] == '=') {
+			for(unsigned i = 0; i < sizeof(sdp_lines) / sizeof(sdp_lines[0]); i++) {
+				if(eol - pos >= sdp_lines[i].length &&
+				   (sdp_lines[i].ignore_case ?
+				     !strncasecmp(sdp + pos, sdp_lines[i].prefix, sdp_lines[i].length) :
+				     !strncmp(sdp + pos, sdp_lines[i].prefix, sdp_lines[i].length))) {
+					if(lines_count == lines_capacity && !grow_lines()) {
+						lines_limit = true;
 						break;
+					}
+					unsigned begin = pos + sdp_lines[i].length;
+					unsigned end = eol;
+					while(begin < end && sdp[begin] == ' ') {
+						++begin;
+					}
+					while(end > begin && sdp[end - 1] == ' ') {
+						--end;
+					}
+					lines[lines_count].type = sdp_lines[i].type;
+					lines[lines_count].offset = begin;
+					lines[lines_count].length = end - begin;
+					++lines_count;
+					break;
 				}
-			} else if(codec == PAYLOAD_TELEVENT && existsPayloadTelevent) {
+			}
+		}
+		pos = eol + 1;
+	}
+	unsigned line_begin = 0;
+	while(media_count < SDP_PARSE_MEDIA_MAX) {
+		int line = find_line(_sdp_media_audio, line_begin);
+		vmPort port;
+		bool image = false;
+		if(line < 0 || !lines[line].length || !port.setFromString(value(line)).isSet()) {
+			line = find_line(_sdp_media_image, line_begin);
+			if(line < 0 || !lines[line].length) {
+				break;
+			}
+			image = port.setFromString(value(line)).isSet();
+		}
+		media[media_count].line_begin = line;
+		media[media_count].port = port;
+		media[media_count].image = image;
+		if(media_count > 0) {
+			media[media_count - 1].line_end = line;
+		}
+		++media_count;
+		line_begin = line + 1;
+	}
+	if(media_count > 0) {
+		media[media_count - 1].line_end = lines_count;
+	}
+	if(lines_limit ||
+	   (media_count == SDP_PARSE_MEDIA_MAX && 
+	    (find_line(_sdp_media_audio, line_begin) >= 0 || find_line(_sdp_media_image, line_begin) >= 0))) {
+		static u_int64_t lastTimeSyslog = 0;
+		u_int64_t actTime = getTimeMS();
+		if(actTime - 1000 > lastTimeSyslog) {
+			syslog(LOG_NOTICE, "sdp parse: limit of %s (%u) exceeded - the rest of sdp is ignored",
+			       lines_limit ? "lines" : "media",
+			       lines_limit ? SDP_PARSE_LINES_MAX : SDP_PARSE_MEDIA_MAX);
+			lastTimeSyslog = actTime;
+		}
+	}
+}
+
+bool s_sdp_parse::grow_lines() {
+	if(lines_capacity >= SDP_PARSE_LINES_MAX) {
+		return(false);
+	}
+	unsigned new_capacity = MIN(lines_capacity * 2, SDP_PARSE_LINES_MAX);
+	s_line *new_lines = new FILE_LINE(0) s_line[new_capacity];
+	memcpy(new_lines, lines, lines_count * sizeof(s_line));
+	if(lines != lines_inline) {
+		delete [] lines;
+	}
+	lines = new_lines;
+	lines_capacity = new_capacity;
+	return(true);
+}
+
+void get_rtpmap_from_sdp(s_sdp_parse *sdp, s_sdp_parse::s_media *media, RTPMAP *rtpmap, bool *existsPayloadTelevent) {
+	int i = 0;
+	for(unsigned line = media->line_begin; line < media->line_end && i < (MAX_RTPMAP - 2); line++) {
+		if(sdp->lines[line].type != s_sdp_parse::_sdp_rtpmap) {
+			continue;
+		}
+		char rtpmap_str[300];
+		unsigned rtpmap_str_length = MIN(sdp->lines[line].length, sizeof(rtpmap_str) - 1);
+		memcpy(rtpmap_str, sdp->value(line), rtpmap_str_length);
+		rtpmap_str[rtpmap_str_length] = 0;
+		int payload = 0;
+		int codec = 0;
+		char mimeSubtype[255];
+		int rate = 0;
+		if(sscanf(rtpmap_str, "%30u %254[^/]/%d", &payload, mimeSubtype, &rate) == 3) {
+			// store payload type and its codec into one integer with 1000 offset
+			codec = rtpmap_codec(mimeSubtype, rate);
+			if(codec == PAYLOAD_TELEVENT && existsPayloadTelevent) {
 				*existsPayloadTelevent = true;
 			}
 		}
-		// return '\r' into sdp_text
-		*z = zchr;
 		if(codec || payload) {
 			rtpmap[i].codec = codec;
 			rtpmap[i].payload = payload;
 			if(codec == PAYLOAD_ILBC) {
-				char tagFmtpWithPayload[100];
-				snprintf(tagFmtpWithPayload, sizeof(tagFmtpWithPayload), "a=fmtp:%i", payload);
-				char *s = _gettag(sdp_text, len, tagFmtpWithPayload , &l);
-				rtpmap[i].frame_size = s && strncasestr(s, "mode=20", l) ? 20 : 30;
+				char payload_str[20];
+				unsigned payload_str_length = snprintf(payload_str, sizeof(payload_str), "%i", payload);
+				bool mode20 = false;
+				for(unsigned line_fmtp = media->line_begin; line_fmtp < media->line_end; line_fmtp++) {
+					if(sdp->lines[line_fmtp].type == s_sdp_parse::_sdp_fmtp &&
+					   sdp->lines[line_fmtp].length >= payload_str_length &&
+					   !strncmp(sdp->value(line_fmtp), payload_str, payload_str_length)) {
+						mode20 = strncasestr(sdp->value(line_fmtp) + payload_str_length, "mode=20", sdp->lines[line_fmtp].length - payload_str_length) != NULL;
+						break;
+					}
+				}
+				rtpmap[i].frame_size = mode20 ? 20 : 30;
 			}
 			i++;
-			//printf("PAYLOAD: rtpmap[%d]:%d payload:%d, mimeSubtype [%d] [%s]\n", i, rtpmap[i], payload, codec, mimeSubtype);
 		}
-	 } while(l && i < (MAX_RTPMAP - 2));
-	 rtpmap[i].clear(); //terminate rtpmap field
-	 return 0;
+	}
+	rtpmap[i].clear(); //terminate rtpmap field
 }
 
 int get_ip_port_from_sdp(Call *call, packet_s_process *packetS, char *sdp_text, size_t sdp_text_len,
@@ -1858,7 +1964,13 @@ int get_ip_port_from_sdp(Call *call, packet_s_process *packetS, char *sdp_text,
 		sdp_text_len = strlen(sdp_text);
 	}
 	
-	s = _gettag(sdp_text,sdp_text_len, "o=", &l);
+	s_sdp_parse sdp;
+	sdp.parse(sdp_text, sdp_text_len);
+	
+	int line = sdp.find_line(s_sdp_parse::_sdp_origin);
+	if(line < 0) return 1;
+	s = sdp.value(line);
+	l = sdp.lines[line].length;
 	if(l == 0) return 1;
 	while(l > 0 && *s != ' ') {
 		++s;
@@ -1877,59 +1989,27 @@ int get_ip_port_from_sdp(Call *call, packet_s_process *packetS, char *sdp_text,
 	memcpy(sessid, s, sessid_length);
 	sessid[sessid_length] = 0;
 	
+	u_int8_t connection_type = packetS->saddr_().is_v6() ? s_sdp_parse::_sdp_connection_ip6 : s_sdp_parse::_sdp_connection_ip4;
 	vmIP ip;
-	s = _gettag(sdp_text, sdp_text_len,
-		    packetS->saddr_().is_v6() ? "c=IN IP6 " : "c=IN IP4 ",
-		    &l);
-	if(l > 0) {
+	line = sdp.find_line(connection_type);
+	if(line >= 0 && sdp.lines[line].length > 0) {
 		char ip_str[IP_STR_MAX_LENGTH];
-		unsigned ip_length = MIN(l, IP_STR_MAX_LENGTH - 1);
-		memcpy(ip_str, s, ip_length);
+		unsigned ip_length = MIN(sdp.lines[line].length, IP_STR_MAX_LENGTH - 1);
+		memcpy(ip_str, sdp.value(line), ip_length);
 		ip_str[ip_length] = 0;
 		ip.setFromString(ip_str);
 	}
 	
-	unsigned sdp_media_start_max = 10;
-	unsigned sdp_media_start_count = 0;
-	char *sdp_media_start[sdp_media_start_max];
-	bool sdp_media_image[sdp_media_start_max];
-	vmPort sdp_media_port[sdp_media_start_max];
-	while(sdp_media_start_count < sdp_media_start_max) {
-		bool image = false;
-		vmPort port;
-		for(unsigned pass = 0; pass < 2; pass++) {
-			s = _gettag(sdp_media_start_count ? sdp_media_start[sdp_media_start_count - 1] + 1 : sdp_text,
-				    sdp_text_len - (sdp_media_start_count ? sdp_media_start[sdp_media_start_count - 1] + 1 - sdp_text: 0), 
-				    pass == 0 ? "m=audio " : "m=image ", 
-				    &l);
-			if(l > 0) {
-				if(port.setFromString(s).isSet()) {
-					if(pass == 1) {
-						image = true;
-					}
-					break;
-				}
-			}
-		}
-		if(l > 0) {
-			sdp_media_start[sdp_media_start_count] = s;
-			sdp_media_image[sdp_media_start_count] = image;
-			sdp_media_port[sdp_media_start_count] = port;
-			++sdp_media_start_count;
-		} else {
-			break;
-		}
-	}
-	
-	if(sdp_media_start_count > 1) {
+	if(sdp.media_count > 1) {
 		*next_sdp_media_data = new FILE_LINE(0) list<s_sdp_media_data*>;
 	}
 	
-	for(unsigned sdp_media_i = 0; sdp_media_i < sdp_media_start_count; sdp_media_i++) {
-		char *sdp_media_text = sdp_media_start[sdp_media_i];
-		unsigned sdp_media_text_len = sdp_media_i < sdp_media_start_count - 1 ?
-					       sdp_media_start[sdp_media_i + 1] - sdp_media_start[sdp_media_i] :
-					       sdp_text_len - (sdp_media_start[sdp_media_i] - sdp_text);
+	for(unsigned sdp_media_i = 0; sdp_media_i < sdp.media_count; sdp_media_i++) {
+		s_sdp_parse::s_media *media = &sdp.media[sdp_media_i];
+		char *sdp_media_text = sdp.value(media->line_begin);
+		unsigned sdp_media_text_len = sdp_media_i < sdp.media_count - 1 ?
+					       sdp.lines[sdp.media[sdp_media_i + 1].line_begin].offset - sdp.lines[media->line_begin].offset :
+					       sdp_text_len - sdp.lines[media->line_begin].offset;
 					       
 		s_sdp_media_data *sdp_media_data_item; 
 		if(sdp_media_i == 0) {
@@ -1938,17 +2018,15 @@ int get_ip_port_from_sdp(Call *call, packet_s_process *packetS, char *sdp_text,
 			sdp_media_data_item = new FILE_LINE(0) s_sdp_media_data;
 		}
 		sdp_media_data_item->ip = ip;
-		sdp_media_data_item->port = sdp_media_port[sdp_media_i];
-		sdp_media_data_item->sdp_flags.is_fax = sdp_media_image[sdp_media_i];
+		sdp_media_data_item->port = media->port;
+		sdp_media_data_item->sdp_flags.is_fax = media->image;
 		
 		if(sdp_media_i > 0) {
-			s = _gettag(sdp_media_text, sdp_media_text_len,
-				    packetS->saddr_().is_v6() ? "c=IN IP6 " : "c=IN IP4 ",
-				    &l);
-			if(l > 0) {
+			line = sdp.find_line(connection_type, media->line_begin, media->line_end);
+			if(line >= 0 && sdp.lines[line].length > 0) {
 				char ip_str[IP_STR_MAX_LENGTH];
-				unsigned ip_length = MIN(l, IP_STR_MAX_LENGTH - 1);
-				memcpy(ip_str, s, ip_length);
+				unsigned ip_length = MIN(sdp.lines[line].length, IP_STR_MAX_LENGTH - 1);
+				memcpy(ip_str, sdp.value(line), ip_length);
 				ip_str[ip_length] = 0;
 				vmIP ip;
 				if(ip.setFromString(ip_str)) {
@@ -1988,84 +2066,76 @@ int get_ip_port_from_sdp(Call *call, packet_s_process *packetS, char *sdp_text,
 			}
 		}
 		
-		s = _gettag(sdp_media_text, sdp_media_text_len, "a=label:", &l);
-		if(l > 0) {
-			unsigned label_length = MIN(l, MAXLEN_SDP_LABEL - 1);
-			memcpy(sdp_media_data_item->label, s, label_length);
+		line = sdp.find_line(s_sdp_parse::_sdp_label, media->line_begin, media->line_end);
+		if(line >= 0 && sdp.lines[line].length > 0) {
+			unsigned label_length = MIN(sdp.lines[line].length, MAXLEN_SDP_LABEL - 1);
+			memcpy(sdp_media_data_item->label, sdp.value(line), label_length);
 			sdp_media_data_item->label[label_length] = 0;
 		}
 		
-		s = _gettag(sdp_media_text, sdp_media_text_len, "a=crypto:", &l);
-		if(l > 0) {
-			char *cryptoContent = s;
-			unsigned cryptoContentLength = l;
+		for(line = media->line_begin; line < media->line_end; line++) {
+			if(sdp.lines[line].type != s_sdp_parse::_sdp_crypto || !sdp.lines[line].length) {
+				continue;
+			}
+			char *cryptoContent = sdp.value(line);
+			unsigned cryptoContentLength = sdp.lines[line].length;
+			char *pointToParam = cryptoContent;
+			unsigned countParams = 0;
+			rtp_crypto_config crypto;
 			do {
-				char *pointToParam = s;
-				unsigned countParams = 0;
-				rtp_crypto_config crypto;
-				do {
-					++countParams;
-					char *pointToSeparator = strnchr(pointToParam, ' ', cryptoContentLength - (pointToParam - cryptoContent));
-					unsigned lengthParam = pointToSeparator ? pointToSeparator - pointToParam : cryptoContentLength - (pointToParam - cryptoContent);
-					switch(countParams) {
-					case 1:
-						crypto.tag = atoi(pointToParam);
-						break;
-					case 2:
-						crypto.suite = string(pointToParam, lengthParam);
-						break;
-					case 3:
-						if(!strncasecmp(pointToParam, "inline:", 7)) {
-							pointToParam += 7;
-							lengthParam -= 7;
-						}
-						char *lifeTimeSeparator = strnchr(pointToParam, '|', lengthParam);
-						crypto.key = string(pointToParam, lifeTimeSeparator ? (lifeTimeSeparator - pointToParam) : lengthParam);
-						break;
-					}
-					pointToParam = pointToSeparator ? pointToSeparator + 1 : NULL;
-				} while(pointToParam && countParams < 3);
-				if(crypto.suite.length() && crypto.key.length()) {
-					if(!sdp_media_data_item->rtp_crypto_config_list) {
-						sdp_media_data_item->rtp_crypto_config_list = new FILE_LINE(0) list<rtp_crypto_config>;
+				++countParams;
+				char *pointToSeparator = strnchr(pointToParam, ' ', cryptoContentLength - (pointToParam - cryptoContent));
+				unsigned lengthParam = pointToSeparator ? pointToSeparator - pointToParam : cryptoContentLength - (pointToParam - cryptoContent);
+				switch(countParams) {
+				case 1:
+					crypto.tag = atoi(pointToParam);
+					break;
+				case 2:
+					crypto.suite = string(pointToParam, lengthParam);
+					break;
+				case 3:
+					if(!strncasecmp(pointToParam, "inline:", 7)) {
+						pointToParam += 7;
+						lengthParam -= 7;
 					}
-					sdp_media_data_item->rtp_crypto_config_list->push_back(crypto);
+					char *lifeTimeSeparator = strnchr(pointToParam, '|', lengthParam);
+					crypto.key = string(pointToParam, lifeTimeSeparator ? (lifeTimeSeparator - pointToParam) : lengthParam);
+					break;
 				}
-				s = _gettag(s, sdp_media_text_len - (s - sdp_media_text), "a=crypto:", &l);
-				if(l > 0) {
-					cryptoContent = s;
-					cryptoContentLength = l;
-				} else {
-					cryptoContent = NULL;
+				pointToParam = pointToSeparator ? pointToSeparator + 1 : NULL;
+			} while(pointToParam && countParams < 3);
+			if(crypto.suite.length() && crypto.key.length()) {
+				if(!sdp_media_data_item->rtp_crypto_config_list) {
+					sdp_media_data_item->rtp_crypto_config_list = new FILE_LINE(0) list<rtp_crypto_config>;
 				}
+				sdp_media_data_item->rtp_crypto_config_list->push_back(crypto);
 			}
-			while(cryptoContent);
 		}
 		
-		if(memmem(sdp_media_text, sdp_media_text_len, "a=rtcp-mux", 10)) {
+		if(sdp.exists_line(s_sdp_parse::_sdp_rtcp_mux, media)) {
 			sdp_media_data_item->sdp_flags.rtcp_mux = 1;
 			call->use_rtcp_mux = true;
 		}
 		
 		bool sdp_sendonly = false;
 		bool sdp_sendrecv = false;
-		if(memmem(sdp_media_text, sdp_media_text_len, "a=sendonly", 10)) {
+		if(sdp.exists_line(s_sdp_parse::_sdp_sendonly, media)) {
 			call->use_sdp_sendonly = true;
 			if (sip_method == INVITE)
 				sdp_sendonly = true;
 		}
 		if (sip_method == INVITE) {
-			if(memmem(sdp_media_text, sdp_media_text_len, "a=sendrecv", 10))
+			if(sdp.exists_line(s_sdp_parse::_sdp_sendrecv, media))
 				sdp_sendrecv = true;
 
 			call->HandleHold(sdp_sendonly, sdp_sendrecv);
 		}
 		
-		if(!sdp_media_data_item->ip.isSet() && memmem(sdp_media_text, sdp_media_text_len, "a=inactive", 10)) {
+		if(!sdp_media_data_item->ip.isSet() && sdp.exists_line(s_sdp_parse::_sdp_inactive, media)) {
 			sdp_media_data_item->inactive_ip0 = true;
 		}
 		
-		get_rtpmap_from_sdp(sdp_media_text, sdp_media_text_len, sdp_media_data_item->rtpmap, &sdp_media_data_item->exists_payload_televent);
+		get_rtpmap_from_sdp(&sdp, media, sdp_media_data_item->rtpmap, &sdp_media_data_item->exists_payload_televent);
 
 		if(sdp_media_i > 0) {
 			(*next_sdp_media_data)->push_back(sdp_media_data_item);
@@ -2166,8 +2236,21 @@ void add_to_rtp_thread_queue(Call *call, packet_s_process_0 *packetS,
 	if(!preSyncRtp) {
 		__sync_add_and_fetch(&call->rtppacketsinqueue, 1);
 	}
+	if(opt_rtp_threads_balance) {
+		// thread_num is read and the packet pushed under the lock of the call - the move in rtp_read_thread_migrate_call
+		// cannot interleave with a push of other producer
+		while(__sync_lock_test_and_set(&call->rtp_thread_push_sync, 1)) {
+			USLEEP(10);
+		}
+		if(call->rtp_thread_migrate_to >= 0) {
+			rtp_read_thread_migrate_call(call);
+		}
+	}
 	rtp_read_thread *read_thread = &(rtp_threads[call->thread_num]);
 	read_thread->push(call, packetS, iscaller, find_by_dest, is_rtcp, stream_in_multiple_calls, is_fax, enable_save_packet, threadIndex);
+	if(opt_rtp_threads_balance) {
+		__sync_lock_release(&call->rtp_thread_push_sync);
+	}
 }
 
 
@@ -2184,7 +2267,7 @@ void *rtp_read_thread_func(void *arg) {
 	rtp_read_thread *read_thread = (rtp_read_thread*)arg;
 	read_thread->threadId = get_unix_tid();
 	read_thread->last_use_time_s = getTimeMS_rdtsc() / 1000;
-	unsigned int usleepCounter = 0;
+	unsigned int spinCounter = 0;
 	unsigned long usleepSumTime = 0;
 	unsigned long usleepSumTime_lastPush = 0;
 	while(!is_terminating() && !is_readend()) {
@@ -2194,7 +2277,8 @@ void *rtp_read_thread_func(void *arg) {
 			unsigned count = batch->count;
 			__SYNC_UNLOCK(read_thread->count_lock_sync);
 			for(unsigned batch_index = 0; batch_index < count && !is_readend(); batch_index++) {
-				read_thread->last_use_time_s = getTimeMS_rdtsc() / 1000;
+				u_int64_t time_ms = getTimeMS_rdtsc();
+				read_thread->last_use_time_s = time_ms / 1000;
 				bool rslt_read_rtp = false;
 				rtp_packet_pcap_queue *rtpp_pq = &batch->batch[batch_index];
 				if(!sverb.disable_read_rtp) {
@@ -2209,6 +2293,9 @@ void *rtp_read_thread_func(void *arg) {
 				if(rslt_read_rtp && !rtpp_pq->is_rtcp) {
 					rtpp_pq->call->set_last_rtp_packet_time_us(getTimeUS(rtpp_pq->packet->header_pt));
 				}
+				if(opt_rtp_threads_balance) {
+					read_thread->balance_account(rtpp_pq->call, time_ms);
+				}
 				rtpp_pq->packet->blockstore_addflag(71 /*pb lock flag*/);
 				//PACKET_S_PROCESS_DESTROY(&rtpp_pq->packet);
 				PACKET_S_PROCESS_PUSH_TO_STACK(&rtpp_pq->packet, 30 + read_thread->threadNum);
@@ -2227,7 +2314,8 @@ void *rtp_read_thread_func(void *arg) {
 					read_thread->readit++;
 				}
 			#endif
-			usleepCounter = 0;
+			read_thread->qringWaitPush.notify(&batch->used);
+			spinCounter = 0;
 			usleepSumTime = 0;
 			usleepSumTime_lastPush = 0;
 		} else {
@@ -2245,8 +2333,11 @@ void *rtp_read_thread_func(void *arg) {
 					usleepSumTime_lastPush = usleepSumTime;
 				}
 			}
+			if(opt_rtp_threads_balance) {
+				read_thread->steal(getTimeMS_rdtsc());
+			}
 			// no packet to read, wait and try again
-			usleepSumTime += USLEEP_C(rtp_qring_usleep, usleepCounter++);
+			usleepSumTime += read_thread->qringWaitPop.wait(&read_thread->qring[read_thread->readit]->used, 0, &spinCounter);
 		}
 	}
 	
@@ -2268,6 +2359,34 @@ void *rtp_read_thread_func(void *arg) {
 	return NULL;
 }
 
+void rtp_read_thread_migrate_call(Call *call) {
+	u_int64_t time_ms = getTimeMS_rdtsc();
+	// the only queued packet is the one being pushed
+	if(call->rtppacketsinqueue != 1) {
+		if(time_ms > call->rtp_thread_migrate_request_ms + RTP_THREAD_MIGRATE_REQUEST_TIMEOUT_MS) {
+			call->rtp_thread_migrate_to = -1;
+			__sync_add_and_fetch(&rtp_threads[call->thread_num].migrate_dropped, 1);
+		}
+		return;
+	}
+	extern volatile int num_threads_active;
+	int target = call->rtp_thread_migrate_to;
+	lock_add_remove_rtp_threads();
+	if(target != call->thread_num && target < num_threads_active &&
+	   rtp_threads[target].threadId > 0 && !rtp_threads[target].remove_flag) {
+		if(rtp_threads[call->thread_num].calls > 0) {
+			__sync_sub_and_fetch(&rtp_threads[call->thread_num].calls, 1);
+		}
+		__sync_add_and_fetch(&rtp_threads[target].calls, 1);
+		__sync_add_and_fetch(&rtp_threads[call->thread_num].migrated_out, 1);
+		__sync_add_and_fetch(&rtp_threads[target].migrated_in, 1);
+		call->thread_num = target;
+		call->rtp_thread_migrate_last_ms = time_ms;
+	}
+	unlock_add_remove_rtp_threads();
+	call->rtp_thread_migrate_to = -1;
+}
+
 void add_rtp_read_thread() {
 	extern int num_threads_start;
 	extern int num_threads_max;
@@ -2411,6 +2530,20 @@ string get_rtp_threads_cpu_usage(bool callPstat) {
 					outStr << setprecision(1) << (ucpu_usage + scpu_usage) << '%';
 					outStr << 'r' << rtp_threads[i].qring_size();
 					outStr << 'c' << rtp_threads[i].calls;
+					if(opt_rtp_threads_balance) {
+						u_int32_t migrated_in, migrated_out, migrate_dropped;
+						rtp_threads[i].getMigrateStat(&migrated_in, &migrated_out, &migrate_dropped);
+						if(migrated_in || migrated_out || migrate_dropped) {
+							outStr << 'm' << migrated_in << ':' << migrated_out << ':' << migrate_dropped;
+						}
+					}
+					if(sverb.qring_wait) {
+						u_int64_t wakeups, parked_us;
+						rtp_threads[i].getQringWaitStat(&wakeups, &parked_us);
+						if(wakeups) {
+							outStr << 'w' << wakeups << ':' << parked_us / 1000;
+						}
+					}
 					++counter;
 				}
 			}
@@ -2713,13 +2846,12 @@ inline Call *new_invite_register(packet_s_process *packetS, int sip_method, char
 			if(l > MAX_FNAME - 1) {
 				l = MAX_FNAME - 1;
 			}
-			strncpy(call->fbasename, s, l);
-			call->fbasename[l] = 0;
+			call->fbasename.set(s, l);
 			use_fbasename_header = true;
 		}
 	}
 	if(!use_fbasename_header) {
-		strcpy_null_term(call->fbasename, callidstr);
+		call->fbasename.set(callidstr);
 	}
 
 	/* this logic updates call on the first INVITES */
@@ -2736,19 +2868,19 @@ inline Call *new_invite_register(packet_s_process *packetS, int sip_method, char
 		}
 
 		// caller number
-		strcpy_null_term(call->caller, data_callerd.caller);
+		call->caller.set(data_callerd.caller);
 
 		// called number
-		strcpy_null_term(call->called, data_callerd.called);
+		call->called.set(data_callerd.called);
 
 		// caller domain 
-		strcpy_null_term(call->caller_domain, data_callerd.caller_domain);
+		call->caller_domain.set(data_callerd.caller_domain);
 
 		// called domain 
-		strcpy_null_term(call->called_domain, data_callerd.called_domain);
+		call->called_domain.set(data_callerd.called_domain);
 		
 		// callername
-		strcpy_null_term(call->callername, data_callerd.callername);
+		call->callername.set(data_callerd.callername);
 
 		if (opt_sipalg_detect) {
 			char via_ip_hostname[100];
@@ -2788,23 +2920,29 @@ inline Call *new_invite_register(packet_s_process *packetS, int sip_method, char
 			// copy contact num <sip:num@domain>
 			s = gettag_sip(packetS, "\nUser-Agent:", &l);
 			if(s) {
-				memcpy(call->a_ua, s, MIN(l, sizeof(call->a_ua)));
-				call->a_ua[MIN(l, sizeof(call->a_ua) - 1)] = '\0';
+				call->a_ua.set(s, l);
 				if(sverb.set_ua) {
 					cout << "set a_ua " << call->a_ua << endl;
 				}
 			}
 
-			get_sip_peername(packetS, "\nContact:", "\nm:", call->contact_num, sizeof(call->contact_num), ppntt_contact, ppndt_contact);
+			char contact_num[64];
+			get_sip_peername(packetS, "\nContact:", "\nm:", contact_num, sizeof(contact_num), ppntt_contact, ppndt_contact);
+			call->contact_num.set(contact_num);
 			// copy contact domain <sip:num@domain>
-			get_sip_domain(packetS, "\nContact:", "\nm:", call->contact_domain, sizeof(call->contact_domain), ppntt_contact, ppndt_contact_domain);
+			char contact_domain[128];
+			get_sip_domain(packetS, "\nContact:", "\nm:", contact_domain, sizeof(contact_domain), ppntt_contact, ppndt_contact_domain);
+			call->contact_domain.set(contact_domain);
 
 			// copy Authorization
 			for(int pass_authorization = 0; pass_authorization < 2; pass_authorization++) {
 				s = gettag_sip(packetS, pass_authorization == 0 ? "\nAuthorization:" : "\nProxy-Authorization:", &l);
 				if(s) {
-					get_value_stringkeyval(s, packetS->datalen_() - (s - packetS->data_()), "username=\"", call->digest_username, sizeof(call->digest_username));
-					get_value_stringkeyval(s, packetS->datalen_() - (s - packetS->data_()), "realm=\"", call->digest_realm, sizeof(call->digest_realm));
+					char digest_value[64];
+					get_value_stringkeyval(s, packetS->datalen_() - (s - packetS->data_()), "username=\"", digest_value, sizeof(digest_value));
+					call->digest_username.set(digest_value);
+					get_value_stringkeyval(s, packetS->datalen_() - (s - packetS->data_()), "realm=\"", digest_value, sizeof(digest_value));
+					call->digest_realm.set(digest_value);
 					break;
 				}
 			}
@@ -2831,7 +2969,7 @@ inline Call *new_invite_register(packet_s_process *packetS, int sip_method, char
 			call->seeninvite = true;
 #ifdef DEBUG_INVITE
 			syslog(LOG_NOTICE, "New call: srcip INET_NTOA[%u] dstip INET_NTOA[%u] From[%s] To[%s] Call-ID[%s]\n", 
-				call->sipcallerip, call->sipcalledip, call->caller, call->called, call->fbasename);
+				call->sipcallerip, call->sipcalledip, call->caller.c_str(), call->called.c_str(), call->fbasename.c_str());
 #endif
 		}
 		if(sip_method == MESSAGE) {
@@ -2986,7 +3124,7 @@ void process_sdp(Call *call, packet_s_process *packetS, int iscaller, char *from
 				if(ok_ip_port) {
 					if(sdp_media_data_item->sdp_flags.is_fax) { 
 						if(verbosity >= 2){
-							syslog(LOG_ERR, "[%s] T38 detected", call->fbasename);
+							syslog(LOG_ERR, "[%s] T38 detected", call->fbasename.c_str());
 						}
 						call->isfax = T38FAX;
 					} else {
@@ -3462,14 +3600,14 @@ void process_packet_sip_call(packet_s_process *packetS) {
 				if(opt_remoteparty_caller[0]) {
 					for(unsigned i = 0; i < opt_remoteparty_caller_v.size(); i++) {
 						if(partyNumber.find(opt_remoteparty_caller_v[i]) != partyNumber.end()) {
-							strcpy_null_term(call->caller, partyNumber[opt_remoteparty_caller_v[i]].c_str());
+							call->caller.set(partyNumber[opt_remoteparty_caller_v[i]]);
 						}
 					}
 				}
 				if(opt_remoteparty_called[0]) {
 					for(unsigned i = 0; i < opt_remoteparty_called_v.size(); i++) {
 						if(partyNumber.find(opt_remoteparty_called_v[i]) != partyNumber.end()) {
-							strcpy_null_term(call->called, partyNumber[opt_remoteparty_called_v[i]].c_str());
+							call->called.set(partyNumber[opt_remoteparty_called_v[i]]);
 						}
 					}
 				}
@@ -3492,13 +3630,15 @@ void process_packet_sip_call(packet_s_process *packetS) {
 		}
 		//update called number for each invite due to overlap-dialling
 		if ((opt_sipoverlap && packetS->saddr_() == call->getSipcallerip()) || (opt_last_dest_number && !reverseInviteSdaddr)) {
+			char called[1024];
 			get_sip_peername(packetS, "\nTo:", "\nt:",
-					 call->called, sizeof(call->called), ppntt_to, ppndt_called);
+					 called, call->called.maxSize(), ppntt_to, ppndt_called);
+			call->called.set(called);
 			if(opt_destination_number_mode == 2) {
-				char called[1024] = "";
+				called[0] = '\0';
 				if(!get_sip_peername(packetS, "INVITE ", NULL, called, sizeof(called), ppntt_invite, ppndt_called) &&
 				   called[0] != '\0') {
-					strcpy_null_term(call->called, called);
+					call->called.set(called);
 				}
 			}
 		}
@@ -3578,11 +3718,11 @@ void process_packet_sip_call(packet_s_process *packetS) {
 		}
 		if(rslt_parse_packet__message != -1) {
 			if(rsltDestNumber.length()) {
-				strcpy_null_term(call->called, rsltDestNumber.c_str());
+				call->called.set(rsltDestNumber);
 				call->updateDstnumFromMessage = true;
 			}
 			if(rsltSrcNumber.length()) {
-				strcpy_null_term(call->caller, rsltSrcNumber.c_str());
+				call->caller.set(rsltSrcNumber);
 			}
 			if(rsltContentLength != (unsigned int)-1) {
 				call->content_length = rsltContentLength;
@@ -3726,7 +3866,7 @@ void process_packet_sip_call(packet_s_process *packetS) {
 						if(branch[0] != '\0') {
 							map<string, string>::iterator iter = call->called_invite_branch_map.find(branch);
 							if(iter != call->called_invite_branch_map.end()) {
-								strcpy_null_term(call->called, iter->second.c_str());
+								call->called.set(iter->second);
 								call->updateDstnumOnAnswer = true;
 							}
 						}
@@ -3962,7 +4102,7 @@ void process_packet_sip_call(packet_s_process *packetS) {
 			char tmp2 = tmp[l - 1];
 			tmp[l - 1] = '\0';
 			if(verbosity >= 2)
-				syslog(LOG_NOTICE, "[%s] DTMF SIP INFO [%c]", call->fbasename, tmp[0]);
+				syslog(LOG_NOTICE, "[%s] DTMF SIP INFO [%c]", call->fbasename.c_str(), tmp[0]);
 			call->handle_dtmf(*tmp, getTimeSF(packetS->header_pt), packetS->saddr_(), packetS->daddr_(), s_dtmf::sip_info);
 			tmp[l - 1] = tmp2;
 			if(!enable_save_dtmf_pcap(call)) {
@@ -3975,7 +4115,7 @@ void process_packet_sip_call(packet_s_process *packetS) {
 			char tmp2 = tmp[l];
 			tmp[l] = '\0';
 			if(verbosity >= 2)
-				syslog(LOG_NOTICE, "[%s] DTMF SIP INFO [%c]", call->fbasename, tmp[0]);
+				syslog(LOG_NOTICE, "[%s] DTMF SIP INFO [%c]", call->fbasename.c_str(), tmp[0]);
 			call->handle_dtmf(*tmp, getTimeSF(packetS->header_pt), packetS->saddr_(), packetS->daddr_(), s_dtmf::sip_info);
 			tmp[l] = tmp2;
 			if(!enable_save_dtmf_pcap(call)) {
@@ -3987,20 +4127,18 @@ void process_packet_sip_call(packet_s_process *packetS) {
 	// check if we have X-VoipMonitor-Custom1
 	s = gettag_sip(packetS, "\nX-VoipMonitor-Custom1:", &l);
 	if(s && l < 255) {
-		memcpy(call->custom_header1, s, l);
-		call->custom_header1[l] = '\0';
+		call->custom_header1.set(s, l);
 		if(verbosity > 2)
-			syslog(LOG_NOTICE, "Seen X-VoipMonitor-Custom1: %s\n", call->custom_header1);
+			syslog(LOG_NOTICE, "Seen X-VoipMonitor-Custom1: %s\n", call->custom_header1.c_str());
 	}
 
 	// check for opt_match_header
 	if(opt_match_header[0] != '\0') {
 		s = gettag_sip(packetS, opt_match_header, &l);
 		if(l && l < 128) {
-			memcpy(call->match_header, s, l);
-			call->match_header[l] = '\0';
+			call->match_header.set(s, l);
 			if(verbosity > 2)
-				syslog(LOG_NOTICE, "Seen header %s: %s\n", opt_match_header, call->match_header);
+				syslog(LOG_NOTICE, "Seen header %s: %s\n", opt_match_header, call->match_header.c_str());
 		}
 	}
 
@@ -4231,15 +4369,13 @@ endsip:
 		if(s) {
 			//cout << "**** " << call->call_id << " " << (iscaller > 0 ? "b" : "a") << " / " << string(s, l) << endl;
 			if(iscaller > 0) {
-				memcpy(call->b_ua, s, MIN(l, sizeof(call->b_ua)));
-				call->b_ua[MIN(l, sizeof(call->b_ua) - 1)] = '\0';
+				call->b_ua.set(s, l);
 				if(sverb.set_ua) {
 					cout << "set b_ua " << call->b_ua << endl;
 				}
 			}
 			if(iscalled > 0) {
-				memcpy(call->a_ua, s, MIN(l, sizeof(call->a_ua)));
-				call->a_ua[MIN(l, sizeof(call->a_ua) - 1)] = '\0';
+				call->a_ua.set(s, l);
 				if(sverb.set_ua) {
 					cout << "set a_ua " << call->a_ua << endl;
 				}
@@ -4258,6 +4394,11 @@ endsip:
 			packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_(),
 			call, logPacketSipMethodCallDescr);
 	}
+	
+	if(call) {
+		// the packet could shorten destroy_call_at* - reschedule the check in the cleanup timer wheel
+		calltable->cleanup_calls_wheel_update(call);
+	}
 }
 
 void process_packet_sip_alone_bye(packet_s_process *packetS) {
@@ -4291,6 +4432,7 @@ void process_packet_sip_alone_bye(packet_s_process *packetS) {
 	   call->existsByeCseq(&packetS->cseq)) {
 		call->lastSIPresponseNum = packetS->lastSIPresponseNum;
 	}
+	calltable->cleanup_calls_wheel_update(call);
 }
 
 void process_packet_sip_register(packet_s_process *packetS) {
@@ -4348,7 +4490,7 @@ void process_packet_sip_register(packet_s_process *packetS) {
 		}
 	}
 		
-	call = calltable->find_by_register_id(packetS->get_callid(), 0);
+	call = calltable->find_by_register_id(packetS->get_callid(), packetS->callid_length, packetS->callid_hash);
 	if(!call) {
 		if(packetS->sip_method == REGISTER) {
 			call = new_invite_register(packetS, packetS->sip_method, packetS->get_callid());
@@ -4377,8 +4519,11 @@ void process_packet_sip_register(packet_s_process *packetS) {
 		for(int pass_authorization = 0; pass_authorization < 2; pass_authorization++) {
 			s = gettag_sip(packetS, pass_authorization == 0 ? "\nAuthorization:" : "\nProxy-Authorization:", &l);
 			if(s) {
-				get_value_stringkeyval(s, packetS->datalen_() - (s - packetS->data_()), "username=\"", call->digest_username, sizeof(call->digest_username));
-				get_value_stringkeyval(s, packetS->datalen_() - (s - packetS->data_()), "realm=\"", call->digest_realm, sizeof(call->digest_realm));
+				char digest_value[64];
+				get_value_stringkeyval(s, packetS->datalen_() - (s - packetS->data_()), "username=\"", digest_value, sizeof(digest_value));
+				call->digest_username.set(digest_value);
+				get_value_stringkeyval(s, packetS->datalen_() - (s - packetS->data_()), "realm=\"", digest_value, sizeof(digest_value));
+				call->digest_realm.set(digest_value);
 				break;
 			}
 		}
@@ -4537,7 +4682,7 @@ void process_packet_sip_register(packet_s_process *packetS) {
 	if(call->regstate && !call->regresponse) {
 		if(opt_enable_fraud && isFraudReady()) {
 			fraudRegisterResponse(call->sipcallerip[0], call->sipcalledip[0], call->first_packet_time_us,
-					      call->a_ua[0] ? call->a_ua : call->b_ua[0] ? call->b_ua : NULL, -1);
+					      call->a_ua[0] ? call->a_ua.c_str() : call->b_ua[0] ? call->b_ua.c_str() : NULL, -1);
 		}
 		call->regresponse = true;
 	}
@@ -4581,8 +4726,7 @@ endsip:
 	if(call && packetS->sip_method != REGISTER) {
 		s = gettag_sip(packetS, "\nUser-Agent:", &l);
 		if(s) {
-			memcpy(call->b_ua, s, MIN(l, sizeof(call->b_ua)));
-			call->b_ua[MIN(l, sizeof(call->b_ua) - 1)] = '\0';
+			call->b_ua.set(s, l);
 			if(sverb.set_ua) {
 				cout << "set b_ua " << call->b_ua << endl;
 			}
@@ -4856,14 +5000,14 @@ Call *process_packet__rtp_nosip(vmIP saddr, vmPort source, vmIP daddr, vmPort de
 	call->setSipcallerip(saddr, source);
 	call->setSipcalledip(daddr, dest);
 	call->flags = flags;
-	strcpy_null_term(call->fbasename, s);
+	call->fbasename.set(s);
 	call->seeninvite = true;
-	strcpy(call->callername, "RTP");
-	strcpy(call->caller, "RTP");
-	strcpy(call->called, "RTP");
+	call->callername.set("RTP");
+	call->caller.set("RTP");
+	call->called.set("RTP");
 
 #ifdef DEBUG_INVITE
-	syslog(LOG_NOTICE, "New RTP call: srcip INET_NTOA[%u] dstip INET_NTOA[%u] From[%s] To[%s]\n", call->sipcallerip, call->sipcalledip, call->caller, call->called);
+	syslog(LOG_NOTICE, "New RTP call: srcip INET_NTOA[%u] dstip INET_NTOA[%u] From[%s] To[%s]\n", call->sipcallerip, call->sipcalledip, call->caller.c_str(), call->called.c_str());
 #endif
 
 	// opening dump file
@@ -4915,7 +5059,7 @@ bool process_packet_rtp(packet_s_process_0 *packetS) {
 		packet_s_process_rtp_call_info call_info[MAX_LENGTH_CALL_INFO];
 		int call_info_length = 0;
 		bool call_info_find_by_dest = false;
-		calltable->lock_calls_hash();
+		calltable->lock_calls_hash_read();
 		node_call_rtp *n_call = NULL;
 		if((n_call = calltable->hashfind_by_ip_port(packetS->daddr_(), packetS->dest_(), false))) {
 			call_info_find_by_dest = true;
@@ -4986,7 +5130,7 @@ bool process_packet_rtp(packet_s_process_0 *packetS) {
 				}
 			}
 		}
-		calltable->unlock_calls_hash();
+		calltable->unlock_calls_hash_read();
 		if(call_info_length) {
 			if(call_info_length > 1) {
 				packetS->set_use_reuse_counter();
@@ -5563,7 +5707,7 @@ inline int parse_packet__message(packet_s_process *packetS, bool strictCheckLeng
 }
 
 inline Call *process_packet__merge(packet_s_process *packetS, char *callidstr, int *merged, bool preprocess) {
-	Call *call = calltable->find_by_mergecall_id(callidstr, 0, preprocess ? packetS->header_pt->ts.tv_sec : 0);
+	Call *call = calltable->find_by_mergecall_id(callidstr, packetS->callid_length, preprocess ? packetS->header_pt->ts.tv_sec : 0, packetS->callid_hash);
 	if(!call) {
 		// this call-id is not yet tracked either in calls list or callidmerge list 
 		// check if there is SIP callidmerge_header which contains parent call-id call
@@ -5596,7 +5740,7 @@ inline Call *process_packet__merge(packet_s_process *packetS, char *callidstr, i
 				*merged = 1;
 				calltable->lock_calls_mergeMAP();
 				call->has_second_merged_leg = true;
-				calltable->calls_mergeMAP[callidstr] = call;
+				calltable->calls_mergeMAP.setWithLock(callidstr, call);
 				calltable->unlock_calls_mergeMAP();
 				call->mergecalls_lock();
 				call->mergecalls[callidstr] = Call::sMergeLegInfo();
@@ -6212,357 +6356,6 @@ void readdump_libnids(pcap_t *handle) {
 #endif
 */
 
-inline void ipfrag_delete_node(ip_frag_s *node, int pushToStack_queue_index) {
-	if(node->header_packet) {
-		PUSH_HP(&node->header_packet, pushToStack_queue_index);
-	}
-	if(node->header_packet_pqout) {
-		((sHeaderPacketPQout*)node->header_packet_pqout)->destroy_or_unlock_blockstore();
-		delete ((sHeaderPacketPQout*)node->header_packet_pqout);
-	}
-	delete node;
-}
-
-/*
-
-defragment packets from queue and allocates memory for new header and packet which is returned 
-in **header an **packet 
-
-*/
-inline int _ipfrag_dequeue(ip_frag_queue *queue, 
-			   sHeaderPacket **header_packet, sHeaderPacketPQout *header_packet_pqout,
-			   int pushToStack_queue_index) {
-	//walk queue
-
-	if(!queue) return 1;
-	if(!queue->size()) return 1;
-
-	// prepare newpacket structure and header structure
-	u_int32_t totallen = queue->begin()->second->header_ip_offset;
-	unsigned i = 0;
-	for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-		totallen += it->second->len;
-		if(i) {
-			totallen -= it->second->iphdr_len;
-		}
-		i++;
-	}
-	if(totallen > 0xFFFF + queue->begin()->second->header_ip_offset) {
-		if(sverb.defrag_overflow) {
-			ip_frag_queue_it_t it = queue->begin();
-			if(it != queue->end()) {
-				ip_frag_s *node = it->second;
-				iphdr2 *iph = (iphdr2*)((u_char*)HPP(node->header_packet) + node->header_ip_offset);
-				syslog(LOG_NOTICE, "ipfrag overflow: %i src ip: %s dst ip: %s", totallen, iph->get_saddr().getString().c_str(), iph->get_daddr().getString().c_str());
-			}
-		}
-		totallen = 0xFFFF + queue->begin()->second->header_ip_offset;
-	}
-	
-	unsigned int additionallen = 0;
-	iphdr2 *iphdr = NULL;
-	i = 0;
-	unsigned int len = 0;
-	
-	if(header_packet) {
-		*header_packet = CREATE_HP(totallen);
-		for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-			ip_frag_s *node = it->second;
-			if(i == 0) {
-				// for first packet copy ethernet header and ip header
-				if(node->header_ip_offset) {
-					memcpy_heapsafe(HPP(*header_packet), *header_packet,
-							HPP(node->header_packet), node->header_packet,
-							node->header_ip_offset);
-					len += node->header_ip_offset;
-					iphdr = (iphdr2*)(HPP(*header_packet) + len);
-				}
-				memcpy_heapsafe(HPP(*header_packet) + len, *header_packet,
-						HPP(node->header_packet) + node->header_ip_offset, node->header_packet,
-						node->len);
-				len += node->len;
-			} else {
-				if(len < totallen) {
-					unsigned cpy_len = min((unsigned)(node->len - node->iphdr_len), totallen - len);
-					memcpy_heapsafe(HPP(*header_packet) + len, *header_packet,
-							HPP(node->header_packet) + node->header_ip_offset + node->iphdr_len, node->header_packet,
-							cpy_len);
-					len += cpy_len;
-					additionallen += cpy_len;
-				}
-			}
-			if(i == queue->size() - 1) {
-				memcpy_heapsafe(HPH(*header_packet), *header_packet, 
-						HPH(node->header_packet), node->header_packet,
-						sizeof(struct pcap_pkthdr));
-				HPH(*header_packet)->len = totallen;
-				HPH(*header_packet)->caplen = totallen;
-			}
-			ipfrag_delete_node(node, pushToStack_queue_index);
-			i++;
-		}
-	} else {
-		header_packet_pqout->header = new FILE_LINE(26012) pcap_pkthdr_plus;
-		header_packet_pqout->packet = new FILE_LINE(26013) u_char[totallen];
-		header_packet_pqout->block_store = NULL;
-		header_packet_pqout->block_store_index = 0;
-		header_packet_pqout->block_store_locked = false;
-		for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-			ip_frag_s *node = it->second;
-			if(i == 0) {
-				// for first packet copy ethernet header and ip header
-				if(node->header_ip_offset) {
-					memcpy_heapsafe(header_packet_pqout->packet, header_packet_pqout->packet,
-							((sHeaderPacketPQout*)node->header_packet_pqout)->packet, 
-							((sHeaderPacketPQout*)node->header_packet_pqout)->block_store ?
-							 ((sHeaderPacketPQout*)node->header_packet_pqout)->block_store->block :
-							 ((sHeaderPacketPQout*)node->header_packet_pqout)->packet,
-							node->header_ip_offset);
-					len += node->header_ip_offset;
-					iphdr = (iphdr2*)(header_packet_pqout->packet + len);
-				}
-				memcpy_heapsafe(header_packet_pqout->packet + len, header_packet_pqout->packet,
-						((sHeaderPacketPQout*)node->header_packet_pqout)->packet + node->header_ip_offset, 
-						((sHeaderPacketPQout*)node->header_packet_pqout)->block_store ?
-						 ((sHeaderPacketPQout*)node->header_packet_pqout)->block_store->block :
-						 ((sHeaderPacketPQout*)node->header_packet_pqout)->packet,
-						node->len);
-				len += node->len;
-			} else {
-				// for rest of a packets append only data 
-				if(len < totallen) {
-					unsigned cpy_len = min((unsigned)(node->len - node->iphdr_len), totallen - len);
-					memcpy_heapsafe(header_packet_pqout->packet + len, header_packet_pqout->packet,
-							((sHeaderPacketPQout*)node->header_packet_pqout)->packet + node->header_ip_offset + node->iphdr_len, 
-							((sHeaderPacketPQout*)node->header_packet_pqout)->block_store ?
-							 ((sHeaderPacketPQout*)node->header_packet_pqout)->block_store->block :
-							 ((sHeaderPacketPQout*)node->header_packet_pqout)->packet,
-							cpy_len);
-					len += cpy_len;
-					additionallen += cpy_len;
-				}
-			}
-			if(i == queue->size() - 1) {
-				memcpy_heapsafe(header_packet_pqout->header, header_packet_pqout->header,
-						((sHeaderPacketPQout*)node->header_packet_pqout)->header,
-						((sHeaderPacketPQout*)node->header_packet_pqout)->block_store ?
-						 ((sHeaderPacketPQout*)node->header_packet_pqout)->block_store->block :
-						 (u_char*)((sHeaderPacketPQout*)node->header_packet_pqout)->header,
-						sizeof(pcap_pkthdr_plus));
-				header_packet_pqout->header->set_len(totallen);
-				header_packet_pqout->header->set_caplen(totallen);
-			}
-			ipfrag_delete_node(node, 0);
-			i++;
-		}
-	}
-	if(iphdr) {
-		//increase IP header length 
-		iphdr->set_tot_len(iphdr->get_tot_len() + additionallen);
-		// reset checksum
-		iphdr->set_check(0);
-		// reset fragment flag to 0
-		iphdr->clear_frag_data();
-	}
-	
-	return 1;
-}
-
-inline int ipfrag_dequeue(ip_frag_queue *queue,
-			  sHeaderPacket **header_packet,
-			  int pushToStack_queue_index) {
-	return(_ipfrag_dequeue(queue,
-			       header_packet, NULL,
-			       pushToStack_queue_index));
-}
-
-inline int ipfrag_dequeue(ip_frag_queue *queue,
-			  sHeaderPacketPQout *header_packet_pqout) {
-	return(_ipfrag_dequeue(queue,
-			       NULL, header_packet_pqout,
-			       -1));
-}
-
-inline int _ipfrag_add(ip_frag_queue *queue, 
-		       sHeaderPacket **header_packet, sHeaderPacketPQout *header_packet_pqout,
-		       unsigned int header_ip_offset, unsigned int len,
-		       int pushToStack_queue_index) {
- 
-	iphdr2 *header_ip = header_packet ?
-			     (iphdr2*)((HPP(*header_packet)) + header_ip_offset) :
-			     (iphdr2*)(header_packet_pqout->packet + header_ip_offset);
-
-	u_int16_t frag_data = header_ip->get_frag_data();
-	unsigned int offset_d = header_ip->get_frag_offset(frag_data);
-
-	if(!header_ip->is_more_frag(frag_data) && offset_d) {
-		// this packet do not set more fragment indicator but contains offset which means that it is the last packet
-		queue->has_last = true;
-	}
-
-	if(!queue->count(offset_d)) {
-		// this offset number is not yet in the queue - add packet to queue which automatically sort it into right position
-
-		// create node
-		ip_frag_s *node = new FILE_LINE(26014) ip_frag_s;
-
-		if(header_packet) {
-			node->ts = HPH(*header_packet)->ts.tv_sec;
-			node->header_packet = *header_packet;
-			node->header_packet_pqout = NULL;
-			*header_packet = NULL;
-		} else {
-			node->ts = header_packet_pqout->header->get_tv_sec();
-			node->header_packet_pqout = new FILE_LINE(26015) sHeaderPacketPQout;
-			node->header_packet = NULL;
-			*(sHeaderPacketPQout*)node->header_packet_pqout = *header_packet_pqout;
-			((sHeaderPacketPQout*)node->header_packet_pqout)->alloc_and_copy_blockstore();
-		}
-		
-		node->header_ip_offset = header_ip_offset;
-		node->len = len;
-		node->offset = offset_d;
-		node->iphdr_len = header_ip->get_hdr_size();
-
-		// add to queue (which will sort it automatically
-		(*queue)[offset_d] = node;
-	} else {
-		// node with that offset already exists - discard
-		return -1;
-	}
-
-	// now check if packets in queue are complete - if yes - defragment - if not, do nithing
-	int ok = true;
-	unsigned int lastoffset = 0;
-	if(queue->has_last and queue->begin()->second->offset == 0) {
-		// queue has first and last packet - check if there are all middle fragments
-		for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-			ip_frag_s *node = it->second;
-			if((node->offset != lastoffset)) {
-				ok = false;
-				break;
-			}
-			lastoffset += node->len - node->iphdr_len;
-		}
-	} else {
-		// queue does not contain a last packet and does not contain a first packet
-		ok = false;
-	}
-
-	if(ok) {
-		// all packets -> defragment 
-		_ipfrag_dequeue(queue, header_packet, header_packet_pqout, pushToStack_queue_index);
-		return 1;
-	} else {
-		return 0;
-	}
-}
-
-inline int ipfrag_add(ip_frag_queue *queue, 
-		      sHeaderPacket **header_packet, 
-		      unsigned int header_ip_offset, unsigned int len,
-		      int pushToStack_queue_index) {
-	return(_ipfrag_add(queue, 
-			   header_packet, NULL,
-			   header_ip_offset, len,
-			   pushToStack_queue_index));
-}
-
-inline int ipfrag_add(ip_frag_queue *queue, 
-		      sHeaderPacketPQout *header_packet_pqout, 
-		      unsigned int header_ip_offset, unsigned int len) {
-	return(_ipfrag_add(queue, 
-			   NULL, header_packet_pqout,
-			   header_ip_offset, len,
-			   -1));
-}
-
-/* 
-
-function inserts packet into fragmentation queue and if all packets within fragmented IP are 
-complete it will dequeue and construct large packet from all fragmented packets. 
-
-return: if packet is defragmented from all pieces function returns 1 and set header and packet 
-pinters to new allocated data which has to be freed later. If packet is only queued function
-returns 0 and header and packet remains same
-
-*/
-inline int _handle_defrag(iphdr2 *header_ip, 
-			  sHeaderPacket **header_packet, sHeaderPacketPQout *header_packet_pqout, 
-			  ipfrag_data_s *ipfrag_data,
-			  int pushToStack_queue_index) {
- 
-	//copy header ip to tmp beacuse it can happen that during exectuion of this function the header_ip can be 
-	//overwriten in kernel ringbuffer if the ringbuffer is small and thus header_ip->saddr can have different value 
-	iphdr2 *header_ip_orig = (iphdr2*)new FILE_LINE(0) u_char[header_ip->get_hdr_size()];
-	memcpy(header_ip_orig, header_ip, header_ip->get_hdr_size());
-
-	// get queue from ip_frag_stream based on source ip address and ip->id identificator (2-dimensional map array)
-	ip_frag_queue *queue = ipfrag_data->ip_frag_stream[header_ip_orig->get_saddr()][header_ip_orig->get_frag_id()];
-	if(!queue) {
-		// queue does not exists yet - create it and assign to map 
-		queue = new FILE_LINE(26016) ip_frag_queue;
-		ipfrag_data->ip_frag_stream[header_ip_orig->get_saddr()][header_ip_orig->get_frag_id()] = queue;
-	}
-	int res = header_packet ?
-		   ipfrag_add(queue,
-			      header_packet, 
-			      (u_char*)header_ip - HPP(*header_packet), header_ip_orig->get_tot_len(),
-			      pushToStack_queue_index) :
-		   ipfrag_add(queue,
-			      header_packet_pqout, 
-			      (u_char*)header_ip - header_packet_pqout->packet, header_ip_orig->get_tot_len());
-	if(res > 0) {
-		// packet was created from all pieces - delete queue and remove it from map
-		ipfrag_data->ip_frag_stream[header_ip_orig->get_saddr()].erase(header_ip_orig->get_frag_id());
-		delete queue;
-	};
-	
-	delete header_ip_orig;
-	
-	return res;
-}
-
-int handle_defrag(iphdr2 *header_ip, sHeaderPacket **header_packet, ipfrag_data_s *ipfrag_data,
-		  int pushToStack_queue_index) {
-	return(_handle_defrag(header_ip, header_packet, NULL, ipfrag_data,
-			      pushToStack_queue_index));
-}
-
-int handle_defrag(iphdr2 *header_ip, void *header_packet_pqout, ipfrag_data_s *ipfrag_data) {
-	return(_handle_defrag(header_ip, NULL, (sHeaderPacketPQout*)header_packet_pqout, ipfrag_data,
-			      -1));
-}
-
-void ipfrag_prune(unsigned int tv_sec, bool all, ipfrag_data_s *ipfrag_data,
-		  int pushToStack_queue_index, int prune_limit) {
- 
-	if(prune_limit < 0) {
-		prune_limit = 30;
-	}
-	ip_frag_queue *queue;
-	for (ipfrag_data->ip_frag_streamIT = ipfrag_data->ip_frag_stream.begin(); ipfrag_data->ip_frag_streamIT != ipfrag_data->ip_frag_stream.end(); ipfrag_data->ip_frag_streamIT++) {
-		for (ipfrag_data->ip_frag_streamITinner = (*ipfrag_data->ip_frag_streamIT).second.begin(); ipfrag_data->ip_frag_streamITinner != (*ipfrag_data->ip_frag_streamIT).second.end();) {
-			queue = ipfrag_data->ip_frag_streamITinner->second;
-			if(!queue->size()) {
-				ipfrag_data->ip_frag_streamIT->second.erase(ipfrag_data->ip_frag_streamITinner++);
-				delete queue;
-				continue;
-			}
-			if(all or ((tv_sec - queue->begin()->second->ts) > prune_limit)) {
-				for (ip_frag_queue_it_t it = queue->begin(); it != queue->end(); ++it) {
-					ip_frag_s *node = it->second;
-					ipfrag_delete_node(node, pushToStack_queue_index);
-				}
-				ipfrag_data->ip_frag_streamIT->second.erase(ipfrag_data->ip_frag_streamITinner++);
-				delete queue;
-				continue;
-			}
-			ipfrag_data->ip_frag_streamITinner++;
-		}
-	}
-}
-
 void readdump_libpcap(pcap_t *handle, u_int16_t handle_index) {
 	pcapProcessData ppd;
 	u_int64_t packet_counter = 0;
@@ -7036,6 +6829,7 @@ void TcpReassemblySip::processPacket(packet_s_process **packetS_ref, bool isSip,
 			rev_it->second.last_seq = 0;
 			rev_it->second.last_ack_seq = 0;
 			rev_it->second.last_time_us = 0;
+			touchStream(&rev_it->second);
 		}
 	}
 	tcp_stream_id id(packetS->saddr_(), packetS->source_(), packetS->daddr_(), packetS->dest_());
@@ -7085,7 +6879,7 @@ void TcpReassemblySip::processPacket(packet_s_process **packetS_ref, bool isSip,
 						cout << " + call complete (check complete after add 1)" << endl;
 					}
 					complete(&it->second, id, processPacket);
-				} else if(it->second.complete_data && it->second.complete_data->size() > 65535) {
+				} else if(it->second.complete_data && it->second.complete_data->size() - it->second.complete_data_offset > 65535) {
 					cleanStream(&it->second);
 				}
 			}
@@ -7093,6 +6887,7 @@ void TcpReassemblySip::processPacket(packet_s_process **packetS_ref, bool isSip,
 	} else {
 		if(isSip) {
 			tcp_stream *stream = &tcp_streams[id];
+			stream->expire_iter = expire_index.insert(expire_index.begin(), id);
 			if(addPacket(stream, &packetS, processPacket)) {
 				usePacketS = true;
 				if(isCompleteStream(stream)) {
@@ -7111,14 +6906,14 @@ void TcpReassemblySip::processPacket(packet_s_process **packetS_ref, bool isSip,
 
 void TcpReassemblySip::clean(time_t ts) {
 	extern int opt_sip_tcp_reassembly_stream_timeout;
-	map<tcp_stream_id, tcp_stream>::iterator it;
-	for(it = tcp_streams.begin(); it != tcp_streams.end();) {
-		if(!ts || (ts - TIME_US_TO_S(it->second.last_time_us)) > (unsigned)opt_sip_tcp_reassembly_stream_timeout) {
-			cleanStream(&it->second, true);
-			tcp_streams.erase(it++);
-		} else {
-			++it;
+	while(!expire_index.empty()) {
+		map<tcp_stream_id, tcp_stream>::iterator it = tcp_streams.find(expire_index.front());
+		if(ts && (ts - TIME_US_TO_S(it->second.last_time_us)) <= (unsigned)opt_sip_tcp_reassembly_stream_timeout) {
+			break;
 		}
+		cleanStream(&it->second, true);
+		tcp_streams.erase(it);
+		expire_index.pop_front();
 	}
 }
 
@@ -7175,19 +6970,20 @@ bool TcpReassemblySip::addPacket(tcp_stream *stream, packet_s_process **packetS_
 	}
 
 	if(stream->packets) {
-		if(stream->complete_data) {
-			stream->complete_data->add(packetS->data_(), packetS->datalen_());
-		} else {
-			stream->complete_data =  new FILE_LINE(26020) SimpleBuffer(10000);
-			stream->complete_data->add(stream->packets->packetS->data_(), stream->packets->packetS->datalen_());
-			stream->complete_data->add(packetS->data_(), packetS->datalen_());
+		if(!stream->complete_data) {
+			packet_s_process *firstPacketS = stream->packets->packetS;
+			stream->complete_data = new FILE_LINE(26020) cStreamBuffer;
+			stream->complete_data_offset = firstPacketS->dataoffset_();
+			stream->complete_data->add((u_char*)firstPacketS->packet, firstPacketS->dataoffset_() + firstPacketS->datalen_());
 		}
+		stream->complete_data->add((u_char*)packetS->data_(), packetS->datalen_());
 	} else {
 		stream->packets = newPacket;
 	}
 	stream->last_seq = seq;
 	stream->last_ack_seq = ack_seq;
 	stream->last_time_us = getTimeUS(packetS->header_pt);
+	touchStream(stream);
 	
 	return(true);
 }
@@ -7201,7 +6997,8 @@ void TcpReassemblySip::complete(tcp_stream *stream, tcp_stream_id /*id*/, PrePro
 		completePacketS = stream->packets->packetS;
 		stream->packets->packetS = NULL;
 	} else {
-		completePacketS = PreProcessPacket::clonePacketS(stream->complete_data->data(), stream->complete_data->size(), stream->packets->packetS);
+		u_int32_t completeDataLength = stream->complete_data->size() - stream->complete_data_offset;
+		completePacketS = PreProcessPacket::clonePacketS_withPacket(stream->complete_data->release(), completeDataLength, stream->packets->packetS);
 	}
 	completePacketS->istcp = 2;
 	if(sverb.reassembly_sip || sverb.reassembly_sip_output) {
@@ -7241,6 +7038,7 @@ void TcpReassemblySip::cleanStream(tcp_stream* stream, bool /*callFromClean*/) {
 	if(stream->complete_data) {
 		delete stream->complete_data;
 		stream->complete_data = NULL;
+		stream->complete_data_offset = 0;
 	}
 }
 
@@ -7365,7 +7163,7 @@ void ReassemblyBuffer::processPacket(u_char *ethHeader, unsigned ethHeaderLength
 		b_data = &streams[id];
 		b_data->ethHeader = new FILE_LINE(0) SimpleBuffer;
 		b_data->ethHeader->add(ethHeader, ethHeaderLength);
-		b_data->buffer = new FILE_LINE(0) SimpleBuffer;
+		b_data->buffer = new FILE_LINE(0) cStreamBuffer;
 		b_data->type = (eType)(type & _type_mask);
 		b_data_update = true;
 	} else {
@@ -7448,8 +7246,7 @@ ReassemblyBuffer::sDataRslt ReassemblyBuffer::complete(sStreamId *streamId, sDat
 	memcpy(dataRslt.ethHeader, b_data->ethHeader->data(), dataRslt.ethHeaderLength);
 	dataRslt.ethHeaderAlloc = true;
 	dataRslt.dataLength = b_data->buffer->size();
-	dataRslt.data = new FILE_LINE(0) u_char[dataRslt.dataLength];
-	memcpy(dataRslt.data, b_data->buffer->data(), dataRslt.dataLength);
+	dataRslt.data = b_data->buffer->release();
 	dataRslt.dataAlloc = true;
 	dataRslt.saddr = streamId->s.ip;
 	dataRslt.sport = streamId->s.port;
@@ -7586,7 +7383,7 @@ void *PreProcessPacket::outThreadFunction() {
 	packet_s_process *packetS;
 	batch_packet_s *batch_detach;
 	batch_packet_s_process *batch;
-	unsigned int usleepCounter = 0;
+	unsigned int spinCounter = 0;
 	u_int64_t usleepSumTimeForPushBatch = 0;
 	while(!this->term_preProcess) {
 		if(this->typePreProcessThread == ppt_detach ?
@@ -7605,6 +7402,7 @@ void *PreProcessPacket::outThreadFunction() {
 					batch_detach->count = 0;
 					batch_detach->used = 0;
 				#endif
+				this->qringWaitPush.notify(&batch_detach->used);
 			} else {
 				batch = this->qring[this->readit];
 				__SYNC_LOCK(this->_sync_count);
@@ -7680,6 +7478,7 @@ void *PreProcessPacket::outThreadFunction() {
 					batch->count = 0;
 					batch->used = 0;
 				#endif
+				this->qringWaitPush.notify(&batch->used);
 			}
 			#if RQUEUE_SAFE
 				__SYNC_INCR(this->readit, this->qring_length);
@@ -7690,7 +7489,7 @@ void *PreProcessPacket::outThreadFunction() {
 					this->readit++;
 				}
 			#endif
-			usleepCounter = 0;
+			spinCounter = 0;
 			usleepSumTimeForPushBatch = 0;
 		} else {
 			if(this->outThreadState == 1) {
@@ -7767,7 +7566,10 @@ void *PreProcessPacket::outThreadFunction() {
 				}
 				usleepSumTimeForPushBatch = 0;
 			}
-			usleepSumTimeForPushBatch += USLEEP_C(opt_preprocess_packets_qring_usleep, usleepCounter++);
+			usleepSumTimeForPushBatch += this->qringWaitPop.wait(this->typePreProcessThread == ppt_detach ?
+									      &this->qring_detach[this->readit]->used :
+									      &this->qring[this->readit]->used,
+									     0, &spinCounter);
 		}
 	}
 	this->outThreadState = 0;
@@ -8287,11 +8089,19 @@ void PreProcessPacket::process_mgcp(packet_s_process **packetS_ref) {
 void PreProcessPacket::process_websocket(packet_s_process **packetS_ref) {
 	packet_s_process *packetS = *packetS_ref;
 	cWebSocketHeader ws(packetS->data_(), packetS->datalen_());
-	bool allocWsData;
-	u_char *ws_data = ws.decodeData(&allocWsData);
-	packet_s_process *newPacketS = clonePacketS(ws_data, ws.getDataLength(), packetS);
-	if(allocWsData) {
-		delete [] ws_data;
+	packet_s_process *newPacketS;
+	if(packetS->_packet_alloc && !packetS->audiocodes) {
+		// own packet (completed tcp stream) - the payload of frames is unmasked in place over the websocket headers
+		unsigned ws_data_length = ws.decodeDataInPlace();
+		newPacketS = clonePacketS_withPacket((u_char*)packetS->packet, ws_data_length, packetS);
+		delete packetS->header_pt;
+		packetS->_packet_alloc = false;
+	} else {
+		// the payload is unmasked directly to the new packet (the data of frames are not longer than the frames)
+		u_char *new_packet = new FILE_LINE(0) u_char[packetS->datalen_() + packetS->dataoffset_()];
+		memcpy(new_packet, packetS->packet, packetS->dataoffset_());
+		unsigned ws_data_length = ws.decodeMessageTo(new_packet + packetS->dataoffset_());
+		newPacketS = clonePacketS_withPacket(new_packet, ws_data_length, packetS);
 	}
 	PACKET_S_PROCESS_DESTROY(&packetS);
 	this->process_parseSipData(&newPacketS);
@@ -8354,7 +8164,7 @@ void PreProcessPacket::process_getLastSipResponse(packet_s_process **packetS_ref
 
 void PreProcessPacket::process_findCall(packet_s_process **packetS_ref) {
 	packet_s_process *packetS = *packetS_ref;
-	packetS->call = calltable->find_by_call_id(packetS->get_callid(), 0, packetS->callid_alternative, packetS->header_pt->ts.tv_sec);
+	packetS->call = calltable->find_by_call_id(packetS->get_callid(), packetS->callid_length, packetS->callid_alternative, packetS->header_pt->ts.tv_sec, packetS->callid_hash);
 	if(packetS->call) {
 		if(pcap_drop_flag) {
 			packetS->call->pcap_drop = pcap_drop_flag;
@@ -8414,6 +8224,13 @@ void PreProcessPacket::autoStopLastLevelPreProcessPacket(bool force) {
 }
 
 packet_s_process *PreProcessPacket::clonePacketS(u_char *newData, unsigned newDataLength, packet_s_process *packetS) {
+	u_char *new_packet = new FILE_LINE(0) u_char[newDataLength + packetS->dataoffset_()];
+	memcpy(new_packet, packetS->packet, packetS->dataoffset_());
+	memcpy(new_packet + packetS->dataoffset_(), newData, newDataLength);
+	return(clonePacketS_withPacket(new_packet, newDataLength, packetS));
+}
+
+packet_s_process *PreProcessPacket::clonePacketS_withPacket(u_char *newPacket, unsigned newDataLength, packet_s_process *packetS) {
 	packet_s_process *newPacketS = PACKET_S_PROCESS_SIP_CREATE();
 	*newPacketS = *packetS;
 	newPacketS->blockstore_clear();
@@ -8422,17 +8239,14 @@ packet_s_process *PreProcessPacket::clonePacketS(u_char *newData, unsigned newDa
 	*new_header = *newPacketS->header_pt;
 	new_header->caplen = newLen;
 	new_header->len = newLen;
-	u_char *new_packet = new FILE_LINE(0) u_char[newLen];
-	memcpy(new_packet, newPacketS->packet, newPacketS->dataoffset_());
-	memcpy(new_packet + newPacketS->dataoffset_(), newData, newDataLength);
-	//u_char *newDataInNewPacket = new_packet + newPacketS->dataoffset_();
-	iphdr2 *newHeaderIpInNewPacket = (iphdr2*)(new_packet + newPacketS->header_ip_offset);
+	//u_char *newDataInNewPacket = newPacket + newPacketS->dataoffset_();
+	iphdr2 *newHeaderIpInNewPacket = (iphdr2*)(newPacket + newPacketS->header_ip_offset);
 	newHeaderIpInNewPacket->set_tot_len(newLen - newPacketS->header_ip_offset);
 	//newPacketS->data = (char*)newDataInNewPacket;
 	newPacketS->_datalen = newDataLength;
 	newPacketS->_datalen_set = 0;
 	newPacketS->header_pt = new_header;
-	newPacketS->packet = new_packet;
+	newPacketS->packet = newPacket;
 	//newPacketS->header_ip = newHeaderIpInNewPacket;
 	newPacketS->_packet_alloc = true;
 	return(newPacketS);
@@ -8526,7 +8340,7 @@ void *ProcessRtpPacket::outThreadFunction() {
 	}
 	this->outThreadId = get_unix_tid();
 	syslog(LOG_NOTICE, "start ProcessRtpPacket %s out thread %i", this->type == hash ? "hash" : "distribute", this->outThreadId);
-	unsigned int usleepCounter = 0;
+	unsigned int spinCounter = 0;
 	u_int64_t usleepSumTimeForPushBatch = 0;
 	while(!this->term_processRtp) {
 		if(this->qring[this->readit]->used == 1) {
@@ -8556,7 +8370,8 @@ void *ProcessRtpPacket::outThreadFunction() {
 					this->readit++;
 				}
 			#endif
-			usleepCounter = 0;
+			this->qringWaitPush.notify(&batch->used);
+			spinCounter = 0;
 			usleepSumTimeForPushBatch = 0;
 		} else {
 			if(usleepSumTimeForPushBatch > 500000ull && !is_terminating()) {
@@ -8587,7 +8402,7 @@ void *ProcessRtpPacket::outThreadFunction() {
 				}
 				usleepSumTimeForPushBatch = 0;
 			}
-			usleepSumTimeForPushBatch += USLEEP_C(opt_process_rtp_packets_qring_usleep, usleepCounter++);
+			usleepSumTimeForPushBatch += this->qringWaitPop.wait(&this->qring[this->readit]->used, 0, &spinCounter);
 		}
 	}
 	return(NULL);
@@ -8644,7 +8459,11 @@ void ProcessRtpPacket::rtp_batch(batch_packet_s_process *batch, unsigned count)
 		for(unsigned batch_index = 0; batch_index < count; batch_index++) {
 			this->hash_find_flag[batch_index] = 0;
 		}
-		calltable->lock_calls_hash();
+		// with hash_rtp_rcu find_hash protects each packet itself
+		bool lock_calls_hash = !calltable->is_calls_hash_rcu();
+		if(lock_calls_hash) {
+			calltable->lock_calls_hash();
+		}
 		if(this->next_thread_handle[0]) {
 			for(int i = 0; i < MAX_PROCESS_RTP_PACKET_HASH_NEXT_THREADS; i++) {
 				this->hash_thread_data[i].null();
@@ -8719,7 +8538,9 @@ void ProcessRtpPacket::rtp_batch(batch_packet_s_process *batch, unsigned count)
 				}
 			}
 		}
-		calltable->unlock_calls_hash();
+		if(lock_calls_hash) {
+			calltable->unlock_calls_hash();
+		}
 		for(;batch_index_distribute < count; batch_index_distribute++) {
 			packet_s_process_0 *packetS = batch->batch[batch_index_distribute];
 			batch->batch[batch_index_distribute] = NULL;
@@ -8801,8 +8622,8 @@ void ProcessRtpPacket::find_hash(packet_s_process_0 *packetS, bool lock) {
 	packetS->blockstore_addflag(31 /*pb lock flag*/);
 	packetS->call_info_length = 0;
 	packetS->call_info_find_by_dest = false;
-	if(lock) {
-		calltable->lock_calls_hash();
+	if(lock || calltable->is_calls_hash_rcu()) {
+		calltable->lock_calls_hash_read();
 	}
 	node_call_rtp *n_call = NULL;
 	if((n_call = calltable->hashfind_by_ip_port(packetS->daddr_(), packetS->dest_(), false))) {
@@ -8873,8 +8694,8 @@ void ProcessRtpPacket::find_hash(packet_s_process_0 *packetS, bool lock) {
 			}
 		}
 	}
-	if(lock) {
-		calltable->unlock_calls_hash();
+	if(lock || calltable->is_calls_hash_rcu()) {
+		calltable->unlock_calls_hash_read();
 	}
 }
 
@@ -8976,6 +8797,17 @@ void rtp_read_thread::init(int threadNum, size_t qring_length) {
 	this->remove_flag = 0;
 	this->last_use_time_s = 0;
 	this->calls = 0;
+	this->steal_to = -1;
+	this->steal_request_ms = 0;
+	this->steal_last_ms = 0;
+	this->balance_window_ms = 0;
+	this->balance_packets = 0;
+	this->migrated_in = 0;
+	this->migrated_out = 0;
+	this->migrated_in_last = 0;
+	this->migrated_out_last = 0;
+	this->migrate_dropped = 0;
+	this->migrate_dropped_last = 0;
 	this->push_lock_sync = 0;
 	this->count_lock_sync = 0;
 	this->init_qring(qring_length);
@@ -9042,3 +8874,56 @@ void rtp_read_thread::term_thread_buffer() {
 size_t rtp_read_thread::qring_size() {
 	return(writeit >= readit ? writeit - readit : writeit + this->qring_length - readit);
 }
+
+void rtp_read_thread::balance_account(Call *call, u_int64_t time_ms) {
+	if(time_ms >= balance_window_ms + RTP_THREAD_BALANCE_WINDOW_MS) {
+		balance_window_ms = time_ms;
+		balance_packets = 0;
+	}
+	++balance_packets;
+	if(call->rtp_thread_balance_window_ms != balance_window_ms) {
+		call->rtp_thread_balance_window_ms = balance_window_ms;
+		call->rtp_thread_balance_packets = 0;
+	}
+	++call->rtp_thread_balance_packets;
+	int _steal_to = steal_to;
+	if(_steal_to >= 0 &&
+	   calls > 1 &&
+	   call->typeIs(INVITE) &&
+	   call->rtp_thread_migrate_to < 0 &&
+	   call->rtp_thread_balance_packets >= RTP_THREAD_MIGRATE_MIN_CALL_PACKETS &&
+	   call->rtp_thread_balance_packets * calls >= balance_packets &&
+	   time_ms > call->rtp_thread_migrate_last_ms + RTP_THREAD_MIGRATE_MIN_INTERVAL_MS) {
+		call->rtp_thread_migrate_request_ms = time_ms;
+		call->rtp_thread_migrate_to = _steal_to;
+		steal_to = -1;
+	}
+}
+
+void rtp_read_thread::steal(u_int64_t time_ms) {
+	if(remove_flag || time_ms < steal_last_ms + RTP_THREAD_STEAL_INTERVAL_MS) {
+		return;
+	}
+	steal_last_ms = time_ms;
+	extern volatile int num_threads_active;
+	int victimIndex = -1;
+	size_t victimQringSize = 0;
+	for(int i = 0; i < num_threads_active; i++) {
+		if(i != threadNum - 1 &&
+		   rtp_threads[i].threadId > 0 && !rtp_threads[i].remove_flag) {
+			size_t size = rtp_threads[i].qring_size();
+			if(size > victimQringSize) {
+				victimIndex = i;
+				victimQringSize = size;
+			}
+		}
+	}
+	if(victimIndex >= 0 && victimQringSize >= RTP_THREAD_STEAL_MIN_QRING_SIZE) {
+		rtp_read_thread *victim = &rtp_threads[victimIndex];
+		if(victim->steal_to < 0 ||
+		   time_ms > victim->steal_request_ms + RTP_THREAD_STEAL_INTERVAL_MS) {
+			victim->steal_request_ms = time_ms;
+			victim->steal_to = threadNum - 1;
+		}
+	}
+}
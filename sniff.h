@@ -33,6 +33,7 @@ void add_rtp_read_thread();
 void set_remove_rtp_read_thread();
 int get_index_rtp_read_thread_min_size();
 int get_index_rtp_read_thread_min_calls();
+void rtp_read_thread_migrate_call(Call *call);
 double get_rtp_sum_cpu_usage(double *max = NULL);
 string get_rtp_threads_cpu_usage(bool callPstat);
 
@@ -45,6 +46,88 @@ void readdump_libpcap(pcap_t *handle, u_int16_t handle_index);
 typedef std::map<vmIP, vmIP> nat_aliases_t; //!< 
 
 
+#define SDP_PARSE_LINES_INLINE 256
+#define SDP_PARSE_LINES_MAX 16384
+#define SDP_PARSE_MEDIA_MAX 10
+
+/* SDP parsed in one pass - the lines used by process_sdp (o=, c=, m=audio / m=image and the media attributes) are kept
+   as offsets of their values (leading and trailing spaces skipped as in _gettag). The media are selected as the former
+   repeated searches did - the next m=audio with port is preferred before the next m=image - and every media takes
+   the lines up to the next selected media. The lines are stored inline up to SDP_PARSE_LINES_INLINE, a longer SDP
+   (WebRTC with many video / data media and candidates) continues in the heap up to SDP_PARSE_LINES_MAX. */
+struct s_sdp_parse {
+	enum e_line_type {
+		_sdp_origin,
+		_sdp_connection_ip4,
+		_sdp_connection_ip6,
+		_sdp_media_audio,
+		_sdp_media_image,
+		_sdp_label,
+		_sdp_crypto,
+		_sdp_rtpmap,
+		_sdp_fmtp,
+		_sdp_rtcp_mux,
+		_sdp_sendonly,
+		_sdp_sendrecv,
+		_sdp_inactive
+	};
+	struct s_line {
+		u_int8_t type;
+		u_int32_t offset;
+		u_int32_t length;
+	};
+	struct s_media {
+		u_int16_t line_begin;
+		u_int16_t line_end;
+		vmPort port;
+		bool image;
+	};
+	s_sdp_parse() {
+		sdp = NULL;
+		sdp_len = 0;
+		lines = lines_inline;
+		lines_capacity = SDP_PARSE_LINES_INLINE;
+		lines_count = 0;
+		media_count = 0;
+	}
+	~s_sdp_parse() {
+		if(lines != lines_inline) {
+			delete [] lines;
+		}
+	}
+	void parse(char *sdp, unsigned sdp_len);
+	int find_line(u_int8_t type, unsigned begin = 0, unsigned end = SDP_PARSE_LINES_MAX) {
+		if(end > lines_count) {
+			end = lines_count;
+		}
+		for(unsigned i = begin; i < end; i++) {
+			if(lines[i].type == type) {
+				return(i);
+			}
+		}
+		return(-1);
+	}
+	bool exists_line(u_int8_t type, s_media *media) {
+		return(find_line(type, media->line_begin, media->line_end) >= 0);
+	}
+	char *value(unsigned line_index) {
+		return(sdp + lines[line_index].offset);
+	}
+	char *sdp;
+	unsigned sdp_len;
+	s_line *lines;
+	unsigned lines_capacity;
+	unsigned lines_count;
+	s_media media[SDP_PARSE_MEDIA_MAX];
+	unsigned media_count;
+private:
+	bool grow_lines();
+	s_sdp_parse(const s_sdp_parse&);
+	s_sdp_parse& operator = (const s_sdp_parse&);
+	s_line lines_inline[SDP_PARSE_LINES_INLINE];
+};
+
+
 /* this is copied from libpcap sll.h header file, which is not included in debian distribution */
 #define SLL_ADDRLEN       8               /* length of address field */
 struct sll_header {
@@ -351,6 +434,8 @@ struct packet_s_process : public packet_s_process_0 {
 	u_int32_t sipDataLen;
 	char callid[128];
 	char *callid_long;
+	unsigned callid_length;
+	u_int64_t callid_hash;
 	vector<string> *callid_alternative;
 	int sip_method;
 	sCseq cseq;
@@ -380,6 +465,8 @@ struct packet_s_process : public packet_s_process_0 {
 		sipDataLen = 0;
 		callid[0] = 0;
 		callid_long = NULL;
+		callid_length = 0;
+		callid_hash = 0;
 		callid_alternative = NULL;
 		sip_method = -1;
 		cseq.null();
@@ -419,6 +506,9 @@ struct packet_s_process : public packet_s_process_0 {
 			strncpy(callid, callid_input, callid_length);
 			callid[callid_length] = 0;
 		}
+		// hash for the lookups in calltable
+		this->callid_length = strlen(get_callid());
+		this->callid_hash = hashStr64(get_callid(), this->callid_length);
 	}
 	void set_callid_alternative(char *callid, unsigned callid_length) {
 		if(!callid_alternative) {
@@ -476,6 +566,20 @@ typedef struct {
 	char save_packet;
 } rtp_packet_pcap_queue;
 
+#define RTP_THREAD_BALANCE_WINDOW_MS 1000
+#define RTP_THREAD_STEAL_INTERVAL_MS 1000
+#define RTP_THREAD_STEAL_MIN_QRING_SIZE 2
+#define RTP_THREAD_MIGRATE_MIN_CALL_PACKETS 50
+#define RTP_THREAD_MIGRATE_MIN_INTERVAL_MS 10000
+#define RTP_THREAD_MIGRATE_REQUEST_TIMEOUT_MS 5000
+
+/* Queue and thread reading RTP of calls assigned to it (Call::thread_num).
+   With rtp_threads_balance an idle thread steals work - it posts a request (steal_to) to the thread with the longest
+   qring and that thread hands over the next of its hot calls (with at least average share of its packets in the last
+   window). The call moves in add_to_rtp_thread_queue when it has no packet queued (rtppacketsinqueue) so the packets
+   of one call are never read by two threads and their order is kept. A call whose queue never drains (the thread
+   is constantly behind it) cannot move - its request is dropped after RTP_THREAD_MIGRATE_REQUEST_TIMEOUT_MS and counted
+   in migrate_dropped (the third number of m<in>:<out>:<dropped> in get_rtp_threads_cpu_usage). */
 class rtp_read_thread {
 public:
 	#if DEBUG_QUEUE_RTP_THREAD
@@ -527,6 +631,22 @@ public:
 	void term_qring();
 	void term_thread_buffer();
 	size_t qring_size();
+	void getQringWaitStat(u_int64_t *wakeups, u_int64_t *parked_us) {
+		qringWaitPop.getStat(wakeups, parked_us);
+	}
+	void balance_account(Call *call, u_int64_t time_ms);
+	void steal(u_int64_t time_ms);
+	void getMigrateStat(u_int32_t *in, u_int32_t *out, u_int32_t *dropped) {
+		u_int32_t _in = migrated_in;
+		u_int32_t _out = migrated_out;
+		u_int32_t _dropped = migrate_dropped;
+		*in = _in - migrated_in_last;
+		*out = _out - migrated_out_last;
+		*dropped = _dropped - migrate_dropped_last;
+		migrated_in_last = _in;
+		migrated_out_last = _out;
+		migrate_dropped_last = _dropped;
+	}
 	inline void push(Call *call, packet_s_process_0 *packet, int iscaller, bool find_by_dest, int is_rtcp, bool stream_in_multiple_calls, char is_fax, int enable_save_packet, int threadIndex = 0) {
 		
 		/* destroy and quit - debug
@@ -566,9 +686,9 @@ public:
 				*/
 				
 				batch_packet_rtp *current_batch = this->qring[this->writeit];
-				unsigned int usleepCounter = 0;
+				unsigned int spinCounter = 0;
 				while(current_batch->used != 0) {
-					USLEEP_C(20, usleepCounter++);
+					this->qringWaitPush.wait(&current_batch->used, 1, &spinCounter);
 				}
 				memcpy(current_batch->batch, thread_buffer->batch, sizeof(rtp_packet_pcap_queue) * thread_buffer->count);
 				#if RQUEUE_SAFE
@@ -586,6 +706,7 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringWaitPop.notify(&current_batch->used);
 				
 				/* destroy threadbuffer array - debug
 				end_thread_buffer_copy:
@@ -622,9 +743,9 @@ public:
 			
 			if(!qring_push_index) {
 				packet->blockstore_addflag(62 /*pb lock flag*/);
-				unsigned int usleepCounter = 0;
+				unsigned int spinCounter = 0;
 				while(this->qring[this->writeit]->used != 0) {
-					USLEEP_C(20, usleepCounter++);
+					this->qringWaitPush.wait(&this->qring[this->writeit]->used, 1, &spinCounter);
 				}
 				qring_push_index = this->writeit + 1;
 				qring_push_index_count = 0;
@@ -658,6 +779,7 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringWaitPop.notify(&qring_active_push_item->used);
 				qring_push_index = 0;
 				qring_push_index_count = 0;
 			}
@@ -692,6 +814,7 @@ public:
 					this->writeit++;
 				}
 			#endif
+			this->qringWaitPop.notify(&qring_active_push_item->used);
 			qring_push_index = 0;
 			qring_push_index_count = 0;
 		}
@@ -717,9 +840,9 @@ public:
 		 
 			while(__sync_lock_test_and_set(&this->push_lock_sync, 1));
 			batch_packet_rtp *current_batch = this->qring[this->writeit];
-			unsigned int usleepCounter = 0;
+			unsigned int spinCounter = 0;
 			while(current_batch->used != 0) {
-				USLEEP_C(20, usleepCounter++);
+				this->qringWaitPush.wait(&current_batch->used, 1, &spinCounter);
 			}
 			memcpy(current_batch->batch, thread_buffer->batch, sizeof(rtp_packet_pcap_queue) * thread_buffer->count);
 			#if RQUEUE_SAFE
@@ -737,6 +860,7 @@ public:
 					this->writeit++;
 				}
 			#endif
+			this->qringWaitPop.notify(&current_batch->used);
 			thread_buffer->count = 0;
 			__sync_lock_release(&this->push_lock_sync);
 		}
@@ -762,8 +886,21 @@ public:
 	volatile bool remove_flag;
 	u_int32_t last_use_time_s;
 	volatile u_int32_t calls;
+	volatile int steal_to;
+	u_int64_t steal_request_ms;
+	u_int64_t steal_last_ms;
+	u_int64_t balance_window_ms;
+	u_int32_t balance_packets;
+	volatile u_int32_t migrated_in;
+	volatile u_int32_t migrated_out;
+	u_int32_t migrated_in_last;
+	u_int32_t migrated_out_last;
+	volatile u_int32_t migrate_dropped;
+	u_int32_t migrate_dropped_last;
 	volatile int push_lock_sync;
 	volatile int count_lock_sync;
+	cWaitNotify qringWaitPush;
+	cWaitNotify qringWaitPop;
 };
 
 #define MAXLIVEFILTERS 10
@@ -730,9 +730,9 @@ int pcapProcess(sHeaderPacket **header_packet, int pushToStack_queue_index,
 	cout << "packet " << (++counter) << " " << HPH(*header_packet)->ts.tv_sec << "." << setw(6) << setfill('0') << HPH(*header_packet)->ts.tv_usec;
 	#endif
 	if(((ppf & ppf_calcMD5) || (ppf & ppf_dedup)) && ppd->header_ip) {
-		// check for duplicate packets (md5 is expensive operation - enable only if you really need it
+		// check for duplicate packets (hash of each packet costs CPU - enable only if you really need it)
 		if(opt_dup_check && 
-		   ppd->prevmd5s != NULL && 
+		   ppd->dedup != NULL && 
 		   (((ppf & ppf_defragInPQout) && is_ip_frag == 1) ||
 		    (ppd->datalen > 0 && (opt_dup_check_ipheader || ppd->traillen < ppd->datalen))) &&
 		   !(ppd->istcp && opt_enable_http && (httpportmatrix[ppd->header_tcp->get_source()] || httpportmatrix[ppd->header_tcp->get_dest()])) &&
@@ -752,18 +752,16 @@ int pcapProcess(sHeaderPacket **header_packet, int pushToStack_queue_index,
 					ppd->header_ip->set_check(0);
 					header_ip_set_orig = true;
 				}
-				MD5_Init(&ppd->ctx);
 				if((ppf & ppf_defragInPQout) && is_ip_frag == 1) {
 					u_int32_t caplen = header_packet ? HPH(*header_packet)->caplen : pcap_header_plus2->get_caplen();
-					MD5_Update(&ppd->ctx, ppd->header_ip, MIN(caplen - ppd->header_ip_offset, ppd->header_ip->get_tot_len()));
+					dedup_hash(_md5, ppd->header_ip, MIN(caplen - ppd->header_ip_offset, ppd->header_ip->get_tot_len()));
 				} else if(opt_dup_check_ipheader) {
-					MD5_Update(&ppd->ctx, ppd->header_ip, MIN(ppd->datalen + (ppd->data - (char*)ppd->header_ip), ppd->header_ip->get_tot_len()));
+					dedup_hash(_md5, ppd->header_ip, MIN(ppd->datalen + (ppd->data - (char*)ppd->header_ip), ppd->header_ip->get_tot_len()));
 				} else {
 					// check duplicates based only on data (without ip header and without UDP/TCP header). Duplicate packets 
 					// will be matched regardless on IP 
-					MD5_Update(&ppd->ctx, ppd->data, MAX(0, (unsigned long)ppd->datalen - ppd->traillen));
+					dedup_hash(_md5, ppd->data, MAX(0, (unsigned long)ppd->datalen - ppd->traillen));
 				}
-				MD5_Final((unsigned char*)_md5, &ppd->ctx);
 				if(header_ip_set_orig) {
 					ppd->header_ip->set_ttl(header_ip_ttl_orig);
 					ppd->header_ip->set_check(header_ip_check_orig);
@@ -773,7 +771,9 @@ int pcapProcess(sHeaderPacket **header_packet, int pushToStack_queue_index,
 				#endif
 			}
 			if((ppf & ppf_dedup) && _md5[0]) {
-				if(memcmp(_md5, ppd->prevmd5s + (_md5[0] * MD5_DIGEST_LENGTH), MD5_DIGEST_LENGTH) == 0) {
+				if(ppd->dedup->check(_md5, header_packet ?
+							       getTimeUS(HPH(*header_packet)->ts) :
+							       getTimeUS(pcap_header_plus2->get_tv_sec(), pcap_header_plus2->get_tv_usec()))) {
 					//printf("dropping duplicate md5[%s]\n", md5);
 					duplicate_counter++;
 					if(sverb.dedup) {
@@ -787,7 +787,6 @@ int pcapProcess(sHeaderPacket **header_packet, int pushToStack_queue_index,
 					#endif
 					return(0);
 				}
-				memcpy(ppd->prevmd5s + (_md5[0] * MD5_DIGEST_LENGTH), _md5, MD5_DIGEST_LENGTH);
 			}
 		}
 	}
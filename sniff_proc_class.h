@@ -7,6 +7,7 @@
 #include "sniff.h"
 #include "calltable.h"
 #include "websocket.h"
+#include "stream_buffer.h"
 
 
 class TcpReassemblySip {
@@ -20,20 +21,6 @@ public:
 		tcp_stream_packet *next;
 		int lastpsh;
 	};
-	struct tcp_stream {
-		tcp_stream() {
-			packets = NULL;
-			complete_data = NULL;
-			last_seq = 0;
-			last_ack_seq = 0;
-			last_time_us = 0;
-		}
-		tcp_stream_packet* packets;
-		SimpleBuffer* complete_data;
-		u_int32_t last_seq;
-		u_int32_t last_ack_seq;
-		u_int64_t last_time_us;
-	};
 	struct tcp_stream_id {
 		tcp_stream_id(vmIP saddr = 0, vmPort source = 0, 
 			      vmIP daddr = 0, vmPort dest = 0) {
@@ -53,6 +40,24 @@ public:
 			       (this->dest < other.dest));
 		}
 	};
+	struct tcp_stream {
+		tcp_stream() {
+			packets = NULL;
+			complete_data = NULL;
+			complete_data_offset = 0;
+			last_seq = 0;
+			last_ack_seq = 0;
+			last_time_us = 0;
+		}
+		tcp_stream_packet* packets;
+		// headers of the first packet followed by the data of all packets - the packet of the completed message
+		cStreamBuffer* complete_data;
+		u_int32_t complete_data_offset;
+		u_int32_t last_seq;
+		u_int32_t last_ack_seq;
+		u_int64_t last_time_us;
+		list<tcp_stream_id>::iterator expire_iter;
+	};
 public:
 	TcpReassemblySip();
 	void processPacket(packet_s_process **packetS_ref, bool isSip, class PreProcessPacket *processPacket);
@@ -77,8 +82,8 @@ private:
 		int data_len;
 		u_char *data;
 		if(stream->complete_data) {
-			data_len = stream->complete_data->size();
-			data = stream->complete_data->data();
+			data_len = stream->complete_data->size() - stream->complete_data_offset;
+			data = stream->complete_data->data() + stream->complete_data_offset;
 		} else {
 			data_len = stream->packets->packetS->datalen_();
 			data = (u_char*)stream->packets->packetS->data_();
@@ -86,13 +91,19 @@ private:
 		return(this->checkSip(data, data_len, false));
 	}
 	void cleanStream(tcp_stream *stream, bool callFromClean = false);
+	// expire_index is ordered by the last packet of the streams, streams without time are at its beginning
+	void touchStream(tcp_stream *stream) {
+		expire_index.splice(stream->last_time_us ? expire_index.end() : expire_index.begin(),
+				    expire_index, stream->expire_iter);
+	}
 public:
 	static bool checkSip(u_char *data, int data_len, bool strict, list<d_u_int32_t> *offsets = NULL) {
 		if(check_websocket(data, data_len)) {
 			cWebSocketHeader ws(data, data_len);
 			bool allocData;
-			u_char *ws_data = ws.decodeData(&allocData);
-			bool rslt = checkSip(ws_data, ws.getDataLength(), strict, offsets);
+			unsigned ws_data_length;
+			u_char *ws_data = ws.decodeData(&allocData, &ws_data_length);
+			bool rslt = checkSip(ws_data, ws_data_length, strict, offsets);
 			if(rslt && offsets && offsets->size()) {
 				unsigned count = 0;
 				for(list<d_u_int32_t>::iterator iter = offsets->begin(); iter != offsets->end(); iter++) {
@@ -160,6 +171,7 @@ public:
 	}
 private:
 	map<tcp_stream_id, tcp_stream> tcp_streams;
+	list<tcp_stream_id> expire_index;
 	time_t last_cleanup;
 };
 
@@ -211,7 +223,7 @@ public:
 	};
 	struct sData : sData_base {
 		SimpleBuffer *ethHeader;
-		SimpleBuffer *buffer;
+		cStreamBuffer *buffer;
 	};
 	struct sDataRslt : sData_base {
 		u_char *ethHeader;
@@ -412,9 +424,9 @@ public:
 	inline void push_packet_detach(packet_s *packetS) {
 		if(this->outThreadState == 2) {
 			if(!qring_push_index) {
-				unsigned int usleepCounter = 0;
+				unsigned int spinCounter = 0;
 				while(this->qring_detach[this->writeit]->used != 0) {
-					USLEEP_C(20, usleepCounter++);
+					this->qringWaitPush.wait(&this->qring_detach[this->writeit]->used, 1, &spinCounter);
 				}
 				qring_push_index = this->writeit + 1;
 				qring_push_index_count = 0;
@@ -448,6 +460,7 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringWaitPop.notify(&qring_detach_active_push_item->used);
 				qring_push_index = 0;
 				qring_push_index_count = 0;
 			}
@@ -467,12 +480,14 @@ public:
 		if(this->outThreadState == 2) {
 			++qringPushCounter;
 			if(!qring_push_index) {
-				unsigned int usleepCounter = 0;
+				unsigned int spinCounter = 0;
+				bool full = false;
 				while(this->qring[this->writeit]->used != 0) {
-					if(usleepCounter == 0) {
+					if(!full) {
 						++qringPushCounter_full;
+						full = true;
 					}
-					USLEEP_C(20, usleepCounter++);
+					this->qringWaitPush.wait(&this->qring[this->writeit]->used, 1, &spinCounter);
 				}
 				qring_push_index = this->writeit + 1;
 				qring_push_index_count = 0;
@@ -494,6 +509,7 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringWaitPop.notify(&qring_active_push_item->used);
 				qring_push_index = 0;
 				qring_push_index_count = 0;
 			}
@@ -606,6 +622,9 @@ public:
 						this->writeit++;
 					}
 				#endif
+				this->qringWaitPop.notify(typePreProcessThread == ppt_detach ?
+							  &qring_detach_active_push_item->used :
+							  &qring_active_push_item->used);
 				qring_push_index = 0;
 				qring_push_index_count = 0;
 			}
@@ -634,6 +653,9 @@ public:
 			(double)(_writeit - _readit) / qring_length * 100 :
 			(double)(qring_length - _readit + _writeit) / qring_length * 100);
 	}
+	void getQringWaitStat(u_int64_t *wakeups, u_int64_t *parked_us) {
+		qringWaitPop.getStat(wakeups, parked_us);
+	}
 	inline packet_s_process *packetS_sip_create() {
 		packet_s_process *packetS = new FILE_LINE(28004) packet_s_process;
 		return(packetS);
@@ -879,6 +901,8 @@ public:
 		return("");
 	}
 	static packet_s_process *clonePacketS(u_char *newData, unsigned newDataLength, packet_s_process *packetS);
+	// newPacket (allocated as u_char[]) already contains the headers of packetS followed by the new data
+	static packet_s_process *clonePacketS_withPacket(u_char *newPacket, unsigned newDataLength, packet_s_process *packetS);
 private:
 	void process_DETACH(packet_s *packetS_detach);
 	void process_DETACH_plus(packet_s_plus_pointer *packetS_detach);
@@ -930,6 +954,8 @@ private:
 	pstat_data threadPstatData[2];
 	u_int64_t qringPushCounter;
 	u_int64_t qringPushCounter_full;
+	cWaitNotify qringWaitPush;
+	cWaitNotify qringWaitPop;
 	int outThreadId;
 	volatile int _sync_push;
 	volatile int _sync_count;
@@ -1103,12 +1129,14 @@ public:
 		}
 		if(!qring_push_index) {
 			++qringPushCounter;
-			unsigned int usleepCounter = 0;
+			unsigned int spinCounter = 0;
+			bool full = false;
 			while(this->qring[this->writeit]->used != 0) {
-				if(usleepCounter == 0) {
+				if(!full) {
 					++qringPushCounter_full;
+					full = true;
 				}
-				USLEEP_C(20, usleepCounter++);
+				this->qringWaitPush.wait(&this->qring[this->writeit]->used, 1, &spinCounter);
 			}
 			qring_push_index = this->writeit + 1;
 			qring_push_index_count = 0;
@@ -1130,6 +1158,7 @@ public:
 					this->writeit++;
 				}
 			#endif
+			this->qringWaitPop.notify(&qring_active_push_item->used);
 			qring_push_index = 0;
 			qring_push_index_count = 0;
 		}
@@ -1149,6 +1178,7 @@ public:
 					this->writeit++;
 				}
 			#endif
+			this->qringWaitPop.notify(&qring_active_push_item->used);
 			qring_push_index = 0;
 			qring_push_index_count = 0;
 		}
@@ -1166,6 +1196,9 @@ public:
 			(double)(_writeit - _readit) / qring_length * 100 :
 			(double)(qring_length - _readit + _writeit) / qring_length * 100);
 	}
+	void getQringWaitStat(u_int64_t *wakeups, u_int64_t *parked_us) {
+		qringWaitPop.getStat(wakeups, parked_us);
+	}
 	bool isNextThreadsGt2Processing(int process_rtp_packets_hash_next_threads) {
 		for(int i = 2; i < process_rtp_packets_hash_next_threads; i++) {
 			if(this->hash_thread_data[i].processing) {
@@ -1204,6 +1237,8 @@ private:
 	pstat_data threadPstatData[1 + MAX_PROCESS_RTP_PACKET_HASH_NEXT_THREADS][2];
 	u_int64_t qringPushCounter;
 	u_int64_t qringPushCounter_full;
+	cWaitNotify qringWaitPush;
+	cWaitNotify qringWaitPop;
 	bool term_processRtp;
 	s_hash_thread_data hash_thread_data[MAX_PROCESS_RTP_PACKET_HASH_NEXT_THREADS];
 	volatile int *hash_find_flag;
@@ -8,6 +8,9 @@
 #include "calltable.h"
 
 
+extern bool opt_srtp_evp;
+
+
 bool RTPsecure::sCryptoConfig::init() {
 	#if HAVE_LIBGNUTLS
 	static struct {
@@ -367,6 +370,9 @@ void RTPsecure::term() {
 }
 
 bool RTPsecure::init_native() {
+	if(opt_srtp_evp) {
+		return(init_native_evp());
+	}
 	#if HAVE_LIBGNUTLS
 	extern bool init_lib_gcrypt();
 	if(!init_lib_gcrypt()) {
@@ -432,6 +438,22 @@ bool RTPsecure::init_native() {
 	#endif
 }
 
+bool RTPsecure::init_native_evp() {
+	if(cryptoConfigVector.size() && cryptoConfigActiveIndex < cryptoConfigVector.size() &&
+	   cryptoConfigVector[cryptoConfigActiveIndex].tag_len > SHA_DIGEST_LENGTH) {
+		setError(err_bad_tag_len);
+		return(false);
+	}
+	rtp->evp = new FILE_LINE(0) cSrtpEvp;
+	rtcp->evp = new FILE_LINE(0) cSrtpEvp;
+	if(!rtp->evp->init(key(), salt(), false) ||
+	   !rtcp->evp->init(key(), salt(), true)) {
+		setError(err_set_key);
+		return(false);
+	}
+	return(true);
+}
+
 bool RTPsecure::init_libsrtp() {
 	#if HAVE_LIBSRTP
 	extern void init_lib_srtp();
@@ -530,6 +552,10 @@ uint32_t RTPsecure::compute_rtp_roc(uint16_t seq) {
 }
 
 u_char *RTPsecure::rtp_digest(u_char *data, size_t data_len, uint32_t roc) {
+	if(rtp->evp) {
+		roc = htonl(roc);
+		return(rtp->evp->digest(data, data_len, &roc));
+	}
 	#if HAVE_LIBGNUTLS
 	gcry_md_reset(rtp->md);
 	gcry_md_write(rtp->md, data, data_len);
@@ -542,6 +568,9 @@ u_char *RTPsecure::rtp_digest(u_char *data, size_t data_len, uint32_t roc) {
 }
 
 u_char *RTPsecure::rtcp_digest(u_char *data, size_t data_len) {
+	if(rtcp->evp) {
+		return(rtcp->evp->digest(data, data_len, NULL));
+	}
 	#if HAVE_LIBGNUTLS
 	gcry_md_reset(rtcp->md);
 	gcry_md_write(rtcp->md, data, data_len);
@@ -553,6 +582,10 @@ u_char *RTPsecure::rtcp_digest(u_char *data, size_t data_len) {
 
 #if HAVE_LIBGNUTLS
 int RTPsecure::rtp_decrypt(u_char *data, unsigned data_len, uint32_t ssrc, uint32_t roc, uint16_t seq) {
+	if(rtp->evp) {
+		rtp->evp->rtp_crypt(data, data_len, ssrc, roc, seq);
+		return(0);
+	}
 	// Determines cryptographic counter (IV)
 	uint32_t counter[4];
 	counter[0] = rtp->salt[0];
@@ -564,6 +597,10 @@ int RTPsecure::rtp_decrypt(u_char *data, unsigned data_len, uint32_t ssrc, uint3
 }
 
 int RTPsecure::rtcp_decrypt(u_char *data, unsigned data_len, uint32_t ssrc, uint32_t index) {
+	if(rtcp->evp) {
+		rtcp->evp->rtcp_crypt(data, data_len, ssrc, index);
+		return(0);
+	}
 	uint32_t counter[4];
 	counter[0] = rtcp->salt[0];
 	counter[1] = rtcp->salt[1] ^ htonl(ssrc);
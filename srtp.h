@@ -12,6 +12,8 @@
 #include <srtp/srtp.h>
 #endif
 
+#include "srtp_evp.h"
+
 
 class RTPsecure {
 public:
@@ -67,6 +69,7 @@ public:
 			cipher = NULL;
 			md = NULL;
 			#endif
+			evp = NULL;
 			window = 0;
 			for(unsigned i = 0; i < sizeof(salt) / sizeof(salt[0]); i++) {
 				salt[i] = 0;
@@ -86,6 +89,9 @@ public:
 				gcry_md_close(md);
 			}
 			#endif
+			if(evp) {
+				delete evp;
+			}
 			#if HAVE_LIBSRTP
 			if(srtp_ctx) {
 				free(srtp_ctx);
@@ -96,6 +102,7 @@ public:
 		gcry_cipher_hd_t cipher;
 		gcry_md_hd_t md;
 		#endif
+		cSrtpEvp *evp;
 		uint64_t window;
 		uint32_t salt[4];
 		uint64_t counter_packets;
@@ -124,6 +131,7 @@ public:
 private:
 	bool init();
 	bool init_native();
+	bool init_native_evp();
 	bool init_libsrtp();
 	void term();
 	bool rtpDecrypt(u_char *payload, unsigned payload_len, uint16_t seq, uint32_t ssrc);
@@ -0,0 +1,227 @@
+#include <string.h>
+
+#include "heap_safe.h"
+#include "srtp_evp.h"
+
+
+// SHA1_* functions are deprecated since OpenSSL 3.0, EVP has no cheap copy of the precomputed HMAC state
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+
+cSrtpEvp::cSrtpEvp() {
+	cipher_ctx = NULL;
+	memset(&sha_inner, 0, sizeof(sha_inner));
+	memset(&sha_outer, 0, sizeof(sha_outer));
+	memset(salt, 0, sizeof(salt));
+	memset(tag, 0, sizeof(tag));
+	ok = false;
+	ks = NULL;
+	ks_size = 0;
+	ks_ssrc = 0;
+	ks_index = 0;
+	ks_packets = 0;
+	ks_blocks = 0;
+}
+
+cSrtpEvp::~cSrtpEvp() {
+	if(cipher_ctx) {
+		EVP_CIPHER_CTX_free(cipher_ctx);
+	}
+	if(ks) {
+		delete [] ks;
+	}
+}
+
+bool cSrtpEvp::init(u_char *master_key, u_char *master_salt, bool rtcp) {
+	ok = false;
+	ks_packets = 0;
+	EVP_CIPHER_CTX *master_ctx = EVP_CIPHER_CTX_new();
+	if(!master_ctx) {
+		return(false);
+	}
+	u_char key[16];
+	u_char auth_key[SHA_DIGEST_LENGTH];
+	bool rslt = EVP_EncryptInit_ex(master_ctx, EVP_aes_128_ecb(), NULL, master_key, NULL) == 1 &&
+		    EVP_CIPHER_CTX_set_padding(master_ctx, 0) == 1 &&
+		    derive(master_ctx, master_salt, rtcp ? 3 : 0, key, sizeof(key)) &&
+		    derive(master_ctx, master_salt, rtcp ? 4 : 1, auth_key, sizeof(auth_key)) &&
+		    derive(master_ctx, master_salt, rtcp ? 5 : 2, salt, 14);
+	EVP_CIPHER_CTX_free(master_ctx);
+	if(!rslt) {
+		return(false);
+	}
+	salt[14] = salt[15] = 0;
+	if(!cipher_ctx) {
+		cipher_ctx = EVP_CIPHER_CTX_new();
+		if(!cipher_ctx) {
+			return(false);
+		}
+	}
+	if(EVP_EncryptInit_ex(cipher_ctx, EVP_aes_128_ecb(), NULL, key, NULL) != 1 ||
+	   EVP_CIPHER_CTX_set_padding(cipher_ctx, 0) != 1) {
+		return(false);
+	}
+	u_char pad[SHA_CBLOCK];
+	memset(pad, 0x36, sizeof(pad));
+	for(unsigned i = 0; i < sizeof(auth_key); i++) {
+		pad[i] ^= auth_key[i];
+	}
+	rslt = SHA1_Init(&sha_inner) == 1 &&
+	       SHA1_Update(&sha_inner, pad, sizeof(pad)) == 1;
+	memset(pad, 0x5c, sizeof(pad));
+	for(unsigned i = 0; i < sizeof(auth_key); i++) {
+		pad[i] ^= auth_key[i];
+	}
+	rslt = rslt &&
+	       SHA1_Init(&sha_outer) == 1 &&
+	       SHA1_Update(&sha_outer, pad, sizeof(pad)) == 1;
+	memset(key, 0, sizeof(key));
+	memset(auth_key, 0, sizeof(auth_key));
+	memset(pad, 0, sizeof(pad));
+	ok = rslt;
+	return(rslt);
+}
+
+void cSrtpEvp::rtp_crypt(u_char *data, unsigned data_len, uint32_t ssrc, uint32_t roc, uint16_t seq) {
+	if(!ok || !data_len) {
+		return;
+	}
+	unsigned blocks = (data_len + 15) / 16;
+	u_int64_t index = ((u_int64_t)roc << 16) | seq;
+	if(blocks > SRTP_EVP_KEYSTREAM_PACKET_BLOCKS_MAX) {
+		crypt_direct(data, data_len, ssrc, index);
+		return;
+	}
+	if(!ks_packets || ssrc != ks_ssrc ||
+	   index < ks_index || index >= ks_index + ks_packets || blocks > ks_blocks) {
+		if(ks_packets && ssrc == ks_ssrc && index < ks_index) {
+			// late packet - the keystream of the following packets is kept
+			crypt_direct(data, data_len, ssrc, index);
+			return;
+		}
+		fill_keystream(ssrc, index, ks_packets && ssrc == ks_ssrc && ks_blocks > blocks ? ks_blocks : blocks);
+	}
+	xor_keystream(data, ks + (index - ks_index) * ks_blocks * 16, data_len);
+}
+
+void cSrtpEvp::rtcp_crypt(u_char *data, unsigned data_len, uint32_t ssrc, uint32_t index) {
+	if(!ok || !data_len) {
+		return;
+	}
+	crypt_direct(data, data_len, ssrc, index);
+}
+
+u_char *cSrtpEvp::digest(u_char *data, unsigned data_len, uint32_t *roc) {
+	u_char inner[SHA_DIGEST_LENGTH];
+	SHA_CTX sha = sha_inner;
+	SHA1_Update(&sha, data, data_len);
+	if(roc) {
+		SHA1_Update(&sha, roc, 4);
+	}
+	SHA1_Final(inner, &sha);
+	sha = sha_outer;
+	SHA1_Update(&sha, inner, sizeof(inner));
+	SHA1_Final(tag, &sha);
+	return(tag);
+}
+
+bool cSrtpEvp::derive(EVP_CIPHER_CTX *master_ctx, u_char *master_salt, u_int8_t label, u_char *out, unsigned out_len) {
+	u_char iv[16];
+	memset(iv, 0, sizeof(iv));
+	memcpy(iv, master_salt, 14);
+	iv[7] ^= label;
+	u_char _ks[32];
+	unsigned blocks = (out_len + 15) / 16;
+	if(blocks > sizeof(_ks) / 16) {
+		return(false);
+	}
+	keystream(master_ctx, iv, 0, _ks, blocks);
+	memcpy(out, _ks, out_len);
+	memset(_ks, 0, sizeof(_ks));
+	return(true);
+}
+
+void cSrtpEvp::set_iv(u_char *iv, uint32_t ssrc, u_int64_t index) {
+	memcpy(iv, salt, 16);
+	iv[4] ^= ssrc >> 24;
+	iv[5] ^= ssrc >> 16;
+	iv[6] ^= ssrc >> 8;
+	iv[7] ^= ssrc;
+	iv[8] ^= index >> 40;
+	iv[9] ^= index >> 32;
+	iv[10] ^= index >> 24;
+	iv[11] ^= index >> 16;
+	iv[12] ^= index >> 8;
+	iv[13] ^= index;
+}
+
+void cSrtpEvp::keystream(EVP_CIPHER_CTX *ctx, u_char *iv, unsigned block_start, u_char *ks, unsigned blocks) {
+	// the counter of block is in the last two bytes of iv (zero in salt) - it does not overflow for the SRTP packet
+	for(unsigned i = 0; i < blocks; i++) {
+		memcpy(ks + i * 16, iv, 16);
+		ks[i * 16 + 14] = (block_start + i) >> 8;
+		ks[i * 16 + 15] = block_start + i;
+	}
+	int out_len;
+	EVP_EncryptUpdate(ctx, ks, &out_len, ks, blocks * 16);
+}
+
+void cSrtpEvp::crypt_direct(u_char *data, unsigned data_len, uint32_t ssrc, u_int64_t index) {
+	u_char iv[16];
+	set_iv(iv, ssrc, index);
+	u_char _ks[SRTP_EVP_DIRECT_BLOCKS * 16];
+	unsigned block = 0;
+	while(data_len) {
+		unsigned blocks = (data_len + 15) / 16;
+		if(blocks > SRTP_EVP_DIRECT_BLOCKS) {
+			blocks = SRTP_EVP_DIRECT_BLOCKS;
+		}
+		keystream(cipher_ctx, iv, block, _ks, blocks);
+		unsigned len = blocks * 16 < data_len ? blocks * 16 : data_len;
+		xor_keystream(data, _ks, len);
+		data += len;
+		data_len -= len;
+		block += blocks;
+	}
+}
+
+void cSrtpEvp::fill_keystream(uint32_t ssrc, u_int64_t index, unsigned blocks) {
+	unsigned size = SRTP_EVP_KEYSTREAM_PACKETS * blocks * 16;
+	if(size > ks_size) {
+		if(ks) {
+			delete [] ks;
+		}
+		ks = new FILE_LINE(0) u_char[size];
+		ks_size = size;
+	}
+	// counter blocks of all packets are encrypted by one call - AES-NI processes more blocks in parallel
+	u_char iv[16];
+	for(unsigned i = 0; i < SRTP_EVP_KEYSTREAM_PACKETS; i++) {
+		set_iv(iv, ssrc, (index + i) & 0xFFFFFFFFFFFFull);
+		u_char *ks_packet = ks + i * blocks * 16;
+		for(unsigned j = 0; j < blocks; j++) {
+			memcpy(ks_packet + j * 16, iv, 16);
+			ks_packet[j * 16 + 14] = j >> 8;
+			ks_packet[j * 16 + 15] = j;
+		}
+	}
+	int out_len;
+	EVP_EncryptUpdate(cipher_ctx, ks, &out_len, ks, SRTP_EVP_KEYSTREAM_PACKETS * blocks * 16);
+	ks_ssrc = ssrc;
+	ks_index = index;
+	ks_packets = SRTP_EVP_KEYSTREAM_PACKETS;
+	ks_blocks = blocks;
+}
+
+void cSrtpEvp::xor_keystream(u_char *data, u_char *ks, unsigned data_len) {
+	unsigned i = 0;
+	for(; i + 8 <= data_len; i += 8) {
+		u_int64_t d, k;
+		memcpy(&d, data + i, 8);
+		memcpy(&k, ks + i, 8);
+		d ^= k;
+		memcpy(data + i, &d, 8);
+	}
+	for(; i < data_len; i++) {
+		data[i] ^= ks[i];
+	}
+}
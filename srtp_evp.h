@@ -0,0 +1,58 @@
+#ifndef SRTP_EVP_H
+#define SRTP_EVP_H
+
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+
+
+#define SRTP_EVP_KEYSTREAM_PACKETS 8
+#define SRTP_EVP_KEYSTREAM_PACKET_BLOCKS_MAX 16
+#define SRTP_EVP_DIRECT_BLOCKS 64
+
+
+/* Native SRTP engine (AES_CM_128 + HMAC_SHA1) on OpenSSL - the AES counter blocks are encrypted by EVP (AES-NI) and
+   HMAC starts from the sha1 states after the inner and outer pad precomputed from the session key, so that the packet
+   needs only the compression of its own data. The states are plain SHA_CTX (copied as a struct) - the copy of an EVP
+   digest context costs more than the compression of a G.711 packet.
+   The keystream of RTP is computed in one EVP call for SRTP_EVP_KEYSTREAM_PACKETS packets of the stream expected from
+   the packet index (ROC / seq) of the decrypted packet - the following packets in order are then decrypted only by the
+   xor with the prepared keystream. Late packets and packets longer than SRTP_EVP_KEYSTREAM_PACKET_BLOCKS_MAX blocks
+   (video) are decrypted directly without the change of the prepared keystream. */
+class cSrtpEvp {
+public:
+	cSrtpEvp();
+	~cSrtpEvp();
+	// derives the session keys (key derivation rate 0) from the master key (16 bytes) and master salt (14 bytes)
+	bool init(u_char *master_key, u_char *master_salt, bool rtcp);
+	void rtp_crypt(u_char *data, unsigned data_len, uint32_t ssrc, uint32_t roc, uint16_t seq);
+	void rtcp_crypt(u_char *data, unsigned data_len, uint32_t ssrc, uint32_t index);
+	// HMAC-SHA1 of data (+ roc in network order if not NULL), the result (SHA_DIGEST_LENGTH) is valid to the next call
+	u_char *digest(u_char *data, unsigned data_len, uint32_t *roc);
+private:
+	bool derive(EVP_CIPHER_CTX *master_ctx, u_char *master_salt, u_int8_t label, u_char *out, unsigned out_len);
+	void set_iv(u_char *iv, uint32_t ssrc, u_int64_t index);
+	void keystream(EVP_CIPHER_CTX *ctx, u_char *iv, unsigned block_start, u_char *ks, unsigned blocks);
+	void crypt_direct(u_char *data, unsigned data_len, uint32_t ssrc, u_int64_t index);
+	void fill_keystream(uint32_t ssrc, u_int64_t index, unsigned blocks);
+	static void xor_keystream(u_char *data, u_char *ks, unsigned data_len);
+private:
+	EVP_CIPHER_CTX *cipher_ctx;
+	SHA_CTX sha_inner;
+	SHA_CTX sha_outer;
+	u_char salt[16];
+	u_char tag[SHA_DIGEST_LENGTH];
+	bool ok;
+	u_char *ks;
+	unsigned ks_size;
+	uint32_t ks_ssrc;
+	u_int64_t ks_index;
+	unsigned ks_packets;
+	unsigned ks_blocks;
+};
+
+
+#endif //SRTP_EVP_H
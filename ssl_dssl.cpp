@@ -1,3 +1,6 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+
 #include "voipmonitor.h"
 #include "pcap_queue.h"
 
@@ -7,6 +10,11 @@
 
 #include "ssl_dssl.h"
 
+#if defined(HAVE_OPENSSL101) and defined(HAVE_LIBGNUTLS)
+#include "dssl/ssl_sessionkey_table.h"
+#include "dssl/tls_ticket_table.h"
+#endif //HAVE_OPENSSL101 && HAVE_LIBGNUTLS
+
 
 #if defined(HAVE_OPENSSL101) and defined(HAVE_LIBGNUTLS)
 
@@ -17,6 +25,8 @@ extern int opt_ssl_store_sessions_expiration_hours;
 extern MySqlStore *sqlStore;
 extern int opt_id_sensor;
 extern int opt_nocdr;
+extern bool opt_ssl_sessionkey_cache;
+extern string opt_ssl_sessionkey_cache_snapshot;
 
 static cSslDsslSessions *SslDsslSessions;
 
@@ -39,6 +49,7 @@ cSslDsslSession::cSslDsslSession(vmIP ip, vmPort port, string keyfile, string pa
 	stored_at = 0;
 	restored = false;
 	lastTimeSyslog = 0;
+	_sync_session = 0;
 	init();
 }
 
@@ -99,6 +110,9 @@ bool cSslDsslSession::initSession() {
 	session = new FILE_LINE(0) DSSL_Session;
 	DSSL_SessionInit(NULL, session, server_info);
 	session->env = DSSL_EnvCreate(100 /*sessionTableSize*/, 3600 /*key_timeout_interval*/);
+	if(SslDsslSessions && SslDsslSessions->session_key_cache) {
+		DSSL_EnvSetSharedCache(session->env, SslDsslSessions->session_key_cache, SslDsslSessions->session_ticket_cache);
+	}
 	session->last_packet = new FILE_LINE(0) DSSL_Pkt;
 	session->gener_master_secret = this->gener_master_secret;
 	session->gener_master_secret_data[0] = this;
@@ -122,11 +136,12 @@ void cSslDsslSession::termServer() {
 
 void cSslDsslSession::termSession() {
 	if(session) {
+		// deinit before destroy env - the session id is released in the (shared) session cache
+		DSSL_SessionDeInit(session);
 		DSSL_EnvDestroy(session->env);
 		session->env = NULL;
 		delete session->last_packet;
 		session->last_packet = NULL;
-		DSSL_SessionDeInit(session);
 		delete session;
 		session = NULL;
 	}
@@ -298,6 +313,7 @@ void cSslDsslSession::store_session(cSslDsslSessions *sessions, struct timeval t
 		SqlDb_row session_row_update;
 		session_row_update.add(sqlDateTimeString(ts.tv_sec), "stored_at");
 		session_row_update.add(session_data, "session");
+		sessions->lock_sessions_db();
 		if(!sessions->sqlDb) {
 			sessions->sqlDb = createSqlObject();
 		}
@@ -306,6 +322,7 @@ void cSslDsslSession::store_session(cSslDsslSessions *sessions, struct timeval t
 				     STORE_PROC_ID_OTHER);
 		this->stored_at = ts.tv_sec;
 		sessions->deleteOldSessions(ts);
+		sessions->unlock_sessions_db();
 	}
 }
 
@@ -425,8 +442,11 @@ cSslDsslSessions::cSslDsslSessions() {
 	sqlDb = NULL;
 	last_delete_old_sessions_at = 0;
 	exists_sessions_table = false;
+	session_key_cache = NULL;
+	session_ticket_cache = NULL;
 	loadSessions();
 	init();
+	initSessionKeyCache();
 }
 
 cSslDsslSessions::~cSslDsslSessions() {
@@ -434,6 +454,7 @@ cSslDsslSessions::~cSslDsslSessions() {
 		delete sqlDb;
 	}
 	term();
+	termSessionKeyCache();
 }
 
 void cSslDsslSessions::processData(vector<string> *rslt_decrypt, char *data, unsigned int datalen, vmIP saddr, vmIP daddr, vmPort sport, vmPort dport, struct timeval ts) {
@@ -511,12 +532,18 @@ void cSslDsslSessions::processData(vector<string> *rslt_decrypt, char *data, uns
 			}
 		}
 	}
-	if(session) {
-		session->processData(rslt_decrypt, data, datalen, 
-				     saddr, daddr, sport, dport, 
-				     ts, init_client_hello || init_store_session, this);
+	if(!session) {
+		unlock_sessions();
+		return;
 	}
+	// the decryption of the session runs outside the lock of sessions (only under the lock of the session) so that
+	// the sessions of the links in different tcp reassembly threads (ssl_reassembly_threads) are decrypted in parallel
+	session->lock_session();
 	unlock_sessions();
+	session->processData(rslt_decrypt, data, datalen, 
+			     saddr, daddr, sport, dport, 
+			     ts, init_client_hello || init_store_session, this);
+	session->unlock_session();
 }
 
 void cSslDsslSessions::destroySession(vmIP saddr, vmIP daddr, vmPort sport, vmPort dport) {
@@ -532,14 +559,21 @@ void cSslDsslSessions::destroySession(vmIP saddr, vmIP daddr, vmPort sport, vmPo
 		      dir == ePacketDirFromClient ? sport : dport);
 	map<sStreamId, cSslDsslSession*>::iterator iter_session;
 	iter_session = sessions.find(sid);
-	if(iter_session != sessions.end()) {
-		if(iter_session->second->client_random_master_secret) {
-			clientRandomErase(iter_session->second->session->client_random);
-		}
-		delete iter_session->second;
-		sessions.erase(iter_session);
+	if(iter_session == sessions.end()) {
+		unlock_sessions();
+		return;
 	}
+	cSslDsslSession *session = iter_session->second;
+	sessions.erase(iter_session);
 	unlock_sessions();
+	// wait for the running decryption of the session outside the lock of sessions - out of the map, the session
+	// can be locked only by processData which found it before the erase
+	session->lock_session();
+	session->unlock_session();
+	if(session->client_random_master_secret) {
+		clientRandomErase(session->session->client_random);
+	}
+	delete session;
 }
 
 void cSslDsslSessions::clientRandomSet(u_char *client_random, u_char *master_secret) {
@@ -640,6 +674,169 @@ string cSslDsslSessions::storeSessionsTableName() {
 	       opt_ssl_store_sessions == 2 ? "ssl_sessions" : "");
 }
 
+void cSslDsslSessions::initSessionKeyCache() {
+	if(!opt_ssl_sessionkey_cache) {
+		return;
+	}
+	session_key_cache = dssl_SessionKT_Create(SSL_DSSL_SESSION_KEY_CACHE_SIZE, SSL_DSSL_SESSION_KEY_CACHE_TIMEOUT);
+	session_ticket_cache = dssl_SessionTicketTable_Create(SSL_DSSL_SESSION_KEY_CACHE_SIZE, SSL_DSSL_SESSION_KEY_CACHE_TIMEOUT);
+	if(!session_key_cache || !session_ticket_cache) {
+		termSessionKeyCache();
+		return;
+	}
+	if(!opt_ssl_sessionkey_cache_snapshot.empty()) {
+		loadSessionKeyCacheSnapshot(opt_ssl_sessionkey_cache_snapshot.c_str());
+	}
+}
+
+void cSslDsslSessions::termSessionKeyCache() {
+	if(session_key_cache && session_ticket_cache &&
+	   !opt_ssl_sessionkey_cache_snapshot.empty()) {
+		saveSessionKeyCacheSnapshot(opt_ssl_sessionkey_cache_snapshot.c_str());
+	}
+	if(session_key_cache) {
+		dssl_SessionKT_Destroy(session_key_cache);
+		session_key_cache = NULL;
+	}
+	if(session_ticket_cache) {
+		dssl_SessionTicketTable_Destroy(session_ticket_cache);
+		session_ticket_cache = NULL;
+	}
+}
+
+void cSslDsslSessions::loadSessionKeyCacheSnapshot(const char *fileName) {
+	FILE *file = fopen(fileName, "r");
+	if(!file) {
+		return;
+	}
+	// the snapshot contains master secrets - a file which could be written by someone else is not trusted
+	struct stat fileStat;
+	if(fstat(fileno(file), &fileStat) ||
+	   fileStat.st_uid != geteuid() ||
+	   (fileStat.st_mode & (S_IWGRP | S_IWOTH))) {
+		syslog(LOG_ERR, "ssl - ignore file %s - it is not owned by the sniffer user or it is writable by group / others", fileName);
+		fclose(file);
+		return;
+	}
+	time_t now = time(NULL);
+	unsigned count_keys = 0;
+	unsigned count_tickets = 0;
+	char *buff = new FILE_LINE(0) char[SSL_DSSL_SESSION_KEY_CACHE_SNAPSHOT_LINE_MAX];
+	u_char *ticket = new FILE_LINE(0) u_char[SSL_DSSL_SESSION_KEY_CACHE_TICKET_MAX];
+	DSSL_Session *session = new FILE_LINE(0) DSSL_Session;
+	while(fgets(buff, SSL_DSSL_SESSION_KEY_CACHE_SNAPSHOT_LINE_MAX, file)) {
+		vector<string> parts = split(buff, ' ');
+		memset(session, 0, sizeof(*session));
+		// master_key_len is the length of data used from master_secret (ssl3 PRF) - the snapshot carries only the whole secret
+		if(parts.size() == 5 && parts[0] == "S" &&
+		   parts[1].length() == DSSL_SESSION_ID_SIZE * 2 &&
+		   parts[2].length() == SSL3_MASTER_SECRET_SIZE * 2 &&
+		   atoi(parts[3].c_str()) == SSL3_MASTER_SECRET_SIZE) {
+			time_t released_at = atol(parts[4].c_str());
+			if(now - released_at > SSL_DSSL_SESSION_KEY_CACHE_TIMEOUT) {
+				continue;
+			}
+			hexdecode(session->session_id, parts[1].c_str(), DSSL_SESSION_ID_SIZE);
+			hexdecode(session->master_secret, parts[2].c_str(), SSL3_MASTER_SECRET_SIZE);
+			session->master_key_len = SSL3_MASTER_SECRET_SIZE;
+			dssl_SessionKT_Lock(session_key_cache);
+			if(!dssl_SessionKT_Find(session_key_cache, session->session_id)) {
+				dssl_SessionKT_Add(session_key_cache, session);
+				DSSL_SessionKeyData *key_data = dssl_SessionKT_Find(session_key_cache, session->session_id);
+				if(key_data) {
+					// not used by any session - it expires in the same time as before the restart
+					key_data->refcount = 0;
+					key_data->released_time = released_at;
+					++count_keys;
+				}
+			}
+			dssl_SessionKT_Unlock(session_key_cache);
+		} else if(parts.size() == 7 && parts[0] == "T" &&
+			  parts[1].length() && parts[1].length() <= SSL_DSSL_SESSION_KEY_CACHE_TICKET_MAX * 2 && !(parts[1].length() % 2) &&
+			  parts[5].length() == SSL3_MASTER_SECRET_SIZE * 2) {
+			time_t timestamp = atol(parts[6].c_str());
+			if(now - timestamp > SSL_DSSL_SESSION_KEY_CACHE_TIMEOUT) {
+				continue;
+			}
+			unsigned ticket_len = parts[1].length() / 2;
+			hexdecode(ticket, parts[1].c_str(), ticket_len);
+			session->version = atoi(parts[2].c_str());
+			session->cipher_suite = atoi(parts[3].c_str());
+			session->compression_method = atoi(parts[4].c_str());
+			hexdecode(session->master_secret, parts[5].c_str(), SSL3_MASTER_SECRET_SIZE);
+			dssl_SessionTicketTable_Lock(session_ticket_cache);
+			if(!dssl_SessionTicketTable_Find(session_ticket_cache, ticket, ticket_len) &&
+			   dssl_SessionTicketTable_Add(session_ticket_cache, session, ticket, ticket_len) == DSSL_RC_OK) {
+				DSSL_SessionTicketData *ticket_data = dssl_SessionTicketTable_Find(session_ticket_cache, ticket, ticket_len);
+				if(ticket_data) {
+					ticket_data->timestamp = timestamp;
+					++count_tickets;
+				}
+			}
+			dssl_SessionTicketTable_Unlock(session_ticket_cache);
+		}
+	}
+	delete session;
+	delete [] ticket;
+	delete [] buff;
+	fclose(file);
+	syslog(LOG_NOTICE, "ssl - loaded %u session keys and %u session tickets from %s", count_keys, count_tickets, fileName);
+}
+
+void cSslDsslSessions::saveSessionKeyCacheSnapshot(const char *fileName) {
+	string fileNameTmp = string(fileName) + ".tmp";
+	// master secrets - readable only by the sniffer user regardless of umask
+	unlink(fileNameTmp.c_str());
+	int fd = open(fileNameTmp.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_TRUNC, 0600);
+	FILE *file = fd >= 0 ? fdopen(fd, "w") : NULL;
+	if(!file) {
+		syslog(LOG_ERR, "ssl - failed create file %s", fileNameTmp.c_str());
+		if(fd >= 0) {
+			close(fd);
+		}
+		return;
+	}
+	time_t now = time(NULL);
+	unsigned count_keys = 0;
+	unsigned count_tickets = 0;
+	dssl_SessionKT_Lock(session_key_cache);
+	for(int i = 0; i < session_key_cache->table_size; i++) {
+		for(DSSL_SessionKeyData *key_data = session_key_cache->table[i]; key_data; key_data = key_data->next) {
+			fprintf(file, "S %s %s %u %lu\n",
+				hexencode(key_data->id, DSSL_SESSION_ID_SIZE).c_str(),
+				hexencode(key_data->master_secret, SSL3_MASTER_SECRET_SIZE).c_str(),
+				key_data->master_secret_len,
+				(u_long)(key_data->released_time ? key_data->released_time : now));
+			++count_keys;
+		}
+	}
+	dssl_SessionKT_Unlock(session_key_cache);
+	dssl_SessionTicketTable_Lock(session_ticket_cache);
+	for(int i = 0; i < session_ticket_cache->table_size; i++) {
+		for(DSSL_SessionTicketData *ticket_data = session_ticket_cache->table[i]; ticket_data; ticket_data = ticket_data->next) {
+			if(ticket_data->ticket_size > SSL_DSSL_SESSION_KEY_CACHE_TICKET_MAX) {
+				continue;
+			}
+			fprintf(file, "T %s %u %u %u %s %lu\n",
+				hexencode(ticket_data->ticket, ticket_data->ticket_size).c_str(),
+				ticket_data->protocol_version,
+				ticket_data->cipher_suite,
+				ticket_data->compression_method,
+				hexencode(ticket_data->master_secret, SSL3_MASTER_SECRET_SIZE).c_str(),
+				(u_long)ticket_data->timestamp);
+			++count_tickets;
+		}
+	}
+	dssl_SessionTicketTable_Unlock(session_ticket_cache);
+	fclose(file);
+	if(rename(fileNameTmp.c_str(), fileName)) {
+		syslog(LOG_ERR, "ssl - failed rename file %s to %s", fileNameTmp.c_str(), fileName);
+		unlink(fileNameTmp.c_str());
+		return;
+	}
+	syslog(LOG_NOTICE, "ssl - saved %u session keys and %u session tickets to %s", count_keys, count_tickets, fileName);
+}
+
 
 #endif //HAVE_OPENSSL101 && HAVE_LIBGNUTLS
 
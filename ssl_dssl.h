@@ -28,6 +28,12 @@
 using namespace std;
 
 
+#define SSL_DSSL_SESSION_KEY_CACHE_SIZE 10007
+#define SSL_DSSL_SESSION_KEY_CACHE_TIMEOUT 3600
+#define SSL_DSSL_SESSION_KEY_CACHE_TICKET_MAX 4096
+#define SSL_DSSL_SESSION_KEY_CACHE_SNAPSHOT_LINE_MAX (SSL_DSSL_SESSION_KEY_CACHE_TICKET_MAX * 2 + 256)
+
+
 class cSslDsslSession {
 public:
 	enum eServerErrors {
@@ -50,6 +56,14 @@ public:
 			 vmIP saddr, vmIP daddr, vmPort sport, vmPort dport, 
 			 struct timeval ts, bool init, class cSslDsslSessions *sessions);
 	bool isClientHello(char *data, unsigned int datalen, NM_PacketDir dir);
+	void lock_session() {
+		while(__sync_lock_test_and_set(&this->_sync_session, 1)) {
+			USLEEP(10);
+		}
+	}
+	void unlock_session() {
+		__sync_lock_release(&this->_sync_session);
+	}
 private:
 	NM_PacketDir getDirection(vmIP sip, vmPort sport, vmIP dip, vmPort dport);
 	static void dataCallback(NM_PacketDir dir, void* user_data, u_char* data, uint32_t len, DSSL_Pkt* pkt);
@@ -78,6 +92,7 @@ private:
 	u_long stored_at;
 	bool restored;
 	u_int64_t lastTimeSyslog;
+	volatile int _sync_session;
 friend class cSslDsslSessions;
 };
 
@@ -147,6 +162,10 @@ private:
 	void loadSessions();
 	void deleteOldSessions(struct timeval ts);
 	string storeSessionsTableName();
+	void initSessionKeyCache();
+	void termSessionKeyCache();
+	void loadSessionKeyCacheSnapshot(const char *fileName);
+	void saveSessionKeyCacheSnapshot(const char *fileName);
 	void lock_sessions() {
 		while(__sync_lock_test_and_set(&this->_sync_sessions, 1));
 	}
@@ -168,6 +187,8 @@ private:
 	SqlDb *sqlDb;
 	u_long last_delete_old_sessions_at;
 	bool exists_sessions_table;
+	dssl_SessionKeyTable *session_key_cache;
+	DSSL_SessionTicketTable *session_ticket_cache;
 friend class cSslDsslSession;
 };
 
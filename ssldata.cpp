@@ -249,8 +249,9 @@ void SslData::processPacket(u_char *ethHeader, unsigned ethHeaderLength, bool et
 		if(dataType == ReassemblyBuffer::_websocket) {
 			cWebSocketHeader ws(data, dataLength);
 			bool allocWsData;
-			u_char *ws_data = ws.decodeData(&allocWsData);
-			cout << string((char*)ws_data, ws.getDataLength()) << endl;
+			unsigned ws_data_length;
+			u_char *ws_data = ws.decodeData(&allocWsData, &ws_data_length);
+			cout << string((char*)ws_data, ws_data_length) << endl;
 			if(allocWsData) {
 				delete [] ws_data;
 			}
@@ -68,6 +68,9 @@ public:
 			 void *uData, TcpReassemblyLink *reassemblyLink,
 			 std::ostream *debugStream);
 	void printContentSummary();
+	TcpReassemblyProcessData *createShardInstance() {
+		return(new FILE_LINE(0) SslData);
+	}
 private:
 	void processPacket(ReassemblyBuffer::sDataRslt *dataRslt) {
 		processPacket(dataRslt->ethHeader, dataRslt->ethHeaderLength, dataRslt->ethHeaderAlloc,
@@ -0,0 +1,164 @@
+#ifndef STR_ARENA_H
+#define STR_ARENA_H
+
+
+#include <string>
+#include <string.h>
+#include <sys/types.h>
+
+#include "tools_global.h"
+
+
+#define STR_ARENA_CHUNK_MIN 256
+#define STR_ARENA_CHUNK_MAX 4096
+
+
+/* Bump allocator for the strings of one object (Call). Memory is released only with the whole arena - a string which
+   grows gets a new buffer and the old one stays valid for readers which already took the pointer (as the fixed arrays did). */
+class cStrArena {
+public:
+	struct sChunk {
+		sChunk *next;
+		u_int32_t size;
+		u_int32_t used;
+		char *data() {
+			return((char*)(this + 1));
+		}
+	};
+public:
+	cStrArena() {
+		chunks = NULL;
+	}
+	~cStrArena() {
+		clear();
+	}
+	char *alloc(unsigned size) {
+		if(!chunks || chunks->size - chunks->used < size) {
+			unsigned chunkSize = chunks ? chunks->size * 2 : STR_ARENA_CHUNK_MIN;
+			if(chunkSize > STR_ARENA_CHUNK_MAX) {
+				chunkSize = STR_ARENA_CHUNK_MAX;
+			}
+			if(chunkSize < size) {
+				chunkSize = size;
+			}
+			sChunk *chunk = (sChunk*)new FILE_LINE(0) char[sizeof(sChunk) + chunkSize];
+			chunk->next = chunks;
+			chunk->size = chunkSize;
+			chunk->used = 0;
+			chunks = chunk;
+		}
+		char *rslt = chunks->data() + chunks->used;
+		chunks->used += size;
+		return(rslt);
+	}
+	void clear() {
+		while(chunks) {
+			sChunk *next = chunks->next;
+			delete [] (char*)chunks;
+			chunks = next;
+		}
+	}
+	size_t getAllocSize() {
+		size_t size = 0;
+		for(sChunk *chunk = chunks; chunk; chunk = chunk->next) {
+			size += sizeof(sChunk) + chunk->size;
+		}
+		return(size);
+	}
+	size_t getUsedSize() {
+		size_t size = 0;
+		for(sChunk *chunk = chunks; chunk; chunk = chunk->next) {
+			size += chunk->used;
+		}
+		return(size);
+	}
+private:
+	sChunk *chunks;
+};
+
+
+/* String with the capacity of the former char[max_size] member - set truncates to max_size - 1 as strcpy_null_term did.
+   The buffer is taken from the arena of the owner, an empty string takes no memory. */
+template <unsigned max_size>
+class cArenaStr {
+public:
+	cArenaStr() {
+		arena = NULL;
+		str = (char*)"";
+		capacity = 0;
+	}
+	void setArena(cStrArena *arena) {
+		this->arena = arena;
+	}
+	operator const char*() const {
+		return(str);
+	}
+	const char *c_str() const {
+		return(str);
+	}
+	bool isEmpty() const {
+		return(!str[0]);
+	}
+	unsigned length() const {
+		return(strlen(str));
+	}
+	static unsigned maxSize() {
+		return(max_size);
+	}
+	void set(const char *src) {
+		set(src, src ? strnlen(src, max_size - 1) : 0);
+	}
+	void set(const char *src, unsigned length) {
+		if(length > max_size - 1) {
+			length = max_size - 1;
+		}
+		if(!length) {
+			clear();
+			return;
+		}
+		if(length + 1 > capacity) {
+			unsigned newCapacity = (length + 1 + 7) & ~7u;
+			if(newCapacity > max_size) {
+				newCapacity = max_size;
+			}
+			char *newStr = arena->alloc(newCapacity);
+			memcpy(newStr, src, length);
+			newStr[length] = 0;
+			__sync_synchronize();
+			str = newStr;
+			capacity = newCapacity;
+		} else {
+			memmove(str, src, length);
+			str[length] = 0;
+		}
+	}
+	void set(const std::string &src) {
+		set(src.c_str(), src.length());
+	}
+	void clear() {
+		if(capacity) {
+			str[0] = 0;
+		}
+	}
+	cArenaStr &operator = (const char *src) {
+		set(src);
+		return(*this);
+	}
+	cArenaStr &operator = (const std::string &src) {
+		set(src);
+		return(*this);
+	}
+	cArenaStr &operator = (const cArenaStr &src) {
+		set(src.str);
+		return(*this);
+	}
+private:
+	cArenaStr(const cArenaStr&);
+private:
+	cStrArena *arena;
+	char *str;
+	unsigned capacity;
+};
+
+
+#endif //STR_ARENA_H
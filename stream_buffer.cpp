@@ -0,0 +1,106 @@
+#include "stream_buffer.h"
+#include "heap_safe.h"
+
+
+cStreamBufferArena streamBufferArena;
+
+
+cStreamBufferArena::cStreamBufferArena() {
+	for(int i = 0; i < STREAM_BUFFER_ARENA_CLASSES; i++) {
+		classes[i].free = NULL;
+		classes[i].count = 0;
+		classes[i]._sync = 0;
+	}
+}
+
+cStreamBufferArena::~cStreamBufferArena() {
+	for(int i = 0; i < STREAM_BUFFER_ARENA_CLASSES; i++) {
+		while(classes[i].free) {
+			sFreeItem *item = classes[i].free;
+			classes[i].free = item->next;
+			delete [] (u_char*)item;
+		}
+		classes[i].count = 0;
+	}
+}
+
+u_char *cStreamBufferArena::alloc(u_int32_t size, u_int32_t *capacity) {
+	int classIndex = getClass(size);
+	if(classIndex < 0) {
+		*capacity = size;
+		return(new FILE_LINE(0) u_char[size]);
+	}
+	*capacity = STREAM_BUFFER_ARENA_MIN_SIZE << classIndex;
+	sClass *_class = &classes[classIndex];
+	sFreeItem *item = NULL;
+	lock(_class);
+	if(_class->free) {
+		item = _class->free;
+		_class->free = item->next;
+		--_class->count;
+	}
+	unlock(_class);
+	if(item) {
+		return((u_char*)item);
+	}
+	return(new FILE_LINE(0) u_char[*capacity]);
+}
+
+void cStreamBufferArena::free(u_char *buffer, u_int32_t capacity) {
+	if(!buffer) {
+		return;
+	}
+	int classIndex = getClass(capacity);
+	if(classIndex >= 0 && (STREAM_BUFFER_ARENA_MIN_SIZE << classIndex) == capacity) {
+		sClass *_class = &classes[classIndex];
+		lock(_class);
+		if((_class->count + 1) * capacity <= STREAM_BUFFER_ARENA_CLASS_MAX_BYTES) {
+			sFreeItem *item = (sFreeItem*)buffer;
+			item->next = _class->free;
+			_class->free = item;
+			++_class->count;
+			buffer = NULL;
+		}
+		unlock(_class);
+	}
+	if(buffer) {
+		delete [] buffer;
+	}
+}
+
+
+void cStreamBuffer::destroy() {
+	if(buffer) {
+		streamBufferArena.free(buffer, capacity);
+		buffer = NULL;
+	}
+	length = 0;
+	capacity = 0;
+}
+
+u_char *cStreamBuffer::release() {
+	if(!buffer) {
+		grow(1);
+	}
+	u_char *data = buffer;
+	buffer = NULL;
+	length = 0;
+	capacity = 0;
+	return(data);
+}
+
+void cStreamBuffer::grow(u_int32_t size) {
+	u_int32_t newCapacity;
+	if(capacity && size < capacity * 2) {
+		size = capacity * 2;
+	}
+	u_char *newBuffer = streamBufferArena.alloc(size, &newCapacity);
+	if(buffer) {
+		if(length) {
+			memcpy(newBuffer, buffer, length);
+		}
+		streamBufferArena.free(buffer, capacity);
+	}
+	buffer = newBuffer;
+	capacity = newCapacity;
+}
@@ -0,0 +1,109 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+
+#include <string.h>
+#include <sys/types.h>
+
+#include "tools_global.h"
+
+
+#define STREAM_BUFFER_ARENA_MIN_SIZE 2048u
+#define STREAM_BUFFER_ARENA_CLASSES 8
+#define STREAM_BUFFER_ARENA_CLASS_MAX_BYTES (4 * 1024 * 1024)
+
+
+/* Arena of buffers for the data of TCP streams waiting for completion (partial SIP messages). The buffers are in size
+   classes by powers of two from STREAM_BUFFER_ARENA_MIN_SIZE and a freed buffer is kept in the free list of its class
+   (up to STREAM_BUFFER_ARENA_CLASS_MAX_BYTES of each class) for the next stream. The buffers are allocated as u_char[]
+   so that a completed buffer can leave the arena - the new owner frees it with delete []. */
+class cStreamBufferArena {
+public:
+	struct sFreeItem {
+		sFreeItem *next;
+	};
+	struct sClass {
+		sFreeItem *free;
+		unsigned count;
+		volatile int _sync;
+	};
+public:
+	cStreamBufferArena();
+	~cStreamBufferArena();
+	u_char *alloc(u_int32_t size, u_int32_t *capacity);
+	void free(u_char *buffer, u_int32_t capacity);
+private:
+	int getClass(u_int32_t size) {
+		u_int32_t classSize = STREAM_BUFFER_ARENA_MIN_SIZE;
+		for(int i = 0; i < STREAM_BUFFER_ARENA_CLASSES; i++) {
+			if(size <= classSize) {
+				return(i);
+			}
+			classSize <<= 1;
+		}
+		return(-1);
+	}
+	void lock(sClass *_class) {
+		while(__sync_lock_test_and_set(&_class->_sync, 1)) {
+			USLEEP(10);
+		}
+	}
+	void unlock(sClass *_class) {
+		__sync_lock_release(&_class->_sync);
+	}
+private:
+	sClass classes[STREAM_BUFFER_ARENA_CLASSES];
+};
+
+
+/* Contiguous growable buffer of one stream taken from the stream buffer arena. The data are appended only once
+   (except the move of the content when the buffer grows to the next class) and the completed content is handed over
+   to its consumer by release without a copy. */
+class cStreamBuffer {
+public:
+	cStreamBuffer() {
+		buffer = NULL;
+		length = 0;
+		capacity = 0;
+	}
+	~cStreamBuffer() {
+		destroy();
+	}
+	void add(u_char *data, u_int32_t dataLength) {
+		if(!data || !dataLength) {
+			return;
+		}
+		if(length + dataLength > capacity) {
+			grow(length + dataLength);
+		}
+		memcpy(buffer + length, data, dataLength);
+		length += dataLength;
+	}
+	u_char *data() {
+		return(buffer);
+	}
+	u_int32_t size() {
+		return(length);
+	}
+	bool empty() {
+		return(length == 0);
+	}
+	void clear() {
+		length = 0;
+	}
+	void destroy();
+	// the content is passed to the caller (free by delete []), the stream buffer stays empty
+	u_char *release();
+private:
+	void grow(u_int32_t size);
+private:
+	u_char *buffer;
+	u_int32_t length;
+	u_int32_t capacity;
+};
+
+
+extern cStreamBufferArena streamBufferArena;
+
+
+#endif //STREAM_BUFFER_H
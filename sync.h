@@ -2,6 +2,16 @@
 #define SYNC_H
 
 
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/types.h>
+#ifndef FREEBSD
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+
 #define __SYNC_LOCK(vint) while(__sync_lock_test_and_set(&vint, 1)) {};
 #define __SYNC_LOCK_USLEEP(vint, us_sleep) while(__sync_lock_test_and_set(&vint, 1)) { if(us_sleep) { USLEEP(us_sleep); } }
 #define __SYNC_UNLOCK(vint) __sync_lock_release(&vint);
@@ -15,5 +25,86 @@
 #define __SYNC_DEC(vint) __sync_sub_and_fetch(&vint, 1);
 #define __SYNC_INCR(vint, length) if((vint + 1) == length) { __SYNC_NULL(vint); } else { __SYNC_INC(vint); }
 
+#if defined(__x86_64__) || defined(__i386__)
+#define __SYNC_CPU_RELAX() __asm__ __volatile__("pause" ::: "memory");
+#elif defined(__aarch64__)
+#define __SYNC_CPU_RELAX() __asm__ __volatile__("yield" ::: "memory");
+#else
+#define __SYNC_CPU_RELAX() __sync_synchronize();
+#endif
+
+#define SYNC_WAIT_PARK_TIMEOUT_US 100000
+
+
+extern int opt_qring_wait_spin;
+
+/* Handoff of qring items between two threads. The waiting side spins for opt_qring_wait_spin rounds
+   and then parks in futex on the flag word until the other side changes the flag and calls notify.
+   Notify is a plain load until the first park, later a fence and a load of waiters counter.
+   The first park can miss a notify and then ends by timeout. */
+class cWaitNotify {
+public:
+	cWaitNotify() {
+		waiters = 0;
+		wakeups[0] = 0;
+		wakeups[1] = 0;
+		parked_us[0] = 0;
+		parked_us[1] = 0;
+	}
+	// waits (one spin round or one park) while *flag == value, returns parked time in us
+	inline unsigned long wait(volatile int *flag, int value, unsigned int *spinCounter, unsigned int timeoutUs = SYNC_WAIT_PARK_TIMEOUT_US) {
+		if(*spinCounter < (unsigned)opt_qring_wait_spin) {
+			++*spinCounter;
+			__SYNC_CPU_RELAX();
+			return(0);
+		}
+		timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		// store of waiters before load of flag - pair of the fence in notify
+		__sync_add_and_fetch(&waiters, 1);
+		if(*flag == value) {
+			#ifndef FREEBSD
+			timespec timeout;
+			timeout.tv_sec = timeoutUs / 1000000;
+			timeout.tv_nsec = (timeoutUs % 1000000) * 1000;
+			syscall(SYS_futex, flag, FUTEX_WAIT_PRIVATE, value, &timeout, NULL, 0);
+			#else
+			usleep(timeoutUs < 100 ? timeoutUs : 100);
+			#endif
+		}
+		__sync_sub_and_fetch(&waiters, 1);
+		timespec end;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		unsigned long parked = (end.tv_sec - start.tv_sec) * 1000000ul + end.tv_nsec / 1000 - start.tv_nsec / 1000;
+		__sync_add_and_fetch(&wakeups[0], 1);
+		__sync_add_and_fetch(&parked_us[0], parked);
+		return(parked);
+	}
+	// call after change of *flag
+	inline void notify(volatile int *flag) {
+		// store of flag (by caller) before load of waiters - the waiter between its check and the increment of
+		// waiters either sees the new flag or is seen here
+		__sync_synchronize();
+		if(waiters) {
+			#ifndef FREEBSD
+			syscall(SYS_futex, flag, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+			#endif
+		}
+	}
+	// counters since the previous call
+	void getStat(u_int64_t *wakeups, u_int64_t *parked_us) {
+		u_int64_t _wakeups = this->wakeups[0];
+		u_int64_t _parked_us = this->parked_us[0];
+		*wakeups = _wakeups - this->wakeups[1];
+		*parked_us = _parked_us - this->parked_us[1];
+		this->wakeups[1] = _wakeups;
+		this->parked_us[1] = _parked_us;
+	}
+private:
+	volatile int waiters;
+	volatile u_int64_t wakeups[2];
+	volatile u_int64_t parked_us[2];
+};
+
 
 #endif //SYNC_H
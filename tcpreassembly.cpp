@@ -2199,6 +2199,52 @@ bool TcpReassemblyLink::checkDuplicitySeq(u_int32_t newSeq) {
 
 
 TcpReassembly::TcpReassembly(eType type) {
+	this->_init(type);
+	char *log = NULL;
+	switch(type) {
+	case http: log = opt_tcpreassembly_http_log; break;
+	case webrtc: log = opt_tcpreassembly_webrtc_log; break;
+	case ssl: log = opt_tcpreassembly_ssl_log; break;
+	case sip: log = opt_tcpreassembly_sip_log; break;
+	}
+	if(log && *log) {
+		this->log = fopen(log, "at");
+		if(this->log) {
+			this->addLog((string(" -- start ") + sqlDateTimeString(getTimeMS()/1000)).c_str());
+		}
+	}
+}
+
+TcpReassembly::TcpReassembly(TcpReassembly *shardParent, unsigned shardIndex) {
+	this->_init(shardParent->type);
+	this->shardParent = shardParent;
+	this->shardIndex = shardIndex;
+	this->enableHttpForceInit = shardParent->enableHttpForceInit;
+	this->enableCrazySequence = shardParent->enableCrazySequence;
+	this->enableWildLink = shardParent->enableWildLink;
+	this->ignoreTcpHandshake = shardParent->ignoreTcpHandshake;
+	this->enableIgnorePairReqResp = shardParent->enableIgnorePairReqResp;
+	this->enableDestroyStreamsInComplete = shardParent->enableDestroyStreamsInComplete;
+	this->enableAllCompleteAfterZerodataAck = shardParent->enableAllCompleteAfterZerodataAck;
+	this->enableValidateDataViaCheckData = shardParent->enableValidateDataViaCheckData;
+	this->enableValidateLastQueueDataViaCheckData = shardParent->enableValidateLastQueueDataViaCheckData;
+	this->enableStrictValidateDataViaCheckData = shardParent->enableStrictValidateDataViaCheckData;
+	this->needValidateDataViaCheckData = shardParent->needValidateDataViaCheckData;
+	this->simpleByAck = shardParent->simpleByAck;
+	this->ignorePshInCheckOkData = shardParent->ignorePshInCheckOkData;
+	this->enableCleanupThread = shardParent->enableCleanupThread;
+	this->enableHttpCleanupExt = shardParent->enableHttpCleanupExt;
+	this->enablePushLock = shardParent->enablePushLock;
+	this->enableSmartCompleteData = shardParent->enableSmartCompleteData;
+	this->enableExtStat = shardParent->enableExtStat;
+	this->extCleanupStreamsLimitStreams = shardParent->extCleanupStreamsLimitStreams;
+	this->extCleanupStreamsLimitHeap = shardParent->extCleanupStreamsLimitHeap;
+	this->linkTimeout = shardParent->linkTimeout;
+	this->ignoreTerminating = shardParent->ignoreTerminating;
+	this->log = shardParent->log;
+}
+
+void TcpReassembly::_init(eType type) {
 	this->type = type;
 	this->_sync_links = 0;
 	this->_sync_push = 0;
@@ -2243,24 +2289,16 @@ TcpReassembly::TcpReassembly(eType type) {
 	this->initPacketThreadOk = false;
 	this->terminatingCleanupThread = false;
 	this->terminatingPacketThread = false;
-	char *log = NULL;
-	switch(type) {
-	case http: log = opt_tcpreassembly_http_log; break;
-	case webrtc: log = opt_tcpreassembly_webrtc_log; break;
-	case ssl: log = opt_tcpreassembly_ssl_log; break;
-	case sip: log = opt_tcpreassembly_sip_log; break;
-	}
-	if(log && *log) {
-		this->log = fopen(log, "at");
-		if(this->log) {
-			this->addLog((string(" -- start ") + sqlDateTimeString(getTimeMS()/1000)).c_str());
-		}
-	} else {
-		this->log = NULL;
-	}
+	this->shardParent = NULL;
+	this->shardIndex = 0;
+	this->last_idle_cleanup_time = 0;
+	this->log = NULL;
 }
 
 TcpReassembly::~TcpReassembly() {
+	for(unsigned i = 0; i < this->shards.size(); i++) {
+		delete this->shards[i];
+	}
 	if(this->initCleanupThreadOk) {
 		this->terminatingCleanupThread = true;
 		pthread_join(this->cleanupThreadHandle, NULL);
@@ -2282,12 +2320,67 @@ TcpReassembly::~TcpReassembly() {
 		delete iter->second;
 		this->links.erase(iter++);
 	}
-	if(this->log) {
+	if(this->shardParent) {
+		delete this->dataCallback;
+	} else if(this->log) {
 		this->addLog((string(" -- stop ") + sqlDateTimeString(getTimeMS()/1000)).c_str());
 		fclose(this->log);
 	}
 }
 
+/* The links are split between shards by the symmetric hash of ip/port of both sides (so both directions of a link come
+   to the same shard). Every shard is a complete TcpReassembly with own links, own packet thread (and own cleanup thread
+   if it is enabled) and own instance of the data processing, the instance which called setShards only dispatches
+   the packets. It has to be called after all settings of the reassembly. */
+void TcpReassembly::setShards(unsigned shardsCount) {
+	if(shardsCount < 2 || this->shards.size() || !this->dataCallback) {
+		return;
+	}
+	TcpReassemblyProcessData *shardDataCallback = this->dataCallback->createShardInstance();
+	if(!shardDataCallback) {
+		syslog(LOG_NOTICE, "tcp reassembly %s does not support more threads", getTypeString().c_str());
+		return;
+	}
+	this->stopThreads();
+	for(unsigned i = 0; i < shardsCount; i++) {
+		TcpReassembly *shard = new FILE_LINE(0) TcpReassembly(this, i);
+		shard->setDataCallback(i ? this->dataCallback->createShardInstance() : shardDataCallback);
+		shard->setEnablePacketThread();
+		if(shard->enableCleanupThread) {
+			shard->createCleanupThread();
+		}
+		this->shards.push_back(shard);
+	}
+}
+
+void TcpReassembly::stopThreads() {
+	if(this->cleanupThreadHandle) {
+		this->terminatingCleanupThread = true;
+		pthread_join(this->cleanupThreadHandle, NULL);
+		this->cleanupThreadHandle = 0;
+		this->initCleanupThreadOk = false;
+		this->terminatingCleanupThread = false;
+	}
+	if(this->packetThreadHandle) {
+		this->terminatingPacketThread = true;
+		pthread_join(this->packetThreadHandle, NULL);
+		this->packetThreadHandle = 0;
+		this->initPacketThreadOk = false;
+		this->terminatingPacketThread = false;
+	}
+}
+
+void TcpReassembly::cleanupIdleShard() {
+	// cleanup without cleanup thread is called from _push - shard without packets has to do it itself
+	u_int64_t time = getTimeMS();
+	if(this->links.size() &&
+	   time > this->last_time + 20 * 1000 &&
+	   time > this->last_idle_cleanup_time + 20 * 1000) {
+		this->cleanup_simple();
+		this->last_idle_cleanup_time = time;
+	}
+}
+
 inline void *_TcpReassembly_cleanupThreadFunction(void* arg) {
 	return(((TcpReassembly*)arg)->cleanupThreadFunction(arg));
 }
@@ -2352,6 +2445,23 @@ double TcpReassembly::getPacketCpuUsagePerc(bool preparePstatData) {
 
 string TcpReassembly::getCpuUsagePerc() {
 	ostringstream outStr;
+	if(this->shards.size()) {
+		outStr << fixed;
+		size_t links_size = 0;
+		for(unsigned i = 0; i < this->shards.size(); i++) {
+			if(i) {
+				outStr << '/';
+			}
+			double tPacketCpu = this->shards[i]->getPacketCpuUsagePerc(true);
+			outStr << setprecision(1) << (tPacketCpu >= 0 ? tPacketCpu : 0);
+			links_size += this->shards[i]->links.size();
+		}
+		outStr << '%';
+		if(links_size) {
+			outStr << '|' << links_size << 'l';
+		}
+		return(outStr.str());
+	}
 	double tPacketCpu = -1;
 	double tCleanupCpu = -1;
 	outStr << fixed;
@@ -2437,8 +2547,11 @@ void* TcpReassembly::cleanupThreadFunction(void*) {
 	if(verbosity) {
 		ostringstream outStr;
 		this->cleanupThreadId = get_unix_tid();
-		outStr << "start cleanup thread t" << getTypeString()
-		       << " - pid: " << this->cleanupThreadId << endl;
+		outStr << "start cleanup thread t" << getTypeString();
+		if(this->shardParent) {
+			outStr << " shard " << this->shardIndex;
+		}
+		outStr << " - pid: " << this->cleanupThreadId << endl;
 		syslog(LOG_NOTICE, "%s", outStr.str().c_str());
 	}
 	unsigned counter = 0;
@@ -2459,8 +2572,11 @@ void* TcpReassembly::packetThreadFunction(void*) {
 	if(verbosity) {
 		ostringstream outStr;
 		this->packetThreadId = get_unix_tid();
-		outStr << "start packet thread t" << getTypeString()
-		       << " - pid: " << this->packetThreadId << endl;
+		outStr << "start packet thread t" << getTypeString();
+		if(this->shardParent) {
+			outStr << " shard " << this->shardIndex;
+		}
+		outStr << " - pid: " << this->packetThreadId << endl;
 		syslog(LOG_NOTICE, "%s", outStr.str().c_str());
 	}
 	sPacket packet;
@@ -2479,6 +2595,9 @@ void* TcpReassembly::packetThreadFunction(void*) {
 				packet.block_store->unlock_packet(packet.block_store_index);
 			}
 		} else {
+			if(this->shardParent && !this->enableCleanupThread) {
+				this->cleanupIdleShard();
+			}
 			USLEEP(1000);
 		}
 	}
@@ -2487,6 +2606,9 @@ void* TcpReassembly::packetThreadFunction(void*) {
 
 void TcpReassembly::setIgnoreTerminating(bool ignoreTerminating) {
 	this->ignoreTerminating = ignoreTerminating;
+	for(unsigned i = 0; i < this->shards.size(); i++) {
+		this->shards[i]->setIgnoreTerminating(ignoreTerminating);
+	}
 }
 
 void TcpReassembly::addLog(const char *logString) {
@@ -2512,6 +2634,13 @@ void TcpReassembly::push_tcp(pcap_pkthdr *header, iphdr2 *header_ip, u_char *pac
 		}
 	}
  
+	if(this->shards.size()) {
+		this->shards[this->getShardIndex(header_ip)]->push_tcp(header, header_ip, packet, alloc_packet,
+								      block_store, block_store_index, block_store_locked,
+								      handle_index, dlt, sensor_id, sensor_ip, pid,
+								      uData, isSip);
+		return;
+	}
 	if((debug_limit_counter && debug_counter > debug_limit_counter) ||
 	   !(type == ssl || 
 	     type == sip ||
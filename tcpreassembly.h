@@ -214,6 +214,8 @@ public:
 				 std::ostream *debugStream) = 0;
 	virtual void writeToDb(bool /*all*/ = false) {}
 	virtual void printContentSummary() {}
+	// own instance for a shard of TcpReassembly (NULL - the data processing does not support shards)
+	virtual TcpReassemblyProcessData *createShardInstance() { return(NULL); }
 };
 
 struct TcpReassemblyLink_id {
@@ -784,6 +786,7 @@ public:
 public:
 	TcpReassembly(eType type);
 	~TcpReassembly();
+	void setShards(unsigned shardsCount);
 	void push_tcp(pcap_pkthdr *header, iphdr2 *header_ip, u_char *packet, bool alloc_packet,
 		      pcap_block_store *block_store, int block_store_index, bool block_store_locked,
 		      u_int16_t handle_index, int dlt, int sensor_id, vmIP sensor_ip, sPacketInfoData pid,
@@ -865,6 +868,9 @@ public:
 		this->doPrintContent = true;
 	}
 	void setIgnoreTerminating(bool ignoreTerminating);
+	unsigned getShardsCount() {
+		return(shards.size());
+	}
 	void addLog(string logString) {
 		addLog(logString.c_str());
 	}
@@ -921,6 +927,8 @@ public:
 	}
 	bool checkOkData(u_char * data, unsigned datalen, bool strict);
 private:
+	TcpReassembly(TcpReassembly *shardParent, unsigned shardIndex);
+	void _init(eType type);
 	void _push(pcap_pkthdr *header, iphdr2 *header_ip, u_char *packet,
 		   pcap_block_store *block_store, int block_store_index,
 		   u_int16_t handle_index, int dlt, int sensor_id, vmIP sensor_ip, sPacketInfoData pid,
@@ -929,6 +937,18 @@ private:
 	void createPacketThread();
 	void *cleanupThreadFunction(void *);
 	void *packetThreadFunction(void *);
+	void stopThreads();
+	void cleanupIdleShard();
+	unsigned getShardIndex(iphdr2 *header_ip) {
+		tcphdr2 *header_tcp = (tcphdr2*)((u_char*)header_ip + header_ip->get_hdr_size());
+		// symmetric - both directions of the link are in the same shard
+		u_int32_t hash = (header_ip->get_saddr().getHashNumber() + header_tcp->get_source().getPort()) ^
+				 (header_ip->get_daddr().getHashNumber() + header_tcp->get_dest().getPort());
+		hash ^= hash >> 16;
+		hash *= 0x45d9f3b;
+		hash ^= hash >> 16;
+		return(hash % shards.size());
+	}
 	void lock_links() {
 		while(__sync_lock_test_and_set(&this->_sync_links, 1)) USLEEP(100);
 	}
@@ -990,6 +1010,10 @@ private:
 	volatile bool initPacketThreadOk;
 	volatile bool terminatingCleanupThread;
 	volatile bool terminatingPacketThread;
+	vector<TcpReassembly*> shards;
+	TcpReassembly *shardParent;
+	unsigned shardIndex;
+	u_int64_t last_idle_cleanup_time;
 friend class TcpReassemblyLink;
 friend class TcpReassemblyStream;
 friend void *_TcpReassembly_cleanupThreadFunction(void* arg);
@@ -0,0 +1,174 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+
+#include <vector>
+#include <sys/types.h>
+
+
+#define TIMER_WHEEL_ROOT_BITS 8
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_LEVELS 3
+#define TIMER_WHEEL_ROOT_SIZE (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_MAX_DELTA ((u_int64_t)1 << (TIMER_WHEEL_ROOT_BITS + TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_BITS))
+#define TIMER_WHEEL_MAX_ADVANCE ((u_int64_t)1 << 16)
+
+
+struct sTimerWheelNode {
+	sTimerWheelNode() {
+		prev = NULL;
+		next = NULL;
+		expire = 0;
+		data = NULL;
+	}
+	bool isLinked() {
+		return(prev != NULL);
+	}
+	sTimerWheelNode *prev;
+	sTimerWheelNode *next;
+	u_int64_t expire;
+	void *data;
+};
+
+
+/* Hierarchical timing wheel (the classic cascading variant) - root wheel with TIMER_WHEEL_ROOT_SIZE slots of one tick and
+   TIMER_WHEEL_LEVELS wheels with TIMER_WHEEL_LEVEL_SIZE slots, each slot covering the whole lower wheel. Nodes are intrusive
+   (embedded in the owner object) so that add / remove / reschedule are O(1) without allocation; advance touches only
+   the slots of the passed ticks and the nodes which are due (plus an occasional cascade of one higher slot).
+   The current tick is set only by advance. Nodes added before the first advance, expire times lower than the current tick
+   and all nodes at a time jump (forward over TIMER_WHEEL_MAX_ADVANCE or backward) are due at the next advance,
+   times over TIMER_WHEEL_MAX_DELTA are clamped. Not thread safe - the owner serializes the calls. */
+class cTimerWheel {
+public:
+	cTimerWheel() {
+		current = 0;
+		count = 0;
+		for(unsigned i = 0; i < TIMER_WHEEL_ROOT_SIZE; i++) {
+			initSlot(&root[i]);
+		}
+		for(unsigned i = 0; i < TIMER_WHEEL_LEVELS; i++) {
+			for(unsigned j = 0; j < TIMER_WHEEL_LEVEL_SIZE; j++) {
+				initSlot(&levels[i][j]);
+			}
+		}
+	}
+	void add(sTimerWheelNode *node, u_int64_t expire) {
+		remove(node);
+		node->expire = expire < current ? current : expire;
+		link(node);
+		++count;
+	}
+	void remove(sTimerWheelNode *node) {
+		if(node->isLinked()) {
+			unlink(node);
+			--count;
+		}
+	}
+	void advance(u_int64_t time, std::vector<void*> *expired) {
+		if(current && time + 1 == current) {
+			// this tick is already done
+			return;
+		}
+		if(!current || time < current || time - current > TIMER_WHEEL_MAX_ADVANCE) {
+			// first advance, time jump (e.g. gap in the pcap file) or time going back - the wheel is reset, everything is due
+			for(unsigned i = 0; i < TIMER_WHEEL_ROOT_SIZE; i++) {
+				moveExpired(&root[i], expired);
+			}
+			for(unsigned i = 0; i < TIMER_WHEEL_LEVELS; i++) {
+				for(unsigned j = 0; j < TIMER_WHEEL_LEVEL_SIZE; j++) {
+					moveExpired(&levels[i][j], expired);
+				}
+			}
+			current = time + 1;
+			return;
+		}
+		while(current <= time) {
+			unsigned index = current & (TIMER_WHEEL_ROOT_SIZE - 1);
+			if(!index) {
+				for(unsigned i = 0; i < TIMER_WHEEL_LEVELS; i++) {
+					unsigned levelIndex = (current >> (TIMER_WHEEL_ROOT_BITS + i * TIMER_WHEEL_LEVEL_BITS)) & (TIMER_WHEEL_LEVEL_SIZE - 1);
+					cascade(&levels[i][levelIndex]);
+					if(levelIndex) {
+						break;
+					}
+				}
+			}
+			moveExpired(&root[index], expired);
+			++current;
+		}
+	}
+	u_int64_t getCurrent() {
+		return(current);
+	}
+	size_t size() {
+		return(count);
+	}
+private:
+	void initSlot(sTimerWheelNode *slot) {
+		slot->prev = slot;
+		slot->next = slot;
+	}
+	void link(sTimerWheelNode *node) {
+		u_int64_t delta = node->expire - current;
+		sTimerWheelNode *slot;
+		if(!current) {
+			// not advanced yet - due at the first advance
+			slot = &root[0];
+		} else if(delta < TIMER_WHEEL_ROOT_SIZE) {
+			slot = &root[node->expire & (TIMER_WHEEL_ROOT_SIZE - 1)];
+		} else {
+			if(delta >= TIMER_WHEEL_MAX_DELTA) {
+				node->expire = current + TIMER_WHEEL_MAX_DELTA - 1;
+				delta = TIMER_WHEEL_MAX_DELTA - 1;
+			}
+			unsigned level = 0;
+			while(delta >= ((u_int64_t)1 << (TIMER_WHEEL_ROOT_BITS + (level + 1) * TIMER_WHEEL_LEVEL_BITS))) {
+				++level;
+			}
+			slot = &levels[level][(node->expire >> (TIMER_WHEEL_ROOT_BITS + level * TIMER_WHEEL_LEVEL_BITS)) & (TIMER_WHEEL_LEVEL_SIZE - 1)];
+		}
+		node->prev = slot->prev;
+		node->next = slot;
+		slot->prev->next = node;
+		slot->prev = node;
+	}
+	void unlink(sTimerWheelNode *node) {
+		node->prev->next = node->next;
+		node->next->prev = node->prev;
+		node->prev = NULL;
+		node->next = NULL;
+	}
+	void cascade(sTimerWheelNode *slot) {
+		sTimerWheelNode *node = slot->next;
+		initSlot(slot);
+		while(node != slot) {
+			sTimerWheelNode *next = node->next;
+			if(node->expire < current) {
+				node->expire = current;
+			}
+			link(node);
+			node = next;
+		}
+	}
+	void moveExpired(sTimerWheelNode *slot, std::vector<void*> *expired) {
+		sTimerWheelNode *node = slot->next;
+		initSlot(slot);
+		while(node != slot) {
+			sTimerWheelNode *next = node->next;
+			node->prev = NULL;
+			node->next = NULL;
+			expired->push_back(node->data);
+			--count;
+			node = next;
+		}
+	}
+private:
+	sTimerWheelNode root[TIMER_WHEEL_ROOT_SIZE];
+	sTimerWheelNode levels[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+	u_int64_t current;
+	size_t count;
+};
+
+
+#endif //TIMER_WHEEL_H
@@ -83,6 +83,7 @@
 #include "tar.h"
 #include "filter_mysql.h"
 #include "sniff_inline.h"
+#include "sip_scan.h"
 #include "sql_db.h"
 
 #ifndef SIZE_MAX
@@ -3129,56 +3130,57 @@ u_int32_t ParsePacket::parseData(char *data, unsigned long datalen, ppContentsX
 	unsigned long rsltDataLen = datalen;
 	contents->sip = datalen ? isSipContent(data, datalen - 1) : false;
 	unsigned int namelength;
-	for(unsigned long i = 0; i < datalen; i++) {
-		if(!contents->doubleEndLine && 
-		   datalen > 3 &&
-		   data[i] == '\r' && i < datalen - 3 && 
-		   data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n') {
-			contents->doubleEndLine = data + i;
-			if(contents->contentLength > -1) {
-				unsigned long modify_datalen = contents->doubleEndLine + 4 - data + contents->contentLength;
-				if(modify_datalen < datalen) {
-					datalen = modify_datalen;
-					rsltDataLen = datalen;
+	// only line starts and line ends are visited - the bytes between them are skipped by the SIMD scan of cSipScan
+	cSipScan scan(data, datalen);
+	unsigned long i = 0;
+	while(i < datalen) {
+		if(data[i] == '\r' || data[i] == '\n') {
+			if(!contents->doubleEndLine && 
+			   datalen > 3 &&
+			   data[i] == '\r' && i < datalen - 3 && 
+			   data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n') {
+				contents->doubleEndLine = data + i;
+				if(contents->contentLength > -1) {
+					unsigned long modify_datalen = contents->doubleEndLine + 4 - data + contents->contentLength;
+					if(modify_datalen < datalen) {
+						datalen = modify_datalen;
+						rsltDataLen = datalen;
+					}
+				} else {
+					rsltDataLen = contents->doubleEndLine + 4 - data;
+					break;
 				}
-			} else {
-				rsltDataLen = contents->doubleEndLine + 4 - data;
-				break;
+				i += 2;
 			}
-			i += 2;
-		} else if(i == 0 || data[i - 1] == '\n') {
+			++i;
+			continue;
+		}
+		if(i == 0 || data[i - 1] == '\n') {
 			ppNode *node = getNode(data + i, datalen - i - 1, &namelength);
 			if(node && !node->isSetNode(contents)) {
 				ppContentItemX *contentItem = node->getPointerToItem(contents);
 				contentItem->offset = i + namelength;
 				i += namelength;
-				bool endLine = false;
-				for(; i < datalen; i++) {
-					if(data[i] == '\r' || data[i] == '\n') {
-						endLine = true;
-						break;
-					}
+				if(i < datalen) {
+					i = MIN(scan.nextEol(i), datalen);
 				}
-				if(endLine || i == datalen) {
-					contentItem->length = i - contentItem->offset;
-					contentItem->trim(data);
-					if(node->isContentLength && contentItem->length) {
-						if(contentItem->offset + contentItem->length == datalen) {
-							char tempLength[10];
-							int maxLengthLength = MIN(sizeof(tempLength) - 1, contentItem->length);
-							strncpy(tempLength, data + contentItem->offset, maxLengthLength);
-							tempLength[maxLengthLength] = 0;
-							contents->contentLength = atoi(tempLength);
-						} else {
-							contents->contentLength = atoi(data + contentItem->offset);
-						}
-					}
-					if(endLine) {
-						--i;
+				contentItem->length = i - contentItem->offset;
+				contentItem->trim(data);
+				if(node->isContentLength && contentItem->length) {
+					if(contentItem->offset + contentItem->length == datalen) {
+						char tempLength[10];
+						int maxLengthLength = MIN(sizeof(tempLength) - 1, contentItem->length);
+						strncpy(tempLength, data + contentItem->offset, maxLengthLength);
+						tempLength[maxLengthLength] = 0;
+						contents->contentLength = atoi(tempLength);
+					} else {
+						contents->contentLength = atoi(data + contentItem->offset);
 					}
 				}
+				continue;
 			}
 		}
+		i = MIN(scan.nextEol(i), datalen);
 	}
 	contents->parseDataPtr = data;
 	return(rsltDataLen);
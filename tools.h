@@ -158,6 +158,8 @@ struct d_item2
 };
 
 struct sStreamId {
+	sStreamId() {
+	}
 	sStreamId(vmIP sip, vmPort sport, vmIP cip, vmPort cport, bool sortSc = false) {
 		s = vmIPport(sip, sport);
 		c = vmIPport(cip, cport);
@@ -180,6 +182,8 @@ struct sStreamId {
 };
 
 struct sStreamId2 {
+	sStreamId2() {
+	}
 	sStreamId2(vmIP sip, vmPort sport, vmIP cip, vmPort cport, u_int64_t id, bool sortSc = false) {
 		s = vmIPport(sip, sport);
 		c = vmIPport(cip, cport);
@@ -206,6 +210,8 @@ struct sStreamId2 {
 };
 
 struct sStreamIds2 {
+	sStreamIds2() {
+	}
 	sStreamIds2(vmIP sip, vmPort sport, vmIP cip, vmPort cport, const char *ids, bool sortSc = false) {
 		s = vmIPport(sip, sport);
 		c = vmIPport(cip, cport);
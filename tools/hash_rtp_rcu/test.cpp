@@ -0,0 +1,344 @@
+/* Benchmark of the RTP ip:port hash of calls (Calltable::calls_hash) - lookups under lock_calls_hash
+   (per batch as ProcessRtpPacket::rtp_batch or per packet) against the lock-free lookups protected by cEpochRcu.
+   One writer thread simulates SIP (calls with 4 ip:port items added and later removed), reader threads
+   simulate ProcessRtpPacket hash threads with the given total packet rate (0 = as fast as possible - default).
+   The cost of a lookup is reported as the CPU time of the reader threads per lookup (the throttled readers
+   sleep, so their lookups/s only follow the given rate), the cost of the writer as the time per add/remove.
+   usage: ./test [readers] [pps] [cps] [seconds] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+#include <deque>
+
+#include "../../epoch_rcu.h"
+
+
+#define MAXNODE 150000
+#define BATCH 32
+
+
+struct sCall {
+	unsigned id;
+	volatile int rtppacketsinqueue;
+};
+
+struct node_call_rtp {
+	node_call_rtp *next;
+	sCall *call;
+	int8_t iscaller;
+};
+
+struct node_call_rtp_ip_port {
+	node_call_rtp_ip_port *next;
+	node_call_rtp *calls;
+	u_int32_t addr;
+	u_int16_t port;
+};
+
+enum eMode {
+	mode_lock_batch,
+	mode_lock_packet,
+	mode_rcu
+};
+
+static node_call_rtp_ip_port *calls_hash[MAXNODE];
+static volatile int _sync_lock_calls_hash;
+static cEpochRcu rcu;
+static eMode mode;
+static volatile bool terminating;
+static unsigned readersCount = 4;
+static unsigned pps = 0;
+static unsigned cps = 2000;
+static unsigned seconds = 5;
+static volatile u_int32_t activePorts[1 << 16];
+static volatile unsigned activePortsCount;
+
+static inline u_int64_t getThreadCpuTimeNS() {
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+static inline u_int64_t getTimeUS() {
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec * 1000000ull + tv.tv_usec);
+}
+
+static inline void lock_calls_hash() {
+	while(__sync_lock_test_and_set(&_sync_lock_calls_hash, 1)) {
+		usleep(10);
+	}
+}
+
+static inline void unlock_calls_hash() {
+	__sync_lock_release(&_sync_lock_calls_hash);
+}
+
+static inline u_int32_t tuplehash(u_int32_t addr, u_int16_t port) {
+	return((addr * 2654435761u ^ port) % MAXNODE);
+}
+
+static inline node_call_rtp *hashfind_by_ip_port(u_int32_t addr, u_int16_t port) {
+	for(node_call_rtp_ip_port *node = calls_hash[tuplehash(addr, port)]; node; node = node->next) {
+		if(node->addr == addr && node->port == port) {
+			return(node->calls);
+		}
+	}
+	return(NULL);
+}
+
+template <class type_node>
+static void retire(type_node *node) {
+	if(mode == mode_rcu) {
+		rcu.retire(node, cEpochRcu::destroyItem<type_node>);
+	} else {
+		delete node;
+	}
+}
+
+static void hashAdd(u_int32_t addr, u_int16_t port, sCall *call) {
+	u_int32_t h = tuplehash(addr, port);
+	lock_calls_hash();
+	node_call_rtp *node_call = new node_call_rtp;
+	node_call->next = NULL;
+	node_call->call = call;
+	node_call->iscaller = 1;
+	for(node_call_rtp_ip_port *node = calls_hash[h]; node; node = node->next) {
+		if(node->addr == addr && node->port == port) {
+			node_call->next = node->calls;
+			__atomic_store_n(&node->calls, node_call, __ATOMIC_RELEASE);
+			unlock_calls_hash();
+			return;
+		}
+	}
+	node_call_rtp_ip_port *node = new node_call_rtp_ip_port;
+	node->addr = addr;
+	node->port = port;
+	node->calls = node_call;
+	node->next = calls_hash[h];
+	__atomic_store_n(&calls_hash[h], node, __ATOMIC_RELEASE);
+	unlock_calls_hash();
+}
+
+static void hashRemove(u_int32_t addr, u_int16_t port, sCall *call) {
+	u_int32_t h = tuplehash(addr, port);
+	lock_calls_hash();
+	node_call_rtp_ip_port *prev = NULL;
+	for(node_call_rtp_ip_port *node = calls_hash[h]; node; node = node->next) {
+		if(node->addr == addr && node->port == port) {
+			node_call_rtp *prev_call = NULL;
+			for(node_call_rtp *node_call = node->calls; node_call; node_call = node_call->next) {
+				if(node_call->call == call) {
+					if(prev_call) {
+						prev_call->next = node_call->next;
+					} else {
+						node->calls = node_call->next;
+					}
+					retire(node_call);
+					break;
+				}
+				prev_call = node_call;
+			}
+			if(!node->calls) {
+				if(prev) {
+					prev->next = node->next;
+				} else {
+					calls_hash[h] = node->next;
+				}
+				retire(node);
+			}
+			break;
+		}
+		prev = node;
+	}
+	unlock_calls_hash();
+}
+
+struct sReader {
+	pthread_t thread;
+	u_int64_t lookups;
+	u_int64_t found;
+	u_int64_t cpuNS;
+	unsigned seed;
+};
+
+static inline void lookup(sReader *reader) {
+	unsigned count = activePortsCount;
+	u_int32_t addr = 0x0A000001;
+	u_int16_t port = count && rand_r(&reader->seed) % 10 ?
+			  activePorts[rand_r(&reader->seed) % count] :
+			  rand_r(&reader->seed) % 65536;
+	node_call_rtp *n_call = hashfind_by_ip_port(addr, port);
+	if(n_call) {
+		for(; n_call; n_call = n_call->next) {
+			__sync_add_and_fetch(&n_call->call->rtppacketsinqueue, 1);
+			__sync_sub_and_fetch(&n_call->call->rtppacketsinqueue, 1);
+		}
+		++reader->found;
+	}
+	++reader->lookups;
+}
+
+static void *readerThread(void *arg) {
+	sReader *reader = (sReader*)arg;
+	u_int64_t startUS = getTimeUS();
+	u_int64_t startCpuNS = getThreadCpuTimeNS();
+	u_int64_t readerPps = pps / readersCount;
+	while(!terminating) {
+		if(readerPps) {
+			u_int64_t expectLookups = (getTimeUS() - startUS) * readerPps / 1000000;
+			if(reader->lookups > expectLookups + BATCH) {
+				usleep(100);
+				continue;
+			}
+		}
+		switch(mode) {
+		case mode_lock_batch:
+			lock_calls_hash();
+			for(unsigned i = 0; i < BATCH; i++) {
+				lookup(reader);
+			}
+			unlock_calls_hash();
+			break;
+		case mode_lock_packet:
+			for(unsigned i = 0; i < BATCH; i++) {
+				lock_calls_hash();
+				lookup(reader);
+				unlock_calls_hash();
+			}
+			break;
+		case mode_rcu:
+			for(unsigned i = 0; i < BATCH; i++) {
+				rcu.readLock();
+				lookup(reader);
+				rcu.readUnlock();
+			}
+			break;
+		}
+	}
+	reader->cpuNS = getThreadCpuTimeNS() - startCpuNS;
+	return(NULL);
+}
+
+struct sActiveCall {
+	sCall *call;
+	u_int16_t ports[4];
+	u_int64_t endUS;
+};
+
+static void run(eMode _mode, const char *name) {
+	mode = _mode;
+	terminating = false;
+	activePortsCount = 0;
+	memset(calls_hash, 0, sizeof(calls_hash));
+	sReader *readers = new sReader[readersCount];
+	for(unsigned i = 0; i < readersCount; i++) {
+		readers[i].lookups = 0;
+		readers[i].found = 0;
+		readers[i].cpuNS = 0;
+		readers[i].seed = i + 1;
+		pthread_create(&readers[i].thread, NULL, readerThread, &readers[i]);
+	}
+	std::deque<sActiveCall> activeCalls;
+	unsigned callId = 0;
+	u_int64_t startUS = getTimeUS();
+	u_int64_t writerUS = 0;
+	u_int64_t writerOps = 0;
+	u_int64_t actUS;
+	while((actUS = getTimeUS()) < startUS + seconds * 1000000ull) {
+		unsigned expectCalls = (actUS - startUS) * cps / 1000000;
+		while(callId < expectCalls) {
+			u_int64_t beginUS = getTimeUS();
+			sActiveCall activeCall;
+			activeCall.call = new sCall;
+			activeCall.call->id = callId++;
+			activeCall.call->rtppacketsinqueue = 0;
+			activeCall.endUS = actUS + seconds * 1000000ull / 3;
+			for(unsigned i = 0; i < 4; i++) {
+				activeCall.ports[i] = (callId * 4 + i) % 65536;
+				hashAdd(0x0A000001, activeCall.ports[i], activeCall.call);
+				activePorts[(callId * 4 + i) % (sizeof(activePorts) / sizeof(activePorts[0]))] = activeCall.ports[i];
+			}
+			if(activePortsCount < sizeof(activePorts) / sizeof(activePorts[0])) {
+				activePortsCount = activePortsCount + 4 < sizeof(activePorts) / sizeof(activePorts[0]) ? activePortsCount + 4 : sizeof(activePorts) / sizeof(activePorts[0]);
+			}
+			activeCalls.push_back(activeCall);
+			writerOps += 4;
+			// as Calltable::cleanup_calls - one grace period for all ended calls
+			unsigned endCalls = 0;
+			for(std::deque<sActiveCall>::iterator iter = activeCalls.begin(); iter != activeCalls.end() && iter->endUS < actUS; iter++) {
+				for(unsigned i = 0; i < 4; i++) {
+					hashRemove(0x0A000001, iter->ports[i], iter->call);
+				}
+				++endCalls;
+				writerOps += 4;
+			}
+			if(endCalls) {
+				if(mode == mode_rcu) {
+					rcu.synchronize();
+				}
+				for(unsigned i = 0; i < endCalls; i++) {
+					delete activeCalls.front().call;
+					activeCalls.pop_front();
+				}
+			}
+			writerUS += getTimeUS() - beginUS;
+		}
+		usleep(100);
+	}
+	terminating = true;
+	u_int64_t lookups = 0;
+	u_int64_t found = 0;
+	u_int64_t cpuNS = 0;
+	for(unsigned i = 0; i < readersCount; i++) {
+		pthread_join(readers[i].thread, NULL);
+		lookups += readers[i].lookups;
+		found += readers[i].found;
+		cpuNS += readers[i].cpuNS;
+	}
+	u_int64_t durationUS = getTimeUS() - startUS;
+	printf("%-12s lookups %8.3f Mpps  reader cpu %7.1f ns/lookup  found %5.1f%%  writer %6.2f us/op  active calls %u  rcu retired %llu reclaimed %llu\n",
+	       name,
+	       (double)lookups / durationUS,
+	       lookups ? (double)cpuNS / lookups : 0.,
+	       lookups ? found * 100. / lookups : 0.,
+	       writerOps ? (double)writerUS / writerOps : 0.,
+	       (unsigned)activeCalls.size(),
+	       (unsigned long long)rcu.getRetiredCount(),
+	       (unsigned long long)rcu.getReclaimedCount());
+	for(std::deque<sActiveCall>::iterator iter = activeCalls.begin(); iter != activeCalls.end(); iter++) {
+		for(unsigned i = 0; i < 4; i++) {
+			hashRemove(0x0A000001, iter->ports[i], iter->call);
+		}
+		delete iter->call;
+	}
+	rcu.synchronize();
+	rcu.reclaim();
+	delete [] readers;
+}
+
+int main(int argc, char *argv[]) {
+	if(argc > 1) {
+		readersCount = atoi(argv[1]);
+	}
+	if(argc > 2) {
+		pps = atoi(argv[2]);
+	}
+	if(argc > 3) {
+		cps = atoi(argv[3]);
+	}
+	if(argc > 4) {
+		seconds = atoi(argv[4]);
+	}
+	printf("readers %u  pps %u  cps %u  seconds %u\n", readersCount, pps, cps, seconds);
+	run(mode_lock_batch, "lock batch");
+	run(mode_lock_packet, "lock packet");
+	run(mode_rcu, "rcu");
+	return(0);
+}
@@ -0,0 +1,8 @@
+/* sizeof(RTP) of the sniffer for the test - only the size is used, the functions defined in the sniffer headers
+   are dropped by the linker (-ffunction-sections + --gc-sections), config.h is taken from the configured tree */
+
+#include "../../voipmonitor.h"
+#include "../../rtp.h"
+
+
+size_t rtp_size = sizeof(RTP);
@@ -0,0 +1,187 @@
+/* Memory of RTP streams against the count of streams - the former layout (file names inline in RTP, all four
+   jitterbuffer channels and the frame created in the constructor) against the lazy one (channels and frame created
+   with the first packet which needs them - fix1 / fix2 / adapt only for enabled jitterbuffer options, record only for
+   streams with recorded audio). The fixed part of RTP is mirrored by its size (sizeof(RTP) of the sniffer, the former
+   layout with inline char[1024] file names instead of std::string), channels and frame are the real asterisk structures. Memory is taken as the growth of RSS (/proc/self/statm) after the streams are created - every
+   run is in own process so that the heap freed by a previous run does not hide the growth.
+   usage: ./test [jitterbuffers enabled 0-3] [percent of recorded streams] [max streams] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string>
+
+extern "C" {
+#include "asterisk/channel.h"
+#include "asterisk/frame.h"
+}
+
+
+#define RTP_FIXED_SIZE_LAZY rtp_size	// sizeof(RTP) with std::string file names
+#define RTP_FIXED_SIZE_EAGER (rtp_size - 2 * sizeof(std::string) + 2 * 1024)	// sizeof(RTP) with gfilename[1024] and basefilename[1024]
+extern size_t rtp_size;
+
+#define BASEFILENAME "/var/spool/voipmonitor/2020-01-01/10/00/AUDIO/3c2a6e1d5b7f4a9c8e0d2b4f6a8c0e2d@10.0.0.1"
+
+
+struct sStreamEager {
+	char *fixed;
+	ast_channel *channels[4];
+	ast_frame *frame;
+};
+
+struct sStreamLazy {
+	char *fixed;
+	std::string *basefilename;
+	ast_channel *channels[4];
+	ast_frame *frame;
+};
+
+static unsigned jitterbuffers = 3;
+static unsigned recordPercent = 10;
+static unsigned maxStreams = 200000;
+
+static u_int64_t getRss() {
+	FILE *file = fopen("/proc/self/statm", "r");
+	if(!file) {
+		return(0);
+	}
+	unsigned long size, resident;
+	if(fscanf(file, "%lu %lu", &size, &resident) != 2) {
+		resident = 0;
+	}
+	fclose(file);
+	return((u_int64_t)resident * sysconf(_SC_PAGESIZE));
+}
+
+static ast_channel *createChannel() {
+	ast_channel *channel = new ast_channel;
+	memset(channel, 0, sizeof(ast_channel));
+	return(channel);
+}
+
+static ast_frame *createFrame() {
+	ast_frame *frame = new ast_frame;
+	memset(frame, 0, sizeof(ast_frame));
+	return(frame);
+}
+
+static void touch(char *fixed, unsigned size) {
+	memset(fixed, 0, size);
+}
+
+static u_int64_t runEager(unsigned streams) {
+	sStreamEager *items = new sStreamEager[streams];
+	u_int64_t rssBegin = getRss();
+	for(unsigned i = 0; i < streams; i++) {
+		items[i].fixed = new char[RTP_FIXED_SIZE_EAGER];
+		touch(items[i].fixed, RTP_FIXED_SIZE_EAGER);
+		strcpy(items[i].fixed, BASEFILENAME);
+		for(unsigned j = 0; j < 4; j++) {
+			items[i].channels[j] = createChannel();
+		}
+		items[i].frame = createFrame();
+	}
+	u_int64_t rss = getRss() - rssBegin;
+	for(unsigned i = 0; i < streams; i++) {
+		for(unsigned j = 0; j < 4; j++) {
+			delete items[i].channels[j];
+		}
+		delete items[i].frame;
+		delete [] items[i].fixed;
+	}
+	delete [] items;
+	return(rss);
+}
+
+static u_int64_t runLazy(unsigned streams) {
+	sStreamLazy *items = new sStreamLazy[streams];
+	u_int64_t rssBegin = getRss();
+	for(unsigned i = 0; i < streams; i++) {
+		items[i].fixed = new char[RTP_FIXED_SIZE_LAZY];
+		touch(items[i].fixed, RTP_FIXED_SIZE_LAZY);
+		items[i].basefilename = new std::string(BASEFILENAME);
+		// the first packet of the stream
+		items[i].frame = createFrame();
+		for(unsigned j = 0; j < 3; j++) {
+			items[i].channels[j] = j < jitterbuffers ? createChannel() : NULL;
+		}
+		items[i].channels[3] = i % 100 < recordPercent ? createChannel() : NULL;
+	}
+	u_int64_t rss = getRss() - rssBegin;
+	for(unsigned i = 0; i < streams; i++) {
+		for(unsigned j = 0; j < 4; j++) {
+			if(items[i].channels[j]) {
+				delete items[i].channels[j];
+			}
+		}
+		delete items[i].frame;
+		delete items[i].basefilename;
+		delete [] items[i].fixed;
+	}
+	delete [] items;
+	return(rss);
+}
+
+static u_int64_t runInChild(u_int64_t (*run)(unsigned), unsigned streams) {
+	int fd[2];
+	if(pipe(fd)) {
+		return(0);
+	}
+	pid_t pid = fork();
+	if(!pid) {
+		close(fd[0]);
+		u_int64_t rss = run(streams);
+		if(write(fd[1], &rss, sizeof(rss)) != sizeof(rss)) {
+			_exit(1);
+		}
+		_exit(0);
+	}
+	close(fd[1]);
+	u_int64_t rss = 0;
+	if(pid < 0 || read(fd[0], &rss, sizeof(rss)) != sizeof(rss)) {
+		rss = 0;
+	}
+	close(fd[0]);
+	if(pid > 0) {
+		waitpid(pid, NULL, 0);
+	}
+	return(rss);
+}
+
+int main(int argc, char *argv[]) {
+	if(argc > 1) {
+		jitterbuffers = atoi(argv[1]);
+		if(jitterbuffers > 3) {
+			jitterbuffers = 3;
+		}
+	}
+	if(argc > 2) {
+		recordPercent = atoi(argv[2]);
+	}
+	if(argc > 3) {
+		maxStreams = atoi(argv[3]);
+	}
+	printf("RTP %u B (former layout %u B)  ast_channel %u B  ast_frame %u B  jitterbuffers %u  recorded streams %u%%\n",
+	       (unsigned)RTP_FIXED_SIZE_LAZY, (unsigned)RTP_FIXED_SIZE_EAGER,
+	       (unsigned)sizeof(ast_channel), (unsigned)sizeof(ast_frame), jitterbuffers, recordPercent);
+	printf("%10s %14s %10s %14s %10s %8s\n", "streams", "eager MB", "B/stream", "lazy MB", "B/stream", "saved");
+	for(unsigned streams = 1000; streams <= maxStreams; streams *= 10) {
+		u_int64_t rssEager = runInChild(runEager, streams);
+		u_int64_t rssLazy = runInChild(runLazy, streams);
+		printf("%10u %14.2f %10llu %14.2f %10llu %7.1f%%\n",
+		       streams,
+		       rssEager / 1024. / 1024., (unsigned long long)(rssEager / streams),
+		       rssLazy / 1024. / 1024., (unsigned long long)(rssLazy / streams),
+		       rssEager ? 100. - rssLazy * 100. / rssEager : 0.);
+		if(streams * 10 > maxStreams && streams != maxStreams) {
+			streams = maxStreams / 10;
+			if(!streams) {
+				break;
+			}
+		}
+	}
+	return(0);
+}
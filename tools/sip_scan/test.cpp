@@ -0,0 +1,392 @@
+/* Benchmark of ParsePacket::parseData - the former walk over every byte of the SIP message against the walk over line
+   starts and line ends found by cSipScan (SIMD compare of 64 byte blocks). The trie of header names (ppNode) and both
+   loops mirror tools.h / tools.cpp, the nodes are the standard ones of ParsePacket::setStdParse.
+   The corpus are INVITE / 200 OK with SDP, REGISTER / 401 / 200 OK messages (as in registration storm); the results of
+   both variants are compared for every message before the measurement.
+   usage: ./test [iterations] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include "../../sip_scan.h"
+
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define NODES_MAX 100
+
+
+struct sContentItem {
+	u_int32_t offset;
+	u_int32_t length;
+	void trim(const char *data) {
+		while(length && data[offset + length - 1] == ' ') {
+			--length;
+		}
+		while(length && data[offset] == ' ') {
+			++offset;
+			--length;
+		}
+	}
+};
+
+struct sContents {
+	void clean() {
+		memset(items, 0, sizeof(items));
+		doubleEndLine = NULL;
+		contentLength = -1;
+	}
+	sContentItem items[NODES_MAX];
+	char *doubleEndLine;
+	int32_t contentLength;
+};
+
+struct sNode {
+	sNode() {
+		memset(nodes, 0, sizeof(nodes));
+		leaf = false;
+		nodeIndex = 0;
+		isContentLength = false;
+	}
+	void addNode(const char *nodeName, int nodeIndex, bool isContentLength) {
+		if(*nodeName) {
+			unsigned char nodeChar = (unsigned char)*nodeName;
+			if(nodeChar >= 'A' && nodeChar <= 'Z') {
+				nodeChar -= 'A' - 'a';
+			}
+			if(!nodes[nodeChar]) {
+				nodes[nodeChar] = new sNode;
+			}
+			nodes[nodeChar]->addNode(nodeName + 1, nodeIndex, isContentLength);
+		} else {
+			leaf = true;
+			this->nodeIndex = nodeIndex;
+			this->isContentLength = isContentLength;
+		}
+	}
+	sNode *getNode(const char *nodeName, u_int32_t *namelength_rslt, u_int32_t namelength, u_int32_t namelength_limit) {
+		if(!leaf) {
+			if(!*nodeName) {
+				return(NULL);
+			}
+			unsigned char nodeChar = (unsigned char)*nodeName;
+			if(nodeChar >= 'A' && nodeChar <= 'Z') {
+				nodeChar -= 'A' - 'a';
+			}
+			if(nodes[nodeChar]) {
+				++namelength;
+				if(namelength > namelength_limit) {
+					return(NULL);
+				}
+				return(nodes[nodeChar]->getNode(nodeName + 1, namelength_rslt, namelength, namelength_limit));
+			}
+			return(NULL);
+		}
+		*namelength_rslt = namelength;
+		return(this);
+	}
+	sNode *nodes[256];
+	bool leaf;
+	int nodeIndex;
+	bool isContentLength;
+};
+
+static const char *nodeNames[] = {
+	"content-length:", "l:", "INVITE ", "MESSAGE ", "call-id:", "i:", "from:", "f:", "to:", "t:", "contact:", "m:",
+	"remote-party-id:", "geoposition:", "user-agent:", "authorization:", "proxy-authorization:", "expires:",
+	"x-voipmonitor-norecord:", "signal:", "signal=", "x-voipmonitor-custom1:", "content-type:", "c:", "cseq:",
+	"supported:", "proxy-authenticate:", "via:", "v:", "reason:", "m=audio ", "a=rtpmap:", "o=", "c=IN IP4 ",
+	"expires=", "username=\"", "realm=\"", "CallID:", "LocalAddr:", "RemoteAddr:", "QualityEst:", "PacketLoss:"
+};
+
+static const char *corpus[] = {
+	"INVITE sip:+420123456789@10.0.0.2:5060;user=phone SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bK-524287-1---6a1c9b3e0d7f2a41;rport\r\n"
+	"Max-Forwards: 70\r\n"
+	"Contact: <sip:+420987654321@10.0.0.1:5060;transport=udp>\r\n"
+	"To: <sip:+420123456789@10.0.0.2;user=phone>\r\n"
+	"From: \"Alice\" <sip:+420987654321@10.0.0.1;user=phone>;tag=9fx3k2l1\r\n"
+	"Call-ID: 3c2a6e1d5b7f4a9c8e0d2b4f6a8c0e2d@10.0.0.1\r\n"
+	"CSeq: 1 INVITE\r\n"
+	"Allow: INVITE, ACK, CANCEL, BYE, NOTIFY, REFER, MESSAGE, OPTIONS, INFO, SUBSCRIBE, UPDATE, PRACK\r\n"
+	"Content-Type: application/sdp\r\n"
+	"Supported: replaces, timer, 100rel\r\n"
+	"User-Agent: Acme Softphone 5.3.2 rv2.10.12\r\n"
+	"P-Asserted-Identity: <sip:+420987654321@10.0.0.1>\r\n"
+	"Session-Expires: 1800;refresher=uac\r\n"
+	"Content-Length: 325\r\n"
+	"\r\n"
+	"v=0\r\n"
+	"o=- 1604396871 1 IN IP4 10.0.0.1\r\n"
+	"s=Acme\r\n"
+	"c=IN IP4 10.0.0.1\r\n"
+	"t=0 0\r\n"
+	"m=audio 40000 RTP/AVP 8 0 18 9 101\r\n"
+	"a=rtpmap:8 PCMA/8000\r\n"
+	"a=rtpmap:0 PCMU/8000\r\n"
+	"a=rtpmap:18 G729/8000\r\n"
+	"a=fmtp:18 annexb=no\r\n"
+	"a=rtpmap:9 G722/8000\r\n"
+	"a=rtpmap:101 telephone-event/8000\r\n"
+	"a=fmtp:101 0-16\r\n"
+	"a=ptime:20\r\n"
+	"a=sendrecv\r\n",
+
+	"SIP/2.0 200 OK\r\n"
+	"Via: SIP/2.0/UDP 10.0.0.1:5060;branch=z9hG4bK-524287-1---6a1c9b3e0d7f2a41;rport=5060\r\n"
+	"Record-Route: <sip:10.0.0.2;lr;ftag=9fx3k2l1;did=a31.b4c1>\r\n"
+	"Contact: <sip:+420123456789@10.0.0.3:5060>\r\n"
+	"To: <sip:+420123456789@10.0.0.2;user=phone>;tag=as6d1f2e3a\r\n"
+	"From: \"Alice\" <sip:+420987654321@10.0.0.1;user=phone>;tag=9fx3k2l1\r\n"
+	"Call-ID: 3c2a6e1d5b7f4a9c8e0d2b4f6a8c0e2d@10.0.0.1\r\n"
+	"CSeq: 1 INVITE\r\n"
+	"Server: Gateway 16.1\r\n"
+	"Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, SUBSCRIBE, NOTIFY, INFO, PUBLISH, MESSAGE\r\n"
+	"Supported: replaces, timer\r\n"
+	"Session-Expires: 1800;refresher=uac\r\n"
+	"Content-Type: application/sdp\r\n"
+	"Content-Length: 232\r\n"
+	"\r\n"
+	"v=0\r\n"
+	"o=root 1740318526 1740318526 IN IP4 10.0.0.3\r\n"
+	"s=Gateway\r\n"
+	"c=IN IP4 10.0.0.3\r\n"
+	"t=0 0\r\n"
+	"m=audio 17170 RTP/AVP 8 101\r\n"
+	"a=rtpmap:8 PCMA/8000\r\n"
+	"a=rtpmap:101 telephone-event/8000\r\n"
+	"a=fmtp:101 0-16\r\n"
+	"a=ptime:20\r\n"
+	"a=sendrecv\r\n",
+
+	"REGISTER sip:pbx.example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 192.168.1.20:5060;branch=z9hG4bK1796854843;rport\r\n"
+	"From: <sip:1042@pbx.example.com>;tag=1563618290\r\n"
+	"To: <sip:1042@pbx.example.com>\r\n"
+	"Call-ID: 1914712345-5060-7@BA.CDF.B.DC\r\n"
+	"CSeq: 21 REGISTER\r\n"
+	"Contact: <sip:1042@192.168.1.20:5060>;+sip.instance=\"<urn:uuid:00000000-0000-1000-8000-000B82A1B2C3>\"\r\n"
+	"Max-Forwards: 70\r\n"
+	"User-Agent: Phone 1.0.7.1\r\n"
+	"Supported: path\r\n"
+	"Expires: 3600\r\n"
+	"Allow: INVITE, ACK, OPTIONS, CANCEL, BYE, SUBSCRIBE, NOTIFY, INFO, REFER, UPDATE, MESSAGE\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n",
+
+	"SIP/2.0 401 Unauthorized\r\n"
+	"Via: SIP/2.0/UDP 192.168.1.20:5060;branch=z9hG4bK1796854843;rport=5060;received=203.0.113.7\r\n"
+	"From: <sip:1042@pbx.example.com>;tag=1563618290\r\n"
+	"To: <sip:1042@pbx.example.com>;tag=as2e5b8c1d\r\n"
+	"Call-ID: 1914712345-5060-7@BA.CDF.B.DC\r\n"
+	"CSeq: 21 REGISTER\r\n"
+	"Server: PBX 18.9.0\r\n"
+	"Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, SUBSCRIBE, NOTIFY, INFO, PUBLISH, MESSAGE\r\n"
+	"Supported: replaces, timer\r\n"
+	"WWW-Authenticate: Digest algorithm=MD5, realm=\"pbx.example.com\", nonce=\"5f7a1c3e\"\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n",
+
+	"REGISTER sip:pbx.example.com SIP/2.0\r\n"
+	"Via: SIP/2.0/UDP 192.168.1.20:5060;branch=z9hG4bK1184719022;rport\r\n"
+	"From: <sip:1042@pbx.example.com>;tag=1563618290\r\n"
+	"To: <sip:1042@pbx.example.com>\r\n"
+	"Call-ID: 1914712345-5060-7@BA.CDF.B.DC\r\n"
+	"CSeq: 22 REGISTER\r\n"
+	"Contact: <sip:1042@192.168.1.20:5060>;+sip.instance=\"<urn:uuid:00000000-0000-1000-8000-000B82A1B2C3>\"\r\n"
+	"Authorization: Digest username=\"1042\", realm=\"pbx.example.com\", nonce=\"5f7a1c3e\", "
+	"uri=\"sip:pbx.example.com\", response=\"0c9a4e1b7d3f5a2c8e6b0d4f1a3c5e7b\", algorithm=MD5\r\n"
+	"Max-Forwards: 70\r\n"
+	"User-Agent: Phone 1.0.7.1\r\n"
+	"Supported: path\r\n"
+	"Expires: 3600\r\n"
+	"Allow: INVITE, ACK, OPTIONS, CANCEL, BYE, SUBSCRIBE, NOTIFY, INFO, REFER, UPDATE, MESSAGE\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n",
+
+	"SIP/2.0 200 OK\r\n"
+	"Via: SIP/2.0/UDP 192.168.1.20:5060;branch=z9hG4bK1184719022;rport=5060;received=203.0.113.7\r\n"
+	"From: <sip:1042@pbx.example.com>;tag=1563618290\r\n"
+	"To: <sip:1042@pbx.example.com>;tag=as7c2f9e0a\r\n"
+	"Call-ID: 1914712345-5060-7@BA.CDF.B.DC\r\n"
+	"CSeq: 22 REGISTER\r\n"
+	"Server: PBX 18.9.0\r\n"
+	"Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, SUBSCRIBE, NOTIFY, INFO, PUBLISH, MESSAGE\r\n"
+	"Supported: replaces, timer\r\n"
+	"Expires: 3600\r\n"
+	"Contact: <sip:1042@192.168.1.20:5060>;expires=3600\r\n"
+	"Date: Sat, 17 Oct 2026 10:00:00 GMT\r\n"
+	"Content-Length: 0\r\n"
+	"\r\n"
+};
+
+static sNode root;
+static volatile u_int64_t checkSum;
+
+static u_int32_t parseBytes(char *data, unsigned long datalen, sContents *contents) {
+	unsigned long rsltDataLen = datalen;
+	u_int32_t namelength;
+	for(unsigned long i = 0; i < datalen; i++) {
+		if(!contents->doubleEndLine &&
+		   datalen > 3 &&
+		   data[i] == '\r' && i < datalen - 3 &&
+		   data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n') {
+			contents->doubleEndLine = data + i;
+			if(contents->contentLength > -1) {
+				unsigned long modify_datalen = contents->doubleEndLine + 4 - data + contents->contentLength;
+				if(modify_datalen < datalen) {
+					datalen = modify_datalen;
+					rsltDataLen = datalen;
+				}
+			} else {
+				rsltDataLen = contents->doubleEndLine + 4 - data;
+				break;
+			}
+			i += 2;
+		} else if(i == 0 || data[i - 1] == '\n') {
+			sNode *node = root.getNode(data + i, &namelength, 0, datalen - i - 1);
+			if(node && !contents->items[node->nodeIndex].length) {
+				sContentItem *contentItem = &contents->items[node->nodeIndex];
+				contentItem->offset = i + namelength;
+				i += namelength;
+				bool endLine = false;
+				for(; i < datalen; i++) {
+					if(data[i] == '\r' || data[i] == '\n') {
+						endLine = true;
+						break;
+					}
+				}
+				if(endLine || i == datalen) {
+					contentItem->length = i - contentItem->offset;
+					contentItem->trim(data);
+					if(node->isContentLength && contentItem->length) {
+						contents->contentLength = atoi(data + contentItem->offset);
+					}
+					if(endLine) {
+						--i;
+					}
+				}
+			}
+		}
+	}
+	return(rsltDataLen);
+}
+
+static u_int32_t parseScan(char *data, unsigned long datalen, sContents *contents) {
+	unsigned long rsltDataLen = datalen;
+	u_int32_t namelength;
+	cSipScan scan(data, datalen);
+	unsigned long i = 0;
+	while(i < datalen) {
+		if(data[i] == '\r' || data[i] == '\n') {
+			if(!contents->doubleEndLine &&
+			   datalen > 3 &&
+			   data[i] == '\r' && i < datalen - 3 &&
+			   data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n') {
+				contents->doubleEndLine = data + i;
+				if(contents->contentLength > -1) {
+					unsigned long modify_datalen = contents->doubleEndLine + 4 - data + contents->contentLength;
+					if(modify_datalen < datalen) {
+						datalen = modify_datalen;
+						rsltDataLen = datalen;
+					}
+				} else {
+					rsltDataLen = contents->doubleEndLine + 4 - data;
+					break;
+				}
+				i += 2;
+			}
+			++i;
+			continue;
+		}
+		if(i == 0 || data[i - 1] == '\n') {
+			sNode *node = root.getNode(data + i, &namelength, 0, datalen - i - 1);
+			if(node && !contents->items[node->nodeIndex].length) {
+				sContentItem *contentItem = &contents->items[node->nodeIndex];
+				contentItem->offset = i + namelength;
+				i += namelength;
+				if(i < datalen) {
+					i = MIN(scan.nextEol(i), datalen);
+				}
+				contentItem->length = i - contentItem->offset;
+				contentItem->trim(data);
+				if(node->isContentLength && contentItem->length) {
+					contents->contentLength = atoi(data + contentItem->offset);
+				}
+				continue;
+			}
+		}
+		i = MIN(scan.nextEol(i), datalen);
+	}
+	return(rsltDataLen);
+}
+
+static u_int64_t getTimeUS() {
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec * 1000000ull + tv.tv_usec);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned iterations = argc > 1 ? atoi(argv[1]) : 200000;
+	for(unsigned i = 0; i < sizeof(nodeNames) / sizeof(nodeNames[0]); i++) {
+		root.addNode(nodeNames[i], i, i < 2);
+	}
+	unsigned corpusCount = sizeof(corpus) / sizeof(corpus[0]);
+	char *messages[sizeof(corpus) / sizeof(corpus[0])];
+	unsigned lengths[sizeof(corpus) / sizeof(corpus[0])];
+	u_int64_t corpusBytes = 0;
+	for(unsigned i = 0; i < corpusCount; i++) {
+		lengths[i] = strlen(corpus[i]);
+		messages[i] = new char[lengths[i]];
+		memcpy(messages[i], corpus[i], lengths[i]);
+		corpusBytes += lengths[i];
+	}
+	sContents contents[2];
+	for(unsigned i = 0; i < corpusCount; i++) {
+		// also the truncated message (as SIP in more packets)
+		for(unsigned length = lengths[i]; length > 0; length = length > 97 ? length - 97 : 0) {
+			contents[0].clean();
+			contents[1].clean();
+			u_int32_t rslt0 = parseBytes(messages[i], length, &contents[0]);
+			u_int32_t rslt1 = parseScan(messages[i], length, &contents[1]);
+			if(rslt0 != rslt1 ||
+			   contents[0].doubleEndLine != contents[1].doubleEndLine ||
+			   contents[0].contentLength != contents[1].contentLength ||
+			   memcmp(contents[0].items, contents[1].items, sizeof(contents[0].items))) {
+				printf("results differ - message %u length %u\n", i, length);
+				return(1);
+			}
+		}
+	}
+	printf("scan implementation %s, %u messages %llu bytes, %u iterations\n",
+	       cSipScan::getImplementation(), corpusCount, (unsigned long long)corpusBytes, iterations);
+	printf("%-12s %12s %12s %10s\n", "variant", "ns/message", "MB/s", "speedup");
+	double nsPerMessage[2];
+	for(unsigned variant = 0; variant < 2; variant++) {
+		u_int64_t check = 0;
+		u_int64_t start = getTimeUS();
+		for(unsigned iter = 0; iter < iterations; iter++) {
+			for(unsigned i = 0; i < corpusCount; i++) {
+				contents[variant].clean();
+				check += variant == 0 ?
+					  parseBytes(messages[i], lengths[i], &contents[variant]) :
+					  parseScan(messages[i], lengths[i], &contents[variant]);
+			}
+		}
+		u_int64_t time = getTimeUS() - start;
+		nsPerMessage[variant] = time * 1000. / iterations / corpusCount;
+		checkSum += check;
+		printf("%-12s %12.1f %12.1f %9.2fx\n",
+		       variant == 0 ? "bytes" : "scan",
+		       nsPerMessage[variant],
+		       corpusBytes * iterations / (time / 1e6) / 1e6,
+		       nsPerMessage[0] / nsPerMessage[variant]);
+	}
+	for(unsigned i = 0; i < corpusCount; i++) {
+		delete [] messages[i];
+	}
+	return(0);
+}
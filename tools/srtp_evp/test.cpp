@@ -0,0 +1,362 @@
+/* Benchmark of SRTP decryption (AES_CM_128_HMAC_SHA1_80) of the native engines of RTPsecure - the former libgcrypt one
+   (gcry_cipher CTR + gcry_md HMAC per packet as RTPsecure::do_ctr_crypt / rtp_digest) against cSrtpEvp (OpenSSL EVP
+   AES-NI with the keystream prepared for the expected packets of the stream + HMAC from precomputed sha1 states),
+   optionally (make LIBSRTP=yes) also against libsrtp (srtp_unprotect).
+   The streams are G.711 20ms (160 bytes of payload) with the seq over the wrap (ROC change), the packets of all streams
+   are interleaved as in RTP thread. Before the measurement the tags and the decrypted payload of all engines are
+   compared with the original.
+   usage: ./test [streams] [packets_per_stream] [passes] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+
+#include <gcrypt.h>
+
+#ifdef HAVE_LIBSRTP
+#include <srtp/srtp.h>
+#endif
+
+#include "../../srtp_evp.h"
+
+
+#define RTP_HEADER_LEN 12
+#define PAYLOAD_LEN 160
+#define TAG_LEN 10
+#define PACKET_LEN (RTP_HEADER_LEN + PAYLOAD_LEN + TAG_LEN)
+#define SEQ_START 65000
+
+
+// srtp_evp.cpp allocates by new FILE_LINE (heap_safe.h) - here without the memory accounting of the sniffer
+void * operator new[](size_t sizeOfObject, const char */*memory_type1*/, int /*memory_type2*/, int /*alloc_number*/) {
+	return(::operator new[](sizeOfObject));
+}
+
+static u_int64_t getTimeUS() {
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec * 1000000ull + tv.tv_usec);
+}
+
+static void random_bytes(u_char *data, unsigned length) {
+	for(unsigned i = 0; i < length; i++) {
+		data[i] = rand();
+	}
+}
+
+
+/* mirror of the gcrypt code of RTPsecure (srtp.cpp) */
+class cSrtpGcrypt {
+public:
+	cSrtpGcrypt() {
+		cipher = NULL;
+		md = NULL;
+	}
+	~cSrtpGcrypt() {
+		if(cipher) {
+			gcry_cipher_close(cipher);
+		}
+		if(md) {
+			gcry_md_close(md);
+		}
+	}
+	bool init(u_char *master_key, u_char *master_salt) {
+		memcpy(this->master_salt, master_salt, 14);
+		gcry_cipher_hd_t _cipher;
+		if(gcry_cipher_open(&cipher, GCRY_CIPHER_AES, GCRY_CIPHER_MODE_CTR, 0) ||
+		   gcry_md_open(&md, GCRY_MD_SHA1, GCRY_MD_FLAG_HMAC) ||
+		   gcry_cipher_open(&_cipher, GCRY_CIPHER_AES, GCRY_CIPHER_MODE_CTR, 0) ||
+		   gcry_cipher_setkey(_cipher, master_key, 16)) {
+			return(false);
+		}
+		u_char r[6];
+		u_char keybuf[20];
+		memset(r, 0, sizeof(r));
+		memset(keybuf, 0, sizeof(keybuf));
+		if(do_derive(_cipher, r, 6, 0, keybuf, 16) ||
+		   gcry_cipher_setkey(cipher, keybuf, 16) ||
+		   do_derive(_cipher, r, 6, 1, keybuf, 20) ||
+		   gcry_md_setkey(md, keybuf, 20) ||
+		   do_derive(_cipher, r, 6, 2, (u_char*)salt, 14)) {
+			return(false);
+		}
+		gcry_cipher_close(_cipher);
+		return(true);
+	}
+	u_char *digest(u_char *data, size_t data_len, uint32_t roc) {
+		gcry_md_reset(md);
+		gcry_md_write(md, data, data_len);
+		roc = htonl(roc);
+		gcry_md_write(md, &roc, 4);
+		return(gcry_md_read(md, 0));
+	}
+	int crypt(u_char *data, unsigned data_len, uint32_t ssrc, uint32_t roc, uint16_t seq) {
+		uint32_t counter[4];
+		counter[0] = salt[0];
+		counter[1] = salt[1] ^ htonl(ssrc);
+		counter[2] = salt[2] ^ htonl(roc);
+		counter[3] = salt[3] ^ htonl(seq << 16);
+		return(do_ctr_crypt(cipher, (u_char*)counter, data, data_len));
+	}
+private:
+	int do_derive(gcry_cipher_hd_t cipher, u_char *r, unsigned rlen, uint8_t label, u_char *out, unsigned outlen) {
+		u_char iv[16];
+		memset(iv, 0, sizeof(iv));
+		memcpy(iv, master_salt, 14);
+		iv[14 - 1 - rlen] ^= label;
+		for(unsigned i = 0; i < rlen; i++) {
+			iv[sizeof(iv) - rlen + i] ^= r[i];
+		}
+		memset(out, 0, outlen);
+		return(do_ctr_crypt(cipher, iv, out, outlen));
+	}
+	int do_ctr_crypt(gcry_cipher_hd_t cipher, u_char *ctr, u_char *data, unsigned len) {
+		unsigned ctrlen = 16;
+		div_t d = div((int)len, (int)ctrlen);
+		if(gcry_cipher_setctr(cipher, ctr, ctrlen) ||
+		   gcry_cipher_decrypt(cipher, data, d.quot * ctrlen, NULL, 0)) {
+			return -1;
+		}
+		if(d.rem) {
+			u_char dummy[ctrlen];
+			data += d.quot * ctrlen;
+			memcpy(dummy, data, d.rem);
+			memset(dummy + d.rem, 0, ctrlen - d.rem);
+			if(gcry_cipher_decrypt(cipher, dummy, ctrlen, data, ctrlen)) {
+				return -1;
+			}
+			memcpy(data, dummy, d.rem);
+		}
+		return(0);
+	}
+private:
+	gcry_cipher_hd_t cipher;
+	gcry_md_hd_t md;
+	u_char master_salt[14];
+	uint32_t salt[4];
+};
+
+
+struct sStream {
+	u_char key_salt[30];
+	uint32_t ssrc;
+	cSrtpGcrypt *gcrypt;
+	cSrtpEvp *evp;
+	#ifdef HAVE_LIBSRTP
+	srtp_t srtp_ctx;
+	#endif
+};
+
+
+static void rtp_header(u_char *packet, uint16_t seq, uint32_t ssrc) {
+	memset(packet, 0, RTP_HEADER_LEN);
+	packet[0] = 0x80;
+	*(uint16_t*)(packet + 2) = htons(seq);
+	*(uint32_t*)(packet + 4) = htonl(seq * 160);
+	*(uint32_t*)(packet + 8) = htonl(ssrc);
+}
+
+static void packet_index(unsigned packet_i, uint16_t *seq, uint32_t *roc) {
+	uint32_t index = SEQ_START + packet_i;
+	*seq = index & 0xFFFF;
+	*roc = index >> 16;
+}
+
+static void init_engines(sStream *streams, unsigned streams_count, bool evp_only) {
+	for(unsigned i = 0; i < streams_count; i++) {
+		if(!evp_only) {
+			if(streams[i].gcrypt) {
+				delete streams[i].gcrypt;
+			}
+			streams[i].gcrypt = new cSrtpGcrypt;
+			streams[i].gcrypt->init(streams[i].key_salt, streams[i].key_salt + 16);
+		}
+		if(!streams[i].evp) {
+			streams[i].evp = new cSrtpEvp;
+		}
+		streams[i].evp->init(streams[i].key_salt, streams[i].key_salt + 16, false);
+	}
+}
+
+#ifdef HAVE_LIBSRTP
+static void init_libsrtp(sStream *streams, unsigned streams_count) {
+	for(unsigned i = 0; i < streams_count; i++) {
+		if(streams[i].srtp_ctx) {
+			srtp_dealloc(streams[i].srtp_ctx);
+		}
+		srtp_policy_t policy;
+		memset(&policy, 0, sizeof(policy));
+		crypto_policy_set_rtp_default(&policy.rtp);
+		crypto_policy_set_rtcp_default(&policy.rtcp);
+		policy.key = streams[i].key_salt;
+		policy.ssrc.type = ssrc_specific;
+		policy.ssrc.value = streams[i].ssrc;
+		policy.window_size = 128;
+		policy.rtp.sec_serv = sec_serv_conf_and_auth;
+		policy.rtp.auth_tag_len = TAG_LEN;
+		policy.rtcp.sec_serv = sec_serv_conf_and_auth;
+		policy.rtcp.auth_tag_len = TAG_LEN;
+		srtp_create(&streams[i].srtp_ctx, &policy);
+	}
+}
+#endif
+
+
+int main(int argc, char *argv[]) {
+	unsigned streams_count = argc > 1 ? atoi(argv[1]) : 64;
+	unsigned packets_count = argc > 2 ? atoi(argv[2]) : 3000;
+	unsigned passes = argc > 3 ? atoi(argv[3]) : 5;
+	if(!gcry_check_version(GCRYPT_VERSION)) {
+		printf("gcrypt init failed\n");
+		return(1);
+	}
+	gcry_control(GCRYCTL_DISABLE_SECMEM, 0);
+	gcry_control(GCRYCTL_INITIALIZATION_FINISHED, 0);
+	#ifdef HAVE_LIBSRTP
+	srtp_init();
+	#endif
+	srand(1);
+	sStream *streams = new sStream[streams_count];
+	memset(streams, 0, sizeof(sStream) * streams_count);
+	for(unsigned i = 0; i < streams_count; i++) {
+		random_bytes(streams[i].key_salt, sizeof(streams[i].key_salt));
+		streams[i].ssrc = rand();
+	}
+	init_engines(streams, streams_count, false);
+	// plain and protected (by the gcrypt engine) packets, interleaved by streams
+	unsigned count = streams_count * packets_count;
+	u_char *plain = new u_char[count * PACKET_LEN];
+	u_char *srtp = new u_char[count * PACKET_LEN];
+	u_char *work = new u_char[count * PACKET_LEN];
+	for(unsigned p = 0; p < packets_count; p++) {
+		for(unsigned s = 0; s < streams_count; s++) {
+			unsigned i = p * streams_count + s;
+			uint16_t seq;
+			uint32_t roc;
+			packet_index(p, &seq, &roc);
+			u_char *packet = plain + i * PACKET_LEN;
+			rtp_header(packet, seq, streams[s].ssrc);
+			random_bytes(packet + RTP_HEADER_LEN, PAYLOAD_LEN);
+			memset(packet + RTP_HEADER_LEN + PAYLOAD_LEN, 0, TAG_LEN);
+			u_char *packet_srtp = srtp + i * PACKET_LEN;
+			memcpy(packet_srtp, packet, PACKET_LEN);
+			streams[s].gcrypt->crypt(packet_srtp + RTP_HEADER_LEN, PAYLOAD_LEN, streams[s].ssrc, roc, seq);
+			memcpy(packet_srtp + RTP_HEADER_LEN + PAYLOAD_LEN,
+			       streams[s].gcrypt->digest(packet_srtp, RTP_HEADER_LEN + PAYLOAD_LEN, roc), TAG_LEN);
+		}
+	}
+	// check
+	init_engines(streams, streams_count, false);
+	unsigned errors = 0;
+	for(unsigned pass = 0; pass < 2; pass++) {
+		memcpy(work, srtp, count * PACKET_LEN);
+		for(unsigned i = 0; i < count; i++) {
+			unsigned s = i % streams_count;
+			uint16_t seq;
+			uint32_t roc;
+			packet_index(i / streams_count, &seq, &roc);
+			u_char *packet = work + i * PACKET_LEN;
+			uint32_t roc_n = htonl(roc);
+			u_char *tag = pass == 0 ?
+				       streams[s].gcrypt->digest(packet, RTP_HEADER_LEN + PAYLOAD_LEN, roc) :
+				       streams[s].evp->digest(packet, RTP_HEADER_LEN + PAYLOAD_LEN, &roc_n);
+			if(memcmp(tag, packet + RTP_HEADER_LEN + PAYLOAD_LEN, TAG_LEN)) {
+				++errors;
+			}
+			if(pass == 0) {
+				streams[s].gcrypt->crypt(packet + RTP_HEADER_LEN, PAYLOAD_LEN, streams[s].ssrc, roc, seq);
+			} else {
+				streams[s].evp->rtp_crypt(packet + RTP_HEADER_LEN, PAYLOAD_LEN, streams[s].ssrc, roc, seq);
+			}
+			if(memcmp(packet, plain + i * PACKET_LEN, RTP_HEADER_LEN + PAYLOAD_LEN)) {
+				++errors;
+			}
+		}
+		printf("check %-8s %s\n", pass == 0 ? "gcrypt" : "evp", errors ? "FAILED" : "ok");
+		if(errors) {
+			return(1);
+		}
+	}
+	#ifdef HAVE_LIBSRTP
+	init_libsrtp(streams, streams_count);
+	memcpy(work, srtp, count * PACKET_LEN);
+	for(unsigned i = 0; i < count; i++) {
+		int len = PACKET_LEN;
+		if(srtp_unprotect(streams[i % streams_count].srtp_ctx, work + i * PACKET_LEN, &len) ||
+		   memcmp(work + i * PACKET_LEN, plain + i * PACKET_LEN, RTP_HEADER_LEN + PAYLOAD_LEN)) {
+			++errors;
+		}
+	}
+	printf("check %-8s %s\n", "libsrtp", errors ? "FAILED" : "ok");
+	if(errors) {
+		return(1);
+	}
+	#endif
+	// measurement
+	const char *engines[] = { "gcrypt", "evp", "libsrtp" };
+	#ifdef HAVE_LIBSRTP
+	unsigned engines_count = 3;
+	#else
+	unsigned engines_count = 2;
+	#endif
+	for(unsigned engine = 0; engine < engines_count; engine++) {
+		u_int64_t time_us = 0;
+		for(unsigned pass = 0; pass < passes; pass++) {
+			memcpy(work, srtp, count * PACKET_LEN);
+			if(engine == 1) {
+				init_engines(streams, streams_count, true);
+			}
+			#ifdef HAVE_LIBSRTP
+			if(engine == 2) {
+				init_libsrtp(streams, streams_count);
+			}
+			#endif
+			u_int64_t start = getTimeUS();
+			for(unsigned i = 0; i < count; i++) {
+				unsigned s = i % streams_count;
+				u_char *packet = work + i * PACKET_LEN;
+				uint16_t seq;
+				uint32_t roc;
+				packet_index(i / streams_count, &seq, &roc);
+				if(engine == 0) {
+					if(!memcmp(streams[s].gcrypt->digest(packet, RTP_HEADER_LEN + PAYLOAD_LEN, roc), packet + RTP_HEADER_LEN + PAYLOAD_LEN, TAG_LEN)) {
+						streams[s].gcrypt->crypt(packet + RTP_HEADER_LEN, PAYLOAD_LEN, streams[s].ssrc, roc, seq);
+					}
+				} else if(engine == 1) {
+					uint32_t roc_n = htonl(roc);
+					if(!memcmp(streams[s].evp->digest(packet, RTP_HEADER_LEN + PAYLOAD_LEN, &roc_n), packet + RTP_HEADER_LEN + PAYLOAD_LEN, TAG_LEN)) {
+						streams[s].evp->rtp_crypt(packet + RTP_HEADER_LEN, PAYLOAD_LEN, streams[s].ssrc, roc, seq);
+					}
+				}
+				#ifdef HAVE_LIBSRTP
+				else {
+					int len = PACKET_LEN;
+					srtp_unprotect(streams[s].srtp_ctx, packet, &len);
+				}
+				#endif
+			}
+			time_us += getTimeUS() - start;
+		}
+		printf("%-8s %8.1f ns / packet  %8.0f kpackets / s\n",
+		       engines[engine],
+		       (double)time_us * 1000 / ((double)count * passes),
+		       (double)count * passes / time_us * 1000);
+	}
+	for(unsigned i = 0; i < streams_count; i++) {
+		delete streams[i].gcrypt;
+		delete streams[i].evp;
+		#ifdef HAVE_LIBSRTP
+		if(streams[i].srtp_ctx) {
+			srtp_dealloc(streams[i].srtp_ctx);
+		}
+		#endif
+	}
+	delete [] streams;
+	delete [] plain;
+	delete [] srtp;
+	delete [] work;
+	return(0);
+}
@@ -0,0 +1,168 @@
+/* Test of cTimerWheel (timer_wheel.h) used by Calltable::cleanup_calls - checks the tick at which every node is due
+   against the expected time, the first advance after adds with a timeout far in the future, a backward time step
+   and a forward time jump. The last part measures add / advance with the given number of nodes.
+   usage: ./test [nodes] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <vector>
+
+#include "../../timer_wheel.h"
+
+
+struct sItem {
+	sItem() {
+		node.data = this;
+		expire = 0;
+		fired = 0;
+	}
+	sTimerWheelNode node;
+	u_int64_t expire;
+	u_int64_t fired;
+};
+
+static unsigned errors;
+
+static inline u_int64_t getTimeUS() {
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec * 1000000ull + tv.tv_usec);
+}
+
+static void check(bool ok, const char *descr) {
+	printf("%-60s %s\n", descr, ok ? "OK" : "FAIL");
+	if(!ok) {
+		++errors;
+	}
+}
+
+static void advance(cTimerWheel *wheel, u_int64_t time) {
+	std::vector<void*> expired;
+	wheel->advance(time, &expired);
+	for(unsigned i = 0; i < expired.size(); i++) {
+		((sItem*)expired[i])->fired = time;
+	}
+}
+
+static void test_first_far() {
+	u_int64_t now = 1700000000;
+	cTimerWheel wheel;
+	sItem far, near;
+	// the first add must not move the current tick to its (far) expire time
+	wheel.add(&far.node, now + 100000);
+	wheel.add(&near.node, now + 5);
+	advance(&wheel, now);
+	check(far.fired == now && near.fired == now && !wheel.size(), "first advance - nodes added before are due");
+	far.fired = near.fired = 0;
+	wheel.add(&far.node, now + 100000);
+	wheel.add(&near.node, now + 5);
+	for(u_int64_t t = now + 1; t <= now + 10; t++) {
+		advance(&wheel, t);
+	}
+	check(near.fired == now + 5, "near timeout after a far timeout is due in time");
+	check(!far.fired && wheel.size() == 1, "far timeout is not due");
+	advance(&wheel, now + 10);
+	check(wheel.getCurrent() == now + 11 && wheel.size() == 1, "repeated advance of the same tick");
+}
+
+static void test_backward() {
+	u_int64_t now = 1700000000;
+	cTimerWheel wheel;
+	sItem items[3];
+	advance(&wheel, now);
+	wheel.add(&items[0].node, now + 30);
+	wheel.add(&items[1].node, now + 5000);
+	for(u_int64_t t = now + 1; t <= now + 10; t++) {
+		advance(&wheel, t);
+	}
+	// time going back (e.g. the next pcap file) resets the wheel
+	advance(&wheel, now - 100);
+	check(items[0].fired == now - 100 && items[1].fired == now - 100 && !wheel.size(), "backward step - all nodes are due");
+	check(wheel.getCurrent() == now - 99, "backward step - current tick from the new time");
+	wheel.add(&items[2].node, now - 97);
+	for(u_int64_t t = now - 99; t <= now - 90; t++) {
+		advance(&wheel, t);
+	}
+	check(items[2].fired == now - 97, "timeout after a backward step is due in time");
+}
+
+static void test_jump() {
+	u_int64_t now = 1700000000;
+	cTimerWheel wheel;
+	sItem item;
+	advance(&wheel, now);
+	wheel.add(&item.node, now + 1000000);
+	advance(&wheel, now + TIMER_WHEEL_MAX_ADVANCE + 10);
+	check(item.fired == now + TIMER_WHEEL_MAX_ADVANCE + 10 && !wheel.size(), "forward time jump - all nodes are due");
+}
+
+static void test_random(unsigned count) {
+	u_int64_t now = 1700000000;
+	cTimerWheel wheel;
+	std::vector<sItem> items(count);
+	for(unsigned i = 0; i < count; i++) {
+		items[i].node.data = &items[i];
+	}
+	advance(&wheel, now);
+	srand(1);
+	u_int64_t end = now + 3 * TIMER_WHEEL_MAX_ADVANCE / 4;
+	for(unsigned i = 0; i < count; i++) {
+		items[i].expire = now + 1 + rand() % (end - now);
+		wheel.add(&items[i].node, items[i].expire);
+	}
+	unsigned rescheduled = 0;
+	for(u_int64_t t = now + 1; t <= end; t++) {
+		advance(&wheel, t);
+		// reschedule (earlier and later) of some nodes
+		for(unsigned j = 0; j < 4; j++) {
+			sItem *item = &items[rand() % count];
+			if(item->node.isLinked()) {
+				item->expire = t + 1 + rand() % (end - t);
+				wheel.add(&item->node, item->expire);
+				++rescheduled;
+			}
+		}
+	}
+	unsigned bad = 0;
+	for(unsigned i = 0; i < count; i++) {
+		if(items[i].fired != items[i].expire) {
+			++bad;
+		}
+	}
+	char descr[100];
+	snprintf(descr, sizeof(descr), "random %u nodes (%u rescheduled) due exactly in time", count, rescheduled);
+	check(!bad && !wheel.size(), descr);
+}
+
+static void bench(unsigned count) {
+	u_int64_t now = 1700000000;
+	cTimerWheel wheel;
+	std::vector<sItem> items(count);
+	for(unsigned i = 0; i < count; i++) {
+		items[i].node.data = &items[i];
+	}
+	advance(&wheel, now);
+	u_int64_t beginUS = getTimeUS();
+	for(unsigned i = 0; i < count; i++) {
+		wheel.add(&items[i].node, now + 1 + i % 3600);
+	}
+	u_int64_t addUS = getTimeUS() - beginUS;
+	beginUS = getTimeUS();
+	for(u_int64_t t = now + 1; t <= now + 3600; t++) {
+		advance(&wheel, t);
+	}
+	u_int64_t advanceUS = getTimeUS() - beginUS;
+	printf("%u nodes: add %.1lf ns/node, advance of 3600 ticks %.1lf ns/node\n",
+	       count, addUS * 1000. / count, advanceUS * 1000. / count);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned count = argc > 1 ? atoi(argv[1]) : 100000;
+	test_first_far();
+	test_backward();
+	test_jump();
+	test_random(count);
+	bench(count);
+	return(errors ? 1 : 0);
+}
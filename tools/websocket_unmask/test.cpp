@@ -0,0 +1,368 @@
+/* Benchmark of decoding of SIP over websocket (masked frames from the browser) - the former way (the payload copied to
+   the new buffer, unmasked by xorData byte after byte and copied again to the cloned packet) against
+   cWebSocketHeader::decodeMessageTo (unmasked by websocket_unmask directly to the packet) and
+   cWebSocketHeader::decodeDataInPlace (unmasked over the websocket headers in own packet).
+   The corpus are INVITE with WebRTC SDP offers (bundle of audio, video with simulcast and data channel, ICE candidates
+   of several interfaces) in one frame and fragmented to frames of 1024 / 256 bytes - the fragmented message is
+   decoded by the former way frame by frame and the frames appended to one buffer. The results of all variants are
+   compared with the message before the measurement.
+   usage: ./test [iterations] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+
+#include "../../websocket.h"
+
+
+#define PACKET_HEADER_LENGTH 54
+
+using namespace std;
+
+
+static volatile u_int64_t checkSum;
+
+// mirror of xorData from tools_global.cpp
+static void xorData(u_char *data, size_t dataLen, const char *key, size_t keyLength, size_t initPos) {
+	for(size_t i = 0; i < dataLen; i++) {
+		data[i] = data[i] ^ key[(initPos + i) % keyLength];
+	}
+}
+
+static string sdpCandidates(const char *component, unsigned port) {
+	char line[256];
+	string rslt;
+	const char *ips[] = { "192.168.1.20", "10.8.0.6", "172.17.0.1", "2001:db8:1::20" };
+	for(unsigned i = 0; i < sizeof(ips) / sizeof(ips[0]); i++) {
+		snprintf(line, sizeof(line), "a=candidate:%u %s udp %u %s %u typ host generation 0 network-id %u network-cost 10\r\n",
+			 1467250027 + i * 7919, component, 2122260223 - i * 256, ips[i], port + i, i + 1);
+		rslt += line;
+		snprintf(line, sizeof(line), "a=candidate:%u %s tcp %u %s 9 typ host tcptype active generation 0 network-id %u network-cost 10\r\n",
+			 3711240011u - i * 7919, component, 1518280447 - i * 256, ips[i], i + 1);
+		rslt += line;
+	}
+	snprintf(line, sizeof(line), "a=candidate:842163049 %s udp 1686052607 203.0.113.7 %u typ srflx raddr 192.168.1.20 rport %u generation 0 network-id 1 network-cost 10\r\n",
+		 component, port + 20, port);
+	rslt += line;
+	snprintf(line, sizeof(line), "a=candidate:1529457429 %s udp 41885439 198.51.100.10 %u typ relay raddr 203.0.113.7 rport %u generation 0 network-id 1 network-cost 10\r\n",
+		 component, 62000 + port % 1000, port + 20);
+	rslt += line;
+	return(rslt);
+}
+
+static string sdpMediaCommon(const char *mid) {
+	return(string("a=ice-ufrag:Vq7m\r\n"
+		      "a=ice-pwd:3m1HnRo3dCvzXpPtC9aJ4kQe\r\n"
+		      "a=ice-options:trickle\r\n"
+		      "a=fingerprint:sha-256 5E:2B:91:0A:7C:4F:D3:18:E6:0B:A9:35:C2:77:14:8D:F0:6A:B3:29:5C:E1:47:9D:02:BE:83:16:6F:D4:A8:3C\r\n"
+		      "a=setup:actpass\r\n"
+		      "a=mid:") + mid + "\r\n");
+}
+
+static string webrtcOffer(bool video, bool simulcast) {
+	string sdp =
+		"v=0\r\n"
+		"o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+		"s=-\r\n"
+		"t=0 0\r\n";
+	sdp += string("a=group:BUNDLE 0") + (video ? " 1" : "") + " 2\r\n"
+		"a=extmap-allow-mixed\r\n"
+		"a=msid-semantic: WMS 9d1f5c3a-0b7e-4c2d-a6f8-3e9b1c7d5a20\r\n";
+	sdp += "m=audio 53212 UDP/TLS/RTP/SAVPF 111 63 9 0 8 13 110 126\r\n"
+	       "c=IN IP4 203.0.113.7\r\n"
+	       "a=rtcp:9 IN IP4 0.0.0.0\r\n";
+	sdp += sdpCandidates("1", 53212);
+	sdp += sdpMediaCommon("0");
+	sdp += "a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+	       "a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+	       "a=extmap:3 http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+	       "a=extmap:4 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+	       "a=sendrecv\r\n"
+	       "a=msid:9d1f5c3a-0b7e-4c2d-a6f8-3e9b1c7d5a20 2c4e6a8b-1d3f-4a5c-9e7b-0f2d4c6e8a1b\r\n"
+	       "a=rtcp-mux\r\n"
+	       "a=rtpmap:111 opus/48000/2\r\n"
+	       "a=rtcp-fb:111 transport-cc\r\n"
+	       "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+	       "a=rtpmap:63 red/48000/2\r\n"
+	       "a=fmtp:63 111/111\r\n"
+	       "a=rtpmap:9 G722/8000\r\n"
+	       "a=rtpmap:0 PCMU/8000\r\n"
+	       "a=rtpmap:8 PCMA/8000\r\n"
+	       "a=rtpmap:13 CN/8000\r\n"
+	       "a=rtpmap:110 telephone-event/48000\r\n"
+	       "a=rtpmap:126 telephone-event/8000\r\n"
+	       "a=ssrc:3735928559 cname:Hq2bL9vX4kTz7mNc\r\n"
+	       "a=ssrc:3735928559 msid:9d1f5c3a-0b7e-4c2d-a6f8-3e9b1c7d5a20 2c4e6a8b-1d3f-4a5c-9e7b-0f2d4c6e8a1b\r\n";
+	if(video) {
+		sdp += "m=video 53213 UDP/TLS/RTP/SAVPF 96 97 102 103 104 105 106 107 108 109 127 125 39 40 45 46 98 99 100 101 112 113 114\r\n"
+		       "c=IN IP4 203.0.113.7\r\n"
+		       "a=rtcp:9 IN IP4 0.0.0.0\r\n";
+		sdp += sdpCandidates("1", 53213);
+		sdp += sdpMediaCommon("1");
+		sdp += "a=extmap:14 urn:ietf:params:rtp-hdrext:toffset\r\n"
+		       "a=extmap:2 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+		       "a=extmap:13 urn:3gpp:video-orientation\r\n"
+		       "a=extmap:3 http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01\r\n"
+		       "a=extmap:5 http://www.webrtc.org/experiments/rtp-hdrext/playout-delay\r\n"
+		       "a=extmap:6 http://www.webrtc.org/experiments/rtp-hdrext/video-content-type\r\n"
+		       "a=extmap:7 http://www.webrtc.org/experiments/rtp-hdrext/video-timing\r\n"
+		       "a=extmap:8 http://www.webrtc.org/experiments/rtp-hdrext/color-space\r\n"
+		       "a=extmap:4 urn:ietf:params:rtp-hdrext:sdes:mid\r\n"
+		       "a=extmap:10 urn:ietf:params:rtp-hdrext:sdes:rtp-stream-id\r\n"
+		       "a=extmap:11 urn:ietf:params:rtp-hdrext:sdes:repaired-rtp-stream-id\r\n"
+		       "a=sendrecv\r\n"
+		       "a=msid:9d1f5c3a-0b7e-4c2d-a6f8-3e9b1c7d5a20 7e5c3a1f-9b8d-4e6f-a2c4-6b8d0f2a4c6e\r\n"
+		       "a=rtcp-mux\r\n"
+		       "a=rtcp-rsize\r\n";
+		const char *codecs[] = { "96 VP8", "98 VP9", "100 VP9", "102 H264", "104 H264", "106 H264", "108 H264", "127 H264", "39 AV1", "45 AV1", "112 H264" };
+		char line[256];
+		for(unsigned i = 0; i < sizeof(codecs) / sizeof(codecs[0]); i++) {
+			unsigned pt = atoi(codecs[i]);
+			const char *name = strchr(codecs[i], ' ') + 1;
+			snprintf(line, sizeof(line),
+				 "a=rtpmap:%u %s/90000\r\n"
+				 "a=rtcp-fb:%u goog-remb\r\n"
+				 "a=rtcp-fb:%u transport-cc\r\n"
+				 "a=rtcp-fb:%u ccm fir\r\n"
+				 "a=rtcp-fb:%u nack\r\n"
+				 "a=rtcp-fb:%u nack pli\r\n",
+				 pt, name, pt, pt, pt, pt, pt);
+			sdp += line;
+			if(!strcmp(name, "H264")) {
+				snprintf(line, sizeof(line), "a=fmtp:%u level-asymmetry-allowed=1;packetization-mode=%u;profile-level-id=42%s\r\n",
+					 pt, i % 2, i % 3 ? "e01f" : "001f");
+				sdp += line;
+			}
+			snprintf(line, sizeof(line),
+				 "a=rtpmap:%u rtx/90000\r\n"
+				 "a=fmtp:%u apt=%u\r\n",
+				 pt + 1, pt + 1, pt);
+			sdp += line;
+		}
+		if(simulcast) {
+			sdp += "a=rid:q send\r\n"
+			       "a=rid:h send\r\n"
+			       "a=rid:f send\r\n"
+			       "a=simulcast:send q;h;f\r\n";
+		}
+		const char *ssrcs[] = { "1134548451", "2886135297", "3221225473", "1879048193", "2415919105", "4026531841" };
+		for(unsigned i = 0; i < (simulcast ? 6u : 2u); i++) {
+			snprintf(line, sizeof(line),
+				 "a=ssrc:%s cname:Hq2bL9vX4kTz7mNc\r\n"
+				 "a=ssrc:%s msid:9d1f5c3a-0b7e-4c2d-a6f8-3e9b1c7d5a20 7e5c3a1f-9b8d-4e6f-a2c4-6b8d0f2a4c6e\r\n",
+				 ssrcs[i], ssrcs[i]);
+			sdp += line;
+		}
+		sdp += simulcast ?
+			"a=ssrc-group:SIM 1134548451 3221225473 2415919105\r\n"
+			"a=ssrc-group:FID 1134548451 2886135297\r\n"
+			"a=ssrc-group:FID 3221225473 1879048193\r\n"
+			"a=ssrc-group:FID 2415919105 4026531841\r\n" :
+			"a=ssrc-group:FID 1134548451 2886135297\r\n";
+	}
+	sdp += "m=application 53214 UDP/DTLS/SCTP webrtc-datachannel\r\n"
+	       "c=IN IP4 203.0.113.7\r\n";
+	sdp += sdpCandidates("1", 53214);
+	sdp += sdpMediaCommon("2");
+	sdp += "a=sctp-port:5000\r\n"
+	       "a=max-message-size:262144\r\n";
+	char contentLength[64];
+	snprintf(contentLength, sizeof(contentLength), "Content-Length: %u\r\n", (unsigned)sdp.length());
+	return(string(
+		"INVITE sip:1042@pbx.example.com SIP/2.0\r\n"
+		"Via: SIP/2.0/WSS df7jal23ls0d.invalid;branch=z9hG4bK2581427\r\n"
+		"Max-Forwards: 69\r\n"
+		"To: <sip:1042@pbx.example.com>\r\n"
+		"From: \"Alice\" <sip:alice@pbx.example.com>;tag=lu8o0ou4k5\r\n"
+		"Call-ID: 8oc3vhb2q9m1t0sduj6a\r\n"
+		"CSeq: 5171 INVITE\r\n"
+		"Contact: <sip:q2j7s8u4@df7jal23ls0d.invalid;transport=ws;ob>\r\n"
+		"Allow: INVITE,ACK,CANCEL,BYE,UPDATE,MESSAGE,OPTIONS,REFER,INFO,NOTIFY\r\n"
+		"Supported: ice,replaces,outbound\r\n"
+		"User-Agent: JsSIP 3.10.1\r\n"
+		"Content-Type: application/sdp\r\n") +
+		contentLength +
+		"\r\n" +
+		sdp);
+}
+
+// frames of the message (from the browser - masked), the first frame text, the others continuation
+static string webSocketFrames(const string &message, unsigned fragmentSize) {
+	string frames;
+	unsigned pos = 0;
+	unsigned index = 0;
+	while(pos < message.length()) {
+		unsigned length = fragmentSize && message.length() - pos > fragmentSize ? fragmentSize : message.length() - pos;
+		bool fin = pos + length == message.length();
+		u_char header[14];
+		unsigned headerLength = 2;
+		header[0] = (fin ? 0x80 : 0) | (index == 0 ? 0x01 : 0x00);
+		if(length < 126) {
+			header[1] = 0x80 | length;
+		} else {
+			header[1] = 0x80 | 126;
+			header[2] = length >> 8;
+			header[3] = length;
+			headerLength = 4;
+		}
+		u_char mask[4] = { (u_char)(0x37 + index), 0xfa, 0x21, (u_char)(0x3d ^ index) };
+		memcpy(header + headerLength, mask, 4);
+		headerLength += 4;
+		frames.append((char*)header, headerLength);
+		for(unsigned i = 0; i < length; i++) {
+			frames += (char)(message[pos + i] ^ mask[i % 4]);
+		}
+		pos += length;
+		++index;
+	}
+	return(frames);
+}
+
+// former process_websocket - decodeData (new + memcpy + xorData) and clonePacketS (new packet + memcpy)
+static u_char *decodeFormer(u_char *packet, unsigned frameLength, unsigned *messageLength) {
+	u_char *message = NULL;
+	unsigned length = 0;
+	unsigned pos = 0;
+	while(pos < frameLength) {
+		cWebSocketHeader ws(packet + PACKET_HEADER_LENGTH + pos, frameLength - pos);
+		unsigned dataLength = ws.getDataLength();
+		u_char *data = new u_char[dataLength];
+		memcpy(data, ws.getData(), dataLength);
+		xorData(data, dataLength, (const char*)ws.getMask(), 4, 0);
+		u_char *new_packet = new u_char[PACKET_HEADER_LENGTH + length + dataLength];
+		memcpy(new_packet, packet, PACKET_HEADER_LENGTH);
+		if(message) {
+			memcpy(new_packet + PACKET_HEADER_LENGTH, message + PACKET_HEADER_LENGTH, length);
+			delete [] message;
+		}
+		memcpy(new_packet + PACKET_HEADER_LENGTH + length, data, dataLength);
+		delete [] data;
+		message = new_packet;
+		length += dataLength;
+		pos += ws.getHeaderLength() + dataLength;
+	}
+	*messageLength = length;
+	return(message);
+}
+
+static u_char *decodeCopy(u_char *packet, unsigned frameLength, unsigned *messageLength) {
+	cWebSocketHeader ws(packet + PACKET_HEADER_LENGTH, frameLength);
+	u_char *new_packet = new u_char[PACKET_HEADER_LENGTH + frameLength];
+	memcpy(new_packet, packet, PACKET_HEADER_LENGTH);
+	*messageLength = ws.decodeMessageTo(new_packet + PACKET_HEADER_LENGTH);
+	return(new_packet);
+}
+
+static unsigned decodeInPlace(u_char *packet, unsigned frameLength) {
+	cWebSocketHeader ws(packet + PACKET_HEADER_LENGTH, frameLength);
+	return(ws.decodeDataInPlace());
+}
+
+static u_int64_t getTimeUS() {
+	timeval tv;
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec * 1000000ull + tv.tv_usec);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned iterations = argc > 1 ? atoi(argv[1]) : 100000;
+	struct sCase {
+		const char *name;
+		string message;
+		unsigned fragmentSize;
+		string frames;
+	} cases[] = {
+		{ "audio + data", webrtcOffer(false, false), 0, "" },
+		{ "audio + video + data", webrtcOffer(true, false), 0, "" },
+		{ "audio + simulcast video + data", webrtcOffer(true, true), 0, "" },
+		{ "audio + simulcast video + data", webrtcOffer(true, true), 1024, "" },
+		{ "audio + simulcast video + data", webrtcOffer(true, true), 256, "" }
+	};
+	unsigned casesCount = sizeof(cases) / sizeof(cases[0]);
+	printf("websocket_unmask implementation: %s\n", websocket_unmask_implementation());
+	for(unsigned c = 0; c < casesCount; c++) {
+		cases[c].frames = webSocketFrames(cases[c].message, cases[c].fragmentSize);
+		unsigned frameLength = cases[c].frames.length();
+		u_char *packet = new u_char[PACKET_HEADER_LENGTH + frameLength];
+		memset(packet, 0x45, PACKET_HEADER_LENGTH);
+		memcpy(packet + PACKET_HEADER_LENGTH, cases[c].frames.data(), frameLength);
+		cWebSocketHeader ws(packet + PACKET_HEADER_LENGTH, frameLength);
+		// as check_websocket (check_websocket_header is in websocket.cpp)
+		if(!check_websocket_first_byte(packet + PACKET_HEADER_LENGTH, frameLength) ||
+		   !ws.isHeaderSizeOk() || !ws.isDataSizeOk()) {
+			printf("check of websocket frames failed: %s\n", cases[c].name);
+			return(1);
+		}
+		unsigned messageLength;
+		u_char *rslt = decodeFormer(packet, frameLength, &messageLength);
+		if(messageLength != cases[c].message.length() ||
+		   memcmp(rslt + PACKET_HEADER_LENGTH, cases[c].message.data(), messageLength)) {
+			printf("former decode mismatch: %s\n", cases[c].name);
+			return(1);
+		}
+		delete [] rslt;
+		rslt = decodeCopy(packet, frameLength, &messageLength);
+		if(messageLength != cases[c].message.length() ||
+		   memcmp(rslt + PACKET_HEADER_LENGTH, cases[c].message.data(), messageLength) ||
+		   memcmp(rslt, packet, PACKET_HEADER_LENGTH)) {
+			printf("decodeMessageTo mismatch: %s\n", cases[c].name);
+			return(1);
+		}
+		delete [] rslt;
+		u_char *work = new u_char[PACKET_HEADER_LENGTH + frameLength];
+		memcpy(work, packet, PACKET_HEADER_LENGTH + frameLength);
+		messageLength = decodeInPlace(work, frameLength);
+		if(messageLength != cases[c].message.length() ||
+		   memcmp(work + PACKET_HEADER_LENGTH, cases[c].message.data(), messageLength)) {
+			printf("decodeDataInPlace mismatch: %s\n", cases[c].name);
+			return(1);
+		}
+		u_int64_t start = getTimeUS();
+		for(unsigned i = 0; i < iterations; i++) {
+			rslt = decodeFormer(packet, frameLength, &messageLength);
+			checkSum += rslt[PACKET_HEADER_LENGTH + (i % messageLength)];
+			delete [] rslt;
+		}
+		u_int64_t timeFormer = getTimeUS() - start;
+		start = getTimeUS();
+		for(unsigned i = 0; i < iterations; i++) {
+			rslt = decodeCopy(packet, frameLength, &messageLength);
+			checkSum += rslt[PACKET_HEADER_LENGTH + (i % messageLength)];
+			delete [] rslt;
+		}
+		u_int64_t timeCopy = getTimeUS() - start;
+		// the in place variant needs the masked frames again in every iteration - the time of this copy is subtracted
+		start = getTimeUS();
+		for(unsigned i = 0; i < iterations; i++) {
+			memcpy(work + PACKET_HEADER_LENGTH, packet + PACKET_HEADER_LENGTH, frameLength);
+			checkSum += work[PACKET_HEADER_LENGTH + (i % frameLength)];
+		}
+		u_int64_t timeRestore = getTimeUS() - start;
+		start = getTimeUS();
+		for(unsigned i = 0; i < iterations; i++) {
+			memcpy(work + PACKET_HEADER_LENGTH, packet + PACKET_HEADER_LENGTH, frameLength);
+			messageLength = decodeInPlace(work, frameLength);
+			checkSum += work[PACKET_HEADER_LENGTH + (i % messageLength)];
+		}
+		u_int64_t timeInPlace = getTimeUS() - start;
+		timeInPlace = timeInPlace > timeRestore ? timeInPlace - timeRestore : 0;
+		char fragments[32];
+		if(cases[c].fragmentSize) {
+			snprintf(fragments, sizeof(fragments), "frames by %u B", cases[c].fragmentSize);
+		} else {
+			snprintf(fragments, sizeof(fragments), "one frame");
+		}
+		printf("%-32s %-16s %6u B: former %7.1f ns (%5.2f GB/s)  decodeMessageTo %7.1f ns (%5.2f GB/s)  in place %7.1f ns (%5.2f GB/s)\n",
+		       cases[c].name, fragments, (unsigned)cases[c].message.length(),
+		       timeFormer * 1000. / iterations, (double)cases[c].message.length() * iterations / (timeFormer * 1000.),
+		       timeCopy * 1000. / iterations, (double)cases[c].message.length() * iterations / (timeCopy * 1000.),
+		       timeInPlace * 1000. / iterations, timeInPlace ? (double)cases[c].message.length() * iterations / (timeInPlace * 1000.) : 0.);
+		delete [] work;
+		delete [] packet;
+	}
+	return(0);
+}
@@ -40,9 +40,14 @@ CompressStream::CompressStream(eTypeCompress typeCompress, u_int32_t compressBuf
 	this->lzoWrkmemDecompress = NULL;
 	this->lzoDecompressData = NULL;
 	#endif //HAVE_LIBLZO
+	#ifdef HAVE_LIBZSTD
+	this->zstdStream = NULL;
+	this->zstdStreamDecompress = NULL;
+	#endif //HAVE_LIBZSTD
 	this->snappyDecompressData = NULL;
 	this->zipLevel = Z_DEFAULT_COMPRESSION;
 	this->lzmaLevel = 6;
+	this->zstdLevel = 3;
 	this->autoPrefixFile = false;
 	this->forceStream = false;
 	this->processed_len = 0;
@@ -63,6 +68,10 @@ void CompressStream::setLzmaLevel(int lzmaLevel) {
 	this->lzmaLevel = lzmaLevel;
 }
 
+void CompressStream::setZstdLevel(int zstdLevel) {
+	this->zstdLevel = zstdLevel;
+}
+
 void CompressStream::enableAutoPrefixFile() {
 	this->autoPrefixFile = true;
 }
@@ -141,6 +150,19 @@ void CompressStream::initCompress() {
 		}
 		#endif //HAVE_LIBLZ4
 		break;
+	case zstd:
+		#ifdef HAVE_LIBZSTD
+		if(!this->zstdStream) {
+			this->zstdStream = ZSTD_createCCtx();
+			if(this->zstdStream &&
+			   !ZSTD_isError(ZSTD_CCtx_setParameter(this->zstdStream, ZSTD_c_compressionLevel, this->zstdLevel))) {
+				createCompressBuffer();
+			} else {
+				this->setError("zstd initialize failed");
+			}
+		}
+		#endif //HAVE_LIBZSTD
+		break;
 	case compress_auto:
 		break;
 	}
@@ -213,6 +235,18 @@ void CompressStream::initDecompress(u_int32_t dataLen) {
 		createDecompressBuffer(dataLen);
 		#endif //HAVE_LIBLZ4
 		break;
+	case zstd:
+		#ifdef HAVE_LIBZSTD
+		if(!this->zstdStreamDecompress) {
+			this->zstdStreamDecompress = ZSTD_createDCtx();
+			if(this->zstdStreamDecompress) {
+				createDecompressBuffer(this->decompressBufferLength);
+			} else {
+				this->setError("zstd decompress initialize failed");
+			}
+		}
+		#endif //HAVE_LIBZSTD
+		break;
 	case compress_auto:
 		break;
 	}
@@ -243,6 +277,12 @@ void CompressStream::termCompress() {
 		this->lz4Stream = NULL;
 	}
 	#endif //ifdef HAVE_LIBLZ4
+	#ifdef HAVE_LIBZSTD
+	if(this->zstdStream) {
+		ZSTD_freeCCtx(this->zstdStream);
+		this->zstdStream = NULL;
+	}
+	#endif //HAVE_LIBZSTD
 	if(this->compressBuffer) {
 		delete [] this->compressBuffer;
 		this->compressBuffer = NULL;
@@ -282,6 +322,12 @@ void CompressStream::termDecompress() {
 		this->lz4StreamDecode = NULL;
 	}
 	#endif //HAVE_LIBLZ4
+	#ifdef HAVE_LIBZSTD
+	if(this->zstdStreamDecompress) {
+		ZSTD_freeDCtx(this->zstdStreamDecompress);
+		this->zstdStreamDecompress = NULL;
+	}
+	#endif //HAVE_LIBZSTD
 	if(this->decompressBuffer) {
 		delete [] this->decompressBuffer;
 		this->decompressBuffer = NULL;
@@ -497,6 +543,32 @@ bool CompressStream::compress(char *data, u_int32_t len, bool flush, CompressStr
 		#endif //HAVE_LIBLZ4
 		}
 		break;
+	case zstd: {
+		#ifdef HAVE_LIBZSTD
+		if(!this->zstdStream) {
+			this->initCompress();
+			if(this->isError()) {
+				return(false);
+			}
+		}
+		ZSTD_inBuffer input = { data, len, 0 };
+		size_t remaining;
+		do {
+			ZSTD_outBuffer output = { this->compressBuffer, this->compressBufferLength, 0 };
+			remaining = ZSTD_compressStream2(this->zstdStream, &output, &input, flush ? ZSTD_e_end : ZSTD_e_continue);
+			if(ZSTD_isError(remaining)) {
+				this->setError(string("zstd compress failed ") + ZSTD_getErrorName(remaining));
+				return(false);
+			}
+			if(output.pos && !baseEv->compress_ev(this->compressBuffer, output.pos, 0)) {
+				this->setError("zstd compress_ev failed");
+				return(false);
+			}
+		} while(input.pos < input.size || (flush && remaining));
+		this->processed_len += len;
+		#endif //HAVE_LIBZSTD
+		}
+		break;
 	case compress_auto:
 		break;
 	}
@@ -753,6 +825,36 @@ bool CompressStream::decompress(char *data, u_int32_t len, u_int32_t decompress_
 		}
 		#endif //HAVE_LIBLZ4
 		break;
+	case zstd: {
+		#ifdef HAVE_LIBZSTD
+		if(!this->zstdStreamDecompress) {
+			this->initDecompress(0);
+			if(this->isError()) {
+				return(false);
+			}
+		}
+		ZSTD_inBuffer input = { data, len, 0 };
+		ZSTD_outBuffer output;
+		do {
+			output.dst = this->decompressBuffer;
+			output.size = this->decompressBufferLength;
+			output.pos = 0;
+			size_t rslt = ZSTD_decompressStream(this->zstdStreamDecompress, &output, &input);
+			if(ZSTD_isError(rslt)) {
+				this->setError(string("zstd decompress failed ") + ZSTD_getErrorName(rslt));
+				return(false);
+			}
+			if(output.pos && !baseEv->decompress_ev(this->decompressBuffer, output.pos)) {
+				this->setError("zstd decompress_ev failed");
+				return(false);
+			}
+		} while(input.pos < input.size || output.pos == output.size);
+		if(use_len) {
+			*use_len = input.pos;
+		}
+		#endif //HAVE_LIBZSTD
+		}
+		break;
 	case compress_auto:
 		break;
 	}
@@ -769,6 +871,7 @@ void CompressStream::createCompressBuffer() {
 	case zip:
 	case gzip:
 	case lzma:
+	case zstd:
 		if(!this->compressBufferLength) {
 			this->compressBufferLength = 8 * 1024;
 		}
@@ -822,6 +925,7 @@ void CompressStream::createDecompressBuffer(u_int32_t bufferLen) {
 	case zip:
 	case gzip:
 	case lzma:
+	case zstd:
 		if(!this->decompressBufferLength) {
 			this->decompressBufferLength = 8 * 1024;
 		}
@@ -880,6 +984,11 @@ CompressStream::eTypeCompress CompressStream::convTypeCompress(const char *typeC
 		return(CompressStream::lz4_stream);
 	}
 	#endif //HAVE_LIBLZ4
+	#ifdef HAVE_LIBZSTD
+	else if(!strcmp(_compress_method, "zstd")) {
+		return(CompressStream::zstd);
+	}
+	#endif //HAVE_LIBZSTD
 	return(CompressStream::compress_na);
 }
 
@@ -901,6 +1010,10 @@ const char *CompressStream::convTypeCompress(eTypeCompress typeCompress) {
 	case lz4_stream:
 		return("lz4_stream");
 	#endif //HAVE_LIBLZ4
+	#ifdef HAVE_LIBZSTD
+	case zstd:
+		return("zstd");
+	#endif //HAVE_LIBZSTD
 	default:
 		return("no");
 	}
@@ -17,6 +17,9 @@
 #ifdef HAVE_LIBLZO
 #include <lzo/lzo1x.h>
 #endif //HAVE_LIBLZO
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif //HAVE_LIBZSTD
 #include <snappy-c.h>
 
 #include "tar_data.h"
@@ -48,6 +51,7 @@ public:
 		lzo,
 		lz4,
 		lz4_stream,
+		zstd,
 		compress_auto
 	};
 	struct sChunkSizeInfo {
@@ -59,6 +63,7 @@ public:
 	virtual ~CompressStream();
 	void setZipLevel(int zipLevel);
 	void setLzmaLevel(int lzmaLevel);
+	void setZstdLevel(int zstdLevel);
 	void enableAutoPrefixFile();
 	void enableForceStream();
 	void setSendParameters(int client, void *c_client);
@@ -72,7 +77,8 @@ public:
 		return(typeCompress == compress_na ||
 		       typeCompress == zip ||
 		       typeCompress == gzip ||
-		       typeCompress == lzma);
+		       typeCompress == lzma ||
+		       typeCompress == zstd);
 	}
 	void setError(const char *errorString) {
 		if(errorString && *errorString) {
@@ -130,10 +136,15 @@ private:
 	u_char *lzoWrkmemDecompress;
 	class SimpleBuffer *lzoDecompressData;
 	#endif //HAVE_LIBLZO
+	#ifdef HAVE_LIBZSTD
+	ZSTD_CCtx *zstdStream;
+	ZSTD_DCtx *zstdStreamDecompress;
+	#endif //HAVE_LIBZSTD
 	class SimpleBuffer *snappyDecompressData;
 	string errorString;
 	int zipLevel;
 	int lzmaLevel;
+	int zstdLevel;
 	bool autoPrefixFile;
 	bool forceStream;
 	u_int32_t processed_len;
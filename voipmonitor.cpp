@@ -206,6 +206,7 @@ bool opt_srtp_rtp_decrypt = false;
 bool opt_srtp_rtp_audio_decrypt = false;
 bool opt_srtp_rtcp_decrypt = true;
 int opt_use_libsrtp = 0;
+bool opt_srtp_evp = true;
 unsigned int opt_ignoreRTCPjitter = 0;	// ignore RTCP over this value (0 = disabled)
 int opt_saveudptl = 0;		// if = 1 all UDPTL packets will be saved (T.38 fax)
 int opt_rtpip_find_endpoints = 1;
@@ -244,6 +245,7 @@ int opt_rtp_check_timestamp = 0;
 int opt_jitterbuffer_f1 = 1;		// turns off/on jitterbuffer simulator to compute MOS score mos_f1
 int opt_jitterbuffer_f2 = 1;		// turns off/on jitterbuffer simulator to compute MOS score mos_f2
 int opt_jitterbuffer_adapt = 1;		// turns off/on jitterbuffer simulator to compute MOS score mos_adapt
+int opt_jitterbuffer_deferred_threads = 0;	// jitterbuffer simulators replayed from per stream log in worker threads
 int opt_ringbuffer = 10;	// ring buffer in MB 
 int opt_sip_register = 0;	// if == 1 save REGISTER messages, if == 2, use old registers
 int opt_sip_options = 0;
@@ -283,6 +285,7 @@ volatile int readend = 0;
 int opt_dup_check = 0;
 int opt_dup_check_ipheader = 1;
 int opt_dup_check_ipheader_ignore_ttl = 1;
+int opt_dup_check_window_ms = 50;
 int opt_fax_dup_seq_check = 0;
 int opt_fax_create_udptl_streams = 0;
 int rtptimeout = 300;
@@ -376,7 +379,9 @@ unsigned int opt_process_rtp_packets_qring_length = 2000;
 unsigned int opt_process_rtp_packets_qring_item_length = 0;
 unsigned int opt_process_rtp_packets_qring_usleep = 10;
 bool opt_process_rtp_packets_qring_force_push = true;
+int opt_qring_wait_spin = 500;
 int opt_cleanup_calls_period = 10;
+bool opt_cleanup_calls_wheel = true;
 int opt_destroy_calls_period = 2;
 bool opt_destroy_calls_in_storing_cdr = false;
 int opt_enable_ss7 = 0;
@@ -390,8 +395,11 @@ bool opt_ssl_log_errors = false;
 bool opt_ssl_ignore_error_invalid_mac = false;
 bool opt_ssl_destroy_tcp_link_on_rst = false;
 bool opt_ssl_destroy_ssl_session_on_rst = false;
+int opt_ssl_reassembly_threads = 0;
 int opt_ssl_store_sessions = 1;
 int opt_ssl_store_sessions_expiration_hours = 12;
+bool opt_ssl_sessionkey_cache = true;
+string opt_ssl_sessionkey_cache_snapshot;
 int opt_tcpreassembly_thread = 1;
 char opt_tcpreassembly_http_log[1024];
 char opt_tcpreassembly_webrtc_log[1024];
@@ -559,6 +567,7 @@ int opt_jitter_forcemark_transit_threshold = 10;
 int opt_jitter_forcemark_delta_threshold = 500;
 bool opt_disable_rtp_warning = false;
 int opt_hash_modify_queue_length_ms = 0;
+bool opt_hash_rtp_rcu = false;
 bool opt_disable_process_sdp = false;
 
 char opt_php_path[1024];
@@ -579,6 +588,12 @@ extern uint64_t opt_pcap_queue_bypass_max_size;
 extern int opt_pcap_queue_compress;
 extern pcap_block_store::compress_method opt_pcap_queue_compress_method;
 extern int opt_pcap_queue_compress_ratio;
+extern int opt_pcap_queue_compress_zstd_level;
+extern int opt_pcap_queue_compress_threads;
+extern bool opt_pcap_queue_disk_async_io;
+extern int opt_pcap_queue_disk_async_inflight;
+extern int opt_pcap_queue_disk_async_readahead;
+extern char opt_pcap_queue_compress_zstd_dict[1024];
 extern string opt_pcap_queue_disk_folder;
 extern ip_port opt_pcap_queue_send_to_ip_port;
 extern ip_port opt_pcap_queue_receive_from_ip_port;
@@ -589,6 +604,15 @@ extern int opt_pcap_queue_dequeu_need_blocks;
 extern int opt_pcap_queue_dequeu_method;
 extern int opt_pcap_queue_use_blocks;
 extern int opt_pcap_queue_use_blocks_auto_enable;
+extern int opt_pcap_queue_iface_tpacket_v3;
+extern int opt_pcap_queue_iface_tpacket_v3_block_size;
+extern int opt_pcap_queue_iface_tpacket_v3_block_timeout;
+extern int opt_pcap_queue_iface_fanout;
+extern int opt_pcap_queue_iface_af_xdp;
+extern int opt_pcap_queue_iface_af_xdp_native;
+extern int opt_pcap_queue_iface_af_xdp_umem_size;
+extern int opt_pcap_queue_iface_kernel_prefilter;
+extern int opt_pcap_queue_iface_kernel_prefilter_max_endpoints;
 extern int opt_pcap_queue_suppress_t1_thread;
 extern int opt_pcap_queue_block_timeout;
 extern bool opt_pcap_queue_pcap_stat_per_one_interface;
@@ -772,6 +796,7 @@ int rtp_threaded = 0;
 int num_threads_set = 0;
 int num_threads_start = 0;
 int num_threads_max = 0;
+bool opt_rtp_threads_balance = false;
 volatile int num_threads_active = 0;
 unsigned int rtpthreadbuffer = 20;	// default 20MB
 unsigned int rtp_qring_length = 0;
@@ -1062,6 +1087,7 @@ bool opt_hugepages_anon = false;
 int opt_hugepages_max = 0;
 int opt_hugepages_overcommit_max = 0;
 int opt_hugepages_second_heap = 0;
+bool opt_slab_alloc = true;
 
 int opt_numa_balancing_set = numa_balancing_set_autodisable;
 
@@ -3608,6 +3634,19 @@ int main(int argc, char *argv[]) {
 		#endif //HEAP_CHUNK_ENABLE
 	}
 	
+	if(opt_slab_alloc && !HeapSafeCheck && !MemoryStatQuick) {
+		bool enableSlabAlloc = true;
+		#ifdef HEAP_CHUNK_ENABLE
+		if(heap_vm_size_call) {
+			// Call objects are allocated in the second heap
+			enableSlabAlloc = false;
+		}
+		#endif //HEAP_CHUNK_ENABLE
+		if(enableSlabAlloc) {
+			cSlabPool::setActive();
+		}
+	}
+	
 	if(!is_read_from_file() && !is_set_gui_params() && command_line_data.size() && reloadLoopCounter == 0) {
 		cLogSensor::log(cLogSensor::notice, "start voipmonitor", "version %s", RTPSENSOR_VERSION);
 		if(diffValuesMysqlLoadConfig.size()) {
@@ -4137,6 +4176,12 @@ int main_init_read() {
 	}
 
 	if(!is_sender() && !is_client_packetbuffer_sender()) {
+		if(opt_jitterbuffer_deferred_threads > 0 &&
+		   (opt_jitterbuffer_f1 || opt_jitterbuffer_f2 || opt_jitterbuffer_adapt)) {
+			jitterbufferDeferredPool = new FILE_LINE(0) cJitterbufferDeferredPool(opt_jitterbuffer_deferred_threads);
+			jitterbufferDeferredPool->start();
+		}
+		
 		// start reading threads
 		if(is_enable_rtp_threads()) {
 			rtp_threads = new FILE_LINE(42021) rtp_read_thread[num_threads_max];
@@ -4250,6 +4295,9 @@ int main_init_read() {
 			tcpReassemblySsl->setEnableWildLink();
 			tcpReassemblySsl->setIgnoreTcpHandshake();
 		}
+		if(opt_ssl_reassembly_threads > 1 && opt_enable_ssl != 10) {
+			tcpReassemblySsl->setShards(opt_ssl_reassembly_threads);
+		}
 	}
 	if(opt_sip_tcp_reassembly_ext) {
 		tcpReassemblySipExt = new FILE_LINE(42031) TcpReassembly(TcpReassembly::sip);
@@ -4283,6 +4331,11 @@ int main_init_read() {
 	if(is_enable_packetbuffer()) {
 		PcapQueue_init();
 		
+		if(opt_pcap_queue_iface_kernel_prefilter &&
+		   ifname[0] && !is_read_from_file_by_pb() && !opt_scanpcapdir[0] && !is_sender()) {
+			kernel_prefilter_init();
+		}
+		
 		if(is_read_from_file_by_pb() && opt_tcpreassembly_thread) {
 			if(tcpReassemblyHttp) {
 				tcpReassemblyHttp->setIgnoreTerminating(true);
@@ -4678,6 +4731,11 @@ void main_term_read() {
 	}
 	delete calltable;
 	calltable = NULL;
+	if(jitterbufferDeferredPool) {
+		delete jitterbufferDeferredPool;
+		jitterbufferDeferredPool = NULL;
+	}
+	kernel_prefilter_term();
 	
 	extern RTPstat rtp_stat;
 	rtp_stat.flush();
@@ -6518,7 +6576,6 @@ void cConfig::addConfigItems() {
 						->addValues(("sip:2|extend:"+intToString(PreProcessPacket::ppt_end_base)+"|auto:-1").c_str()));
 					addConfigItem(new FILE_LINE(42152) cConfigItem_integer("preprocess_packets_qring_length", &opt_preprocess_packets_qring_length));
 					addConfigItem(new FILE_LINE(42153) cConfigItem_integer("preprocess_packets_qring_item_length", &opt_preprocess_packets_qring_item_length));
-					addConfigItem(new FILE_LINE(42154) cConfigItem_integer("preprocess_packets_qring_usleep", &opt_preprocess_packets_qring_usleep));
 					addConfigItem(new FILE_LINE(42155) cConfigItem_yesno("preprocess_packets_qring_force_push", &opt_preprocess_packets_qring_force_push));
 					addConfigItem((new FILE_LINE(42156) cConfigItem_integer("process_rtp_packets_hash_next_thread", &opt_process_rtp_packets_hash_next_thread))
 						->setMaximum(MAX_PROCESS_RTP_PACKET_HASH_NEXT_THREADS)
@@ -6529,11 +6586,15 @@ void cConfig::addConfigItems() {
 						->addValues("2:2"));
 					addConfigItem(new FILE_LINE(42158) cConfigItem_integer("process_rtp_packets_qring_length", &opt_process_rtp_packets_qring_length));
 					addConfigItem(new FILE_LINE(42159) cConfigItem_integer("process_rtp_packets_qring_item_length", &opt_process_rtp_packets_qring_item_length));
-					addConfigItem(new FILE_LINE(42160) cConfigItem_integer("process_rtp_packets_qring_usleep", &opt_process_rtp_packets_qring_usleep));
 					addConfigItem(new FILE_LINE(42161) cConfigItem_yesno("process_rtp_packets_qring_force_push", &opt_process_rtp_packets_qring_force_push));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("qring_wait_spin", &opt_qring_wait_spin));
 					addConfigItem(new FILE_LINE(0) cConfigItem_integer("cleanup_calls_period", &opt_cleanup_calls_period));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("cleanup_calls_wheel", &opt_cleanup_calls_wheel));
 					addConfigItem(new FILE_LINE(0) cConfigItem_integer("destroy_calls_period", &opt_destroy_calls_period));
 					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("destroy_calls_in_storing_cdr", &opt_destroy_calls_in_storing_cdr));
+						obsolete();
+						addConfigItem(new FILE_LINE(42154) cConfigItem_integer("preprocess_packets_qring_usleep", &opt_preprocess_packets_qring_usleep));
+						addConfigItem(new FILE_LINE(42160) cConfigItem_integer("process_rtp_packets_qring_usleep", &opt_process_rtp_packets_qring_usleep));
 			setDisableIfEnd();
 	group("manager");
 		addConfigItem(new FILE_LINE(42162) cConfigItem_string("managerip", opt_manager_ip, sizeof(opt_manager_ip)));
@@ -6549,6 +6610,7 @@ void cConfig::addConfigItems() {
 				addConfigItem((new FILE_LINE(42166) cConfigItem_integer("rtpthreads", &num_threads_set))
 					->setIfZeroOrNegative(max(sysconf(_SC_NPROCESSORS_ONLN) - 1, 1l)));
 				addConfigItem(new FILE_LINE(42167) cConfigItem_integer("rtpthreads_start", &num_threads_start));
+				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("rtp_threads_balance", &opt_rtp_threads_balance));
 					expert();
 					addConfigItem(new FILE_LINE(42168) cConfigItem_yesno("savertp-threaded", &opt_rtpsave_threaded));
 				addConfigItem(new FILE_LINE(42169) cConfigItem_yesno("packetbuffer_compress", &opt_pcap_queue_compress));
@@ -6562,6 +6624,15 @@ void cConfig::addConfigItems() {
 					addConfigItem((new FILE_LINE(42174) cConfigItem_yesno("pcap_queue_use_blocks", &opt_pcap_queue_use_blocks))
 						->addAlias("use_blocks"));					
 					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("auto_enable_use_blocks", &opt_pcap_queue_use_blocks_auto_enable));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("tpacket_v3", &opt_pcap_queue_iface_tpacket_v3));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("tpacket_v3_block_size", &opt_pcap_queue_iface_tpacket_v3_block_size));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("tpacket_v3_block_timeout", &opt_pcap_queue_iface_tpacket_v3_block_timeout));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("interface_fanout", &opt_pcap_queue_iface_fanout));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("af_xdp", &opt_pcap_queue_iface_af_xdp));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("af_xdp_native", &opt_pcap_queue_iface_af_xdp_native));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("af_xdp_umem_size", &opt_pcap_queue_iface_af_xdp_umem_size));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("kernel_prefilter", &opt_pcap_queue_iface_kernel_prefilter));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("kernel_prefilter_max_endpoints", &opt_pcap_queue_iface_kernel_prefilter_max_endpoints));
 					addConfigItem((new FILE_LINE(42175) cConfigItem_integer("packetbuffer_block_maxsize", &opt_pcap_queue_block_max_size))
 						->setMultiple(1024));
 					addConfigItem(new FILE_LINE(42176) cConfigItem_integer("packetbuffer_block_maxtime", &opt_pcap_queue_block_max_time_ms));
@@ -6573,6 +6644,11 @@ void cConfig::addConfigItems() {
 					addConfigItem((new FILE_LINE(42178) cConfigItem_integer("packetbuffer_file_totalmaxsize", &opt_pcap_queue_store_queue_max_disk_size))
 						->setMultiple(1024 * 1024));
 					addConfigItem(new FILE_LINE(42179) cConfigItem_string("packetbuffer_file_path", &opt_pcap_queue_disk_folder));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("packetbuffer_file_async_io", &opt_pcap_queue_disk_async_io));
+					addConfigItem((new FILE_LINE(0) cConfigItem_integer("packetbuffer_file_async_inflight", &opt_pcap_queue_disk_async_inflight))
+						->setMinimum(1));
+					addConfigItem((new FILE_LINE(0) cConfigItem_integer("packetbuffer_file_async_readahead", &opt_pcap_queue_disk_async_readahead))
+						->setMinimum(1));
 	group("data storing");
 		setDisableIfBegin("sniffer_mode=" + snifferMode_sender_str);
 		subgroup("main");
@@ -6632,6 +6708,7 @@ void cConfig::addConfigItems() {
 				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("srtp_rtp_audio", &opt_srtp_rtp_audio_decrypt));
 				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("srtp_rtcp", &opt_srtp_rtcp_decrypt));
 				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("libsrtp", &opt_use_libsrtp));
+				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("srtp_evp", &opt_srtp_evp));
 					expert();
 					addConfigItem(new FILE_LINE(42212) cConfigItem_type_compress("pcap_dump_zip_rtp", &opt_pcap_dump_zip_rtp));
 					addConfigItem(new FILE_LINE(42213) cConfigItem_integer("pcap_dump_ziplevel_rtp", &opt_pcap_dump_ziplevel_rtp));
@@ -6705,6 +6782,7 @@ void cConfig::addConfigItems() {
 		addConfigItem(new FILE_LINE(42249) cConfigItem_yesno("dscp", &opt_dscp));
 				expert();
 				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("deduplicate_ipheader_ignore_ttl", &opt_dup_check_ipheader_ignore_ttl));
+				addConfigItem(new FILE_LINE(0) cConfigItem_integer("deduplicate_window", &opt_dup_check_window_ms));
 				addConfigItem(new FILE_LINE(42250) cConfigItem_string("tcpreassembly_http_log", opt_tcpreassembly_http_log, sizeof(opt_tcpreassembly_http_log)));
 				addConfigItem(new FILE_LINE(42251) cConfigItem_string("tcpreassembly_webrtc_log", opt_tcpreassembly_webrtc_log, sizeof(opt_tcpreassembly_webrtc_log)));
 				addConfigItem(new FILE_LINE(42252) cConfigItem_string("tcpreassembly_ssl_log", opt_tcpreassembly_ssl_log, sizeof(opt_tcpreassembly_ssl_log)));
@@ -6725,9 +6803,12 @@ void cConfig::addConfigItems() {
 			addConfigItem(new FILE_LINE(0) cConfigItem_yesno("ssl_ignore_error_invalid_mac", &opt_ssl_ignore_error_invalid_mac));
 			addConfigItem(new FILE_LINE(0) cConfigItem_yesno("ssl_destroy_tcp_link_on_rst", &opt_ssl_destroy_tcp_link_on_rst));
 			addConfigItem(new FILE_LINE(0) cConfigItem_yesno("ssl_destroy_ssl_session_on_rst", &opt_ssl_destroy_ssl_session_on_rst));
+			addConfigItem(new FILE_LINE(0) cConfigItem_integer("ssl_reassembly_threads", &opt_ssl_reassembly_threads));
 			addConfigItem((new FILE_LINE(0) cConfigItem_yesno("ssl_store_sessions", &opt_ssl_store_sessions))
 				->addValues("memory:1|persistent:2"));
 			addConfigItem(new FILE_LINE(0) cConfigItem_integer("ssl_store_sessions_expiration_hours", &opt_ssl_store_sessions_expiration_hours));
+			addConfigItem(new FILE_LINE(0) cConfigItem_yesno("ssl_sessionkey_cache", &opt_ssl_sessionkey_cache));
+			addConfigItem(new FILE_LINE(0) cConfigItem_string("ssl_sessionkey_cache_snapshot", &opt_ssl_sessionkey_cache_snapshot));
 		setDisableIfEnd();
 	group("SKINNY");
 		setDisableIfBegin("sniffer_mode=" + snifferMode_sender_str);
@@ -6819,6 +6900,7 @@ void cConfig::addConfigItems() {
 				addConfigItem(new FILE_LINE(0) cConfigItem_yesno("disable_sdp_multiplication_warning", &opt_disable_sdp_multiplication_warning));
 					expert();
 					addConfigItem(new FILE_LINE(0) cConfigItem_integer("hash_queue_length_ms", &opt_hash_modify_queue_length_ms));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("hash_rtp_rcu", &opt_hash_rtp_rcu));
 					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("disable_process_sdp", &opt_disable_process_sdp));
 		subgroup("REGISTER");
 			addConfigItem((new FILE_LINE(42290) cConfigItem_yesno("sip-register", &opt_sip_register))
@@ -6924,6 +7006,7 @@ void cConfig::addConfigItems() {
 			addConfigItem(new FILE_LINE(42336) cConfigItem_yesno("jitterbuffer_f1", &opt_jitterbuffer_f1));
 			addConfigItem(new FILE_LINE(42337) cConfigItem_yesno("jitterbuffer_f2", &opt_jitterbuffer_f2));
 			addConfigItem(new FILE_LINE(42338) cConfigItem_yesno("jitterbuffer_adapt", &opt_jitterbuffer_adapt));
+			addConfigItem(new FILE_LINE(0) cConfigItem_integer("jitterbuffer_deferred_threads", &opt_jitterbuffer_deferred_threads));
 			addConfigItem(new FILE_LINE(42339) cConfigItem_yesno("enable_jitterbuffer_asserts", &opt_enable_jitterbuffer_asserts));
 		setDisableIfEnd();
 	group("system");
@@ -7058,8 +7141,9 @@ void cConfig::addConfigItems() {
 		subgroup("interface - read packets");
 					expert();
 					addConfigItem(new FILE_LINE(42423) cConfigItem_integer("rtp_qring_length", &rtp_qring_length));
-					addConfigItem(new FILE_LINE(42424) cConfigItem_integer("rtp_qring_usleep", &rtp_qring_usleep));
 					addConfigItem(new FILE_LINE(42425) cConfigItem_integer("rtp_qring_batch_length", &rtp_qring_batch_length));
+						obsolete();
+						addConfigItem(new FILE_LINE(42424) cConfigItem_integer("rtp_qring_usleep", &rtp_qring_usleep));
 		subgroup("mirroring");
 					expert();
 					addConfigItem(new FILE_LINE(42426) cConfigItem_yesno("mirrorip", &opt_mirrorip));
@@ -7096,9 +7180,12 @@ void cConfig::addConfigItems() {
 					addConfigItem((new FILE_LINE(42443) cConfigItem_integer("packetbuffer_total_maxheap", &opt_pcap_queue_store_queue_max_memory_size))
 						->setMultiple(1024 * 1024));
 					addConfigItem((new FILE_LINE(42444) cConfigItem_yesno("packetbuffer_compress_method"))
-						->addValues("snappy:1|s:1|lz4:2|l:2")
+						->addValues("snappy:1|s:1|lz4:2|l:2|zstd:3|z:3")
 						->setDefaultValueStr("no"));
 					addConfigItem(new FILE_LINE(42445) cConfigItem_integer("packetbuffer_compress_ratio", &opt_pcap_queue_compress_ratio));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("packetbuffer_compress_threads", &opt_pcap_queue_compress_threads));
+					addConfigItem(new FILE_LINE(0) cConfigItem_integer("packetbuffer_compress_zstd_level", &opt_pcap_queue_compress_zstd_level));
+					addConfigItem(new FILE_LINE(0) cConfigItem_string("packetbuffer_compress_zstd_dict", opt_pcap_queue_compress_zstd_dict, sizeof(opt_pcap_queue_compress_zstd_dict)));
 						obsolete();
 						addConfigItem(new FILE_LINE(42446) cConfigItem_yesno("pcap_dispatch", &opt_pcap_dispatch));
 		subgroup("storing packets into pcap files, graph, audio");
@@ -7163,6 +7250,7 @@ void cConfig::addConfigItems() {
 					addConfigItem((new FILE_LINE(0) cConfigItem_yesno("hugepages_second_heap", &opt_hugepages_second_heap))
 						->addValues("all:1|call:2|packetbuffer:3")
 						->setDefaultValueStr("no"));
+					addConfigItem(new FILE_LINE(0) cConfigItem_yesno("slab_alloc", &opt_slab_alloc));
 					addConfigItem((new FILE_LINE(0) cConfigItem_yesno("numa_balancing_set", &opt_numa_balancing_set))
 						->addValues(("autodisable:" + intToString(numa_balancing_set_autodisable) + "|" + 
 							     "enable:" + intToString(numa_balancing_set_enable) + "|" +
@@ -7287,6 +7375,9 @@ void cConfig::evSetConfigItem(cConfigItem *configItem) {
 		case 2:
 			opt_pcap_queue_compress_method = pcap_block_store::lz4;
 			break;
+		case 3:
+			opt_pcap_queue_compress_method = pcap_block_store::zstd;
+			break;
 		}
 	}
 	if((configItem->config_name == "mirror_destination" && ((cConfigItem_ip_port*)configItem)->getValue()) || 
@@ -7577,6 +7668,7 @@ void parse_verb_param(string verbParam) {
 	else if(verbParam.substr(0, 25) == "memory_stat_ignore_limit=")
 								sverb.memory_stat_ignore_limit = atoi(verbParam.c_str() + 25);
 	else if(verbParam == "qring_stat")			sverb.qring_stat = 1;
+	else if(verbParam == "qring_wait")			sverb.qring_wait = 1;
 	else if(verbParam.substr(0, 10) == "qring_full")	sverb.qring_full = atoi(verbParam.c_str() + 11);
 	else if(verbParam == "alloc_stat")			sverb.alloc_stat = 1;
 	else if(verbParam == "qfiles")				sverb.qfiles = 1;
@@ -7639,6 +7731,7 @@ void parse_verb_param(string verbParam) {
 	else if(verbParam == "screen_popup")			sverb.screen_popup = 1;
 	else if(verbParam == "screen_popup_syslog")		sverb.screen_popup_syslog = 1;
 	else if(verbParam == "cleanup_calls")			sverb.cleanup_calls = 1;
+	else if(verbParam == "jitterbuffer_deferred_check")	sverb.jitterbuffer_deferred_check = 1;
 	else if(verbParam == "usleep_stats")			sverb.usleep_stats = 1;
 	else if(verbParam == "charts_cache_only")		sverb.charts_cache_only = 1;
 	else if(verbParam == "charts_cache_filters_eval")	sverb.charts_cache_filters_eval = 1;
@@ -8160,6 +8253,12 @@ void set_context_config() {
 	if(!opt_mysql_enable_new_store) {
 		opt_mysql_enable_set_id = false;
 	}
+	
+	if(opt_preprocess_packets_qring_usleep != 10 ||
+	   opt_process_rtp_packets_qring_usleep != 10 ||
+	   rtp_qring_usleep != 100) {
+		syslog(LOG_NOTICE, "options preprocess_packets_qring_usleep, process_rtp_packets_qring_usleep and rtp_qring_usleep are obsolete and ignored - queues wait by qring_wait_spin");
+	}
  
 	if(opt_scanpcapdir[0]) {
 		sniffer_mode = snifferMode_read_from_files;
@@ -8375,6 +8474,13 @@ void set_context_config() {
 		}
 	}
 	
+	if((opt_pcap_queue_iface_tpacket_v3 || opt_pcap_queue_iface_af_xdp) && 
+	   !opt_scanpcapdir[0] && !opt_pb_read_from_file[0] && !opt_pcap_queue_use_blocks &&
+	   !is_sender() && !is_client_packetbuffer_sender()) {
+		opt_pcap_queue_use_blocks = 1;
+		syslog(LOG_NOTICE, "enabling pcap_queue_use_blocks because set %s", opt_pcap_queue_iface_af_xdp ? "af_xdp" : "tpacket_v3");
+	}
+	
 	if(!opt_scanpcapdir[0] && !opt_pcap_queue_use_blocks && opt_pcap_queue_use_blocks_auto_enable) {
 		if(opt_udpfrag) {
 			if(is_receiver() || is_server()) {
@@ -8402,7 +8508,7 @@ void set_context_config() {
 	}
 	
 	if(getThreadingMode() < 2 && 
-	   (ifnamev.size() > 1 || opt_pcap_queue_use_blocks)) {
+	   (ifnamev.size() > 1 || opt_pcap_queue_use_blocks || opt_pcap_queue_iface_fanout > 1)) {
 		syslog(LOG_NOTICE, "set threading mode 2");
 		setThreadingMode(2);
 	}
@@ -9169,6 +9275,9 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "rtpthreads_start", NULL))) {
 		num_threads_start = atoi(value);
 	}
+	if((value = ini.GetValue("general", "rtp_threads_balance", NULL))) {
+		opt_rtp_threads_balance = yesno(value);
+	}
 	if((value = ini.GetValue("general", "rtptimeout", NULL))) {
 		rtptimeout = atoi(value);
 	}
@@ -9283,6 +9392,9 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "deduplicate_ipheader_ignore_ttl", NULL))) {
 		opt_dup_check_ipheader_ignore_ttl = yesno(value);
 	}
+	if((value = ini.GetValue("general", "deduplicate_window", NULL))) {
+		opt_dup_check_window_ms = atoi(value);
+	}
 	if((value = ini.GetValue("general", "dscp", NULL))) {
 		opt_dscp = yesno(value);
 	}
@@ -9580,6 +9692,9 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "libsrtp", NULL))) {
 		opt_use_libsrtp = yesno(value);
 	}
+	if((value = ini.GetValue("general", "srtp_evp", NULL))) {
+		opt_srtp_evp = yesno(value);
+	}
 	if((value = ini.GetValue("general", "norecord-header", NULL))) {
 		opt_norecord_header = yesno(value);
 	}
@@ -10093,6 +10208,9 @@ int eval_config(string inistr) {
 			break;
 		}
 	}
+	if((value = ini.GetValue("general", "jitterbuffer_deferred_threads", NULL))) {
+		opt_jitterbuffer_deferred_threads = atoi(value);
+	}
 	if((value = ini.GetValue("general", "sqlcallend", NULL))) {
 		opt_callend = yesno(value);
 	}
@@ -10250,6 +10368,15 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "packetbuffer_file_path", NULL))) {
 		opt_pcap_queue_disk_folder = value;
 	}
+	if((value = ini.GetValue("general", "packetbuffer_file_async_io", NULL))) {
+		opt_pcap_queue_disk_async_io = yesno(value);
+	}
+	if((value = ini.GetValue("general", "packetbuffer_file_async_inflight", NULL))) {
+		opt_pcap_queue_disk_async_inflight = max(atoi(value), 1);
+	}
+	if((value = ini.GetValue("general", "packetbuffer_file_async_readahead", NULL))) {
+		opt_pcap_queue_disk_async_readahead = max(atoi(value), 1);
+	}
 	/*
 	DEFAULT VALUES
 	if((value = ini.GetValue("general", "packetbuffer_file_maxfilesize", NULL))) {
@@ -10270,11 +10397,22 @@ int eval_config(string inistr) {
 			opt_pcap_queue_compress_method = pcap_block_store::snappy;
 		} else if(!strcmp(_opt_pcap_queue_compress_method, "lz4")) {
 			opt_pcap_queue_compress_method = pcap_block_store::lz4;
+		} else if(!strcmp(_opt_pcap_queue_compress_method, "zstd")) {
+			opt_pcap_queue_compress_method = pcap_block_store::zstd;
 		}
 	}
 	if((value = ini.GetValue("general", "packetbuffer_compress_ratio", NULL))) {
 		opt_pcap_queue_compress_ratio = atoi(value);
 	}
+	if((value = ini.GetValue("general", "packetbuffer_compress_threads", NULL))) {
+		opt_pcap_queue_compress_threads = atoi(value);
+	}
+	if((value = ini.GetValue("general", "packetbuffer_compress_zstd_level", NULL))) {
+		opt_pcap_queue_compress_zstd_level = atoi(value);
+	}
+	if((value = ini.GetValue("general", "packetbuffer_compress_zstd_dict", NULL))) {
+		strcpy_null_term(opt_pcap_queue_compress_zstd_dict, value);
+	}
 	if((value = ini.GetValue("general", "mirror_destination_ip", NULL)) &&
 	   (value2 = ini.GetValue("general", "mirror_destination_port", NULL))) {
 		opt_pcap_queue_send_to_ip_port.set_ip(value);
@@ -10379,6 +10517,9 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "ssl_ignore_tcp_handshake", NULL))) {
 		opt_ssl_ignore_tcp_handshake = yesno(value);
 	}
+	if((value = ini.GetValue("general", "ssl_reassembly_threads", NULL))) {
+		opt_ssl_reassembly_threads = atoi(value);
+	}
 	if((value = ini.GetValue("general", "ssl_log_errors", NULL))) {
 		opt_ssl_log_errors = yesno(value);
 	}
@@ -10398,6 +10539,12 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "ssl_store_sessions_expiration_hours", NULL))) {
 		opt_ssl_store_sessions_expiration_hours = atoi(value);
 	}
+	if((value = ini.GetValue("general", "ssl_sessionkey_cache", NULL))) {
+		opt_ssl_sessionkey_cache = yesno(value);
+	}
+	if((value = ini.GetValue("general", "ssl_sessionkey_cache_snapshot", NULL))) {
+		opt_ssl_sessionkey_cache_snapshot = value;
+	}
 	if((value = ini.GetValue("general", "tcpreassembly_http_log", NULL))) {
 		strcpy_null_term(opt_tcpreassembly_http_log, value);
 	}
@@ -10436,6 +10583,33 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "auto_enable_use_blocks", NULL))) {
 		opt_pcap_queue_use_blocks_auto_enable = yesno(value);
 	}
+	if((value = ini.GetValue("general", "tpacket_v3", NULL))) {
+		opt_pcap_queue_iface_tpacket_v3 = yesno(value);
+	}
+	if((value = ini.GetValue("general", "tpacket_v3_block_size", NULL))) {
+		opt_pcap_queue_iface_tpacket_v3_block_size = atoi(value);
+	}
+	if((value = ini.GetValue("general", "tpacket_v3_block_timeout", NULL))) {
+		opt_pcap_queue_iface_tpacket_v3_block_timeout = atoi(value);
+	}
+	if((value = ini.GetValue("general", "interface_fanout", NULL))) {
+		opt_pcap_queue_iface_fanout = atoi(value);
+	}
+	if((value = ini.GetValue("general", "af_xdp", NULL))) {
+		opt_pcap_queue_iface_af_xdp = yesno(value);
+	}
+	if((value = ini.GetValue("general", "af_xdp_native", NULL))) {
+		opt_pcap_queue_iface_af_xdp_native = yesno(value);
+	}
+	if((value = ini.GetValue("general", "af_xdp_umem_size", NULL))) {
+		opt_pcap_queue_iface_af_xdp_umem_size = atoi(value);
+	}
+	if((value = ini.GetValue("general", "kernel_prefilter", NULL))) {
+		opt_pcap_queue_iface_kernel_prefilter = yesno(value);
+	}
+	if((value = ini.GetValue("general", "kernel_prefilter_max_endpoints", NULL))) {
+		opt_pcap_queue_iface_kernel_prefilter_max_endpoints = atoi(value);
+	}
 	if((value = ini.GetValue("general", "pcap_dispatch", NULL))) {
 		opt_pcap_dispatch = yesno(value);
 	}
@@ -10796,6 +10970,9 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "hash_queue_length_ms", NULL))) {
 		opt_hash_modify_queue_length_ms = atoi(value);
 	}
+	if((value = ini.GetValue("general", "hash_rtp_rcu", NULL))) {
+		opt_hash_rtp_rcu = yesno(value);
+	}
 	if((value = ini.GetValue("general", "disable_process_sdp", NULL))) {
 		opt_disable_process_sdp = yesno(value);
 	}
@@ -10873,9 +11050,15 @@ int eval_config(string inistr) {
 	if((value = ini.GetValue("general", "process_rtp_packets_qring_force_push", NULL))) {
 		opt_process_rtp_packets_qring_force_push = yesno(value);
 	}
+	if((value = ini.GetValue("general", "qring_wait_spin", NULL))) {
+		opt_qring_wait_spin = atoi(value);
+	}
 	if((value = ini.GetValue("general", "cleanup_calls_period", NULL))) {
 		opt_cleanup_calls_period = atoi(value);
 	}
+	if((value = ini.GetValue("general", "cleanup_calls_wheel", NULL))) {
+		opt_cleanup_calls_wheel = yesno(value);
+	}
 	if((value = ini.GetValue("general", "destroy_calls_period", NULL))) {
 		opt_destroy_calls_period = atoi(value);
 	}
@@ -11012,6 +11195,9 @@ int eval_config(string inistr) {
 			opt_hugepages_second_heap = yesno(value);
 		}
 	}
+	if((value = ini.GetValue("general", "slab_alloc", NULL))) {
+		opt_slab_alloc = yesno(value);
+	}
 	if((value = ini.GetValue("general", "numa_balancing_set", NULL))) {
 		if(!strcasecmp(value, "autodisable")) {
 			opt_numa_balancing_set = numa_balancing_set_autodisable;
@@ -4,22 +4,22 @@
 #include "websocket.h"
 
 
-u_char *cWebSocketHeader::decodeData(bool *allocData, unsigned dataLength) {
-	if(isMask()) {
-		if(dataLength) {
-			if(dataLength > getHeaderLength()) {
-				dataLength -= getHeaderLength();
-			} else {
-				*allocData = false;
-				return(NULL);
-			}
-		} else {
-			dataLength = getDataLength();
+u_char *cWebSocketHeader::decodeData(bool *allocData, unsigned *dataLength) {
+	if(!isFin()) {
+		unsigned messageLength;
+		unsigned messageDataLength;
+		if(getMessageLength(&messageLength, &messageDataLength)) {
+			*allocData = true;
+			u_char *data = new FILE_LINE(0) u_char[messageDataLength ? messageDataLength : 1];
+			*dataLength = decodeMessageTo(data);
+			return(data);
 		}
+	}
+	*dataLength = getDataLength();
+	if(isMask()) {
 		*allocData = true;
-		u_char *data = new FILE_LINE(0) u_char[dataLength];
-		memcpy(data, getData(), dataLength);
-		xorData(data, dataLength, (const char*)getMask(), 4, 0);
+		u_char *data = new FILE_LINE(0) u_char[*dataLength ? *dataLength : 1];
+		websocket_unmask(data, getData(), *dataLength, getMask());
 		return(data);
 	} else {
 		*allocData = false;
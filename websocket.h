@@ -2,6 +2,9 @@
 #define WEBSOCKET_H
 
 
+#include "websocket_unmask.h"
+
+
 class cWebSocketHeader {
 public:
 	struct sFixHeader {
@@ -54,13 +57,20 @@ public:
 		case 1:
 			return(htons(*(u_int16_t*)(header + 2)));
 		case 2:
-			return(htonl(*(u_int64_t*)(header + 2)));
+			return(((u_int64_t)ntohl(*(u_int32_t*)(header + 2)) << 32) |
+			       ntohl(*(u_int32_t*)(header + 6)));
 		}
 		return(((sFixHeader*)header)->payload_len);
 	}
 	bool isMask() {
 		return(((sFixHeader*)header)->mask);
 	}
+	bool isFin() {
+		return(((sFixHeader*)header)->fin);
+	}
+	bool isControl() {
+		return(((sFixHeader*)header)->opcode & 0x08);
+	}
 	u_char *getMask() {
 		return(isMask() ?
 			header + sizeof(sFixHeader) + getExtendedLengthSize() :
@@ -74,14 +84,100 @@ public:
 	u_char *getData() {
 		return(header + getHeaderLength());
 	}
-	u_char *decodeData(bool *allocData, unsigned dataLength = 0);
 	bool isHeaderSizeOk() {
 		return(size >= sizeof(sFixHeader) &&
 		       size >= getHeaderLength());
 	}
 	bool isDataSizeOk() {
-		return(size == (getHeaderLength() + getDataLength()));
+		if(isFin()) {
+			return(size == (getHeaderLength() + getDataLength()));
+		}
+		unsigned messageLength;
+		return(getMessageLength(&messageLength) &&
+		       messageLength == size);
+	}
+	/* The message fragmented to more frames (the first frame without fin, continuation frames to the frame with fin,
+	   control frames can be between them) is walked from the header. Returns false if the message is not complete
+	   in size, otherwise the length of all its frames and the length of its data (payload of data frames). */
+	bool getMessageLength(unsigned *messageLength, unsigned *messageDataLength = NULL) {
+		unsigned pos = 0;
+		unsigned dataLength = 0;
+		while(true) {
+			cWebSocketHeader frame(header + pos, size - pos);
+			if(!frame.isHeaderSizeOk() ||
+			   frame.getDataLength() > frame.size - frame.getHeaderLength()) {
+				return(false);
+			}
+			pos += frame.getHeaderLength() + frame.getDataLength();
+			if(!frame.isControl()) {
+				dataLength += frame.getDataLength();
+				if(frame.isFin()) {
+					break;
+				}
+			}
+		}
+		*messageLength = pos;
+		if(messageDataLength) {
+			*messageDataLength = dataLength;
+		}
+		return(true);
+	}
+	/* Unmasked payload of the data frames of the message (or of the single frame) is written contiguously to dst,
+	   returns its length. dst can be the header itself - the payload is then moved to the place of the headers
+	   in the buffer without any copy to other buffer. */
+	unsigned decodeMessageTo(u_char *dst) {
+		unsigned pos = 0;
+		unsigned dataLength = 0;
+		while(pos < size) {
+			cWebSocketHeader frame(header + pos, size - pos);
+			if(!frame.isHeaderSizeOk()) {
+				break;
+			}
+			// in place the header of frame can be overwritten by the data - everything is read before
+			unsigned frameHeaderLength = frame.getHeaderLength();
+			unsigned frameDataLength = frame.getDataLength() < frame.size - frameHeaderLength ?
+						    frame.getDataLength() :
+						    frame.size - frameHeaderLength;
+			bool frameControl = frame.isControl();
+			bool frameFin = frame.isFin();
+			if(!frameControl) {
+				if(frame.isMask()) {
+					websocket_unmask(dst + dataLength, frame.getData(), frameDataLength, frame.getMask());
+				} else if(dst + dataLength != frame.getData()) {
+					memmove(dst + dataLength, frame.getData(), frameDataLength);
+				}
+				dataLength += frameDataLength;
+			}
+			pos += frameHeaderLength + frameDataLength;
+			if(!frameControl && frameFin) {
+				break;
+			}
+		}
+		return(dataLength);
+	}
+	unsigned decodeDataInPlace() {
+		return(decodeMessageTo(header));
+	}
+	// decoded first bytes of the data of the first frame (for check of the content), availLength is the size of data with header
+	unsigned decodeDataPrefix(u_char *dst, unsigned dstSize, unsigned availLength) {
+		if(availLength <= getHeaderLength()) {
+			return(0);
+		}
+		u_int64_t length = availLength - getHeaderLength();
+		if(length > getDataLength()) {
+			length = getDataLength();
+		}
+		if(length > dstSize) {
+			length = dstSize;
+		}
+		if(isMask()) {
+			websocket_unmask(dst, getData(), length, getMask());
+		} else {
+			memcpy(dst, getData(), length);
+		}
+		return(length);
 	}
+	u_char *decodeData(bool *allocData, unsigned *dataLength);
 public:
 	u_char *header;
 	unsigned size;
@@ -92,7 +188,8 @@ bool check_websocket_header(char *data, unsigned len, bool checkDataSize = true)
 unsigned websocket_header_length(char *data, unsigned len);
 
 inline bool check_websocket_first_byte(char *data, unsigned len) {
-	return(len > 0 && (u_char)data[0] == 0x81);
+	// text frame with fin or the first frame of the fragmented text message
+	return(len > 0 && ((u_char)data[0] == 0x81 || (u_char)data[0] == 0x01));
 }
 inline bool check_websocket_first_byte(u_char *data, unsigned len) {
 	return(check_websocket_first_byte((char*)data, len));
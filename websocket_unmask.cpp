@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include "websocket_unmask.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__SSE2__)
+#define WEBSOCKET_UNMASK_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define WEBSOCKET_UNMASK_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+
+// the tail from pos - pos is multiple of 4 so that the bytes of mask32 are in the order of the mask
+static inline void websocket_unmask_tail(u_char *dst, const u_char *src, u_int64_t pos, u_int64_t length, u_int32_t mask32) {
+	u_int64_t mask64 = mask32 | ((u_int64_t)mask32 << 32);
+	for(; pos + 8 <= length; pos += 8) {
+		u_int64_t d;
+		memcpy(&d, src + pos, 8);
+		d ^= mask64;
+		memcpy(dst + pos, &d, 8);
+	}
+	for(; pos < length; pos++) {
+		dst[pos] = src[pos] ^ ((u_char*)&mask32)[pos & 3];
+	}
+}
+
+static void websocket_unmask_scalar(u_char *dst, const u_char *src, u_int64_t length, u_int32_t mask32) {
+	websocket_unmask_tail(dst, src, 0, length, mask32);
+}
+
+#if WEBSOCKET_UNMASK_SSE2
+static void websocket_unmask_sse2(u_char *dst, const u_char *src, u_int64_t length, u_int32_t mask32) {
+	const __m128i mask = _mm_set1_epi32(mask32);
+	u_int64_t pos = 0;
+	for(; pos + 32 <= length; pos += 32) {
+		__m128i v0 = _mm_loadu_si128((const __m128i*)(src + pos));
+		__m128i v1 = _mm_loadu_si128((const __m128i*)(src + pos + 16));
+		_mm_storeu_si128((__m128i*)(dst + pos), _mm_xor_si128(v0, mask));
+		_mm_storeu_si128((__m128i*)(dst + pos + 16), _mm_xor_si128(v1, mask));
+	}
+	if(pos + 16 <= length) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + pos));
+		_mm_storeu_si128((__m128i*)(dst + pos), _mm_xor_si128(v, mask));
+		pos += 16;
+	}
+	websocket_unmask_tail(dst, src, pos, length, mask32);
+}
+#endif
+
+#if WEBSOCKET_UNMASK_AVX2
+__attribute__((target("avx2")))
+static void websocket_unmask_avx2(u_char *dst, const u_char *src, u_int64_t length, u_int32_t mask32) {
+	const __m256i mask = _mm256_set1_epi32(mask32);
+	u_int64_t pos = 0;
+	for(; pos + 64 <= length; pos += 64) {
+		__m256i v0 = _mm256_loadu_si256((const __m256i*)(src + pos));
+		__m256i v1 = _mm256_loadu_si256((const __m256i*)(src + pos + 32));
+		_mm256_storeu_si256((__m256i*)(dst + pos), _mm256_xor_si256(v0, mask));
+		_mm256_storeu_si256((__m256i*)(dst + pos + 32), _mm256_xor_si256(v1, mask));
+	}
+	if(pos + 32 <= length) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(src + pos));
+		_mm256_storeu_si256((__m256i*)(dst + pos), _mm256_xor_si256(v, mask));
+		pos += 32;
+	}
+	if(pos + 16 <= length) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + pos));
+		_mm_storeu_si128((__m128i*)(dst + pos), _mm_xor_si128(v, _mm256_castsi256_si128(mask)));
+		pos += 16;
+	}
+	websocket_unmask_tail(dst, src, pos, length, mask32);
+}
+#endif
+
+struct sWebsocketUnmaskImplementation {
+	void (*unmask)(u_char *dst, const u_char *src, u_int64_t length, u_int32_t mask32);
+	const char *name;
+};
+
+static sWebsocketUnmaskImplementation websocket_unmask_select() {
+	sWebsocketUnmaskImplementation impl;
+	impl.unmask = websocket_unmask_scalar;
+	impl.name = "scalar";
+	#if WEBSOCKET_UNMASK_SSE2
+	impl.unmask = websocket_unmask_sse2;
+	impl.name = "sse2";
+	#endif
+	#if WEBSOCKET_UNMASK_AVX2
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		impl.unmask = websocket_unmask_avx2;
+		impl.name = "avx2";
+	}
+	#endif
+	return(impl);
+}
+
+static sWebsocketUnmaskImplementation websocketUnmaskImplementation = websocket_unmask_select();
+
+
+void websocket_unmask(u_char *dst, const u_char *src, u_int64_t length, const u_char *mask) {
+	// the mask is read before the unmasking - in place it can be in the bytes overwritten by the payload
+	u_int32_t mask32;
+	memcpy(&mask32, mask, 4);
+	if(length < 16 || !websocketUnmaskImplementation.unmask) {
+		// also in the time before the static initialization of this unit
+		websocket_unmask_scalar(dst, src, length, mask32);
+		return;
+	}
+	websocketUnmaskImplementation.unmask(dst, src, length, mask32);
+}
+
+const char *websocket_unmask_implementation() {
+	return(websocketUnmaskImplementation.name);
+}
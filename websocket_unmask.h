@@ -0,0 +1,17 @@
+#ifndef WEBSOCKET_UNMASK_H
+#define WEBSOCKET_UNMASK_H
+
+
+#include <sys/types.h>
+
+
+/* Unmasking of websocket payload (xor with the 4 bytes mask of the frame). The mask is replicated to the whole vector
+   and the payload is processed in blocks of 32 bytes with AVX2 (when the cpu supports it, the choice is made once at
+   runtime because the sniffer is built for the generic -march) or 16 bytes with SSE2, the tail in 8 bytes words and
+   single bytes. The block is loaded before it is stored so that dst may be the same as src or overlap it from the
+   lower address - the payloads of several frames can be unmasked in place to one contiguous message. */
+void websocket_unmask(u_char *dst, const u_char *src, u_int64_t length, const u_char *mask);
+const char *websocket_unmask_implementation();
+
+
+#endif //WEBSOCKET_UNMASK_H
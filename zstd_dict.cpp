@@ -0,0 +1,333 @@
+#include "voipmonitor.h"
+
+#include <stdio.h>
+#include <syslog.h>
+#include <sstream>
+#ifdef HAVE_LIBZSTD
+#include <zdict.h>
+#include <zstd_errors.h>
+#endif //HAVE_LIBZSTD
+
+#include "zstd_dict.h"
+#include "tools.h"
+
+
+extern int opt_pcap_queue_compress_zstd_level;
+extern char opt_pcap_queue_compress_zstd_dict[1024];
+
+
+cZstdDictionary zstdDictionary;
+
+#ifdef HAVE_LIBZSTD
+// contexts of compress / decompress threads - freed at the exit of the thread
+static __thread ZSTD_CCtx *zstdThreadCCtx;
+static __thread ZSTD_DCtx *zstdThreadDCtx;
+static pthread_key_t zstdThreadKey;
+static pthread_once_t zstdThreadKeyOnce = PTHREAD_ONCE_INIT;
+
+static void zstd_thread_exit(void *) {
+	if(zstdThreadCCtx) {
+		ZSTD_freeCCtx(zstdThreadCCtx);
+		zstdThreadCCtx = NULL;
+	}
+	if(zstdThreadDCtx) {
+		ZSTD_freeDCtx(zstdThreadDCtx);
+		zstdThreadDCtx = NULL;
+	}
+}
+
+static void zstd_thread_key_init() {
+	pthread_key_create(&zstdThreadKey, zstd_thread_exit);
+}
+
+static void zstd_thread_register() {
+	pthread_once(&zstdThreadKeyOnce, zstd_thread_key_init);
+	pthread_setspecific(zstdThreadKey, (void*)1);
+}
+#endif //HAVE_LIBZSTD
+
+
+cZstdDictionary::cZstdDictionary() {
+	active = NULL;
+	initLoadDone = false;
+	trainState = train_na;
+	samples = NULL;
+	samplesSize = 0;
+	samplesSizeMax = 0;
+	trainDictSize = 0;
+	_sync = 0;
+}
+
+cZstdDictionary::~cZstdDictionary() {
+	#ifdef HAVE_LIBZSTD
+	for(std::list<sDict>::iterator iter = dicts.begin(); iter != dicts.end(); iter++) {
+		ZSTD_freeCDict(iter->cdict);
+		ZSTD_freeDDict(iter->ddict);
+	}
+	#endif //HAVE_LIBZSTD
+	if(samples) {
+		delete [] samples;
+	}
+}
+
+std::string cZstdDictionary::getFileName() {
+	if(opt_pcap_queue_compress_zstd_dict[0]) {
+		return(opt_pcap_queue_compress_zstd_dict);
+	}
+	return(std::string(getSpoolDir(tsf_main, 0)) + "/" + ZSTD_DICT_FILE_NAME);
+}
+
+bool cZstdDictionary::load(std::string *error) {
+	#ifdef HAVE_LIBZSTD
+	std::string fileName = getFileName();
+	FILE *file = fopen(fileName.c_str(), "r");
+	if(!file) {
+		if(error) {
+			*error = "failed open dictionary file " + fileName;
+		}
+		return(false);
+	}
+	std::string dictData;
+	char buff[16 * 1024];
+	size_t readLength;
+	while((readLength = fread(buff, 1, sizeof(buff), file)) > 0) {
+		dictData.append(buff, readLength);
+	}
+	fclose(file);
+	unsigned id = ZSTD_getDictID_fromDict(dictData.data(), dictData.length());
+	if(!id) {
+		if(error) {
+			*error = "bad dictionary file " + fileName;
+		}
+		return(false);
+	}
+	lock();
+	for(std::list<sDict>::iterator iter = dicts.begin(); iter != dicts.end(); iter++) {
+		if(iter->id == id) {
+			active = &(*iter);
+			unlock();
+			return(true);
+		}
+	}
+	unlock();
+	sDict dict;
+	dict.id = id;
+	dict.fileName = fileName;
+	dict.cdict = ZSTD_createCDict(dictData.data(), dictData.length(), opt_pcap_queue_compress_zstd_level);
+	dict.ddict = ZSTD_createDDict(dictData.data(), dictData.length());
+	if(!dict.cdict || !dict.ddict) {
+		ZSTD_freeCDict(dict.cdict);
+		ZSTD_freeDDict(dict.ddict);
+		if(error) {
+			*error = "failed create dictionary from file " + fileName;
+		}
+		return(false);
+	}
+	lock();
+	dicts.push_back(dict);
+	active = &dicts.back();
+	unlock();
+	syslog(LOG_NOTICE, "packetbuffer: zstd dictionary %u loaded from %s", id, fileName.c_str());
+	return(true);
+	#else
+	if(error) {
+		*error = "zstd is not supported";
+	}
+	return(false);
+	#endif //HAVE_LIBZSTD
+}
+
+void cZstdDictionary::initLoad() {
+	lock();
+	bool doLoad = !initLoadDone;
+	initLoadDone = true;
+	unlock();
+	if(doLoad && opt_pcap_queue_compress_zstd_dict[0]) {
+		std::string error;
+		if(!load(&error)) {
+			syslog(LOG_ERR, "packetbuffer: %s - zstd compression without dictionary", error.c_str());
+		}
+	}
+}
+
+bool cZstdDictionary::startTraining(size_t samplesSize, size_t dictSize, std::string *error) {
+	#ifdef HAVE_LIBZSTD
+	lock();
+	if(trainState == train_collect || trainState == train_run) {
+		unlock();
+		if(error) {
+			*error = "training is already in progress";
+		}
+		return(false);
+	}
+	if(samples) {
+		delete [] samples;
+	}
+	this->samplesSizeMax = samplesSize ? samplesSize : ZSTD_DICT_TRAIN_SAMPLES_SIZE_DEFAULT;
+	this->samples = new FILE_LINE(0) u_char[this->samplesSizeMax];
+	this->samplesSize = 0;
+	this->samplesLengths.clear();
+	this->trainDictSize = dictSize ? dictSize : ZSTD_DICT_TRAIN_DICT_SIZE_DEFAULT;
+	this->trainResult = "";
+	this->trainState = train_collect;
+	unlock();
+	return(true);
+	#else
+	if(error) {
+		*error = "zstd is not supported";
+	}
+	return(false);
+	#endif //HAVE_LIBZSTD
+}
+
+void cZstdDictionary::addTrainingSamples(const u_char * const *data, const u_int32_t *lengths, unsigned count) {
+	// one lock for the packets of the whole block
+	bool startTrain = false;
+	lock();
+	if(trainState != train_collect) {
+		unlock();
+		return;
+	}
+	for(unsigned i = 0; i < count; i++) {
+		size_t length = lengths[i] > ZSTD_DICT_TRAIN_SAMPLE_MAX_SIZE ? ZSTD_DICT_TRAIN_SAMPLE_MAX_SIZE : lengths[i];
+		if(samplesSize + length > samplesSizeMax) {
+			trainState = train_run;
+			startTrain = true;
+			break;
+		}
+		memcpy(samples + samplesSize, data[i], length);
+		samplesSize += length;
+		samplesLengths.push_back(length);
+	}
+	unlock();
+	if(startTrain) {
+		pthread_t thread;
+		vm_pthread_create_autodestroy("zstd dictionary training",
+					      &thread, NULL, trainThread, this, __FILE__, __LINE__);
+	}
+}
+
+void *cZstdDictionary::trainThread(void *arg) {
+	((cZstdDictionary*)arg)->train();
+	return(NULL);
+}
+
+void cZstdDictionary::train() {
+	#ifdef HAVE_LIBZSTD
+	size_t *lengths = new FILE_LINE(0) size_t[samplesLengths.size()];
+	unsigned count = 0;
+	for(std::list<size_t>::iterator iter = samplesLengths.begin(); iter != samplesLengths.end(); iter++) {
+		lengths[count++] = *iter;
+	}
+	u_char *dict = new FILE_LINE(0) u_char[trainDictSize];
+	size_t dictLength = ZDICT_trainFromBuffer(dict, trainDictSize, samples, lengths, count);
+	std::string result;
+	bool ok = false;
+	if(ZDICT_isError(dictLength)) {
+		result = std::string("training failed: ") + ZDICT_getErrorName(dictLength);
+	} else {
+		std::string fileName = getFileName();
+		FILE *file = fopen(fileName.c_str(), "w");
+		if(file && fwrite(dict, 1, dictLength, file) == dictLength) {
+			std::ostringstream outStr;
+			outStr << "dictionary " << ZDICT_getDictID(dict, dictLength)
+			       << " (" << dictLength << " B from " << count << " samples) saved to " << fileName;
+			result = outStr.str();
+			ok = true;
+		} else {
+			result = "failed write dictionary file " + fileName;
+		}
+		if(file) {
+			fclose(file);
+		}
+	}
+	delete [] lengths;
+	delete [] dict;
+	syslog(ok ? LOG_NOTICE : LOG_ERR, "packetbuffer: zstd %s", result.c_str());
+	lock();
+	delete [] samples;
+	samples = NULL;
+	samplesLengths.clear();
+	trainResult = result;
+	trainState = ok ? train_done : train_failed;
+	unlock();
+	#endif //HAVE_LIBZSTD
+}
+
+std::string cZstdDictionary::getStatusString() {
+	std::ostringstream outStr;
+	lock();
+	if(active) {
+		outStr << "active dictionary: " << active->id << " (" << active->fileName << ")";
+	} else {
+		outStr << "active dictionary: none";
+	}
+	outStr << ", loaded: " << dicts.size() << std::endl;
+	switch(trainState) {
+	case train_na:
+		break;
+	case train_collect:
+		outStr << "training: collecting samples " << samplesSize << " / " << samplesSizeMax << " B" << std::endl;
+		break;
+	case train_run:
+		outStr << "training: running" << std::endl;
+		break;
+	case train_done:
+	case train_failed:
+		outStr << "training: " << trainResult << std::endl;
+		break;
+	}
+	unlock();
+	return(outStr.str());
+}
+
+#ifdef HAVE_LIBZSTD
+size_t cZstdDictionary::compress(void *dst, size_t dstCapacity, const void *src, size_t srcSize) {
+	if(!zstdThreadCCtx) {
+		zstdThreadCCtx = ZSTD_createCCtx();
+		zstd_thread_register();
+	}
+	ZSTD_CCtx *cctx = zstdThreadCCtx;
+	if(!initLoadDone) {
+		initLoad();
+	}
+	sDict *dict = active;
+	return(dict ?
+		ZSTD_compress_usingCDict(cctx, dst, dstCapacity, src, srcSize, dict->cdict) :
+		ZSTD_compressCCtx(cctx, dst, dstCapacity, src, srcSize, opt_pcap_queue_compress_zstd_level));
+}
+
+size_t cZstdDictionary::decompress(void *dst, size_t dstCapacity, const void *src, size_t srcSize) {
+	if(!zstdThreadDCtx) {
+		zstdThreadDCtx = ZSTD_createDCtx();
+		zstd_thread_register();
+	}
+	ZSTD_DCtx *dctx = zstdThreadDCtx;
+	if(!initLoadDone) {
+		initLoad();
+	}
+	unsigned id = ZSTD_getDictID_fromFrame(src, srcSize);
+	if(!id) {
+		return(ZSTD_decompressDCtx(dctx, dst, dstCapacity, src, srcSize));
+	}
+	ZSTD_DDict *ddict = NULL;
+	lock();
+	for(std::list<sDict>::iterator iter = dicts.begin(); iter != dicts.end(); iter++) {
+		if(iter->id == id) {
+			ddict = iter->ddict;
+			break;
+		}
+	}
+	unlock();
+	if(!ddict) {
+		static u_int64_t lastTimeLogErr = 0;
+		u_int64_t actTime = getTimeMS();
+		if(actTime - 1000 > lastTimeLogErr) {
+			syslog(LOG_ERR, "packetbuffer: zstd dictionary %u is not loaded", id);
+			lastTimeLogErr = actTime;
+		}
+		return((size_t)-ZSTD_error_dictionary_wrong);
+	}
+	return(ZSTD_decompress_usingDDict(dctx, dst, dstCapacity, src, srcSize, ddict));
+}
+#endif //HAVE_LIBZSTD
@@ -0,0 +1,88 @@
+#ifndef ZSTD_DICT_H
+#define ZSTD_DICT_H
+
+
+#include <string>
+#include <list>
+#include <sys/types.h>
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif //HAVE_LIBZSTD
+
+#include "tools_global.h"
+
+
+#define ZSTD_DICT_FILE_NAME "packetbuffer_zstd.dict"
+#define ZSTD_DICT_TRAIN_SAMPLES_SIZE_DEFAULT (16 * 1024 * 1024)
+#define ZSTD_DICT_TRAIN_DICT_SIZE_DEFAULT (112 * 1024)
+#define ZSTD_DICT_TRAIN_SAMPLE_MAX_SIZE 4096
+
+
+/* Dictionaries for zstd compression of packetbuffer blocks. The dictionary loaded last is used for compression,
+   all loaded dictionaries stay available for decompression and are selected by the dictionary id in the zstd frame
+   (blocks in the disk buffer may be compressed with a previous one). Training collects packets from blocks which are
+   being compressed, trains in own thread and saves the dictionary to file. The new dictionary is not used until
+   the next load because the receiving side of the mirror must have the same dictionary. */
+class cZstdDictionary {
+public:
+	struct sDict {
+		unsigned id;
+		std::string fileName;
+		#ifdef HAVE_LIBZSTD
+		ZSTD_CDict *cdict;
+		ZSTD_DDict *ddict;
+		#endif //HAVE_LIBZSTD
+	};
+	enum eTrainState {
+		train_na,
+		train_collect,
+		train_run,
+		train_done,
+		train_failed
+	};
+public:
+	cZstdDictionary();
+	~cZstdDictionary();
+	bool load(std::string *error = NULL);
+	bool startTraining(size_t samplesSize, size_t dictSize, std::string *error = NULL);
+	inline bool isCollecting() {
+		return(trainState == train_collect);
+	}
+	void addTrainingSamples(const u_char * const *data, const u_int32_t *lengths, unsigned count);
+	std::string getStatusString();
+	std::string getFileName();
+	#ifdef HAVE_LIBZSTD
+	size_t compress(void *dst, size_t dstCapacity, const void *src, size_t srcSize);
+	size_t decompress(void *dst, size_t dstCapacity, const void *src, size_t srcSize);
+	#endif //HAVE_LIBZSTD
+private:
+	void initLoad();
+	void train();
+	static void *trainThread(void *arg);
+	void lock() {
+		while(__sync_lock_test_and_set(&this->_sync, 1)) {
+			USLEEP(10);
+		}
+	}
+	void unlock() {
+		__sync_lock_release(&this->_sync);
+	}
+private:
+	std::list<sDict> dicts;
+	sDict * volatile active;
+	volatile bool initLoadDone;
+	volatile eTrainState trainState;
+	u_char *samples;
+	size_t samplesSize;
+	size_t samplesSizeMax;
+	std::list<size_t> samplesLengths;
+	size_t trainDictSize;
+	std::string trainResult;
+	volatile int _sync;
+};
+
+
+extern cZstdDictionary zstdDictionary;
+
+
+#endif //ZSTD_DICT_H